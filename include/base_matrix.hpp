@@ -59,6 +59,116 @@ struct is_type_a_matrix : std::false_type
 
 
 
+//-------------------------------------------------------------------
+/**
+ * @brief Trait to check if a matrix type stores its elements in one
+ *        contiguous row-major block of memory exposed through data(),
+ *        with consecutive rows row_stride() elements apart
+ *
+ * Algorithms like the dense matrix multiplication kernel use this
+ * to work directly on the raw memory instead of going through at()
+ *
+ * Views that keep the storage of the matrix they view (like a ROI)
+ * propagate this trait, but depending on their parameters (for example
+ * a reversed ROI) their data() can return nullptr, in which case the
+ * algorithms fall back to at()
+ *
+ * @tparam MatrixType The matrix type to check.
+ */
+//-------------------------------------------------------------------
+template<typename MatrixType>
+struct has_contiguous_storage : std::false_type
+{
+};
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+/**
+ * @brief Trait to check if every row of a matrix type is contiguous in
+ *        memory, exposed through row_data() and row_span()
+ *
+ * It's true for every type with contiguous storage, and for views that
+ * keep whole rows without them being evenly spaced (like row selectors).
+ * Like data(), row_data() can return nullptr depending on the parameters
+ * of a view.
+ *
+ * @tparam MatrixType The matrix type to check.
+ */
+//-------------------------------------------------------------------
+template<typename MatrixType>
+struct has_contiguous_rows : has_contiguous_storage<MatrixType>
+{
+};
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+/**
+ * @brief Trait to check if a matrix type has a get_version() function
+ *        returning a number that changes whenever its data is written
+ *        (through its begin_write()/end_write() protocol)
+ *
+ * Views that cache values computed from a matrix use it to know when
+ * their cache is stale.
+ *
+ * @tparam MatrixType The matrix type to check.
+ */
+//-------------------------------------------------------------------
+template<typename MatrixType>
+struct has_data_version : std::false_type
+{
+};
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+/**
+ * @brief A contiguous row of a matrix, used to loop over it with a
+ *        raw pointer (empty when the row is not contiguous).
+ *
+ * @tparam DataType The type of the elements (const for read-only rows).
+ */
+//-------------------------------------------------------------------
+template<typename DataType>
+struct RowSpan
+{
+    DataType* pointer = nullptr;        ///< First element of the row.
+    uintptr_t length = 0;               ///< Number of elements in the row.
+
+    DataType* data()const { return pointer; }
+    uintptr_t size()const { return length; }
+    bool empty()const { return length == 0; }
+
+    DataType* begin()const { return pointer; }
+    DataType* end()const { return pointer + length; }
+
+    DataType& operator[](uintptr_t index)const { return pointer[index]; }
+};
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+/**
+ * @brief Creates a RowSpan, empty if the pointer is nullptr.
+ */
+//-------------------------------------------------------------------
+template<typename DataType>
+inline RowSpan<DataType> make_row_span(DataType* pointer, uintptr_t length)
+{
+    if(pointer == nullptr)
+        return RowSpan<DataType>();
+
+    return RowSpan<DataType>{pointer, length};
+}
+//-------------------------------------------------------------------
+
+
+
 //-------------------------------------------------------------------
 /**
  * @brief Base class for matrix expressions.
@@ -193,6 +303,29 @@ public:
         }
     }
 
+    // Raw access to contiguous rows (only for types with has_contiguous_rows)
+    decltype(auto) row_data(int64_t row)const
+    {
+        auto pointer = underlying().data();
+        return pointer ? pointer + row * underlying().row_stride() : pointer;
+    }
+
+    decltype(auto) row_data(int64_t row)
+    {
+        auto pointer = underlying().data();
+        return pointer ? pointer + row * underlying().row_stride() : pointer;
+    }
+
+    auto row_span(int64_t row)const
+    {
+        return make_row_span(underlying().row_data(row), this->columns());
+    }
+
+    auto row_span(int64_t row)
+    {
+        return make_row_span(underlying().row_data(row), this->columns());
+    }
+
     // Functions used to handle row and column header names
     std::string get_row_header(int64_t row_index) const { return underlying().get_row_header(row_index); }
     std::string get_column_header(int64_t column_index) const { return underlying().get_column_header(column_index); }
@@ -282,6 +415,18 @@ public:
         return (*this)(circ_index);
     }
 
+    // Raw access to contiguous rows (only for types with has_contiguous_rows)
+    decltype(auto) row_data(int64_t row)const
+    {
+        auto pointer = underlying().data();
+        return pointer ? pointer + row * underlying().row_stride() : pointer;
+    }
+
+    auto row_span(int64_t row)const
+    {
+        return make_row_span(underlying().row_data(row), this->columns());
+    }
+
     // Functions used to handle row and column header names
     std::string get_row_header(int64_t row_index) const { return underlying().get_row_header(row_index); }
     std::string get_column_header(int64_t column_index) const { return underlying().get_column_header(column_index); }
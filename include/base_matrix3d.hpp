@@ -26,6 +26,7 @@
 #include <iostream>
 #include <cstdint>
 #include "page_and_row_and_column_headers.hpp"
+#include "base_matrix.hpp"
 //-------------------------------------------------------------------
 
 
@@ -206,6 +207,19 @@ public:
         }
     }
 
+    // Raw access to contiguous rows (only for types with has_contiguous_storage)
+    auto row_span(int64_t page, int64_t row)const
+    {
+        auto pointer = underlying().data();
+        return make_row_span(pointer ? pointer + page * underlying().page_stride() + row * underlying().row_stride() : pointer, this->columns());
+    }
+
+    auto row_span(int64_t page, int64_t row)
+    {
+        auto pointer = underlying().data();
+        return make_row_span(pointer ? pointer + page * underlying().page_stride() + row * underlying().row_stride() : pointer, this->columns());
+    }
+
     // Functions used to handle row and column header names
     std::string get_page_header(int64_t page_index) const { return underlying().get_page_header(page_index); }
     std::string get_row_header(int64_t row_index) const { return underlying().get_row_header(row_index); }
@@ -316,6 +330,13 @@ public:
         return (*this)(circ_index);
     }
 
+    // Raw access to contiguous rows (only for types with has_contiguous_storage)
+    auto row_span(int64_t page, int64_t row)const
+    {
+        auto pointer = underlying().data();
+        return make_row_span(pointer ? pointer + page * underlying().page_stride() + row * underlying().row_stride() : pointer, this->columns());
+    }
+
     // Functions used to handle row and column header names
     std::string get_page_header(int64_t page_index) const { return underlying().get_page_header(page_index); }
     std::string get_row_header(int64_t row_index) const { return underlying().get_row_header(row_index); }
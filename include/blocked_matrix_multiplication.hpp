@@ -0,0 +1,532 @@
+//-------------------------------------------------------------------
+/**
+ * @file blocked_matrix_multiplication.hpp
+ * @brief Cache-blocked dense matrix multiplication kernel for matrices
+ *        with contiguous row-major storage.
+ *
+ * The product is computed the way optimized BLAS libraries do it:
+ * - The right matrix is split into kc x nc blocks and the left matrix
+ *   into mc x kc blocks, sized to stay in the L3/L2 caches.
+ * - Each block is packed into a contiguous buffer of thin panels
+ *   (mr rows of the left block, nr columns of the right block), so
+ *   that the innermost loop only reads memory sequentially.
+ * - A register-blocked micro-kernel computes an mr x nr tile of the
+ *   result keeping all the accumulators in registers. With AVX2/FMA
+ *   (see the LazyMatrix_ENABLE_AVX2 cmake option) float and double
+ *   use hand written intrinsics kernels, every other arithmetic type
+ *   uses a portable kernel the compiler can auto-vectorize.
+ * - The result tiles are computed in parallel on the library thread pool.
+ *
+ * @author Vincenzo Barbato
+ *
+ * Additional Information:
+ * - GitHub Project: [LazyMatrix](https://github.com/navyenzo/LazyMatrix.git)
+ * - LinkedIn: [Vincenzo Barbato](https://www.linkedin.com/in/vincenzobarbato/)
+ */
+//-------------------------------------------------------------------
+
+
+
+#ifndef INCLUDE_BLOCKED_MATRIX_MULTIPLICATION_HPP_
+#define INCLUDE_BLOCKED_MATRIX_MULTIPLICATION_HPP_
+
+
+
+//-------------------------------------------------------------------
+// Includes
+//-------------------------------------------------------------------
+#include <cstdint>
+#include <vector>
+#include <algorithm>
+#include <type_traits>
+
+#include "thread_pool.hpp"
+
+#if defined(__AVX2__) && (defined(__FMA__) || defined(_MSC_VER))
+    #include <immintrin.h>
+    #define LAZYMATRIX_GEMM_USE_AVX2
+#endif
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+// Define every thing within the namespace LazyMatrix
+//-------------------------------------------------------------------
+namespace LazyMatrix
+{
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+/**
+ * @brief Block sizes used by the blocked matrix multiplication.
+ *
+ * - mr x nr is the size of the result tile computed by the micro-kernel
+ * - mc x kc is the size of the packed block of the left matrix (L2 cache)
+ * - kc x nc is the size of the packed block of the right matrix (L3 cache)
+ *
+ * mc must be a multiple of mr and nc a multiple of nr.
+ *
+ * When multithreaded, the result is split into tiles of mc x tile_columns
+ * (a multiple of nr) computed in parallel, as long as the product needs at
+ * least minimum_multiplications_per_thread multiply-adds.
+ *
+ * @tparam DataType The type of the matrix elements.
+ */
+//-------------------------------------------------------------------
+template<typename DataType>
+
+struct BlockedMatrixMultiplicationParameters
+{
+    static constexpr uintptr_t mr = 4;
+    static constexpr uintptr_t nr = 4;
+    static constexpr uintptr_t mc = 96;
+    static constexpr uintptr_t kc = 256;
+    static constexpr uintptr_t nc = 2048;
+    static constexpr uintptr_t tile_columns = 256;
+    static constexpr double minimum_multiplications_per_thread = 64.0 * 64.0 * 64.0;
+};
+
+
+
+#if defined(LAZYMATRIX_GEMM_USE_AVX2)
+
+// 6x8 doubles = 12 ymm accumulators
+template<>
+
+struct BlockedMatrixMultiplicationParameters<double>
+{
+    static constexpr uintptr_t mr = 6;
+    static constexpr uintptr_t nr = 8;
+    static constexpr uintptr_t mc = 96;
+    static constexpr uintptr_t kc = 256;
+    static constexpr uintptr_t nc = 2048;
+    static constexpr uintptr_t tile_columns = 256;
+    static constexpr double minimum_multiplications_per_thread = 64.0 * 64.0 * 64.0;
+};
+
+// 6x16 floats = 12 ymm accumulators
+template<>
+
+struct BlockedMatrixMultiplicationParameters<float>
+{
+    static constexpr uintptr_t mr = 6;
+    static constexpr uintptr_t nr = 16;
+    static constexpr uintptr_t mc = 96;
+    static constexpr uintptr_t kc = 384;
+    static constexpr uintptr_t nc = 2048;
+    static constexpr uintptr_t tile_columns = 256;
+    static constexpr double minimum_multiplications_per_thread = 64.0 * 64.0 * 64.0;
+};
+
+#endif
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+/**
+ * @brief Packs an mc x kc block of a row-major matrix into panels of
+ *        mr rows, each panel stored column by column (mr values per
+ *        column). The last panel is padded with zeros.
+ */
+//-------------------------------------------------------------------
+template<uintptr_t MR, typename DataType>
+
+inline void pack_left_matrix_block(uintptr_t mc,
+                                   uintptr_t kc,
+                                   const DataType* a,
+                                   uintptr_t lda,
+                                   DataType* packed_a)
+{
+    for(uintptr_t i = 0; i < mc; i += MR)
+    {
+        uintptr_t number_of_rows = std::min(MR, mc - i);
+
+        for(uintptr_t p = 0; p < kc; ++p)
+        {
+            for(uintptr_t r = 0; r < number_of_rows; ++r)
+                *packed_a++ = a[(i + r) * lda + p];
+
+            for(uintptr_t r = number_of_rows; r < MR; ++r)
+                *packed_a++ = static_cast<DataType>(0);
+        }
+    }
+}
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+/**
+ * @brief Packs a kc x nc block of a row-major matrix into panels of
+ *        nr columns, each panel stored row by row (nr values per
+ *        row). The last panel is padded with zeros.
+ */
+//-------------------------------------------------------------------
+template<uintptr_t NR, typename DataType>
+
+inline void pack_right_matrix_block(uintptr_t kc,
+                                    uintptr_t nc,
+                                    const DataType* b,
+                                    uintptr_t ldb,
+                                    DataType* packed_b)
+{
+    for(uintptr_t j = 0; j < nc; j += NR)
+    {
+        uintptr_t number_of_columns = std::min(NR, nc - j);
+
+        for(uintptr_t p = 0; p < kc; ++p)
+        {
+            const DataType* b_row = b + p * ldb + j;
+
+            for(uintptr_t c = 0; c < number_of_columns; ++c)
+                *packed_b++ = b_row[c];
+
+            for(uintptr_t c = number_of_columns; c < NR; ++c)
+                *packed_b++ = static_cast<DataType>(0);
+        }
+    }
+}
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+/**
+ * @brief Portable micro-kernel: c[0:m, 0:n] += packed_a * packed_b
+ *        where packed_a is an mr x kc panel and packed_b a kc x nr panel.
+ *
+ * The fixed size accumulator lets the compiler keep it in registers
+ * and vectorize the inner loop.
+ */
+//-------------------------------------------------------------------
+template<uintptr_t MR, uintptr_t NR, typename DataType>
+
+inline void generic_matrix_multiplication_micro_kernel(uintptr_t kc,
+                                                       const DataType* packed_a,
+                                                       const DataType* packed_b,
+                                                       DataType* c,
+                                                       uintptr_t ldc,
+                                                       uintptr_t m,
+                                                       uintptr_t n)
+{
+    DataType accumulator[MR][NR] = {};
+
+    for(uintptr_t p = 0; p < kc; ++p)
+    {
+        for(uintptr_t i = 0; i < MR; ++i)
+        {
+            const DataType a_value = packed_a[i];
+
+            for(uintptr_t j = 0; j < NR; ++j)
+                accumulator[i][j] += a_value * packed_b[j];
+        }
+
+        packed_a += MR;
+        packed_b += NR;
+    }
+
+    for(uintptr_t i = 0; i < m; ++i)
+        for(uintptr_t j = 0; j < n; ++j)
+            c[i * ldc + j] += accumulator[i][j];
+}
+//-------------------------------------------------------------------
+
+
+
+#if defined(LAZYMATRIX_GEMM_USE_AVX2)
+
+//-------------------------------------------------------------------
+/**
+ * @brief AVX2/FMA 6x8 micro-kernel for doubles.
+ */
+//-------------------------------------------------------------------
+inline void avx2_matrix_multiplication_micro_kernel(uintptr_t kc,
+                                                    const double* packed_a,
+                                                    const double* packed_b,
+                                                    double* c,
+                                                    uintptr_t ldc,
+                                                    uintptr_t m,
+                                                    uintptr_t n)
+{
+    __m256d accumulator[6][2];
+
+    for(int i = 0; i < 6; ++i)
+    {
+        accumulator[i][0] = _mm256_setzero_pd();
+        accumulator[i][1] = _mm256_setzero_pd();
+    }
+
+    for(uintptr_t p = 0; p < kc; ++p)
+    {
+        __m256d b0 = _mm256_loadu_pd(packed_b);
+        __m256d b1 = _mm256_loadu_pd(packed_b + 4);
+
+        for(int i = 0; i < 6; ++i)
+        {
+            __m256d a_value = _mm256_broadcast_sd(packed_a + i);
+            accumulator[i][0] = _mm256_fmadd_pd(a_value, b0, accumulator[i][0]);
+            accumulator[i][1] = _mm256_fmadd_pd(a_value, b1, accumulator[i][1]);
+        }
+
+        packed_a += 6;
+        packed_b += 8;
+    }
+
+    if(m == 6 && n == 8)
+    {
+        for(int i = 0; i < 6; ++i)
+        {
+            double* c_row = c + i * ldc;
+            _mm256_storeu_pd(c_row, _mm256_add_pd(_mm256_loadu_pd(c_row), accumulator[i][0]));
+            _mm256_storeu_pd(c_row + 4, _mm256_add_pd(_mm256_loadu_pd(c_row + 4), accumulator[i][1]));
+        }
+    }
+    else
+    {
+        // Edge tile, only part of the result is inside the matrix
+        alignas(32) double tile[6][8];
+
+        for(int i = 0; i < 6; ++i)
+        {
+            _mm256_store_pd(&tile[i][0], accumulator[i][0]);
+            _mm256_store_pd(&tile[i][4], accumulator[i][1]);
+        }
+
+        for(uintptr_t i = 0; i < m; ++i)
+            for(uintptr_t j = 0; j < n; ++j)
+                c[i * ldc + j] += tile[i][j];
+    }
+}
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+/**
+ * @brief AVX2/FMA 6x16 micro-kernel for floats.
+ */
+//-------------------------------------------------------------------
+inline void avx2_matrix_multiplication_micro_kernel(uintptr_t kc,
+                                                    const float* packed_a,
+                                                    const float* packed_b,
+                                                    float* c,
+                                                    uintptr_t ldc,
+                                                    uintptr_t m,
+                                                    uintptr_t n)
+{
+    __m256 accumulator[6][2];
+
+    for(int i = 0; i < 6; ++i)
+    {
+        accumulator[i][0] = _mm256_setzero_ps();
+        accumulator[i][1] = _mm256_setzero_ps();
+    }
+
+    for(uintptr_t p = 0; p < kc; ++p)
+    {
+        __m256 b0 = _mm256_loadu_ps(packed_b);
+        __m256 b1 = _mm256_loadu_ps(packed_b + 8);
+
+        for(int i = 0; i < 6; ++i)
+        {
+            __m256 a_value = _mm256_broadcast_ss(packed_a + i);
+            accumulator[i][0] = _mm256_fmadd_ps(a_value, b0, accumulator[i][0]);
+            accumulator[i][1] = _mm256_fmadd_ps(a_value, b1, accumulator[i][1]);
+        }
+
+        packed_a += 6;
+        packed_b += 16;
+    }
+
+    if(m == 6 && n == 16)
+    {
+        for(int i = 0; i < 6; ++i)
+        {
+            float* c_row = c + i * ldc;
+            _mm256_storeu_ps(c_row, _mm256_add_ps(_mm256_loadu_ps(c_row), accumulator[i][0]));
+            _mm256_storeu_ps(c_row + 8, _mm256_add_ps(_mm256_loadu_ps(c_row + 8), accumulator[i][1]));
+        }
+    }
+    else
+    {
+        // Edge tile, only part of the result is inside the matrix
+        alignas(32) float tile[6][16];
+
+        for(int i = 0; i < 6; ++i)
+        {
+            _mm256_store_ps(&tile[i][0], accumulator[i][0]);
+            _mm256_store_ps(&tile[i][8], accumulator[i][1]);
+        }
+
+        for(uintptr_t i = 0; i < m; ++i)
+            for(uintptr_t j = 0; j < n; ++j)
+                c[i * ldc + j] += tile[i][j];
+    }
+}
+//-------------------------------------------------------------------
+
+#endif
+
+
+
+//-------------------------------------------------------------------
+/**
+ * @brief Calls the best micro-kernel available for the data type.
+ */
+//-------------------------------------------------------------------
+template<typename DataType>
+
+inline void matrix_multiplication_micro_kernel(uintptr_t kc,
+                                               const DataType* packed_a,
+                                               const DataType* packed_b,
+                                               DataType* c,
+                                               uintptr_t ldc,
+                                               uintptr_t m,
+                                               uintptr_t n)
+{
+#if defined(LAZYMATRIX_GEMM_USE_AVX2)
+    if constexpr (std::is_same_v<DataType, double> || std::is_same_v<DataType, float>)
+    {
+        avx2_matrix_multiplication_micro_kernel(kc, packed_a, packed_b, c, ldc, m, n);
+        return;
+    }
+    else
+#endif
+    {
+        using parameters = BlockedMatrixMultiplicationParameters<DataType>;
+
+        generic_matrix_multiplication_micro_kernel<parameters::mr, parameters::nr>(kc, packed_a, packed_b, c, ldc, m, n);
+    }
+}
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+/**
+ * @brief Computes c += a * b for row-major matrices stored contiguously.
+ *
+ * For every kc x nc block of b, the result is split into tiles of mc rows
+ * by tile_columns columns which are computed in parallel on the thread pool.
+ * Each result element belongs to a single tile and the blocks of the shared
+ * dimension are processed in order, so the result is exactly the same no
+ * matter how many threads are used.
+ *
+ * @tparam DataType Arithmetic type of the matrix elements.
+ * @param m Number of rows of a and c.
+ * @param n Number of columns of b and c.
+ * @param k Number of columns of a and rows of b.
+ * @param a Pointer to the first element of the m x k left matrix.
+ * @param lda Distance (in elements) between consecutive rows of a.
+ * @param b Pointer to the first element of the k x n right matrix.
+ * @param ldb Distance (in elements) between consecutive rows of b.
+ * @param c Pointer to the first element of the m x n result matrix.
+ * @param ldc Distance (in elements) between consecutive rows of c.
+ * @param thread_pool Thread pool used to compute the result tiles.
+ */
+//-------------------------------------------------------------------
+template<typename DataType>
+
+inline void blocked_matrix_multiply_add(uintptr_t m,
+                                        uintptr_t n,
+                                        uintptr_t k,
+                                        const DataType* a,
+                                        uintptr_t lda,
+                                        const DataType* b,
+                                        uintptr_t ldb,
+                                        DataType* c,
+                                        uintptr_t ldc,
+                                        ThreadPool& thread_pool = get_default_thread_pool())
+{
+    static_assert(std::is_arithmetic_v<DataType>, "blocked_matrix_multiply_add needs an arithmetic data type");
+
+    using parameters = BlockedMatrixMultiplicationParameters<DataType>;
+
+    constexpr uintptr_t MR = parameters::mr;
+    constexpr uintptr_t NR = parameters::nr;
+
+    if(m == 0 || n == 0 || k == 0)
+        return;
+
+    // Small products are not worth the cost of waking up other threads
+    bool should_use_multiple_threads = (double(m) * double(n) * double(k) >= parameters::minimum_multiplications_per_thread);
+
+    // The packing buffer never needs to be bigger than the matrix
+    uintptr_t maximum_nc = std::min(parameters::nc, ((n + NR - 1) / NR) * NR);
+    uintptr_t maximum_kc = std::min(parameters::kc, k);
+
+    std::vector<DataType> packed_b(maximum_kc * maximum_nc);
+
+    for(uintptr_t jc = 0; jc < n; jc += parameters::nc)
+    {
+        uintptr_t nc = std::min(parameters::nc, n - jc);
+
+        for(uintptr_t pc = 0; pc < k; pc += parameters::kc)
+        {
+            uintptr_t kc = std::min(parameters::kc, k - pc);
+
+            pack_right_matrix_block<NR>(kc, nc, b + pc * ldb + jc, ldb, packed_b.data());
+
+            uintptr_t number_of_row_blocks = (m + parameters::mc - 1) / parameters::mc;
+            uintptr_t number_of_column_tiles = (nc + parameters::tile_columns - 1) / parameters::tile_columns;
+
+            auto multiply_tile = [&](uintptr_t tile_index)
+            {
+                uintptr_t ic = (tile_index / number_of_column_tiles) * parameters::mc;
+                uintptr_t jt = (tile_index % number_of_column_tiles) * parameters::tile_columns;
+
+                uintptr_t mc = std::min(parameters::mc, m - ic);
+                uintptr_t tc = std::min(parameters::tile_columns, nc - jt);
+
+                // Every thread keeps its own packing buffer for the left matrix
+                thread_local std::vector<DataType> packed_a;
+
+                if(packed_a.size() < parameters::mc * parameters::kc)
+                    packed_a.resize(parameters::mc * parameters::kc);
+
+                pack_left_matrix_block<MR>(mc, kc, a + ic * lda + pc, lda, packed_a.data());
+
+                for(uintptr_t jr = jt; jr < jt + tc; jr += NR)
+                {
+                    for(uintptr_t ir = 0; ir < mc; ir += MR)
+                    {
+                        matrix_multiplication_micro_kernel(kc,
+                                                           packed_a.data() + ir * kc,
+                                                           packed_b.data() + jr * kc,
+                                                           c + (ic + ir) * ldc + jc + jr,
+                                                           ldc,
+                                                           std::min(MR, mc - ir),
+                                                           std::min(NR, nc - jr));
+                    }
+                }
+            };
+
+            uintptr_t number_of_tiles = number_of_row_blocks * number_of_column_tiles;
+
+            if(should_use_multiple_threads)
+            {
+                thread_pool.parallel_for(number_of_tiles, multiply_tile);
+            }
+            else
+            {
+                for(uintptr_t tile_index = 0; tile_index < number_of_tiles; ++tile_index)
+                    multiply_tile(tile_index);
+            }
+        }
+    }
+}
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+} // namespace LazyMatrix
+//-------------------------------------------------------------------
+
+
+
+#endif  // INCLUDE_BLOCKED_MATRIX_MULTIPLICATION_HPP_
@@ -31,6 +31,10 @@
 #include <string_view>
 #include <charconv>
 #include <regex>
+#include <limits>
+#include <locale>
+#include <cstdint>
+#include <type_traits>
 
 #include <Poco/Dynamic/Var.h>
 #include <Poco/Dynamic/Struct.h>
@@ -51,6 +55,284 @@ namespace LazyMatrix
 
 
 
+//-------------------------------------------------------------------
+/**
+ * @brief Decimal number split into its components.
+ *
+ * The number represented is (-1)^is_negative * mantissa * 10^exponent.
+ * Only the first 19 significant digits fit in the mantissa, if there
+ * are more, has_truncated_digits is set.
+ */
+//-------------------------------------------------------------------
+struct ParsedDecimalNumber
+{
+    bool is_negative = false;
+    uint64_t mantissa = 0;
+    int64_t exponent = 0;
+    bool has_truncated_digits = false;
+};
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+/**
+ * @brief Checks whether 8 bytes (loaded as a little endian 64-bit
+ *        integer) are all decimal digits.
+ */
+//-------------------------------------------------------------------
+inline bool are_eight_digits(uint64_t eight_characters)
+{
+    return (((eight_characters & 0xF0F0F0F0F0F0F0F0ULL) |
+            (((eight_characters + 0x0606060606060606ULL) & 0xF0F0F0F0F0F0F0F0ULL) >> 4)) == 0x3333333333333333ULL);
+}
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+/**
+ * @brief Converts 8 decimal digits (loaded as a little endian 64-bit
+ *        integer) into their value using SWAR (SIMD within a register)
+ *        multiplications instead of 8 multiply-adds.
+ */
+//-------------------------------------------------------------------
+inline uint32_t parse_eight_digits(uint64_t eight_characters)
+{
+    const uint64_t mask = 0x000000FF000000FFULL;
+    const uint64_t multiplier1 = 0x000F424000000064ULL; // 100 + (1000000 << 32)
+    const uint64_t multiplier2 = 0x0000271000000001ULL; // 1 + (10000 << 32)
+
+    eight_characters -= 0x3030303030303030ULL;
+    eight_characters = (eight_characters * 10) + (eight_characters >> 8);
+    eight_characters = (((eight_characters & mask) * multiplier1) + (((eight_characters >> 16) & mask) * multiplier2)) >> 32;
+
+    return uint32_t(eight_characters);
+}
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+/**
+ * @brief Splits a decimal number into its sign, mantissa and exponent.
+ *
+ * @param begin Pointer to the first character to convert.
+ * @param end Pointer to one past the last character to convert.
+ * @param decimal_point_delimiter Character used to denote the decimal point.
+ * @param number The resulting decimal number components.
+ * @return const char* Pointer to where the conversion ended (begin if there
+ *                     was nothing that looked like a number).
+ *
+ * Digits are accumulated 8 at a time when possible. Like the original
+ * from_string, a number can start with 'e' or 'E' (meaning 10^exponent)
+ * and conversion stops at the first character that can't be part of
+ * the number.
+ */
+//-------------------------------------------------------------------
+inline const char* parse_decimal_number(const char* begin,
+                                        const char* end,
+                                        char decimal_point_delimiter,
+                                        ParsedDecimalNumber& number)
+{
+    number = ParsedDecimalNumber();
+
+    const char* current = begin;
+
+    if(current == end)
+        return begin;
+
+    if(*current == '-' || *current == '+')
+    {
+        number.is_negative = (*current == '-');
+        ++current;
+    }
+
+    auto is_digit = [](char c) { return c >= '0' && c <= '9'; };
+
+    // Number of digits stored in the mantissa (leading zeros are not counted)
+    int number_of_mantissa_digits = 0;
+    bool has_digits = false;
+    bool has_decimal_point_been_encountered_already = false;
+
+    auto add_digit = [&](uint64_t digit)
+    {
+        has_digits = true;
+
+        if(number_of_mantissa_digits < 19)
+        {
+            number.mantissa = number.mantissa * 10 + digit;
+
+            if(number.mantissa != 0)
+                ++number_of_mantissa_digits;
+
+            if(has_decimal_point_been_encountered_already)
+                --number.exponent;
+        }
+        else
+        {
+            // The mantissa is full, the digit only changes the exponent
+            number.has_truncated_digits = number.has_truncated_digits || (digit != 0);
+
+            if(!has_decimal_point_been_encountered_already)
+                ++number.exponent;
+        }
+    };
+
+    while(current < end)
+    {
+#if !defined(__BYTE_ORDER__) || __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+        // Fast path, 8 digits at a time while they fit in the mantissa
+        while(end - current >= 8 && number_of_mantissa_digits <= 11)
+        {
+            uint64_t eight_characters;
+            std::memcpy(&eight_characters, current, sizeof(uint64_t));
+
+            if(!are_eight_digits(eight_characters))
+                break;
+
+            number.mantissa = number.mantissa * 100000000 + parse_eight_digits(eight_characters);
+            number_of_mantissa_digits = (number.mantissa != 0) ? number_of_mantissa_digits + 8 : 0;
+            has_digits = true;
+
+            if(has_decimal_point_been_encountered_already)
+                number.exponent -= 8;
+
+            current += 8;
+        }
+
+        if(current >= end)
+            break;
+#endif
+
+        char current_character = *current;
+
+        if(is_digit(current_character))
+            add_digit(uint64_t(current_character - '0'));
+        else if(current_character == decimal_point_delimiter && !has_decimal_point_been_encountered_already)
+            has_decimal_point_been_encountered_already = true;
+        else
+            break;
+
+        ++current;
+    }
+
+    // Exponent part, only consumed if followed by an actual exponent
+    if(current < end && (*current == 'e' || *current == 'E'))
+    {
+        const char* exponent_position = current + 1;
+
+        bool is_exponent_negative = false;
+
+        if(exponent_position < end && (*exponent_position == '-' || *exponent_position == '+'))
+        {
+            is_exponent_negative = (*exponent_position == '-');
+            ++exponent_position;
+        }
+
+        if(exponent_position < end && is_digit(*exponent_position))
+        {
+            int64_t exponent = 0;
+
+            while(exponent_position < end && is_digit(*exponent_position))
+            {
+                // Cap the exponent, anything this big is already 0 or infinity
+                if(exponent < 100000)
+                    exponent = exponent * 10 + (*exponent_position - '0');
+
+                ++exponent_position;
+            }
+
+            // A number starting with 'e' (or "-e", ".e") means 10^exponent
+            if(!has_digits)
+            {
+                number.mantissa = 1;
+                has_digits = true;
+            }
+
+            number.exponent += is_exponent_negative ? -exponent : exponent;
+            current = exponent_position;
+        }
+    }
+
+    // Without digits there's no number (a lone sign or decimal
+    // point is still reported as consumed, converting to 0)
+    if(!has_digits)
+        number.exponent = 0;
+
+    return current;
+}
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+/**
+ * @brief Exact conversion of a decimal number written in a string,
+ *        used when the fast path of from_string can't be used
+ *        (more than 19 significant digits or very large exponents).
+ */
+//-------------------------------------------------------------------
+template<typename FloatType>
+
+inline FloatType exact_string_to_float(const char* begin,
+                                       const char* end,
+                                       char decimal_point_delimiter,
+                                       const ParsedDecimalNumber& number)
+{
+    // Normalize the number so it can be read by the standard library
+    std::string normalized;
+    normalized.reserve(std::size_t(end - begin) + 1);
+
+    const char* current = begin;
+
+    if(current < end && (*current == '+' || *current == '-'))
+    {
+        if(*current == '-')
+            normalized.push_back('-');
+
+        ++current;
+    }
+
+    bool has_digits = false;
+
+    for(; current < end; ++current)
+    {
+        char c = *current;
+
+        if(c >= '0' && c <= '9')
+            has_digits = true;
+        
+        if((c == 'e' || c == 'E') && !has_digits)
+            normalized.push_back('1');
+
+        normalized.push_back(c == decimal_point_delimiter ? '.' : c);
+    }
+
+    FloatType value = static_cast<FloatType>(0);
+
+#if defined(__cpp_lib_to_chars) && __cpp_lib_to_chars >= 201611L
+    auto result = std::from_chars(normalized.data(), normalized.data() + normalized.size(), value);
+
+    if(result.ec == std::errc::result_out_of_range)
+    {
+        value = (number.exponent > 0) ? std::numeric_limits<FloatType>::infinity() : static_cast<FloatType>(0);
+
+        if(number.is_negative)
+            value = -value;
+    }
+#else
+    std::istringstream stream(normalized);
+    stream.imbue(std::locale::classic());
+    stream >> value;
+#endif
+
+    return value;
+}
+//-------------------------------------------------------------------
+
+
+
 //-------------------------------------------------------------------
 /**
  * @brief Converts a substring of a string to a number.
@@ -65,6 +347,11 @@ namespace LazyMatrix
  *
  * Converts a portion of a string into a numeric value of type NumberType, starting and ending 
  * at specified positions. Handles negative numbers and scientific notation.
+ * The digits are first accumulated into a 64-bit integer mantissa and a power of 10 exponent.
+ * For float and double, when the mantissa and the power of 10 are both exactly representable
+ * (Clinger's fast path, which covers the vast majority of numbers found in CSV files), the
+ * result is a single correctly rounded multiplication or division. Otherwise the number is
+ * converted exactly with std::from_chars.
  */
 //-------------------------------------------------------------------
 template<typename NumberType>
@@ -84,130 +371,79 @@ inline int from_string(NumberType& resulting_converted_number,
         return position_where_to_begin_converting;
     }
 
-    int current_position = position_where_to_begin_converting;
+    const char* begin = string_begin + position_where_to_begin_converting;
+    const char* end = string_begin + position_where_to_end_converting;
 
-    bool is_number_negative = false;
+    ParsedDecimalNumber number;
 
-    bool has_decimal_point_been_encountered_already = false;
-    NumberType decimal_point_multiplier = static_cast<NumberType>(1);
+    const char* end_of_number = parse_decimal_number(begin, end, decimal_point_delimiter, number);
 
-    char current_character = string_begin[current_position];
+    int position_where_conversion_ended = position_where_to_begin_converting + int(end_of_number - begin);
 
-    // The first step is to check the first digit
-    // for special characters
-    if(current_character == '-')
-    {
-        is_number_negative = true;
-        ++current_position;
-    }
-    else if(current_character == '+')
-    {
-        ++current_position;
-    }
-    else if(current_character == decimal_point_delimiter)
-    {
-        has_decimal_point_been_encountered_already = true;
-        ++current_position;
-    }
-    else if(current_character == 'e' || current_character == 'E')
+    if(number.mantissa == 0)
     {
-        // In this case the first character of the
-        // string is an 'e' or 'E' which means that
-        // the number we're converting is an exponent.
-        // Since it is the first character, the number
-        // will be 10^exponent.
-        // Therefore, we find the exponent and then raise
-        // 10 to its power
-        ++current_position;
-        NumberType exponent;
-        current_position = from_string(exponent, string_begin, current_position, position_where_to_end_converting, decimal_point_delimiter);
-
-        resulting_converted_number = std::pow(static_cast<NumberType>(10), exponent);
-
-        return current_position;
+        return position_where_conversion_ended;
     }
 
-    // Now we loop through the remaining elements
-    // of the string and calculate the number
-    // accordingly.
-
-    // NOTE:    Remember that we are looping from left to
-    //          right, so from the highest value digit to
-    //          the lowest value digit (numerically speaking)
-
-    while(current_position < position_where_to_end_converting)
+    if constexpr (std::is_same_v<NumberType, double> || std::is_same_v<NumberType, float>)
     {
-        current_character = string_begin[current_position];
-
-        if(current_character >= '0' && current_character <= '9')
+        // Powers of 10 that are exactly representable
+        static constexpr double exact_powers_of_10[] = {1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,
+                                                        1e8,  1e9,  1e10, 1e11, 1e12, 1e13, 1e14, 1e15,
+                                                        1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+        constexpr bool is_double = std::is_same_v<NumberType, double>;
+        constexpr uint64_t maximum_exact_mantissa = is_double ? (uint64_t(1) << 53) : (uint64_t(1) << 24);
+        constexpr int64_t maximum_exact_exponent = is_double ? 22 : 10;
+
+        if(!number.has_truncated_digits &&
+           number.mantissa <= maximum_exact_mantissa &&
+           number.exponent >= -maximum_exact_exponent &&
+           number.exponent <= maximum_exact_exponent)
         {
-            if(has_decimal_point_been_encountered_already)
-            {
-                // This means that the digit is after the decimal
-                // point, so we add the current digit divided by
-                // its place after the decimal point
-                decimal_point_multiplier *= static_cast<NumberType>(10);
-                resulting_converted_number += (static_cast<NumberType>(current_character - '0') / decimal_point_multiplier);
-            }
-            else
-            {
-                // This means that the digit is before the decimal
-                // point, so we multiply the current number by 10
-                // and add the new digit
-                resulting_converted_number = resulting_converted_number * static_cast<NumberType>(10) + static_cast<NumberType>(current_character - '0');
-            }
+            NumberType value = static_cast<NumberType>(number.mantissa);
+            NumberType power_of_10 = static_cast<NumberType>(exact_powers_of_10[number.exponent < 0 ? -number.exponent : number.exponent]);
+
+            value = (number.exponent < 0) ? value / power_of_10 : value * power_of_10;
+
+            resulting_converted_number = number.is_negative ? -value : value;
         }
-        else if(current_character == decimal_point_delimiter && !has_decimal_point_been_encountered_already)
+        else
         {
-            // This means that we have just found the decimal
-            // point so we just store the fact that we found
-            // it in the boolean flag
-            has_decimal_point_been_encountered_already = true;
+            resulting_converted_number = exact_string_to_float<NumberType>(begin, end_of_number, decimal_point_delimiter, number);
         }
-        else if( current_character == 'e' || current_character == 'E')
-        {
-            // In this case, it means that we're about to multiply
-            // the current number by 10^exponent.
-            // Thus, we find the value of the exponent and
-            // then multiply
-
-            // We calculate the exponent by recursively calling
-            // this function
-            NumberType exponent;
-            int new_position = from_string(exponent, string_begin, current_position + 1, position_where_to_end_converting, decimal_point_delimiter);
-
-            if((current_position - position_where_to_begin_converting == 1) &&
-               (string_begin[current_position - 1] == '-' ||
-                string_begin[current_position - 1] == '+' ||
-                string_begin[current_position - 1] == '.'))
-            {
-                resulting_converted_number = std::pow(static_cast<NumberType>(10), exponent);
-            }
-            else
-                resulting_converted_number = resulting_converted_number * std::pow(static_cast<NumberType>(10), exponent);
-
-            current_position = new_position;
+    }
+    else if constexpr (std::is_floating_point_v<NumberType>)
+    {
+        resulting_converted_number = exact_string_to_float<NumberType>(begin, end_of_number, decimal_point_delimiter, number);
+    }
+    else if constexpr (std::is_integral_v<NumberType>)
+    {
+        // Integers keep the integer part of the number
+        uint64_t value = number.mantissa;
 
-            break;
+        if(number.exponent >= 0)
+        {
+            for(int64_t i = 0; i < number.exponent && i < 20; ++i)
+                value *= 10;
         }
         else
         {
-            // In this case, we found a non-valid character, so
-            // we are done
-            break;
+            for(int64_t i = 0; i < -number.exponent && value != 0; ++i)
+                value /= 10;
         }
 
-        // Advance to the next position in the string
-        ++current_position;
-    }
+        resulting_converted_number = static_cast<NumberType>(value);
 
-    // Check if the number is negative
-    if(is_number_negative)
-        resulting_converted_number *= static_cast<NumberType>(-1);
+        if(number.is_negative)
+            resulting_converted_number = static_cast<NumberType>(static_cast<NumberType>(0) - resulting_converted_number);
+    }
+    else
+    {
+        resulting_converted_number = static_cast<NumberType>(exact_string_to_float<double>(begin, end_of_number, decimal_point_delimiter, number));
+    }
 
-    // Now we return the current position in the string
-    // where we ended the conversion
-    return current_position;
+    return position_where_conversion_ended;
 }
 //-------------------------------------------------------------------
 
@@ -277,12 +513,11 @@ private:
             return;
         }
 
-        if (std::isdigit(*it))
+        if (std::isdigit(*it) || (*it == '.' && (it + 1) != end && std::isdigit(*(it + 1))))
         {
-            std::string number_str;
-            while (it != end && (std::isdigit(*it) || *it == '.')) number_str.push_back(*it++);
-            std::istringstream iss(number_str);
-            iss >> token.value;
+            // Numbers are converted in place with the same parser used for csv entries
+            int number_length = from_string(token.value, &*it, 0, int(end - it), '.');
+            it += number_length;
             token.type = NUMBER;
             return;
         }
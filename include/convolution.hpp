@@ -0,0 +1,545 @@
+//-------------------------------------------------------------------
+/**
+ * @file convolution.hpp
+ * @brief Convolution engine used by the filter function.
+ *
+ * The functions in this file compute the 2D correlation of a matrix with
+ * a filter kernel, working on raw row-major buffers of doubles:
+ *
+ * - The source (or a tile of it) is first copied into a buffer padded by
+ *   half a kernel on every side (repeating the border values), so none of
+ *   the kernels has to check for borders.
+ * - Separable (rank one) kernels, like the ones made by
+ *   create_gaussian_kernel, are applied as a horizontal and a vertical
+ *   1D pass, costing rows + columns multiply-adds per element instead of
+ *   rows * columns.
+ * - Big kernels that are not separable are applied with FFTs.
+ * - Small kernels that are not separable are applied directly.
+ *
+ * The inner loops of the direct and separable kernels run along rows of
+ * the buffers so the compiler can vectorize them.
+ *
+ * @author Vincenzo Barbato
+ *
+ * Additional Information:
+ * - GitHub Project: [LazyMatrix](https://github.com/navyenzo/LazyMatrix.git)
+ * - LinkedIn: [Vincenzo Barbato](https://www.linkedin.com/in/vincenzobarbato/)
+ */
+//-------------------------------------------------------------------
+
+
+
+#ifndef INCLUDE_CONVOLUTION_HPP_
+#define INCLUDE_CONVOLUTION_HPP_
+
+
+
+//-------------------------------------------------------------------
+// Includes
+//-------------------------------------------------------------------
+#include <cstdint>
+#include <cmath>
+#include <complex>
+#include <vector>
+#include <algorithm>
+#include <utility>
+
+#include "unsupported/Eigen/FFT"
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+// Define every thing within the namespace LazyMatrix
+//-------------------------------------------------------------------
+namespace LazyMatrix
+{
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+/**
+ * @brief Methods available to apply a filter kernel.
+ */
+//-------------------------------------------------------------------
+enum class ConvolutionMethod
+{
+    automatic,  ///< Picks one of the methods below based on the kernel.
+    direct,     ///< Multiplies every kernel element with the source.
+    separable,  ///< Two 1D passes (falls back to direct if not separable).
+    fft         ///< Multiplication in the frequency domain.
+};
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+/**
+ * @struct ConvolutionParameters
+ * @brief Tuning parameters used to pick the convolution method.
+ */
+//-------------------------------------------------------------------
+struct ConvolutionParameters
+{
+    // Kernels that aren't separable use FFTs from this many elements
+    static constexpr uintptr_t minimum_fft_kernel_size = 15 * 15;
+
+    // Relative tolerance used to decide if a kernel is separable
+    static constexpr double separability_tolerance = 1e-10;
+
+    // Number of output rows filtered by each parallel task
+    static constexpr uintptr_t tile_rows = 32;
+
+    // FFT tiles have at least this many times the rows of the kernel,
+    // so the halo doesn't dominate the size of the transforms
+    static constexpr uintptr_t fft_tile_rows_per_kernel_row = 4;
+};
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+/**
+ * @brief Splits a kernel into a column and a row kernel if it's separable.
+ *
+ * A kernel is separable when kernel(i,j) == column_kernel[i] * row_kernel[j]
+ * for every element (within the separability tolerance).
+ *
+ * @param kernel Row-major kernel elements.
+ * @param kernel_rows Number of rows of the kernel.
+ * @param kernel_columns Number of columns of the kernel.
+ * @param column_kernel Filled with the vertical 1D kernel.
+ * @param row_kernel Filled with the horizontal 1D kernel.
+ * @return true if the kernel is separable.
+ */
+//-------------------------------------------------------------------
+inline bool separate_kernel(const double* kernel,
+                            uintptr_t kernel_rows,
+                            uintptr_t kernel_columns,
+                            std::vector<double>& column_kernel,
+                            std::vector<double>& row_kernel)
+{
+    // Use the biggest element as pivot to keep the division accurate
+    uintptr_t pivot = 0;
+
+    for(uintptr_t i = 1; i < kernel_rows * kernel_columns; ++i)
+    {
+        if(std::abs(kernel[i]) > std::abs(kernel[pivot]))
+            pivot = i;
+    }
+
+    double maximum_value = std::abs(kernel[pivot]);
+
+    if(maximum_value == 0)
+        return false;
+
+    uintptr_t pivot_row = pivot / kernel_columns;
+    uintptr_t pivot_column = pivot % kernel_columns;
+
+    column_kernel.resize(kernel_rows);
+    row_kernel.resize(kernel_columns);
+
+    for(uintptr_t i = 0; i < kernel_rows; ++i)
+        column_kernel[i] = kernel[i * kernel_columns + pivot_column];
+
+    for(uintptr_t j = 0; j < kernel_columns; ++j)
+        row_kernel[j] = kernel[pivot_row * kernel_columns + j] / kernel[pivot];
+
+    double tolerance = ConvolutionParameters::separability_tolerance * maximum_value;
+
+    for(uintptr_t i = 0; i < kernel_rows; ++i)
+    {
+        for(uintptr_t j = 0; j < kernel_columns; ++j)
+        {
+            if(std::abs(kernel[i * kernel_columns + j] - column_kernel[i] * row_kernel[j]) > tolerance)
+                return false;
+        }
+    }
+
+    return true;
+}
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+/**
+ * @brief Computes rows [row_begin, row_end) of the correlation of a
+ *        padded source with a kernel, one kernel element at a time.
+ *
+ * output(i,j) = sum over (ki,kj) of kernel(ki,kj) * padded(i + ki, j + kj)
+ *
+ * @param padded Row-major padded source.
+ * @param padded_columns Number of columns of the padded source.
+ * @param kernel Row-major kernel elements.
+ * @param kernel_rows Number of rows of the kernel.
+ * @param kernel_columns Number of columns of the kernel.
+ * @param output Row-major output with the given number of columns.
+ * @param columns Number of columns of the output.
+ * @param row_begin First output row to compute.
+ * @param row_end One past the last output row to compute.
+ */
+//-------------------------------------------------------------------
+inline void correlate_direct(const double* padded,
+                             uintptr_t padded_columns,
+                             const double* kernel,
+                             uintptr_t kernel_rows,
+                             uintptr_t kernel_columns,
+                             double* output,
+                             uintptr_t columns,
+                             uintptr_t row_begin,
+                             uintptr_t row_end)
+{
+    for(uintptr_t i = row_begin; i < row_end; ++i)
+    {
+        double* output_row = output + i * columns;
+
+        std::fill(output_row, output_row + columns, 0.0);
+
+        for(uintptr_t ki = 0; ki < kernel_rows; ++ki)
+        {
+            for(uintptr_t kj = 0; kj < kernel_columns; ++kj)
+            {
+                double weight = kernel[ki * kernel_columns + kj];
+                const double* source_row = padded + (i + ki) * padded_columns + kj;
+
+                for(uintptr_t j = 0; j < columns; ++j)
+                    output_row[j] += weight * source_row[j];
+            }
+        }
+    }
+}
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+/**
+ * @brief Horizontal pass of a separable correlation for rows
+ *        [row_begin, row_end) of the intermediate buffer.
+ *
+ * intermediate(r,j) = sum over kj of row_kernel[kj] * padded(r, j + kj)
+ *
+ * The intermediate buffer has columns columns and as many rows as the
+ * padded source.
+ */
+//-------------------------------------------------------------------
+inline void correlate_rows(const double* padded,
+                           uintptr_t padded_columns,
+                           const std::vector<double>& row_kernel,
+                           double* intermediate,
+                           uintptr_t columns,
+                           uintptr_t row_begin,
+                           uintptr_t row_end)
+{
+    for(uintptr_t r = row_begin; r < row_end; ++r)
+    {
+        double* intermediate_row = intermediate + r * columns;
+
+        std::fill(intermediate_row, intermediate_row + columns, 0.0);
+
+        for(uintptr_t kj = 0; kj < row_kernel.size(); ++kj)
+        {
+            double weight = row_kernel[kj];
+            const double* source_row = padded + r * padded_columns + kj;
+
+            for(uintptr_t j = 0; j < columns; ++j)
+                intermediate_row[j] += weight * source_row[j];
+        }
+    }
+}
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+/**
+ * @brief Vertical pass of a separable correlation for output rows
+ *        [row_begin, row_end).
+ *
+ * output(i,j) = sum over ki of column_kernel[ki] * intermediate(i + ki, j)
+ */
+//-------------------------------------------------------------------
+inline void correlate_columns(const double* intermediate,
+                              const std::vector<double>& column_kernel,
+                              double* output,
+                              uintptr_t columns,
+                              uintptr_t row_begin,
+                              uintptr_t row_end)
+{
+    for(uintptr_t i = row_begin; i < row_end; ++i)
+    {
+        double* output_row = output + i * columns;
+
+        std::fill(output_row, output_row + columns, 0.0);
+
+        for(uintptr_t ki = 0; ki < column_kernel.size(); ++ki)
+        {
+            double weight = column_kernel[ki];
+            const double* source_row = intermediate + (i + ki) * columns;
+
+            for(uintptr_t j = 0; j < columns; ++j)
+                output_row[j] += weight * source_row[j];
+        }
+    }
+}
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+/**
+ * @brief Get the smallest number not less than n whose only prime
+ *        factors are 2, 3 and 5, which are sizes the FFT handles fast.
+ */
+//-------------------------------------------------------------------
+inline uintptr_t get_fft_friendly_size(uintptr_t n)
+{
+    for(uintptr_t size = std::max<uintptr_t>(1, n); ; ++size)
+    {
+        uintptr_t remainder = size;
+
+        for(uintptr_t factor : {2, 3, 5})
+        {
+            while(remainder % factor == 0)
+                remainder /= factor;
+        }
+
+        if(remainder == 1)
+            return size;
+    }
+}
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+/**
+ * @brief In place 2D FFT of a row-major buffer of complex numbers.
+ *
+ * @param data Row-major buffer of rows x columns complex numbers.
+ * @param rows Number of rows.
+ * @param columns Number of columns.
+ * @param is_inverse true to compute the (scaled) inverse FFT.
+ */
+//-------------------------------------------------------------------
+inline void fft_2d(std::vector<std::complex<double>>& data,
+                   uintptr_t rows,
+                   uintptr_t columns,
+                   bool is_inverse)
+{
+    Eigen::FFT<double> fft;
+
+    std::vector<std::complex<double>> input;
+    std::vector<std::complex<double>> output;
+
+    auto transform = [&]()
+    {
+        if(is_inverse)
+            fft.inv(output, input);
+        else
+            fft.fwd(output, input);
+    };
+
+    input.resize(columns);
+
+    for(uintptr_t i = 0; i < rows; ++i)
+    {
+        std::copy(data.begin() + i * columns, data.begin() + (i + 1) * columns, input.begin());
+        transform();
+        std::copy(output.begin(), output.end(), data.begin() + i * columns);
+    }
+
+    input.resize(rows);
+
+    for(uintptr_t j = 0; j < columns; ++j)
+    {
+        for(uintptr_t i = 0; i < rows; ++i)
+            input[i] = data[i * columns + j];
+
+        transform();
+
+        for(uintptr_t i = 0; i < rows; ++i)
+            data[i * columns + j] = output[i];
+    }
+}
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+/**
+ * @brief Computes the correlation of a padded source with a kernel
+ *        using FFTs.
+ *
+ * The padded source and the kernel are zero padded to FFT friendly sizes
+ * not smaller than the padded source. The circular correlation computed
+ * in the frequency domain doesn't wrap around for the rows x columns
+ * output elements, so they match the direct correlation.
+ *
+ * @param padded Row-major padded source of
+ *               (rows + kernel_rows - 1) x (columns + kernel_columns - 1).
+ * @param kernel Row-major kernel elements.
+ * @param kernel_rows Number of rows of the kernel.
+ * @param kernel_columns Number of columns of the kernel.
+ * @param output Row-major output of rows x columns.
+ * @param rows Number of rows of the output.
+ * @param columns Number of columns of the output.
+ */
+//-------------------------------------------------------------------
+inline void correlate_fft(const double* padded,
+                          const double* kernel,
+                          uintptr_t kernel_rows,
+                          uintptr_t kernel_columns,
+                          double* output,
+                          uintptr_t rows,
+                          uintptr_t columns)
+{
+    uintptr_t padded_rows = rows + kernel_rows - 1;
+    uintptr_t padded_columns = columns + kernel_columns - 1;
+
+    uintptr_t fft_rows = get_fft_friendly_size(padded_rows);
+    uintptr_t fft_columns = get_fft_friendly_size(padded_columns);
+
+    std::vector<std::complex<double>> source_spectrum(fft_rows * fft_columns);
+    std::vector<std::complex<double>> kernel_spectrum(fft_rows * fft_columns);
+
+    for(uintptr_t i = 0; i < padded_rows; ++i)
+        for(uintptr_t j = 0; j < padded_columns; ++j)
+            source_spectrum[i * fft_columns + j] = padded[i * padded_columns + j];
+
+    for(uintptr_t i = 0; i < kernel_rows; ++i)
+        for(uintptr_t j = 0; j < kernel_columns; ++j)
+            kernel_spectrum[i * fft_columns + j] = kernel[i * kernel_columns + j];
+
+    fft_2d(source_spectrum, fft_rows, fft_columns, false);
+    fft_2d(kernel_spectrum, fft_rows, fft_columns, false);
+
+    // Correlation is multiplication by the conjugate of the kernel spectrum
+    for(uintptr_t i = 0; i < source_spectrum.size(); ++i)
+        source_spectrum[i] *= std::conj(kernel_spectrum[i]);
+
+    fft_2d(source_spectrum, fft_rows, fft_columns, true);
+
+    for(uintptr_t i = 0; i < rows; ++i)
+        for(uintptr_t j = 0; j < columns; ++j)
+            output[i * columns + j] = source_spectrum[i * fft_columns + j].real();
+}
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+/**
+ * @struct ConvolutionKernel
+ * @brief A filter kernel ready to be applied by correlate.
+ *
+ * The method is resolved once when the kernel is created (see
+ * create_convolution_kernel), so it can be applied to many tiles.
+ */
+//-------------------------------------------------------------------
+struct ConvolutionKernel
+{
+    std::vector<double> elements;       ///< Row-major kernel elements.
+    uintptr_t rows = 0;                 ///< Number of rows of the kernel.
+    uintptr_t columns = 0;              ///< Number of columns of the kernel.
+    ConvolutionMethod method = ConvolutionMethod::direct;   ///< Method used to apply the kernel.
+    std::vector<double> column_kernel;  ///< Vertical 1D kernel (separable method only).
+    std::vector<double> row_kernel;     ///< Horizontal 1D kernel (separable method only).
+};
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+/**
+ * @brief Creates a kernel ready to be applied by correlate.
+ *
+ * The automatic method picks the separable method if the kernel is
+ * separable, the FFT method for big kernels and the direct method
+ * otherwise. Asking for the separable method with a kernel that isn't
+ * separable gives the direct method.
+ *
+ * @param elements Row-major kernel elements.
+ * @param rows Number of rows of the kernel.
+ * @param columns Number of columns of the kernel.
+ * @param method Method used to apply the kernel.
+ */
+//-------------------------------------------------------------------
+inline ConvolutionKernel create_convolution_kernel(std::vector<double> elements,
+                                                   uintptr_t rows,
+                                                   uintptr_t columns,
+                                                   ConvolutionMethod method = ConvolutionMethod::automatic)
+{
+    ConvolutionKernel kernel;
+
+    kernel.elements = std::move(elements);
+    kernel.rows = rows;
+    kernel.columns = columns;
+    kernel.method = method;
+
+    if(method == ConvolutionMethod::automatic || method == ConvolutionMethod::separable)
+    {
+        if(separate_kernel(kernel.elements.data(), rows, columns, kernel.column_kernel, kernel.row_kernel))
+            kernel.method = ConvolutionMethod::separable;
+        else if(method == ConvolutionMethod::automatic && rows * columns >= ConvolutionParameters::minimum_fft_kernel_size)
+            kernel.method = ConvolutionMethod::fft;
+        else
+            kernel.method = ConvolutionMethod::direct;
+    }
+
+    return kernel;
+}
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+/**
+ * @brief Computes the correlation of a padded source with a kernel.
+ *
+ * @param kernel The kernel (see create_convolution_kernel).
+ * @param padded Row-major padded source of
+ *               (rows + kernel.rows - 1) x (columns + kernel.columns - 1).
+ * @param output Row-major output of rows x columns.
+ * @param rows Number of rows of the output.
+ * @param columns Number of columns of the output.
+ */
+//-------------------------------------------------------------------
+inline void correlate(const ConvolutionKernel& kernel,
+                      const double* padded,
+                      double* output,
+                      uintptr_t rows,
+                      uintptr_t columns)
+{
+    uintptr_t padded_rows = rows + kernel.rows - 1;
+    uintptr_t padded_columns = columns + kernel.columns - 1;
+
+    if(kernel.method == ConvolutionMethod::separable)
+    {
+        std::vector<double> intermediate(padded_rows * columns);
+
+        correlate_rows(padded, padded_columns, kernel.row_kernel, intermediate.data(), columns, 0, padded_rows);
+        correlate_columns(intermediate.data(), kernel.column_kernel, output, columns, 0, rows);
+    }
+    else if(kernel.method == ConvolutionMethod::fft)
+    {
+        correlate_fft(padded, kernel.elements.data(), kernel.rows, kernel.columns, output, rows, columns);
+    }
+    else
+    {
+        correlate_direct(padded, padded_columns, kernel.elements.data(), kernel.rows, kernel.columns, output, columns, 0, rows);
+    }
+}
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+} // namespace LazyMatrix
+//-------------------------------------------------------------------
+
+
+
+#endif  // INCLUDE_CONVOLUTION_HPP_
@@ -33,6 +33,9 @@
 //-------------------------------------------------------------------
 #include <unordered_map>
 #include <utility>
+#include <vector>
+#include <thread>
+#include <algorithm>
 
 #include <string_view>
 
@@ -41,6 +44,7 @@
 
 #include "base_matrix.hpp"
 #include "convert_numbers.hpp"
+#include "csv_structural_scanner.hpp"
 //-------------------------------------------------------------------
 
 
@@ -111,17 +115,36 @@ public:
     const std::string& get_row_delimiters()const { return row_delimiters_; }
     const std::string& get_column_delimiters()const { return column_delimiters_; }
     char get_decimal_point_delimiter()const { return decimal_point_delimiter_; }
-    void set_string_delimiter(const char& string_delimiter) { string_delimiter_ = string_delimiter; }
-    void set_row_delimiters(const std::string& row_delimiters) { row_delimiters_ = row_delimiters; }
-    void set_column_delimiters(const std::string& column_delimiters) { column_delimiters_ = column_delimiters; }
+    void set_string_delimiter(const char& string_delimiter) { string_delimiter_ = string_delimiter; update_scanner(); }
+    void set_row_delimiters(const std::string& row_delimiters) { row_delimiters_ = row_delimiters; update_scanner(); }
+    void set_column_delimiters(const std::string& column_delimiters) { column_delimiters_ = column_delimiters; update_scanner(); }
     void set_decimal_point_delimiter(char decimal_point_delimiter) { decimal_point_delimiter_ = decimal_point_delimiter; }
 
+    // Row offset index stride, an index entry is stored every "stride" rows
+    // - 1 stores the start of every row, 0 disables the index
+    // - It has to be set before calling load() to take effect
+    uintptr_t get_row_index_stride()const { return row_index_stride_; }
+    void set_row_index_stride(uintptr_t row_index_stride) { row_index_stride_ = row_index_stride; }
+
+    // Number of threads used to count rows/columns and build the row
+    // offset index when loading a file
+    // - 1 loads on the calling thread, 0 uses all hardware threads
+    // - It has to be set before calling load() to take effect
+    uintptr_t get_number_of_loading_threads()const { return number_of_loading_threads_; }
+    void set_number_of_loading_threads(uintptr_t number_of_loading_threads) { number_of_loading_threads_ = number_of_loading_threads; }
+
     uintptr_t rows()const { return rows_; }
     uintptr_t columns()const { return columns_; }
 
     std::string_view string_at(int64_t row, int64_t column)const;
     std::pair<Poco::Dynamic::Var, ResultType> dynamic_at(int64_t row, int64_t column)const;
 
+    // Function used to convert the rows [first_row, last_row) walking each row
+    // only once, it calls function(row, column, value) for every entry
+    // - Missing entries of short rows are reported as DataType(0)
+    template<typename Function>
+    void for_each_value_in_rows(uintptr_t first_row, uintptr_t last_row, Function&& function)const;
+
 
 
     // Function used to load (actually map the file, not load) the data from a CSV file
@@ -141,21 +164,44 @@ private: // Private functions
 
 
     decltype(auto) const_at_(int64_t row, int64_t column)const;
+
+    DataType convert_entry(uintptr_t begin, uintptr_t end)const;
     
     uintptr_t find_end_of_current_row(uintptr_t current_position_in_csv_string)const;
     uintptr_t find_end_of_current_column(uintptr_t current_position_in_csv_string, uintptr_t end_of_row)const;
     
     uintptr_t find_nth_row(uintptr_t row_index)const;
+    uintptr_t skip_non_empty_rows(uintptr_t current_position, uintptr_t number_of_rows_to_skip)const;
     uintptr_t find_nth_column_in_current_row(uintptr_t column_index, uintptr_t current_position, uintptr_t end_of_row)const;
 
-    std::pair<int, int> find_begin_end_indeces_of_csv_entry(uintptr_t row, uintptr_t column)const;
+    std::pair<uintptr_t, uintptr_t> find_begin_end_indeces_of_csv_entry(uintptr_t row, uintptr_t column)const;
 
     uintptr_t count_number_of_columns_for_current_row(uintptr_t start_of_row, uintptr_t end_of_row)const;    
     void count_number_of_rows_and_columns();
 
+    // Rows found in a chunk of the csv data when loading in parallel
+    // - Rows that cross the chunk boundaries are stitched together
+    //   by count_number_of_rows_and_columns
+    struct ChunkRows
+    {
+        bool has_row_delimiter = false;
+        uintptr_t first_row_delimiter = 0;
+        uintptr_t column_delimiters_before_first_row_delimiter = 0;
+
+        std::vector<uintptr_t> non_empty_row_starts;
+        uintptr_t maximum_number_of_columns = 0;
+
+        uintptr_t start_of_last_row = 0;
+        uintptr_t column_delimiters_in_last_row = 0;
+    };
+
+    ChunkRows index_chunk(uintptr_t chunk_begin, uintptr_t chunk_end, bool begins_inside_quotes)const;
+
     void parse_row_headers();
     void parse_column_headers();
 
+    void update_scanner() { scanner_.set_delimiters(string_delimiter_, row_delimiters_, column_delimiters_); }
+
 
 
 private: // Private variables
@@ -167,6 +213,20 @@ private: // Private variables
     // The memory map holding the csv data
     mio::shared_mmap_sink mapped_csv_;
 
+    // Row offset index built at load time
+    // - row_offsets_[k] is the position in the csv string where
+    //   data row (k * row_index_stride_) begins
+    // - first_data_row_position_ is the position right after the
+    //   column headers row (or 0 if there are no column headers)
+    uintptr_t row_index_stride_ = 1;
+    std::vector<uintptr_t> row_offsets_;
+    uintptr_t first_data_row_position_ = 0;
+
+    // Number of threads used when loading the csv file and the
+    // minimum number of bytes each of those threads processes
+    uintptr_t number_of_loading_threads_ = 1;
+    static constexpr uintptr_t minimum_bytes_per_loading_thread_ = 1 << 16;
+
     // Boolean flags used to indicate whether
     // the csv file contains row and column headers
     bool does_first_row_contain_column_header_names_ = false;
@@ -179,6 +239,10 @@ private: // Private variables
     std::string delimiters_to_checkFor_ = ", \n\r";
     char decimal_point_delimiter_ = '.';
 
+    // Vectorized scanner used to find the (unquoted)
+    // row and column delimiters in the csv data
+    CSVStructuralScanner scanner_;
+
     // Empty string returned when a user asks
     // for a row or column name that does not
     // exist
@@ -233,12 +297,8 @@ template<typename DataType>
 inline decltype(auto) CSVMatrix<DataType>::const_at_(int64_t row, int64_t column)const
 {
     auto [begin,end] = find_begin_end_indeces_of_csv_entry(row, column);
-    
-    DataType value;
-    
-    from_string(value, &mapped_csv_.data()[0], begin, end, decimal_point_delimiter_);
 
-    return value;
+    return convert_entry(begin, end);
 }
 
 
@@ -268,6 +328,82 @@ inline decltype(auto) CSVMatrix<Poco::Dynamic::Var>::const_at_(int64_t row, int6
 
 
 
+//-------------------------------------------------------------------
+// Function used to convert the csv entry found
+// between [begin, end) into a number
+//-------------------------------------------------------------------
+template<typename DataType>
+
+inline DataType CSVMatrix<DataType>::convert_entry(uintptr_t begin, uintptr_t end)const
+{
+    DataType value;
+    
+    // We convert relative to the beginning of the entry so that
+    // positions in files larger than 2GB don't overflow
+    from_string(value, &mapped_csv_.data()[begin], 0, int(end - begin), decimal_point_delimiter_);
+
+    return value;
+}
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+// Function used to convert a range of rows walking
+// each row once (instead of looking up every entry
+// from the beginning of its row)
+//-------------------------------------------------------------------
+template<typename DataType>
+template<typename Function>
+
+inline void CSVMatrix<DataType>::for_each_value_in_rows(uintptr_t first_row, uintptr_t last_row, Function&& function)const
+{
+    last_row = std::min<uintptr_t>(last_row, rows_);
+
+    if(first_row >= last_row)
+        return;
+
+    uintptr_t start_of_row = find_nth_row(first_row);
+
+    for(uintptr_t row = first_row; row < last_row && start_of_row < mapped_csv_.size(); )
+    {
+        uintptr_t end_of_row = find_end_of_current_row(start_of_row);
+
+        // Empty rows are not counted as rows
+        if(end_of_row == start_of_row)
+        {
+            ++start_of_row;
+            continue;
+        }
+
+        uintptr_t position = start_of_row;
+
+        if(does_first_column_contain_row_header_names_)
+            position = std::min(find_end_of_current_column(position, end_of_row) + 1, end_of_row + 1);
+
+        uintptr_t column = 0;
+
+        while(column < columns_ && position <= end_of_row)
+        {
+            uintptr_t end_of_column = find_end_of_current_column(position, end_of_row);
+
+            function(row, column, convert_entry(position, end_of_column));
+
+            ++column;
+            position = end_of_column + 1;
+        }
+
+        for(; column < columns_; ++column)
+            function(row, column, static_cast<DataType>(0));
+
+        ++row;
+        start_of_row = end_of_row + 1;
+    }
+}
+//-------------------------------------------------------------------
+
+
+
 //-------------------------------------------------------------------
 // Function used to return a string view looking
 // at the string entry at the user specified (i,j)
@@ -316,9 +452,9 @@ std::pair<Poco::Dynamic::Var, ResultType> CSVMatrix<DataType>::dynamic_at(int64_
 // - This function doesn't load anything, it actually memory maps
 //   the specified CSV file and calculates the number of rows and
 //   columns in the CSV file
-// - It does not cache the locations of the rows and columns as those
-//   are found on the fly
-//   - TODO:  I might add caching at a later point
+// - While counting rows it also builds the row offset index (one
+//   entry every row_index_stride_ rows), the locations of the
+//   columns within a row are still found on the fly
 // - NOTE:  The algorithm does not count zero-sized rows and columns
 //-------------------------------------------------------------------
 template<typename DataType>
@@ -362,16 +498,16 @@ inline std::error_code CSVMatrix<DataType>::load(const std::string& csv_data_fil
 //-------------------------------------------------------------------
 template<typename DataType>
 
-inline std::pair<int, int> CSVMatrix<DataType>::find_begin_end_indeces_of_csv_entry(uintptr_t row, uintptr_t column)const
+inline std::pair<uintptr_t, uintptr_t> CSVMatrix<DataType>::find_begin_end_indeces_of_csv_entry(uintptr_t row, uintptr_t column)const
 {
     uintptr_t nth_row_position_in_csv = find_nth_row(row);
 
     if(nth_row_position_in_csv >= mapped_csv_.size())
-        return std::pair<int, int>(0,0);
+        return std::pair<uintptr_t, uintptr_t>(0,0);
     
     uintptr_t end_of_nth_row = find_end_of_current_row(nth_row_position_in_csv);
 
-    std::pair<int,int> begin_end_of_column;
+    std::pair<uintptr_t,uintptr_t> begin_end_of_column;
 
     begin_end_of_column.first = find_nth_column_in_current_row(column, nth_row_position_in_csv, end_of_nth_row);
 
@@ -480,10 +616,11 @@ inline void CSVMatrix<DataType>::parse_column_headers()
 // - If some rows have a different number of
 //   columns, it uses the maximum number as the
 //   number of columns for the matrix
-// - It does not cache the location of the starting/ending
-//   positions in the csv file of the rows and columns
-//   - TODO:  I might add optional caching of locations of
-//            rows and columns at a later point
+// - It also stores the starting position of every
+//   row_index_stride_ data rows so that find_nth_row
+//   does not have to scan the file from the beginning
+// - The file is split in chunks that are indexed
+//   concurrently by number_of_loading_threads_ threads
 //-------------------------------------------------------------------
 template<typename DataType>
 
@@ -492,27 +629,124 @@ inline void CSVMatrix<DataType>::count_number_of_rows_and_columns()
     rows_ = 0;
     columns_ = 0;
 
+    row_offsets_.clear();
+    first_data_row_position_ = 0;
+
     if(!mapped_csv_.is_open())
         return;
 
-    uintptr_t number_of_columns_in_current_row = 0;
+    // Data rows start right after the column headers row
+    if(does_first_row_contain_column_header_names_)
+    {
+        first_data_row_position_ = find_end_of_current_row(0);
 
-    uintptr_t current_position = 0;
-    uintptr_t end_of_row = 0;
+        if(first_data_row_position_ < mapped_csv_.size())
+            ++first_data_row_position_;
+    }
 
-    while(current_position < mapped_csv_.size())
+    // We split the file in chunks (one per loading thread)
+    uintptr_t file_size = mapped_csv_.size();
+
+    uintptr_t number_of_chunks = number_of_loading_threads_;
+
+    if(number_of_chunks == 0)
+        number_of_chunks = std::max(1u, std::thread::hardware_concurrency());
+
+    number_of_chunks = std::max<uintptr_t>(1, std::min(number_of_chunks, file_size / minimum_bytes_per_loading_thread_));
+
+    std::vector<uintptr_t> chunk_begins(number_of_chunks + 1);
+
+    for(uintptr_t i = 0; i <= number_of_chunks; ++i)
+        chunk_begins[i] = (file_size / number_of_chunks) * i;
+
+    chunk_begins[number_of_chunks] = file_size;
+
+    // First pass: count the quotes of each chunk so that we know
+    // whether each chunk starts inside or outside a quoted entry
+    std::vector<uintptr_t> number_of_quotes(number_of_chunks, 0);
+
+    auto run_on_all_chunks = [&](auto&& function)
     {
-        end_of_row = this->find_end_of_current_row(current_position);
+        std::vector<std::thread> threads;
 
-        number_of_columns_in_current_row = count_number_of_columns_for_current_row(current_position, end_of_row);
+        for(uintptr_t i = 1; i < number_of_chunks; ++i)
+            threads.emplace_back(function, i);
 
-        if(number_of_columns_in_current_row > columns_)
-            columns_ = number_of_columns_in_current_row;
-        
-        if(number_of_columns_in_current_row > 0)
-            ++rows_;
-        
-        current_position = end_of_row + 1;
+        function(0);
+
+        for(auto& thread : threads)
+            thread.join();
+    };
+
+    if(number_of_chunks > 1)
+    {
+        run_on_all_chunks([&](uintptr_t i)
+        {
+            number_of_quotes[i] = scanner_.count_quotes(mapped_csv_.data(), chunk_begins[i], chunk_begins[i + 1]);
+        });
+    }
+
+    std::vector<char> does_chunk_begin_inside_quotes(number_of_chunks, false);
+
+    for(uintptr_t i = 1; i < number_of_chunks; ++i)
+        does_chunk_begin_inside_quotes[i] = does_chunk_begin_inside_quotes[i - 1] ^ (number_of_quotes[i - 1] % 2);
+
+    // Second pass: find the rows of each chunk
+    std::vector<ChunkRows> chunks(number_of_chunks);
+
+    run_on_all_chunks([&](uintptr_t i)
+    {
+        chunks[i] = index_chunk(chunk_begins[i], chunk_begins[i + 1], does_chunk_begin_inside_quotes[i]);
+    });
+
+    // Finally we stitch the chunks together in order, finishing
+    // the rows that cross the chunk boundaries
+    uintptr_t start_of_open_row = 0;
+    uintptr_t column_delimiters_in_open_row = 0;
+    uintptr_t number_of_data_rows = 0;
+
+    auto add_row = [&](uintptr_t start_of_row)
+    {
+        ++rows_;
+
+        if(start_of_row >= first_data_row_position_)
+        {
+            if(row_index_stride_ > 0 && number_of_data_rows % row_index_stride_ == 0)
+                row_offsets_.push_back(start_of_row);
+
+            ++number_of_data_rows;
+        }
+    };
+
+    for(auto& chunk : chunks)
+    {
+        column_delimiters_in_open_row += chunk.column_delimiters_before_first_row_delimiter;
+
+        if(!chunk.has_row_delimiter)
+            continue;
+
+        if(chunk.first_row_delimiter > start_of_open_row)
+        {
+            columns_ = std::max(columns_, column_delimiters_in_open_row + 1);
+            add_row(start_of_open_row);
+        }
+
+        columns_ = std::max(columns_, chunk.maximum_number_of_columns);
+
+        for(auto start_of_row : chunk.non_empty_row_starts)
+            add_row(start_of_row);
+
+        std::vector<uintptr_t>().swap(chunk.non_empty_row_starts);
+
+        start_of_open_row = chunk.start_of_last_row;
+        column_delimiters_in_open_row = chunk.column_delimiters_in_last_row;
+    }
+
+    // The last row might not end with a row delimiter
+    if(file_size > start_of_open_row)
+    {
+        columns_ = std::max(columns_, column_delimiters_in_open_row + 1);
+        add_row(start_of_open_row);
     }
 
     if(does_first_row_contain_column_header_names_ && rows_ > 0)
@@ -525,45 +759,124 @@ inline void CSVMatrix<DataType>::count_number_of_rows_and_columns()
 
 
 
+//-------------------------------------------------------------------
+// Function used to find the rows within a chunk of
+// the csv data [chunk_begin, chunk_end)
+// - Only the rows that both start and end within the
+//   chunk are fully resolved here, the column delimiters
+//   before the first row delimiter and after the last
+//   one are returned so that the rows crossing chunk
+//   boundaries can be finished when merging the chunks
+//-------------------------------------------------------------------
+template<typename DataType>
+
+inline typename CSVMatrix<DataType>::ChunkRows
+CSVMatrix<DataType>::index_chunk(uintptr_t chunk_begin, uintptr_t chunk_end, bool begins_inside_quotes)const
+{
+    ChunkRows chunk;
+
+    uintptr_t start_of_row = chunk_begin;
+    uintptr_t column_delimiters_in_current_row = 0;
+
+    scanner_.for_each_delimiter(mapped_csv_.data(), chunk_begin, chunk_end,
+                                [&](uintptr_t position, bool is_row_delimiter)
+                                {
+                                    if(!is_row_delimiter)
+                                    {
+                                        ++column_delimiters_in_current_row;
+                                        return true;
+                                    }
+
+                                    if(!chunk.has_row_delimiter)
+                                    {
+                                        chunk.has_row_delimiter = true;
+                                        chunk.first_row_delimiter = position;
+                                        chunk.column_delimiters_before_first_row_delimiter = column_delimiters_in_current_row;
+                                    }
+                                    else if(position > start_of_row)
+                                    {
+                                        chunk.non_empty_row_starts.push_back(start_of_row);
+                                        chunk.maximum_number_of_columns = std::max(chunk.maximum_number_of_columns,
+                                                                                   column_delimiters_in_current_row + 1);
+                                    }
+
+                                    start_of_row = position + 1;
+                                    column_delimiters_in_current_row = 0;
+
+                                    return true;
+                                },
+                                begins_inside_quotes);
+
+    if(chunk.has_row_delimiter)
+    {
+        chunk.start_of_last_row = start_of_row;
+        chunk.column_delimiters_in_last_row = column_delimiters_in_current_row;
+    }
+    else
+    {
+        chunk.column_delimiters_before_first_row_delimiter = column_delimiters_in_current_row;
+    }
+
+    return chunk;
+}
+//-------------------------------------------------------------------
+
+
+
 //-------------------------------------------------------------------
 // Function used to find the beginning of the
 // nth row in the csv matrix
+// - If the row offset index is available, we jump
+//   to the closest indexed row before the nth row
+//   and only scan the remaining (at most stride - 1)
+//   rows, otherwise we scan from the first data row
 //-------------------------------------------------------------------
 template<typename DataType>
 
 inline uintptr_t CSVMatrix<DataType>::find_nth_row(uintptr_t row_index)const
 {
-    uintptr_t nth_row_begin_position = 0;
-    uintptr_t nth_row_end_position = 0;
-
-    int64_t current_row = -1;
-
-    if(does_first_row_contain_column_header_names_)
+    if(row_index_stride_ > 0 && !row_offsets_.empty())
     {
-        nth_row_begin_position = find_end_of_current_row(nth_row_begin_position);
+        uintptr_t index_entry = row_index / row_index_stride_;
 
-        if(nth_row_begin_position < mapped_csv_.size())
-            ++nth_row_begin_position;
+        if(index_entry >= row_offsets_.size())
+            return mapped_csv_.size();
+
+        return skip_non_empty_rows(row_offsets_[index_entry], row_index - index_entry * row_index_stride_);
     }
 
-    while(nth_row_begin_position < mapped_csv_.size() &&
-          current_row < int64_t(row_index))
-    {
-        nth_row_end_position = find_end_of_current_row(nth_row_begin_position);
+    return skip_non_empty_rows(first_data_row_position_, row_index);
+}
+//-------------------------------------------------------------------
+
 
-        if((nth_row_end_position - nth_row_begin_position) > 1)
-            ++current_row;
 
-        if(current_row < row_index)
+//-------------------------------------------------------------------
+// Function used to skip a number of non-empty rows
+// starting from the current position
+// - Returns the beginning of the first non-empty row
+//   after the skipped ones (or the end of the csv string)
+//-------------------------------------------------------------------
+template<typename DataType>
+
+inline uintptr_t CSVMatrix<DataType>::skip_non_empty_rows(uintptr_t current_position, uintptr_t number_of_rows_to_skip)const
+{
+    while(current_position < mapped_csv_.size())
+    {
+        uintptr_t end_of_row = find_end_of_current_row(current_position);
+
+        if(end_of_row > current_position)
         {
-            nth_row_begin_position = nth_row_end_position;
+            if(number_of_rows_to_skip == 0)
+                return current_position;
 
-            if(nth_row_begin_position < mapped_csv_.size())
-                ++nth_row_begin_position;
+            --number_of_rows_to_skip;
         }
+
+        current_position = end_of_row + 1;
     }
 
-    return nth_row_begin_position;
+    return mapped_csv_.size();
 }
 //-------------------------------------------------------------------
 
@@ -615,35 +928,7 @@ template<typename DataType>
 
 inline uintptr_t CSVMatrix<DataType>::count_number_of_columns_for_current_row(uintptr_t start_of_row, uintptr_t end_of_row)const
 {
-    uintptr_t number_of_columns = 0;
-
-    if(start_of_row >= end_of_row)
-        return number_of_columns;
-
-    uintptr_t current_number_of_string_delimiters = 0;
-
-    uintptr_t current_position = start_of_row;
-
-    while(current_position < end_of_row)
-    {
-        char current_character = mapped_csv_.data()[current_position];
-
-        if(current_character == string_delimiter_)
-        {
-            ++current_number_of_string_delimiters;
-        }
-        else if(current_number_of_string_delimiters % 2 == 0)
-        {
-            if(column_delimiters_.find(current_character) != std::string::npos)
-                ++number_of_columns;
-        }
-
-        ++current_position;
-    }
-    
-    ++number_of_columns;
-
-    return number_of_columns;
+    return scanner_.count_columns(mapped_csv_.data(), start_of_row, end_of_row);
 }
 //-------------------------------------------------------------------
 
@@ -657,30 +942,8 @@ template<typename DataType>
 
 inline uintptr_t CSVMatrix<DataType>::find_end_of_current_row(uintptr_t current_position_in_csv_string)const
 {
-    // This is to avoid counting row delimiters
-    // inside string quotes
-    uintptr_t number_of_found_string_delimiters = 0;
-
-    uintptr_t end_of_current_row = current_position_in_csv_string;
-
-    while(end_of_current_row < mapped_csv_.size())
-    {
-        char current_character = mapped_csv_.data()[end_of_current_row];
-
-        if(current_character == string_delimiter_)
-        {
-            ++number_of_found_string_delimiters;
-        }
-        else if(number_of_found_string_delimiters % 2 == 0)
-        {
-            if(row_delimiters_.find(current_character) != std::string::npos)
-                return end_of_current_row;
-        }
-
-        ++end_of_current_row;
-    }
-
-    return end_of_current_row;
+    // The scanner skips row delimiters inside string quotes
+    return scanner_.find_end_of_row(mapped_csv_.data(), current_position_in_csv_string, mapped_csv_.size());
 }
 //-------------------------------------------------------------------
 
@@ -694,30 +957,8 @@ template<typename DataType>
 
 inline uintptr_t CSVMatrix<DataType>::find_end_of_current_column(uintptr_t current_position_in_csv_string, uintptr_t end_of_row)const
 {
-    // This is to avoid counting row/column delimiters
-    // inside string quotes
-    uintptr_t number_of_found_string_delimiters = 0;
-
-    uintptr_t end_of_current_column = current_position_in_csv_string;
-
-    while(end_of_current_column < end_of_row)
-    {
-        char current_character = mapped_csv_.data()[end_of_current_column];
-
-        if(current_character == string_delimiter_)
-        {
-            ++number_of_found_string_delimiters;
-        }
-        else if(number_of_found_string_delimiters % 2 == 0)
-        {
-            if(column_delimiters_.find(current_character) != std::string::npos)
-                return end_of_current_column;
-        }
-
-        ++end_of_current_column;
-    }
-
-    return end_of_current_column;
+    // The scanner skips column delimiters inside string quotes
+    return scanner_.find_end_of_column(mapped_csv_.data(), current_position_in_csv_string, end_of_row);
 }
 //-------------------------------------------------------------------
 
@@ -0,0 +1,451 @@
+//-------------------------------------------------------------------
+/**
+ * @file csv_structural_scanner.hpp
+ * @brief Vectorized scanner used to find row/column delimiters and quotes in CSV data.
+ *
+ * The CSVStructuralScanner class classifies CSV data 64 bytes at a time, producing
+ * bitmasks of string delimiters (quotes), row delimiters and column delimiters.
+ * Quoted regions are resolved with a prefix-xor of the quote bitmask, so delimiters
+ * inside quotes are ignored without tracking a per-character quote counter.
+ * The classification uses AVX2 or SSE2 instructions when the compiler targets them
+ * and falls back to a 256-entry lookup table otherwise.
+ * It is used by the CSVMatrix class to count rows/columns and to split fields.
+ *
+ * @author Vincenzo Barbato
+ *
+ * Additional Information:
+ * - GitHub Project: [LazyMatrix](https://github.com/navyenzo/LazyMatrix.git)
+ * - LinkedIn: [Vincenzo Barbato](https://www.linkedin.com/in/vincenzobarbato/)
+ */
+//-------------------------------------------------------------------
+
+
+
+#ifndef INCLUDE_CSV_STRUCTURAL_SCANNER_HPP_
+#define INCLUDE_CSV_STRUCTURAL_SCANNER_HPP_
+
+
+
+//-------------------------------------------------------------------
+// Includes
+//-------------------------------------------------------------------
+#include <array>
+#include <cstdint>
+#include <string>
+#include <algorithm>
+
+#if defined(__AVX2__)
+    #include <immintrin.h>
+    #define LAZYMATRIX_CSV_SCANNER_USE_AVX2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #include <emmintrin.h>
+    #define LAZYMATRIX_CSV_SCANNER_USE_SSE2
+#endif
+
+#if defined(_MSC_VER)
+    #include <intrin.h>
+#endif
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+// Define every thing within the namespace LazyMatrix
+//-------------------------------------------------------------------
+namespace LazyMatrix
+{
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+/**
+ * @brief Bitmasks describing a block of (up to) 64 bytes of CSV data.
+ *
+ * Bit i of each mask is set when byte i of the block is a string
+ * delimiter, a row delimiter or a column delimiter respectively.
+ */
+//-------------------------------------------------------------------
+struct CSVStructuralMasks
+{
+    uint64_t quotes = 0;
+    uint64_t rows = 0;
+    uint64_t columns = 0;
+};
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+/**
+ * @brief Returns the index of the least significant set bit of a
+ *        non-zero 64-bit mask.
+ */
+//-------------------------------------------------------------------
+inline int count_trailing_zeros(uint64_t mask)
+{
+#if defined(_MSC_VER)
+    unsigned long index = 0;
+    _BitScanForward64(&index, mask);
+    return int(index);
+#else
+    return __builtin_ctzll(mask);
+#endif
+}
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+/**
+ * @brief Computes the prefix xor of a 64-bit mask.
+ *
+ * Bit i of the result is the parity of the set bits in positions [0,i]
+ * of the mask. Applied to a quotes bitmask it marks every byte that is
+ * inside a quoted region (including the opening quote).
+ */
+//-------------------------------------------------------------------
+inline uint64_t prefix_xor(uint64_t mask)
+{
+    mask ^= mask << 1;
+    mask ^= mask << 2;
+    mask ^= mask << 4;
+    mask ^= mask << 8;
+    mask ^= mask << 16;
+    mask ^= mask << 32;
+
+    return mask;
+}
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+/**
+ * @class CSVStructuralScanner
+ * @brief Finds unquoted row and column delimiters in CSV data a block at a time.
+ *
+ * The scanner follows the same rules as the original character by character
+ * CSVMatrix parser: a delimiter counts only when an even number of string
+ * delimiters has been seen since the position where the scan started, and
+ * a string delimiter character is never treated as a row/column delimiter.
+ */
+//-------------------------------------------------------------------
+class CSVStructuralScanner
+{
+public:
+
+    // Number of bytes classified at a time
+    static constexpr uintptr_t block_size = 64;
+
+    CSVStructuralScanner(char string_delimiter = '\"',
+                         const std::string& row_delimiters = "\n\r",
+                         const std::string& column_delimiters = ", ")
+    {
+        set_delimiters(string_delimiter, row_delimiters, column_delimiters);
+    }
+
+    /**
+     * @brief Sets the delimiters used to classify the CSV data.
+     */
+    void set_delimiters(char string_delimiter,
+                        const std::string& row_delimiters,
+                        const std::string& column_delimiters)
+    {
+        string_delimiter_ = string_delimiter;
+        row_delimiters_ = row_delimiters;
+        column_delimiters_ = column_delimiters;
+
+        character_classes_.fill(0);
+
+        for(char c : row_delimiters_)
+            character_classes_[uint8_t(c)] |= ROW;
+
+        for(char c : column_delimiters_)
+            character_classes_[uint8_t(c)] |= COLUMN;
+
+        // String delimiters take precedence over row/column delimiters
+        character_classes_[uint8_t(string_delimiter_)] = QUOTE;
+    }
+
+    /**
+     * @brief Classifies a full block of 64 bytes.
+     */
+    CSVStructuralMasks classify_block(const char* block)const
+    {
+#if defined(LAZYMATRIX_CSV_SCANNER_USE_AVX2)
+
+        CSVStructuralMasks masks;
+
+        __m256i low = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block));
+        __m256i high = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block + 32));
+
+        auto match = [&](char c)
+        {
+            __m256i pattern = _mm256_set1_epi8(c);
+            uint64_t low_mask = uint32_t(_mm256_movemask_epi8(_mm256_cmpeq_epi8(low, pattern)));
+            uint64_t high_mask = uint32_t(_mm256_movemask_epi8(_mm256_cmpeq_epi8(high, pattern)));
+            return low_mask | (high_mask << 32);
+        };
+
+        masks.quotes = match(string_delimiter_);
+
+        for(char c : row_delimiters_)
+            masks.rows |= match(c);
+
+        for(char c : column_delimiters_)
+            masks.columns |= match(c);
+
+        masks.rows &= ~masks.quotes;
+        masks.columns &= ~masks.quotes;
+
+        return masks;
+
+#elif defined(LAZYMATRIX_CSV_SCANNER_USE_SSE2)
+
+        CSVStructuralMasks masks;
+
+        __m128i chunks[4];
+
+        for(int i = 0; i < 4; ++i)
+            chunks[i] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block + 16 * i));
+
+        auto match = [&](char c)
+        {
+            __m128i pattern = _mm_set1_epi8(c);
+            uint64_t mask = 0;
+
+            for(int i = 0; i < 4; ++i)
+                mask |= uint64_t(uint32_t(_mm_movemask_epi8(_mm_cmpeq_epi8(chunks[i], pattern))) & 0xFFFF) << (16 * i);
+
+            return mask;
+        };
+
+        masks.quotes = match(string_delimiter_);
+
+        for(char c : row_delimiters_)
+            masks.rows |= match(c);
+
+        for(char c : column_delimiters_)
+            masks.columns |= match(c);
+
+        masks.rows &= ~masks.quotes;
+        masks.columns &= ~masks.quotes;
+
+        return masks;
+
+#else
+
+        return classify_partial_block(block, block_size);
+
+#endif
+    }
+
+    /**
+     * @brief Classifies a block of less than (or equal to) 64 bytes using
+     *        the lookup table, this is used for the tail of the data so
+     *        that we never read past the end of the mapped memory.
+     */
+    CSVStructuralMasks classify_partial_block(const char* block, uintptr_t length)const
+    {
+        CSVStructuralMasks masks;
+
+        for(uintptr_t i = 0; i < length; ++i)
+        {
+            uint64_t character_class = character_classes_[uint8_t(block[i])];
+
+            masks.quotes |= uint64_t(character_class & QUOTE) << i;
+            masks.rows |= uint64_t((character_class & ROW) >> 1) << i;
+            masks.columns |= uint64_t((character_class & COLUMN) >> 2) << i;
+        }
+
+        return masks;
+    }
+
+    /**
+     * @brief Calls callback(position, is_row_delimiter) for every unquoted
+     *        row or column delimiter in [begin, end), in order.
+     *
+     * The scan assumes position "begin" is outside of any quoted region,
+     * unless begins_inside_quotes is true (used when the data is split in
+     * chunks and a chunk starts in the middle of a quoted entry).
+     * The callback can return false to stop the scan early.
+     */
+    template<typename Callback>
+    void for_each_delimiter(const char* data,
+                            uintptr_t begin,
+                            uintptr_t end,
+                            Callback&& callback,
+                            bool begins_inside_quotes = false)const
+    {
+        uint64_t inside_quotes_carry = begins_inside_quotes ? ~uint64_t(0) : uint64_t(0);
+
+        for(uintptr_t position = begin; position < end; position += block_size)
+        {
+            uint64_t rows = 0;
+            uint64_t columns = 0;
+
+            classify_and_resolve_quotes(data, position, end, inside_quotes_carry, rows, columns);
+
+            uint64_t delimiters = rows | columns;
+
+            while(delimiters)
+            {
+                uint64_t lowest_bit = delimiters & (~delimiters + 1);
+
+                if(!callback(position + count_trailing_zeros(delimiters), (rows & lowest_bit) != 0))
+                    return;
+
+                delimiters ^= lowest_bit;
+            }
+        }
+    }
+
+    /**
+     * @brief Counts the number of string delimiters in [begin, end).
+     *
+     * The parity of this count tells whether a chunk of data ends
+     * inside or outside a quoted region.
+     */
+    uintptr_t count_quotes(const char* data, uintptr_t begin, uintptr_t end)const
+    {
+        uintptr_t number_of_quotes = 0;
+
+        for(uintptr_t position = begin; position < end; position += block_size)
+        {
+            uintptr_t length = std::min(block_size, end - position);
+
+            CSVStructuralMasks masks = (length == block_size) ? classify_block(data + position)
+                                                              : classify_partial_block(data + position, length);
+
+            number_of_quotes += count_set_bits(masks.quotes);
+        }
+
+        return number_of_quotes;
+    }
+
+    /**
+     * @brief Finds the first unquoted row delimiter in [begin, end),
+     *        returns end if none is found.
+     */
+    uintptr_t find_end_of_row(const char* data, uintptr_t begin, uintptr_t end)const
+    {
+        return find_first_delimiter(data, begin, end, true);
+    }
+
+    /**
+     * @brief Finds the first unquoted column delimiter in [begin, end),
+     *        returns end if none is found.
+     */
+    uintptr_t find_end_of_column(const char* data, uintptr_t begin, uintptr_t end)const
+    {
+        return find_first_delimiter(data, begin, end, false);
+    }
+
+    /**
+     * @brief Counts the number of columns in [begin, end), which is the
+     *        number of unquoted column delimiters plus one (0 if empty).
+     */
+    uintptr_t count_columns(const char* data, uintptr_t begin, uintptr_t end)const
+    {
+        if(begin >= end)
+            return 0;
+
+        uintptr_t number_of_columns = 1;
+        uint64_t inside_quotes_carry = 0;
+
+        for(uintptr_t position = begin; position < end; position += block_size)
+        {
+            uint64_t rows = 0;
+            uint64_t columns = 0;
+
+            classify_and_resolve_quotes(data, position, end, inside_quotes_carry, rows, columns);
+
+            number_of_columns += count_set_bits(columns);
+        }
+
+        return number_of_columns;
+    }
+
+
+
+private:
+
+    enum CharacterClass : uint8_t
+    {
+        QUOTE = 1,
+        ROW = 2,
+        COLUMN = 4
+    };
+
+    // Classifies the block starting at "position" and clears the
+    // delimiters found inside quoted regions
+    void classify_and_resolve_quotes(const char* data,
+                                     uintptr_t position,
+                                     uintptr_t end,
+                                     uint64_t& inside_quotes_carry,
+                                     uint64_t& rows,
+                                     uint64_t& columns)const
+    {
+        uintptr_t length = std::min(block_size, end - position);
+
+        CSVStructuralMasks masks = (length == block_size) ? classify_block(data + position)
+                                                          : classify_partial_block(data + position, length);
+
+        uint64_t inside_quotes = prefix_xor(masks.quotes) ^ inside_quotes_carry;
+
+        // Propagate the quote state of the last byte to the next block
+        inside_quotes_carry = uint64_t(0) - (inside_quotes >> 63);
+
+        rows = masks.rows & ~inside_quotes;
+        columns = masks.columns & ~inside_quotes;
+    }
+
+    uintptr_t find_first_delimiter(const char* data, uintptr_t begin, uintptr_t end, bool look_for_row_delimiters)const
+    {
+        uint64_t inside_quotes_carry = 0;
+
+        for(uintptr_t position = begin; position < end; position += block_size)
+        {
+            uint64_t rows = 0;
+            uint64_t columns = 0;
+
+            classify_and_resolve_quotes(data, position, end, inside_quotes_carry, rows, columns);
+
+            uint64_t delimiters = look_for_row_delimiters ? rows : columns;
+
+            if(delimiters)
+                return position + count_trailing_zeros(delimiters);
+        }
+
+        return end;
+    }
+
+    static uintptr_t count_set_bits(uint64_t mask)
+    {
+#if defined(_MSC_VER)
+        return uintptr_t(__popcnt64(mask));
+#else
+        return uintptr_t(__builtin_popcountll(mask));
+#endif
+    }
+
+    char string_delimiter_ = '\"';
+    std::string row_delimiters_ = "\n\r";
+    std::string column_delimiters_ = ", ";
+
+    // Lookup table used by the scalar fallback and
+    // for the tail of the data
+    std::array<uint8_t, 256> character_classes_{};
+};
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+} // namespace LazyMatrix
+//-------------------------------------------------------------------
+
+
+
+#endif // INCLUDE_CSV_STRUCTURAL_SCANNER_HPP_
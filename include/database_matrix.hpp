@@ -10,6 +10,17 @@
  * SafeColumnName classes to prevent SQL injection by sanitizing table and
  * column names.
  *
+ * Rows are read from the database in windows of consecutive rows. The most
+ * recently used windows are cached, the window following the one being
+ * read is prefetched in the background, and tables sorted by a unique
+ * indexed column are paged with keyset (seek) pagination instead of OFFSET.
+ * Windows can store every cell as a Poco::Dynamic::Var, or store each
+ * column in a typed array (see DatabaseCacheMode), which TypedDatabaseMatrix
+ * reads as plain numbers or strings.
+ * Column selectors, ROIs and simple comparisons (see where) on a database
+ * matrix are pushed down into the generated SQL, so only the selected
+ * columns and rows are transferred.
+ *
  * @author Vincenzo Barbato
  * 
  * Additional Information:
@@ -27,6 +38,12 @@
 
 //-------------------------------------------------------------------
 #include <string>
+#include <string_view>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <future>
 #include <regex>
 #include <stdexcept>
 #include <vector>
@@ -40,13 +57,18 @@
 #include <fstream>
 #include <locale>
 
+#include <Poco/Exception.h>
 #include <Poco/Data/Session.h>
 #include <Poco/Data/RecordSet.h>
 #include <Poco/Dynamic/Var.h>
 #include <Poco/Dynamic/Struct.h>
 #include <Poco/Data/Statement.h>
+#include <Poco/Data/MetaColumn.h>
 
 #include "base_matrix.hpp"
+#include "shared_references.hpp"
+#include "selector_view.hpp"
+#include "roi_view.hpp"
 //-------------------------------------------------------------------
 
 
@@ -142,6 +164,12 @@ private:
  *
  * Encapsulates a sorting method for database rows. Validates the column
  * name and sorting order. Stores an error message if there is an issue.
+ *
+ * When the column is indexed and holds unique values, DatabaseMatrix pages
+ * through the sorted rows with keyset pagination (WHERE column > last key)
+ * instead of OFFSET, which gets slower the deeper it goes into the table.
+ * Keyset pagination skips rows when values repeat, so it's only used when
+ * the column is declared unique.
  */
 //-------------------------------------------------------------------
 class SafeRowSortingMethod
@@ -152,19 +180,25 @@ public:
      * Constructor for SafeRowSortingMethod.
      * @param column The column name to be used in sorting, validated via SafeName.
      * @param order The sorting order ('ASC' or 'DESC').
+     * @param is_unique_indexed_column True if the column is indexed and holds unique values.
      */
-    SafeRowSortingMethod(const std::string& column = "", const std::string& order = "")
+    SafeRowSortingMethod(const std::string& column = "", const std::string& order = "", bool is_unique_indexed_column = false)
     {
-        set_parameters(column, order);
+        set_parameters(column, order, is_unique_indexed_column);
     }
 
     /**
      * Sets the parameters for SafeRowSortingMethod.
      * @param column The column name to be used in sorting, validated via SafeName.
      * @param order The sorting order ('ASC' or 'DESC').
+     * @param is_unique_indexed_column True if the column is indexed and holds unique values.
      */
-    void set_parameters(const std::string& column, const std::string& order)
+    void set_parameters(const std::string& column, const std::string& order, bool is_unique_indexed_column = false)
     {
+        column_.clear();
+        order_.clear();
+        is_unique_indexed_column_ = false;
+
         SafeName safe_column(column);
 
         if (!safe_column.get_last_error().empty())
@@ -183,6 +217,9 @@ public:
         else
         {
             sort_method += " " + order;
+            column_ = safe_column.get();
+            order_ = order;
+            is_unique_indexed_column_ = is_unique_indexed_column;
         }
     }
 
@@ -195,6 +232,33 @@ public:
         return sort_method;
     }
 
+    /**
+     * Gets the column used in sorting.
+     * @return The column name (empty if not set or invalid).
+     */
+    const std::string& get_column() const
+    {
+        return column_;
+    }
+
+    /**
+     * Gets the sorting order.
+     * @return 'ASC', 'DESC' or empty if not set or invalid.
+     */
+    const std::string& get_order() const
+    {
+        return order_;
+    }
+
+    /**
+     * Checks if rows can be paged with keyset pagination.
+     * @return True if the sorting column is indexed and holds unique values.
+     */
+    bool is_unique_indexed_column() const
+    {
+        return is_unique_indexed_column_ && !column_.empty();
+    }
+
     /**
      * Gets the last error message.
      * @return The last error message.
@@ -207,12 +271,287 @@ public:
 private:
 
     std::string sort_method; ///< The safe sorting method string.
+    std::string column_;     ///< The sorting column.
+    std::string order_;      ///< The sorting order.
+    bool is_unique_indexed_column_ = false; ///< True if the sorting column is a unique index.
     std::string last_error_; ///< Last error message.
 };
 //-------------------------------------------------------------------
 
 
 
+//-------------------------------------------------------------------
+/**
+ * @class SafeRowPredicate
+ * @brief Class for safely comparing a column to a value in database queries.
+ *
+ * Validates the column name and the comparison operator. The value is
+ * never written into the SQL, it's bound to a ? placeholder. Stores an
+ * error message if there is an issue.
+ */
+//-------------------------------------------------------------------
+class SafeRowPredicate
+{
+public:
+
+    /**
+     * Constructor for SafeRowPredicate.
+     * @param column The column name to be compared, validated via SafeName.
+     * @param comparison The comparison ('=', '!=', '<', '<=', '>' or '>=').
+     * @param value The value the column is compared to.
+     */
+    SafeRowPredicate(const std::string& column, const std::string& comparison, const Poco::Dynamic::Var& value)
+    {
+        set_parameters(column, comparison, value);
+    }
+
+    /**
+     * Sets the parameters for SafeRowPredicate.
+     * @param column The column name to be compared, validated via SafeName.
+     * @param comparison The comparison ('=', '!=', '<', '<=', '>' or '>=').
+     * @param value The value the column is compared to.
+     */
+    void set_parameters(const std::string& column, const std::string& comparison, const Poco::Dynamic::Var& value)
+    {
+        predicate_.clear();
+        value_ = value;
+
+        SafeName safe_column(column);
+
+        if (!safe_column.get_last_error().empty())
+        {
+            last_error_ = safe_column.get_last_error();
+            return;
+        }
+
+        static const std::vector<std::string> comparisons = {"=", "!=", "<", "<=", ">", ">="};
+
+        if (std::find(comparisons.begin(), comparisons.end(), comparison) == comparisons.end())
+        {
+            last_error_ = "Invalid comparison: " + comparison;
+            return;
+        }
+
+        predicate_ = safe_column.get() + " " + comparison + " ?";
+    }
+
+    /**
+     * Gets the safe predicate.
+     * @return The predicate with a ? placeholder for the value (empty if invalid).
+     */
+    const std::string& get() const
+    {
+        return predicate_;
+    }
+
+    /**
+     * Gets the value bound to the placeholder of the predicate.
+     * @return The value.
+     */
+    const Poco::Dynamic::Var& get_value() const
+    {
+        return value_;
+    }
+
+    /**
+     * Gets the last error message.
+     * @return The last error message.
+     */
+    const std::string& get_last_error() const
+    {
+        return last_error_;
+    }
+
+private:
+
+    std::string predicate_;    ///< The safe predicate string.
+    Poco::Dynamic::Var value_; ///< The value compared to the column.
+    std::string last_error_;   ///< Last error message.
+};
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+/**
+ * @struct DatabaseSelection
+ * @brief A subset of the rows and columns of a DatabaseMatrix, see
+ *        DatabaseMatrix::select.
+ *
+ * The predicates are applied first, then the row range is taken from the
+ * rows satisfying them.
+ */
+//-------------------------------------------------------------------
+struct DatabaseSelection
+{
+    std::vector<int64_t> columns;              ///< Columns to keep (every column when empty).
+    int64_t first_row = 0;                     ///< First row to keep.
+    int64_t number_of_rows = -1;               ///< Number of rows to keep (every row when negative).
+    std::vector<SafeRowPredicate> predicates;  ///< Comparisons the rows have to satisfy.
+};
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+/**
+ * @struct DatabaseQuerySettings
+ * @brief Condition and row sorting shared by a DatabaseMatrix and every
+ *        database matrix selected from it.
+ *
+ * It's changed (under the session lock) by set_condition and
+ * set_row_sorting_method, which increment its version so that the
+ * other matrices sharing it know to drop their cache and count their
+ * rows and columns again.
+ */
+//-------------------------------------------------------------------
+struct DatabaseQuerySettings
+{
+    SafeRowSortingMethod row_sorting_method;   ///< Method for row sorting.
+    std::string condition;                     ///< SQL condition for data retrieval.
+    std::atomic<uint64_t> version{0};          ///< Incremented on every change.
+};
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+/**
+ * @brief Type of the values of a database column, detected once from the
+ *        column metadata of the table.
+ */
+//-------------------------------------------------------------------
+enum class DatabaseColumnType
+{
+    Integer, ///< Integer and boolean columns, stored as int64_t.
+    Real,    ///< Floating point columns, stored as double.
+    Text,    ///< Text columns, stored in a string arena.
+    Variant  ///< Any other column (dates, blobs...), stored as Poco::Dynamic::Var.
+};
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+/**
+ * @brief How DatabaseMatrix stores the values of its cache windows.
+ */
+//-------------------------------------------------------------------
+enum class DatabaseCacheMode
+{
+    Variant, ///< Every cell is stored as a Poco::Dynamic::Var.
+    Typed    ///< Every column is stored in a typed array (see DatabaseColumn).
+};
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+/**
+ * @brief Converts the metadata type of a column to the type used to store it.
+ * @param column_data_type The type of the column reported by Poco.
+ * @return The type used to store the column.
+ */
+//-------------------------------------------------------------------
+inline DatabaseColumnType get_database_column_type(Poco::Data::MetaColumn::ColumnDataType column_data_type)
+{
+    using Poco::Data::MetaColumn;
+
+    switch (column_data_type)
+    {
+        case MetaColumn::FDT_BOOL:
+        case MetaColumn::FDT_INT8:
+        case MetaColumn::FDT_UINT8:
+        case MetaColumn::FDT_INT16:
+        case MetaColumn::FDT_UINT16:
+        case MetaColumn::FDT_INT32:
+        case MetaColumn::FDT_UINT32:
+        case MetaColumn::FDT_INT64:
+        case MetaColumn::FDT_UINT64:
+            return DatabaseColumnType::Integer;
+
+        case MetaColumn::FDT_FLOAT:
+        case MetaColumn::FDT_DOUBLE:
+            return DatabaseColumnType::Real;
+
+        case MetaColumn::FDT_STRING:
+            return DatabaseColumnType::Text;
+
+        default:
+            return DatabaseColumnType::Variant;
+    }
+}
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+/**
+ * @struct DatabaseColumn
+ * @brief The values of one column of a cache window, stored by type.
+ *
+ * Only the storage matching the type of the column is used: integers and
+ * reals in plain arrays, strings back to back in a single arena string,
+ * and any other type as Poco::Dynamic::Var.
+ */
+//-------------------------------------------------------------------
+struct DatabaseColumn
+{
+    DatabaseColumnType type = DatabaseColumnType::Variant; ///< Type of the column.
+    std::vector<int64_t> integers;                         ///< Values of Integer columns.
+    std::vector<double> reals;                             ///< Values of Real columns.
+    std::string text;                                      ///< Arena holding the strings of Text columns.
+    std::vector<uintptr_t> text_offsets;                   ///< Where each string starts in the arena (one more than the rows).
+    std::vector<Poco::Dynamic::Var> values;                ///< Values of Variant columns.
+    std::vector<uint8_t> is_null;                          ///< 1 for NULL values.
+
+    std::string_view get_text(uintptr_t row) const
+    {
+        return std::string_view(text).substr(text_offsets[row], text_offsets[row + 1] - text_offsets[row]);
+    }
+
+    Poco::Dynamic::Var get_value(uintptr_t row) const
+    {
+        if (is_null[row])
+            return Poco::Dynamic::Var();
+
+        switch (type)
+        {
+            case DatabaseColumnType::Integer: return Poco::Dynamic::Var(Poco::Int64(integers[row]));
+            case DatabaseColumnType::Real: return Poco::Dynamic::Var(reals[row]);
+            case DatabaseColumnType::Text: return Poco::Dynamic::Var(std::string(get_text(row)));
+            default: return values[row];
+        }
+    }
+
+    template<typename DataType>
+    DataType get(uintptr_t row) const
+    {
+        if (is_null[row])
+            return DataType();
+
+        if constexpr (std::is_arithmetic_v<DataType>)
+        {
+            // Numbers are read without going through Poco::Dynamic::Var
+            if (type == DatabaseColumnType::Integer)
+                return static_cast<DataType>(integers[row]);
+
+            if (type == DatabaseColumnType::Real)
+                return static_cast<DataType>(reals[row]);
+        }
+        else if constexpr (std::is_same_v<DataType, std::string>)
+        {
+            if (type == DatabaseColumnType::Text)
+                return std::string(get_text(row));
+        }
+
+        return get_value(row).template convert<DataType>();
+    }
+};
+//-------------------------------------------------------------------
+
+
+
 //-------------------------------------------------------------------
 /**
  * @struct DatabaseWindow
@@ -221,6 +560,12 @@ private:
  * This structure manages a cache window for efficient data retrieval from
  * the database. It stores a range of rows and columns and the corresponding
  * cached data.
+ *
+ * With keyset pagination, last_key holds the sorting column value of the
+ * last row of the window, after which the following window starts.
+ *
+ * In the typed cache mode the values are stored per column in
+ * typed_columns instead of cache.
  */
 //-------------------------------------------------------------------
 struct DatabaseWindow
@@ -228,6 +573,8 @@ struct DatabaseWindow
     std::vector<Poco::Dynamic::Var> cache; ///< The cache holding data within the window.
     int row1, column1;                     ///< Upper left corner of the window.
     int row2, column2;                     ///< Lower right corner of the window.
+    Poco::Dynamic::Var last_key;           ///< Sorting column value of the last row (keyset pagination).
+    std::vector<DatabaseColumn> typed_columns; ///< Values stored per column (typed cache mode).
 
     DatabaseWindow() : row1(0), column1(0), row2(0), column2(0) {}
 
@@ -236,18 +583,30 @@ struct DatabaseWindow
         return row >= row1 && row < row2 && column >= column1 && column < column2;
     }
 
-    void resize_window(int r1, int c1, int r2, int c2)
+    void resize_window(int r1, int c1, int r2, int c2, bool is_typed = false)
     {
         row1 = std::min(r1, r2);
         column1 = std::min(c1, c2);
         row2 = std::max(r1, r2);
         column2 = std::max(c1, c2);
-        cache.resize((row2 - row1) * (column2 - column1));
+
+        if (is_typed)
+        {
+            cache.clear();
+            typed_columns.assign(column2 - column1, DatabaseColumn());
+        }
+        else
+        {
+            cache.resize((row2 - row1) * (column2 - column1));
+            typed_columns.clear();
+        }
     }
 
     void clear()
     {
         this->resize_window(0, 0, 0, 0);
+        last_key.clear();
+        typed_columns.clear();
     }
 };
 //-------------------------------------------------------------------
@@ -260,9 +619,36 @@ struct DatabaseWindow
  * @brief Represents and accesses a SQL database table as a 2D matrix.
  *
  * This class provides an interface to treat SQL database tables as 2D matrices,
- * enabling matrix-like data access and operations. It uses a DatabaseWindow
+ * enabling matrix-like data access and operations. It uses DatabaseWindows
  * for caching and efficient data retrieval. The class supports basic matrix
  * operations and ensures safe interaction with the database.
+ *
+ * Rows are fetched in windows of cache_window_size consecutive rows:
+ * - The most recently used windows (4 by default) are kept in a LRU cache.
+ * - When reading moves into a new window, the following window is fetched
+ *   in the background (on the same session, one query at a time) so
+ *   sequential scans don't wait for the database at every window.
+ * - When the rows are sorted by a unique indexed column (see
+ *   SafeRowSortingMethod), a window following a cached window is fetched
+ *   with keyset pagination (WHERE column > last key of the previous window),
+ *   any other window with LIMIT and OFFSET.
+ * - In the typed cache mode (see set_cache_mode) the column types are
+ *   detected once from the table metadata and windows store each column
+ *   in a typed array instead of a Poco::Dynamic::Var per cell. get_value
+ *   and TypedDatabaseMatrix then read numbers without any conversion.
+ *
+ * A database matrix can be narrowed down to some of its columns, a range
+ * of its rows, and rows satisfying simple comparisons, with select (or the
+ * columns, column, rows_and_columns, roi and where functions). The narrowed
+ * matrix only queries those columns and rows, and shares the session (and
+ * its lock) with the original matrix. It also shares its condition and row
+ * sorting (see DatabaseQuerySettings): changing them on either matrix
+ * changes them for both, and each one drops its cache and counts its rows
+ * again the next time it's used.
+ *
+ * Reading the same matrix from multiple threads at once is not supported,
+ * and the session shouldn't run other queries while a window is prefetched
+ * (or prefetching should be disabled with set_prefetching).
  */
 //-------------------------------------------------------------------
 class DatabaseMatrix : public BaseMatrix<DatabaseMatrix,false>
@@ -284,12 +670,19 @@ public:
      * @param condition SQL condition for data retrieval (default is empty).
      * @param cache_window_size Size of cache window for data retrieval (default is 100).
      * @param row_sorting_method SafeRowSortingMethod object for defining row sorting (default is empty).
+     * @param number_of_cached_windows Number of cache windows kept in memory (default is 4).
      */
     DatabaseMatrix(Poco::Data::Session& session,
                    const SafeName& table_name,
                    const std::string& condition = "",
                    uintptr_t cache_window_size = 100,
-                   const SafeRowSortingMethod& row_sorting_method = SafeRowSortingMethod("", ""));
+                   const SafeRowSortingMethod& row_sorting_method = SafeRowSortingMethod("", ""),
+                   uintptr_t number_of_cached_windows = 4);
+
+    /**
+     * @brief Destructor, waits for the window being prefetched.
+     */
+    ~DatabaseMatrix();
 
     /**
      * @brief Gets the number of rows in the matrix.
@@ -302,17 +695,78 @@ public:
     uintptr_t columns() const;
 
     /**
-     * @brief Sets the row sorting method for the matrix.
+     * @brief Sets the row sorting method for the matrix (and the matrices
+     *        selected from it, or it was selected from).
      * @param row_sorting_method The new sorting method.
      */
     void set_row_sorting_method(const SafeRowSortingMethod& row_sorting_method)const;
 
     /**
-     * @brief Sets the SQL condition for data retrieval.
+     * @brief Sets the SQL condition for data retrieval (for the matrices
+     *        selected from it, or it was selected from, too).
      * @param condition The new SQL condition.
      */
     void set_condition(const std::string& condition)const;
 
+    /**
+     * @brief Sets the number of cache windows kept in memory.
+     * @param number_of_cached_windows The number of windows (at least 1).
+     */
+    void set_number_of_cached_windows(uintptr_t number_of_cached_windows)const;
+
+    /**
+     * @brief Enables or disables prefetching the window following the one being read.
+     * @param is_prefetching_enabled True to prefetch windows in the background.
+     */
+    void set_prefetching(bool is_prefetching_enabled)const;
+
+    /**
+     * @brief Sets how the cache windows store their values, dropping the cached windows.
+     * @param cache_mode Variant (a Poco::Dynamic::Var per cell) or Typed (typed arrays per column).
+     */
+    void set_cache_mode(DatabaseCacheMode cache_mode)const;
+
+    /**
+     * @brief Gets how the cache windows store their values.
+     */
+    DatabaseCacheMode get_cache_mode()const;
+
+    /**
+     * @brief Gets the type of a column, detected from the table metadata.
+     * @param column Column index.
+     * @return The type used to store the column in the typed cache mode.
+     */
+    DatabaseColumnType get_column_type(int64_t column)const;
+
+    /**
+     * @brief Reads a value converted to DataType. In the typed cache mode
+     *        numbers and strings are read straight from the typed arrays.
+     * @param row Row index.
+     * @param column Column index.
+     * @return The value, or DataType() for NULL values and out of range indices.
+     */
+    template<typename DataType>
+    DataType get_value(int64_t row, int64_t column)const;
+
+    /**
+     * @brief Creates a database matrix holding a subset of the rows and
+     *        columns of this one, which only queries the selected columns
+     *        and rows.
+     *
+     * Predicates can't be applied after a row range; if this matrix was
+     * selected with a row range, selecting with predicates gives an empty
+     * matrix with an error message (see get_last_error), as do invalid
+     * predicates and column names.
+     *
+     * The selected matrix follows later changes of the condition and row
+     * sorting of this matrix (the row range and predicates are applied on
+     * top of them).
+     *
+     * @param selection The columns, rows and predicates to select.
+     * @return The new database matrix.
+     */
+    std::shared_ptr<DatabaseMatrix> select(const DatabaseSelection& selection)const;
+
     /**
      * @brief Retrieves the last error message, if any.
      * @return The last error message.
@@ -342,6 +796,38 @@ private: // Private functions
         return std::error_code();
     }
 
+    /**
+     * @brief Constructor used by select, copies the settings of a database
+     *        matrix (sharing its condition and row sorting) and narrows them
+     *        down to a selection.
+     * @param source The database matrix being selected from.
+     * @param selection The columns, rows and predicates to select.
+     */
+    DatabaseMatrix(const DatabaseMatrix& source, const DatabaseSelection& selection);
+
+    /**
+     * @brief Drops the cache and counts the rows and columns again if the
+     *        condition or row sorting was changed through another matrix.
+     */
+    void update_query_settings()const;
+
+    /**
+     * @brief Gets the list of columns to query.
+     * @param key_column Set to the index of the sorting column in the list
+     *        when keyset pagination can be used, -1 otherwise.
+     * @return "*" or the selected columns separated by commas (followed by
+     *         the sorting column if it's not selected).
+     */
+    std::string get_select_list(int64_t& key_column)const;
+
+    /**
+     * @brief Appends the WHERE clause (condition, predicates and keyset
+     *        comparison) to a statement and binds its values.
+     * @param statement The statement.
+     * @param last_key The key after which rows are read (keyset pagination), or nullptr.
+     */
+    void append_where_clause(Poco::Data::Statement& statement, const Poco::Dynamic::Var* last_key)const;
+
     /**
      * Accesses an element of the matrix at the specified row and column.
      * @param row Row index.
@@ -350,6 +836,14 @@ private: // Private functions
      */
     value_type const_at_(int64_t row, int64_t column) const;
 
+    /**
+     * @brief Gets the cache window holding the specified row and column.
+     * @param row Row index.
+     * @param column Column index.
+     * @return The window, or nullptr if the indices are out of range.
+     */
+    const DatabaseWindow* get_window_holding(int64_t row, int64_t column) const;
+
     /**
      * @brief Counts the number of rows in the matrix.
      */
@@ -361,11 +855,51 @@ private: // Private functions
     void count_columns()const;
 
     /**
-     * @brief Preloads data into the cache for the specified row and column.
-     * @param row Row index around which to preload data.
-     * @param column Column index around which to preload data.
+     * @brief Gets the cache window holding a row, fetching it if it's not
+     *        cached, and starts prefetching the following window.
+     * @param row Row index.
+     * @return The cache window.
+     */
+    std::shared_ptr<const DatabaseWindow> get_window(int64_t row) const;
+
+    /**
+     * @brief Fetches a cache window from the database.
+     * @param window_index Index of the window (its first row divided by the window size).
+     * @param previous_window The cached previous window if any (used for keyset pagination).
+     * @return The fetched window.
+     */
+    std::shared_ptr<const DatabaseWindow> fetch_window(int64_t window_index,
+                                                       std::shared_ptr<const DatabaseWindow> previous_window) const;
+
+    /**
+     * @brief Finds the cached window holding a row, marking it as the most recently used.
+     * @param row Row index.
+     * @return The cached window or nullptr.
+     */
+    std::shared_ptr<const DatabaseWindow> find_cached_window(int64_t row) const;
+
+    /**
+     * @brief Adds a window to the cache, dropping the least recently used windows.
+     * @param window The window.
+     */
+    void add_cached_window(std::shared_ptr<const DatabaseWindow> window) const;
+
+    /**
+     * @brief Starts fetching a window in the background.
+     * @param window_index Index of the window.
+     * @param previous_window The cached previous window.
+     */
+    void start_prefetch(int64_t window_index, std::shared_ptr<const DatabaseWindow> previous_window) const;
+
+    /**
+     * @brief Waits for the window being prefetched, if any.
+     */
+    void wait_for_prefetch() const;
+
+    /**
+     * @brief Drops every cached window.
      */
-    void preload_data(int64_t row, int64_t column) const;
+    void clear_cache() const;
 
 
 
@@ -373,12 +907,27 @@ private: // Private variables
 
     Poco::Data::Session& session_;                      ///< Database session for connectivity.
     SafeName table_name_;                               ///< Sanitized table name.
-    mutable SafeRowSortingMethod row_sorting_method_;   ///< Method for row sorting.
-    mutable std::string condition_;                     ///< SQL condition for data retrieval.
+    std::shared_ptr<DatabaseQuerySettings> query_settings_ = std::make_shared<DatabaseQuerySettings>(); ///< Condition and row sorting (shared with selected matrices).
+    mutable uint64_t query_settings_version_ = 0;       ///< Version of the query settings the rows and columns were counted with.
 
-    mutable DatabaseWindow cache_window_;               ///< Cache window for efficient data retrieval.
     mutable uintptr_t cache_window_size_ = 100;         ///< Size of the cache window.
 
+    mutable std::shared_ptr<const DatabaseWindow> current_window_;            ///< Window of the last read row.
+    mutable std::list<std::shared_ptr<const DatabaseWindow>> cached_windows_; ///< Cached windows, most recently used first.
+    mutable uintptr_t number_of_cached_windows_ = 4;    ///< Maximum number of cached windows.
+    mutable std::mutex cache_mutex_;                    ///< Protects the cached windows.
+    std::shared_ptr<std::mutex> session_mutex_ = std::make_shared<std::mutex>(); ///< Runs one query at a time on the session (shared with selected matrices).
+    mutable std::future<void> prefetch_;                ///< Window being fetched in the background.
+    mutable bool is_prefetching_enabled_ = true;        ///< True to prefetch the following window.
+
+    mutable DatabaseCacheMode cache_mode_ = DatabaseCacheMode::Variant; ///< How windows store their values.
+    mutable std::vector<DatabaseColumnType> column_types_; ///< Type of each column.
+
+    std::vector<std::string> selected_columns_;         ///< Columns to query (every column when empty).
+    std::vector<SafeRowPredicate> predicates_;          ///< Comparisons the rows have to satisfy.
+    int64_t first_row_ = 0;                             ///< First row of the query results.
+    int64_t maximum_number_of_rows_ = -1;               ///< Maximum number of rows (no limit when negative).
+
     mutable uintptr_t rows_ = 0;                        ///< Number of rows in the matrix.
 
     mutable std::string last_error_;                    ///< Last error message, if any.
@@ -404,13 +953,16 @@ inline DatabaseMatrix::DatabaseMatrix(Poco::Data::Session& session,
                                       const SafeName& table_name,
                                       const std::string& condition,
                                       uintptr_t cache_window_size,
-                                      const SafeRowSortingMethod& row_sorting_method)
+                                      const SafeRowSortingMethod& row_sorting_method,
+                                      uintptr_t number_of_cached_windows)
                                       : session_(session),
                                         table_name_(table_name),
-                                        condition_(condition),
-                                        cache_window_size_(cache_window_size),
-                                        row_sorting_method_(row_sorting_method)
+                                        cache_window_size_(std::max<uintptr_t>(1, cache_window_size)),
+                                        number_of_cached_windows_(std::max<uintptr_t>(1, number_of_cached_windows))
 {
+    query_settings_->row_sorting_method = row_sorting_method;
+    query_settings_->condition = condition;
+
     count_rows();
     count_columns();
 }
@@ -419,29 +971,155 @@ inline DatabaseMatrix::DatabaseMatrix(Poco::Data::Session& session,
 
 
 //-------------------------------------------------------------------
-inline void DatabaseMatrix::count_rows()const
+inline DatabaseMatrix::DatabaseMatrix(const DatabaseMatrix& source, const DatabaseSelection& selection)
+                                      : session_(source.session_),
+                                        table_name_(source.table_name_),
+                                        query_settings_(source.query_settings_),
+                                        cache_window_size_(source.cache_window_size_),
+                                        number_of_cached_windows_(source.number_of_cached_windows_),
+                                        session_mutex_(source.session_mutex_),
+                                        is_prefetching_enabled_(source.is_prefetching_enabled_),
+                                        cache_mode_(source.cache_mode_),
+                                        selected_columns_(source.selected_columns_),
+                                        predicates_(source.predicates_),
+                                        first_row_(source.first_row_),
+                                        maximum_number_of_rows_(source.maximum_number_of_rows_)
 {
-    try
-    {
-        rows_ = 0;
-        Poco::Data::Statement row_statement(session_);
-        
-        // Use the already validated and sanitized table name directly
-        row_statement << "SELECT COUNT(*) FROM " << table_name_.get();
+    // The rows and columns of the source have to match the current settings
+    source.update_query_settings();
+    query_settings_version_ = source.query_settings_version_;
 
-        if (!condition_.empty())
-            row_statement << " WHERE " << condition_;
+    bool is_source_row_range = (source.first_row_ > 0 || source.maximum_number_of_rows_ >= 0);
 
-        row_statement, Poco::Data::Keywords::into(rows_),
-            Poco::Data::Keywords::now;
-        row_statement.execute();
-    }
-    catch (const std::exception& e)
+    if (!selection.predicates.empty() && is_source_row_range)
     {
-        last_error_ = "Error counting rows: " + std::string(e.what());
+        last_error_ = "Predicates can't be applied after a row range";
+        return;
     }
-}
-//-------------------------------------------------------------------
+
+    for (const auto& predicate : selection.predicates)
+    {
+        if (predicate.get().empty())
+        {
+            last_error_ = "Invalid predicate: " + predicate.get_last_error();
+            return;
+        }
+
+        predicates_.push_back(predicate);
+    }
+
+    // Columns are selected by name, the names come from the source
+    if (!selection.columns.empty())
+    {
+        selected_columns_.clear();
+
+        for (size_t i = 0; i < selection.columns.size(); ++i)
+        {
+            int64_t column = selection.columns[i];
+
+            if (column < 0 || column >= int64_t(source.columns()))
+            {
+                last_error_ = "Invalid column index: " + std::to_string(column);
+                return;
+            }
+
+            SafeName safe_column(source.get_column_header(column));
+
+            if (!safe_column.get_last_error().empty())
+            {
+                last_error_ = safe_column.get_last_error();
+                return;
+            }
+
+            selected_columns_.push_back(safe_column.get());
+            this->headers_.set_column_header(i, safe_column.get());
+            column_types_.push_back(source.get_column_type(column));
+        }
+    }
+    else
+    {
+        for (int64_t i = 0; i < int64_t(source.columns()); ++i)
+            this->headers_.set_column_header(i, source.get_column_header(i));
+
+        column_types_ = source.column_types_;
+    }
+
+    // Row ranges are relative to the rows of the source
+    first_row_ += std::max<int64_t>(0, selection.first_row);
+
+    if (maximum_number_of_rows_ >= 0)
+        maximum_number_of_rows_ = std::max<int64_t>(0, maximum_number_of_rows_ - std::max<int64_t>(0, selection.first_row));
+
+    if (selection.number_of_rows >= 0)
+    {
+        if (maximum_number_of_rows_ >= 0)
+            maximum_number_of_rows_ = std::min(maximum_number_of_rows_, selection.number_of_rows);
+        else
+            maximum_number_of_rows_ = selection.number_of_rows;
+    }
+
+    // Without new predicates the rows don't need to be counted again
+    if (selection.predicates.empty())
+    {
+        int64_t number_of_rows = std::max<int64_t>(0, int64_t(source.rows()) - std::max<int64_t>(0, selection.first_row));
+
+        if (selection.number_of_rows >= 0)
+            number_of_rows = std::min(number_of_rows, selection.number_of_rows);
+
+        rows_ = uintptr_t(number_of_rows);
+    }
+    else
+    {
+        count_rows();
+    }
+}
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+inline DatabaseMatrix::~DatabaseMatrix()
+{
+    wait_for_prefetch();
+}
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+inline void DatabaseMatrix::count_rows()const
+{
+    try
+    {
+        rows_ = 0;
+        uintptr_t number_of_rows = 0;
+
+        std::lock_guard<std::mutex> lock(*session_mutex_);
+
+        Poco::Data::Statement row_statement(session_);
+        
+        // Use the already validated and sanitized table name directly
+        row_statement << "SELECT COUNT(*) FROM " << table_name_.get();
+
+        append_where_clause(row_statement, nullptr);
+
+        row_statement, Poco::Data::Keywords::into(number_of_rows);
+        row_statement.execute();
+
+        // Keep the selected range of rows
+        int64_t selected_rows = std::max<int64_t>(0, int64_t(number_of_rows) - first_row_);
+
+        if (maximum_number_of_rows_ >= 0)
+            selected_rows = std::min(selected_rows, maximum_number_of_rows_);
+
+        rows_ = uintptr_t(selected_rows);
+    }
+    catch (const std::exception& e)
+    {
+        last_error_ = "Error counting rows: " + std::string(e.what());
+    }
+}
+//-------------------------------------------------------------------
 
 
 
@@ -450,26 +1128,36 @@ inline void DatabaseMatrix::count_columns()const
 {
     try
     {
+        // Clear the cache
+        clear_cache();
+
         this->headers_.clear_column_header_names();
+        column_types_.clear();
 
-        // Clear the cache
-        cache_window_.clear();
+        std::lock_guard<std::mutex> lock(*session_mutex_);
 
         // Construct and execute the SQL query with a WHERE condition
+        int64_t key_column = -1;
         Poco::Data::Statement column_statement(session_);
-        column_statement << "SELECT * FROM " << table_name_.get();
+        column_statement << "SELECT " << get_select_list(key_column) << " FROM " << table_name_.get();
 
-        if (!condition_.empty())
-            column_statement << " WHERE " << condition_;
+        append_where_clause(column_statement, nullptr);
 
         column_statement << " LIMIT 1";
         column_statement.execute();
 
-        // Retrieve column names from the result metadata
+        // Retrieve column names from the result metadata (without the
+        // sorting column added for keyset pagination)
         Poco::Data::RecordSet record_set(column_statement);
-        for (size_t i = 0; i < record_set.columnCount(); ++i)
+        size_t number_of_columns = record_set.columnCount();
+
+        if (!selected_columns_.empty())
+            number_of_columns = std::min(number_of_columns, selected_columns_.size());
+
+        for (size_t i = 0; i < number_of_columns; ++i)
         {
             this->headers_.set_column_header(i, record_set.columnName(i));
+            column_types_.push_back(get_database_column_type(record_set.columnType(i)));
         }
 
         if (headers_.get_number_of_set_column_header_names() == 0)
@@ -489,6 +1177,8 @@ inline void DatabaseMatrix::count_columns()const
 //-------------------------------------------------------------------
 inline uintptr_t DatabaseMatrix::rows() const
 {
+    update_query_settings();
+
     return rows_;
 }
 //-------------------------------------------------------------------
@@ -498,6 +1188,8 @@ inline uintptr_t DatabaseMatrix::rows() const
 //-------------------------------------------------------------------
 inline uintptr_t DatabaseMatrix::columns() const
 {
+    update_query_settings();
+
     return this->headers_.get_number_of_set_column_header_names();
 }
 //-------------------------------------------------------------------
@@ -505,62 +1197,424 @@ inline uintptr_t DatabaseMatrix::columns() const
 
 
 //-------------------------------------------------------------------
-inline DatabaseMatrix::value_type DatabaseMatrix::const_at_(int64_t row, int64_t column) const
+inline const DatabaseWindow* DatabaseMatrix::get_window_holding(int64_t row, int64_t column) const
 {
     // Check if the data is in the current cache window
-    if (!cache_window_.is_data_found_in_window(row, column))
+    if (!current_window_ || !current_window_->is_data_found_in_window(row, column))
     {
-        // If not, preload the data around the requested row and column
-        preload_data(row, column);
+        if (row < 0 || row >= int64_t(this->rows()) || column < 0 || column >= int64_t(this->columns()))
+            return nullptr;
+
+        // If not, get the window holding the requested row
+        current_window_ = get_window(row);
+
+        if (!current_window_->is_data_found_in_window(row, column))
+            return nullptr;
     }
 
+    return current_window_.get();
+}
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+inline DatabaseMatrix::value_type DatabaseMatrix::const_at_(int64_t row, int64_t column) const
+{
+    const DatabaseWindow* window = get_window_holding(row, column);
+
+    if (!window)
+        return value_type();
+
+    if (!window->typed_columns.empty())
+        return window->typed_columns[column - window->column1].get_value(row - window->row1);
+
     // Calculate the index in the cache for the requested data
-    size_t cache_index = (row - cache_window_.row1) * (cache_window_.column2 - cache_window_.column1) + (column - cache_window_.column1);
+    size_t cache_index = (row - window->row1) * (window->column2 - window->column1) + (column - window->column1);
 
     // Return the data from the cache
-    return cache_window_.cache[cache_index];
+    return window->cache[cache_index];
+}
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+template<typename DataType>
+
+inline DataType DatabaseMatrix::get_value(int64_t row, int64_t column) const
+{
+    const DatabaseWindow* window = get_window_holding(row, column);
+
+    if (!window)
+        return DataType();
+
+    if (!window->typed_columns.empty())
+        return window->typed_columns[column - window->column1].template get<DataType>(row - window->row1);
+
+    const auto& value = window->cache[(row - window->row1) * (window->column2 - window->column1) + (column - window->column1)];
+
+    if (value.isEmpty())
+        return DataType();
+
+    return value.convert<DataType>();
 }
 //-------------------------------------------------------------------
 
 
 
 //-------------------------------------------------------------------
-inline void DatabaseMatrix::preload_data(int64_t row, int64_t column) const
+inline std::shared_ptr<const DatabaseWindow> DatabaseMatrix::get_window(int64_t row) const
 {
-    // Determine the range of rows to preload
-    int64_t start_row = std::max(int64_t(0), row - int64_t(cache_window_size_) / int64_t(2));
-    int64_t end_row = std::min(start_row + int64_t(cache_window_size_), int64_t(this->rows()));
+    int64_t window_size = int64_t(cache_window_size_);
+    int64_t window_index = row / window_size;
+
+    auto window = find_cached_window(row);
 
-    // Resize and reset the cache window
-    cache_window_.resize_window(start_row, 0, end_row, this->columns());
+    if (!window)
+    {
+        // The window might be the one being prefetched
+        wait_for_prefetch();
+        window = find_cached_window(row);
+    }
+
+    if (!window)
+    {
+        window = fetch_window(window_index, find_cached_window(window_index * window_size - 1));
+        add_cached_window(window);
+    }
+
+    // Fetch the following window while this one is being read
+    int64_t next_row = (window_index + 1) * window_size;
+
+    if (is_prefetching_enabled_ && next_row < int64_t(this->rows()) && !find_cached_window(next_row))
+        start_prefetch(window_index + 1, window);
+
+    return window;
+}
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+inline std::shared_ptr<const DatabaseWindow> DatabaseMatrix::fetch_window(int64_t window_index,
+                                                                          std::shared_ptr<const DatabaseWindow> previous_window) const
+{
+    // Determine the range of rows to fetch
+    // This runs on the prefetching thread too, so the rows and columns
+    // are read directly instead of through rows() and columns(), which
+    // can update the query settings
+    uintptr_t number_of_columns_in_matrix = this->headers_.get_number_of_set_column_header_names();
+
+    int64_t start_row = window_index * int64_t(cache_window_size_);
+    int64_t end_row = std::min(start_row + int64_t(cache_window_size_), int64_t(rows_));
+
+    bool is_typed = (cache_mode_ == DatabaseCacheMode::Typed);
+
+    auto window = std::make_shared<DatabaseWindow>();
+    window->resize_window(start_row, 0, end_row, number_of_columns_in_matrix, is_typed);
+
+    // The query settings are only read and changed under the session lock
+    std::lock_guard<std::mutex> lock(*session_mutex_);
+
+    const SafeRowSortingMethod& row_sorting_method = query_settings_->row_sorting_method;
+
+    // Column holding the sorting keys, used for keyset pagination
+    int64_t key_column = -1;
+    std::string select_list = get_select_list(key_column);
+
+    // Continue right after the last key of the previous window instead of
+    // skipping start_row rows with OFFSET
+    bool is_seeking = key_column >= 0 &&
+                      previous_window &&
+                      previous_window->row2 == start_row &&
+                      !previous_window->last_key.isEmpty();
 
     // Construct and execute the SQL query
     Poco::Data::Statement select(session_);
 
-    select << "SELECT * FROM " << table_name_.get();
+    select << "SELECT " << select_list << " FROM " << table_name_.get();
+
+    append_where_clause(select, is_seeking ? &previous_window->last_key : nullptr);
+
+    if (!row_sorting_method.get().empty())
+        select << " ORDER BY " << row_sorting_method.get();
+
+    select << " LIMIT " << (end_row - start_row);
+
+    if (!is_seeking)
+        select << " OFFSET " << (first_row_ + start_row);
 
-    if (!condition_.empty())
-        select << " WHERE " << condition_;
-    
-    if (!row_sorting_method_.get().empty())
-        select << " ORDER BY " << row_sorting_method_.get();
-    
-    select << " LIMIT " << (end_row - start_row) << " OFFSET " << start_row;
-    
     select.execute();
 
-    // Load the data into the cache
+    // Load the data into the window
     Poco::Data::RecordSet record_set(select);
+    size_t number_of_columns = std::min<size_t>(record_set.columnCount(), number_of_columns_in_matrix);
+
+    if (is_typed)
+    {
+        size_t number_of_rows = size_t(end_row - start_row);
+        size_t number_of_fetched_rows = std::min<size_t>(record_set.rowCount(), number_of_rows);
+
+        for (size_t i = 0; i < window->typed_columns.size(); ++i)
+        {
+            DatabaseColumn& column = window->typed_columns[i];
+
+            column.type = (i < column_types_.size()) ? column_types_[i] : DatabaseColumnType::Variant;
+            column.is_null.assign(number_of_rows, 1);
+
+            switch (column.type)
+            {
+                case DatabaseColumnType::Integer: column.integers.assign(number_of_rows, 0); break;
+                case DatabaseColumnType::Real: column.reals.assign(number_of_rows, 0); break;
+                case DatabaseColumnType::Text: column.text_offsets.assign(number_of_rows + 1, 0); break;
+                default: column.values.assign(number_of_rows, Poco::Dynamic::Var()); break;
+            }
+
+            if (i >= number_of_columns)
+                continue;
+
+            // Values are converted once here instead of on every read
+            auto fill_column = [&]()
+            {
+                for (size_t row = 0; row < number_of_fetched_rows; ++row)
+                {
+                    if (!record_set.isNull(i, row))
+                    {
+                        Poco::Dynamic::Var value = record_set.value(i, row);
+
+                        switch (column.type)
+                        {
+                            case DatabaseColumnType::Integer: column.integers[row] = value.convert<Poco::Int64>(); break;
+                            case DatabaseColumnType::Real: column.reals[row] = value.convert<double>(); break;
+                            case DatabaseColumnType::Text: column.text += value.convert<std::string>(); break;
+                            default: column.values[row] = value; break;
+                        }
+
+                        column.is_null[row] = 0;
+                    }
+
+                    if (column.type == DatabaseColumnType::Text)
+                        column.text_offsets[row + 1] = column.text.size();
+                }
+
+                if (column.type == DatabaseColumnType::Text)
+                    std::fill(column.text_offsets.begin() + number_of_fetched_rows + 1, column.text_offsets.end(), column.text.size());
+            };
+
+            try
+            {
+                fill_column();
+            }
+            catch (const Poco::Exception&)
+            {
+                // SQLite columns can hold values of any type, when one of them
+                // doesn't convert to the type of its column, the column keeps
+                // its raw values in this window (like the untyped cache mode)
+                column.type = DatabaseColumnType::Variant;
+                column.integers.clear();
+                column.reals.clear();
+                column.text.clear();
+                column.text_offsets.clear();
+                column.is_null.assign(number_of_rows, 1);
+                column.values.assign(number_of_rows, Poco::Dynamic::Var());
+
+                fill_column();
+            }
+        }
+
+        if (key_column >= 0 && number_of_fetched_rows > 0)
+            window->last_key = record_set.value(size_t(key_column), number_of_fetched_rows - 1);
+
+        return window;
+    }
+
     size_t cache_index = 0;
     bool more = record_set.moveFirst();
-    while (more)
+    while (more && cache_index < window->cache.size())
     {
-        for (size_t i = 0; i < record_set.columnCount(); ++i)
+        for (size_t i = 0; i < number_of_columns; ++i)
         {
-            cache_window_.cache[cache_index++] = record_set[i];
+            window->cache[cache_index++] = record_set[i];
         }
+
+        if (key_column >= 0)
+            window->last_key = record_set[size_t(key_column)];
+
         more = record_set.moveNext();
     }
+
+    return window;
+}
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+inline std::string DatabaseMatrix::get_select_list(int64_t& key_column) const
+{
+    key_column = -1;
+
+    std::string key_name;
+
+    const SafeRowSortingMethod& row_sorting_method = query_settings_->row_sorting_method;
+
+    if (row_sorting_method.is_unique_indexed_column())
+        key_name = row_sorting_method.get_column();
+
+    if (selected_columns_.empty())
+    {
+        int64_t number_of_columns = int64_t(this->headers_.get_number_of_set_column_header_names());
+
+        for (int64_t i = 0; i < number_of_columns && !key_name.empty(); ++i)
+        {
+            if (this->headers_.get_column_header(i) == key_name)
+                key_column = i;
+        }
+
+        return "*";
+    }
+
+    std::string select_list;
+
+    for (size_t i = 0; i < selected_columns_.size(); ++i)
+    {
+        if (i > 0)
+            select_list += ", ";
+
+        select_list += selected_columns_[i];
+
+        if (selected_columns_[i] == key_name)
+            key_column = int64_t(i);
+    }
+
+    // The sorting keys are also needed for keyset pagination
+    if (!key_name.empty() && key_column < 0)
+    {
+        select_list += ", " + key_name;
+        key_column = int64_t(selected_columns_.size());
+    }
+
+    return select_list;
+}
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+inline void DatabaseMatrix::append_where_clause(Poco::Data::Statement& statement, const Poco::Dynamic::Var* last_key) const
+{
+    const char* separator = " WHERE ";
+
+    const std::string& condition = query_settings_->condition;
+    const SafeRowSortingMethod& row_sorting_method = query_settings_->row_sorting_method;
+
+    if (!condition.empty())
+    {
+        statement << separator << "(" << condition << ")";
+        separator = " AND ";
+    }
+
+    for (const auto& predicate : predicates_)
+    {
+        statement << separator << predicate.get();
+        statement, Poco::Data::Keywords::bind(predicate.get_value());
+        separator = " AND ";
+    }
+
+    if (last_key)
+    {
+        statement << separator << row_sorting_method.get_column() << (row_sorting_method.get_order() == "ASC" ? " > ?" : " < ?");
+        statement, Poco::Data::Keywords::bind(*last_key);
+    }
+}
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+inline std::shared_ptr<const DatabaseWindow> DatabaseMatrix::find_cached_window(int64_t row) const
+{
+    std::lock_guard<std::mutex> lock(cache_mutex_);
+
+    for (auto it = cached_windows_.begin(); it != cached_windows_.end(); ++it)
+    {
+        if (row >= (*it)->row1 && row < (*it)->row2)
+        {
+            // Move it to the front as the most recently used
+            cached_windows_.splice(cached_windows_.begin(), cached_windows_, it);
+            return cached_windows_.front();
+        }
+    }
+
+    return nullptr;
+}
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+inline void DatabaseMatrix::add_cached_window(std::shared_ptr<const DatabaseWindow> window) const
+{
+    std::lock_guard<std::mutex> lock(cache_mutex_);
+
+    cached_windows_.push_front(std::move(window));
+
+    while (cached_windows_.size() > number_of_cached_windows_)
+        cached_windows_.pop_back();
+}
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+inline void DatabaseMatrix::start_prefetch(int64_t window_index, std::shared_ptr<const DatabaseWindow> previous_window) const
+{
+    // Only one window is prefetched at a time
+    if (prefetch_.valid())
+    {
+        if (prefetch_.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+            return;
+
+        prefetch_.get();
+    }
+
+    prefetch_ = std::async(std::launch::async, [this, window_index, previous_window]()
+    {
+        // Errors are dropped here, the window is fetched again
+        // (and the error thrown) when it's actually read
+        try
+        {
+            add_cached_window(fetch_window(window_index, previous_window));
+        }
+        catch (...)
+        {
+        }
+    });
+}
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+inline void DatabaseMatrix::wait_for_prefetch() const
+{
+    if (prefetch_.valid())
+        prefetch_.get();
+}
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+inline void DatabaseMatrix::clear_cache() const
+{
+    wait_for_prefetch();
+
+    std::lock_guard<std::mutex> lock(cache_mutex_);
+
+    cached_windows_.clear();
+    current_window_.reset();
 }
 //-------------------------------------------------------------------
 
@@ -569,12 +1623,21 @@ inline void DatabaseMatrix::preload_data(int64_t row, int64_t column) const
 //-------------------------------------------------------------------
 inline void DatabaseMatrix::set_row_sorting_method(const SafeRowSortingMethod& row_sorting_method)const
 {
-    if(row_sorting_method_.get() != row_sorting_method.get())
+    update_query_settings();
+
     {
-        row_sorting_method_ = row_sorting_method;
-        cache_window_.clear();
-        preload_data(0,0);
+        std::lock_guard<std::mutex> lock(*session_mutex_);
+
+        if(query_settings_->row_sorting_method.get() == row_sorting_method.get())
+            return;
+
+        query_settings_->row_sorting_method = row_sorting_method;
+        query_settings_version_ = ++query_settings_->version;
     }
+
+    // Also drops the cached windows (the sorting column
+    // might have to be added for keyset pagination)
+    count_columns();
 }
 //-------------------------------------------------------------------
 
@@ -583,14 +1646,449 @@ inline void DatabaseMatrix::set_row_sorting_method(const SafeRowSortingMethod& r
 //-------------------------------------------------------------------
 inline void DatabaseMatrix::set_condition(const std::string& condition)const
 {
-    if(condition_ != condition)
+    update_query_settings();
+
     {
-        condition_ = condition;
-        count_rows();
-        count_columns();
-        cache_window_.clear();
-        preload_data(0,0);
+        std::lock_guard<std::mutex> lock(*session_mutex_);
+
+        if(query_settings_->condition == condition)
+            return;
+
+        query_settings_->condition = condition;
+        query_settings_version_ = ++query_settings_->version;
     }
+
+    // Drops the windows prefetched with the old condition
+    clear_cache();
+    count_rows();
+    count_columns();
+}
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+inline void DatabaseMatrix::update_query_settings()const
+{
+    uint64_t version = query_settings_->version.load(std::memory_order_acquire);
+
+    if(version == query_settings_version_)
+        return;
+
+    // Set first, counting the columns reads the number of columns
+    query_settings_version_ = version;
+
+    clear_cache();
+    count_rows();
+    count_columns();
+}
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+inline void DatabaseMatrix::set_number_of_cached_windows(uintptr_t number_of_cached_windows)const
+{
+    std::lock_guard<std::mutex> lock(cache_mutex_);
+
+    number_of_cached_windows_ = std::max<uintptr_t>(1, number_of_cached_windows);
+
+    while (cached_windows_.size() > number_of_cached_windows_)
+        cached_windows_.pop_back();
+}
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+inline void DatabaseMatrix::set_prefetching(bool is_prefetching_enabled)const
+{
+    if (!is_prefetching_enabled)
+        wait_for_prefetch();
+
+    is_prefetching_enabled_ = is_prefetching_enabled;
+}
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+inline const std::string& DatabaseMatrix::get_last_error() const
+{
+    return last_error_;
+}
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+inline std::shared_ptr<DatabaseMatrix> DatabaseMatrix::select(const DatabaseSelection& selection)const
+{
+    // The constructor is private, so the matrix can't be made with std::make_shared
+    return std::shared_ptr<DatabaseMatrix>(new DatabaseMatrix(*this, selection));
+}
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+inline void DatabaseMatrix::set_cache_mode(DatabaseCacheMode cache_mode)const
+{
+    if (cache_mode_ != cache_mode)
+    {
+        clear_cache();
+        cache_mode_ = cache_mode;
+    }
+}
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+inline DatabaseCacheMode DatabaseMatrix::get_cache_mode()const
+{
+    return cache_mode_;
+}
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+inline DatabaseColumnType DatabaseMatrix::get_column_type(int64_t column)const
+{
+    if (column < 0 || column >= int64_t(column_types_.size()))
+        return DatabaseColumnType::Variant;
+
+    return column_types_[column];
+}
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+/**
+ * @class TypedDatabaseMatrix
+ * @brief A view of a DatabaseMatrix whose values are converted to DataType.
+ *
+ * Lets numeric code (filters, statistics, downsampling...) read a database
+ * table like any other matrix of numbers. With the typed cache mode of the
+ * database matrix (see DatabaseMatrix::set_cache_mode), integer and real
+ * columns are read straight from the typed arrays of the cache windows.
+ * NULL values read as DataType().
+ *
+ * @tparam DataType The type the values are converted to.
+ */
+//-------------------------------------------------------------------
+template<typename DataType>
+
+class TypedDatabaseMatrix : public BaseMatrix<TypedDatabaseMatrix<DataType>, false>
+{
+public:
+
+    // Type of value that is stored in the matrix
+    using value_type = DataType;
+
+    friend class BaseMatrix<TypedDatabaseMatrix<DataType>, false>;
+
+    /**
+     * @brief Construct a new TypedDatabaseMatrix object
+     * @param database_matrix The database matrix.
+     */
+    explicit TypedDatabaseMatrix(ConstSharedMatrixRef<DatabaseMatrix> database_matrix)
+    : database_matrix_(database_matrix)
+    {
+    }
+
+    /**
+     * @brief Returns the number of rows of the database matrix.
+     */
+    uintptr_t rows()const
+    {
+        return database_matrix_.rows();
+    }
+
+    /**
+     * @brief Returns the number of columns of the database matrix.
+     */
+    uintptr_t columns()const
+    {
+        return database_matrix_.columns();
+    }
+
+    // Functions used to handle row and column header names
+    std::string get_row_header(int64_t row_index) const { return database_matrix_.get_row_header(row_index); }
+    std::string get_column_header(int64_t column_index) const { return database_matrix_.get_column_header(column_index); }
+    void set_row_header(int64_t row_index, const std::string& row_header) const { database_matrix_.set_row_header(row_index, row_header); }
+    void set_column_header(int64_t column_index, const std::string& column_header) const { }
+
+
+
+private: // Private functions
+
+    /**
+     * @brief Dummy "resize" function needed for the matrix interface, but
+     *        here it doesn't do anything
+     * 
+     * @param rows 
+     * @param columns 
+     * @return std::error_code 
+     */
+    std::error_code resize_(uintptr_t rows, uintptr_t columns)
+    {
+        return std::error_code();
+    }
+
+    /**
+     * @brief Accesses the element at the specified position.
+     * @param row Row index.
+     * @param column Column index.
+     * @return The value converted to DataType.
+     */
+    value_type const_at_(int64_t row, int64_t column)const
+    {
+        return database_matrix_.get_ptr()->template get_value<DataType>(row, column);
+    }
+
+
+
+private: // Private variables
+
+    ConstSharedMatrixRef<DatabaseMatrix> database_matrix_;
+};
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+// Compile time functions to check if the type is a matrix expression type
+//-------------------------------------------------------------------
+template<typename DataType>
+
+struct is_type_a_matrix< TypedDatabaseMatrix<DataType> > : std::true_type
+{
+};
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+/**
+ * @brief Returns a view of a database matrix whose values are converted to DataType.
+ * @tparam DataType The type the values are converted to (double, int64_t, std::string...).
+ * @param database_matrix Shared reference to the database matrix.
+ * @return A ConstSharedMatrixRef to the typed view.
+ */
+//-------------------------------------------------------------------
+template<typename DataType>
+
+inline auto typed_database_matrix(ConstSharedMatrixRef<DatabaseMatrix> database_matrix)
+{
+    auto view = std::make_shared<TypedDatabaseMatrix<DataType>>(database_matrix);
+    return ConstSharedMatrixRef<TypedDatabaseMatrix<DataType>>(view);
+}
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+/**
+ * @brief Keeps the rows of a database matrix satisfying a comparison,
+ *        which is added to the WHERE clause of its queries.
+ *
+ * Comparisons are combined by calling where again on the result. They
+ * can't be applied after a row range (see DatabaseMatrix::select).
+ *
+ * @param m Shared reference to the database matrix.
+ * @param predicate The comparison, e.g. SafeRowPredicate("value", ">", 10).
+ * @return A ConstSharedMatrixRef to the new database matrix.
+ */
+//-------------------------------------------------------------------
+inline ConstSharedMatrixRef<DatabaseMatrix> where(ConstSharedMatrixRef<DatabaseMatrix> m,
+                                                  const SafeRowPredicate& predicate)
+{
+    DatabaseSelection selection;
+    selection.predicates.push_back(predicate);
+
+    return ConstSharedMatrixRef<DatabaseMatrix>(m.get_ptr()->select(selection));
+}
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+/**
+ * @brief Selects the columns of a database matrix to query.
+ * @param m Shared reference to the database matrix.
+ * @param column_indeces Indeces of the columns (wrapping around like circ_at).
+ * @param selected_columns Set to the indeces of the columns in the selected database matrix.
+ * @return The selected database matrix, or nullptr if the columns can't
+ *         be selected in SQL (e.g. column names that aren't safe).
+ */
+//-------------------------------------------------------------------
+inline std::shared_ptr<DatabaseMatrix> select_database_columns(ConstSharedMatrixRef<DatabaseMatrix> m,
+                                                               const std::vector<int64_t>& column_indeces,
+                                                               std::vector<int64_t>& selected_columns)
+{
+    int64_t number_of_columns = int64_t(m.columns());
+
+    if (number_of_columns == 0 || column_indeces.empty())
+        return nullptr;
+
+    // Every column is queried once even if it's selected more than once
+    DatabaseSelection selection;
+    selected_columns.clear();
+
+    for (int64_t column_index : column_indeces)
+    {
+        int64_t column = (number_of_columns + column_index % number_of_columns) % number_of_columns;
+
+        auto iter = std::find(selection.columns.begin(), selection.columns.end(), column);
+
+        selected_columns.push_back(int64_t(iter - selection.columns.begin()));
+
+        if (iter == selection.columns.end())
+            selection.columns.push_back(column);
+    }
+
+    auto selected_matrix = m.get_ptr()->select(selection);
+
+    if (!selected_matrix->get_last_error().empty())
+        return nullptr;
+
+    return selected_matrix;
+}
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+/**
+ * @brief Selects columns of a database matrix, querying only those columns.
+ * @param m Shared reference to the database matrix.
+ * @param column_indeces Indeces of the columns to select.
+ * @return A ConstSharedMatrixRef to the MultipleVectorSelectorView, viewing
+ *         a database matrix which only queries the selected columns.
+ */
+//-------------------------------------------------------------------
+inline auto columns(ConstSharedMatrixRef<DatabaseMatrix> m, const std::vector<int64_t>& column_indeces)
+{
+    std::vector<int64_t> selected_columns;
+
+    if (auto selected_matrix = select_database_columns(m, column_indeces, selected_columns))
+        return create_multiple_vector_selector_view(ConstSharedMatrixRef<DatabaseMatrix>(selected_matrix), selected_columns, false);
+
+    return create_multiple_vector_selector_view(m, column_indeces, false);
+}
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+/**
+ * @brief Selects a column of a database matrix, querying only that column.
+ * @param m Shared reference to the database matrix.
+ * @param column_index Index of the column to select.
+ * @return A ConstSharedMatrixRef to the SingleVectorSelectorView, viewing
+ *         a database matrix which only queries the selected column.
+ */
+//-------------------------------------------------------------------
+inline auto column(ConstSharedMatrixRef<DatabaseMatrix> m, int64_t column_index)
+{
+    std::vector<int64_t> selected_columns;
+
+    if (auto selected_matrix = select_database_columns(m, {column_index}, selected_columns))
+        return create_single_vector_selector_view(ConstSharedMatrixRef<DatabaseMatrix>(selected_matrix), 0, false);
+
+    return create_single_vector_selector_view(m, column_index, false);
+}
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+/**
+ * @brief Selects rows and columns of a database matrix, querying only
+ *        the selected columns.
+ * @param m Shared reference to the database matrix.
+ * @param selected_rows Indeces of the rows to select.
+ * @param selected_columns Indeces of the columns to select.
+ * @return A ConstSharedMatrixRef to the RowAndColumnSelectorView, viewing
+ *         a database matrix which only queries the selected columns.
+ */
+//-------------------------------------------------------------------
+inline auto rows_and_columns(ConstSharedMatrixRef<DatabaseMatrix> m,
+                             const std::vector<int64_t>& selected_rows,
+                             const std::vector<int64_t>& selected_columns)
+{
+    using view_type = RowAndColumnSelectorView<ConstSharedMatrixRef<DatabaseMatrix>>;
+
+    std::vector<int64_t> columns_of_selected_matrix;
+
+    if (auto selected_matrix = select_database_columns(m, selected_columns, columns_of_selected_matrix))
+    {
+        auto view = std::make_shared<view_type>(ConstSharedMatrixRef<DatabaseMatrix>(selected_matrix), selected_rows, columns_of_selected_matrix);
+        return ConstSharedMatrixRef<view_type>(view);
+    }
+
+    auto view = std::make_shared<view_type>(m, selected_rows, selected_columns);
+    return ConstSharedMatrixRef<view_type>(view);
+}
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+/**
+ * @brief Creates a ROI of a database matrix, querying only the rows and
+ *        columns of the ROI when it lies inside the matrix (ROIs wrapping
+ *        around the matrix query every row and column).
+ * @param m Shared reference to the database matrix.
+ * @param row1 first row of the ROI.
+ * @param column1 first column of the ROI.
+ * @param row2 second row of the ROI.
+ * @param column2 second column of the ROI.
+ * @return A ConstSharedMatrixRef to the ROI view.
+ */
+//-------------------------------------------------------------------
+inline auto roi(ConstSharedMatrixRef<DatabaseMatrix> m,
+                int64_t row1, int64_t column1, int64_t row2, int64_t column2)
+{
+    using view_type = ROIView<ConstSharedMatrixRef<DatabaseMatrix>>;
+
+    int64_t first_row = std::min(row1, row2);
+    int64_t last_row = std::max(row1, row2);
+    int64_t first_column = std::min(column1, column2);
+    int64_t last_column = std::max(column1, column2);
+
+    bool is_inside_matrix = first_row >= 0 && last_row < int64_t(m.rows()) &&
+                            first_column >= 0 && last_column < int64_t(m.columns());
+
+    if (is_inside_matrix)
+    {
+        DatabaseSelection selection;
+        selection.first_row = first_row;
+        selection.number_of_rows = last_row - first_row + 1;
+
+        for (int64_t column = first_column; column <= last_column; ++column)
+            selection.columns.push_back(column);
+
+        auto selected_matrix = m.get_ptr()->select(selection);
+
+        if (selected_matrix->get_last_error().empty())
+        {
+            // The ROI covers the whole selected matrix, keeping its direction
+            ConstSharedMatrixRef<DatabaseMatrix> selected_reference(selected_matrix);
+
+            auto view = std::make_shared<view_type>(selected_reference,
+                                                    row1 - first_row, column1 - first_column,
+                                                    row2 - first_row, column2 - first_column);
+
+            return ConstSharedMatrixRef<view_type>(view);
+        }
+    }
+
+    auto view = std::make_shared<view_type>(m, row1, column1, row2, column2);
+    return ConstSharedMatrixRef<view_type>(view);
 }
 //-------------------------------------------------------------------
 
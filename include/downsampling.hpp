@@ -23,11 +23,16 @@
 
 
 //-------------------------------------------------------------------
+#include <algorithm>
+#include <cmath>
 #include <cstdint>
+#include <vector>
 
 #include "base_matrix.hpp"
+#include "expression_evaluation.hpp"
 #include "selector_view.hpp"
 #include "shared_references.hpp"
+#include "thread_pool.hpp"
 //-------------------------------------------------------------------
 
 
@@ -327,6 +332,279 @@ inline void downsample_lttb_xy(const ReferenceType1& x_source,
 
 
 
+//-------------------------------------------------------------------
+/**
+ * @brief Reads count consecutive values of a channel of a matrix (a row
+ *        when sample_rows is true, a column otherwise), starting at the
+ *        given position within the channel.
+ *
+ * Rows are read with evaluate_row_block, which points straight into the
+ * memory of matrices with contiguous rows. Columns of matrices with
+ * contiguous storage are read with a stride, columns of matrices with
+ * contiguous rows are read one row at a time, and every other matrix
+ * goes through at().
+ *
+ * @param source The source matrix.
+ * @param channel The row (or column) to read.
+ * @param position Position of the first value within the channel.
+ * @param count Number of values to read (at most expression_block_size).
+ * @param sample_rows If true the channel is a row, otherwise a column.
+ * @param buffer Where the values are written if they can't be read in place.
+ * @return Pointer to the values.
+ */
+//-------------------------------------------------------------------
+template<typename ReferenceType,
+         std::enable_if_t<is_matrix_reference<ReferenceType>{}>* = nullptr>
+
+inline const typename ReferenceType::value_type* read_channel_block(const ReferenceType& source,
+                                                                    int64_t channel,
+                                                                    int64_t position,
+                                                                    uintptr_t count,
+                                                                    bool sample_rows,
+                                                                    typename ReferenceType::value_type* buffer)
+{
+    using matrix_type = typename ReferenceType::matrix_type;
+
+    if(sample_rows)
+        return evaluate_row_block(source, channel, position, count, buffer);
+
+    if constexpr(has_contiguous_storage<matrix_type>::value)
+    {
+        auto data = source.data();
+
+        if(data)
+        {
+            uintptr_t row_stride = source.row_stride();
+            auto column_data = data + position * row_stride + channel;
+
+            for(uintptr_t i = 0; i < count; ++i)
+                buffer[i] = column_data[i * row_stride];
+
+            return buffer;
+        }
+    }
+    else if constexpr(has_contiguous_rows<matrix_type>::value)
+    {
+        // Rows aren't evenly spaced (like with a row selector),
+        // so each value is read from its own row
+        for(uintptr_t i = 0; i < count; ++i)
+        {
+            auto row_span = source.row_span(position + i);
+
+            buffer[i] = row_span.empty() ? source.at(position + i, channel) : row_span[channel];
+        }
+
+        return buffer;
+    }
+
+    for(uintptr_t i = 0; i < count; ++i)
+        buffer[i] = source.at(position + i, channel);
+
+    return buffer;
+}
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+/**
+ * @brief Downsamples one channel (row or column) of a matrix using the
+ *        Largest Triangle Three Buckets (LTTB) algorithm.
+ *
+ * Gives the same result as downsample_lttb (or downsample_lttb_xy when an
+ * x channel is given) on the selected row or column, but without going
+ * through circ_at for every sample: the circular range is wrapped once per
+ * bucket and then read a block at a time (see read_channel_block), the
+ * average of each bucket is computed once, and the triangle areas of a
+ * block are computed in a loop the compiler can vectorize before picking
+ * the largest one.
+ *
+ * @param source_matrix The source matrix containing the original data points.
+ * @param destination_matrix The destination matrix where the downsampled data will be stored.
+ * @param channel The row (or column) to downsample.
+ * @param x_channel The row (or column) holding the x values, or -1 to use the sample indices.
+ * @param write_x_channel If true the x values of the selected points are also written.
+ * @param start_index The starting index for downsampling.
+ * @param end_index The ending index for downsampling.
+ * @param sample_rows If true the channel is a row, otherwise a column.
+ */
+//-------------------------------------------------------------------
+template<typename ReferenceType1,
+         typename ReferenceType2,
+         std::enable_if_t<is_matrix_reference<ReferenceType1>{}>* = nullptr,
+         std::enable_if_t<is_matrix_reference<ReferenceType2>{}>* = nullptr>
+
+inline void downsample_lttb_channel(const ReferenceType1& source_matrix,
+                                    ReferenceType2& destination_matrix,
+                                    int64_t channel,
+                                    int64_t x_channel,
+                                    bool write_x_channel,
+                                    int64_t start_index,
+                                    int64_t end_index,
+                                    bool sample_rows)
+{
+    using value_type = typename ReferenceType1::value_type;
+
+    int64_t channel_length = sample_rows ? source_matrix.columns() : source_matrix.rows();
+    uintptr_t source_size = std::abs(end_index - start_index);
+    uintptr_t destination_size = sample_rows ? destination_matrix.columns() : destination_matrix.rows();
+
+    if(destination_size == 0 || source_size == 0 || channel_length == 0)
+        return;
+
+    bool has_x_channel = (x_channel >= 0);
+
+    auto wrap = [channel_length](int64_t index)
+    {
+        return (channel_length + index % channel_length) % channel_length;
+    };
+
+    auto value_at = [&](int64_t current_channel, int64_t position) -> value_type
+    {
+        return sample_rows ? source_matrix.at(current_channel, position) : source_matrix.at(position, current_channel);
+    };
+
+    auto write_point = [&](uintptr_t destination_index, int64_t position)
+    {
+        if(sample_rows)
+            destination_matrix(channel, destination_index) = source_matrix.at(channel, position);
+        else
+            destination_matrix(destination_index, channel) = source_matrix.at(position, channel);
+
+        if(has_x_channel && write_x_channel)
+        {
+            if(sample_rows)
+                destination_matrix(x_channel, destination_index) = source_matrix.at(x_channel, position);
+            else
+                destination_matrix(destination_index, x_channel) = source_matrix.at(position, x_channel);
+        }
+    };
+
+    if(destination_size >= source_size)
+    {
+        for(uintptr_t count = 0; count < source_size; ++count)
+            write_point(count, wrap(start_index + count));
+
+        return;
+    }
+
+    if(destination_size == 1)
+    {
+        write_point(0, wrap(start_index));
+        return;
+    }
+
+    std::vector<value_type> y_buffer(expression_block_size);
+    std::vector<value_type> x_buffer(has_x_channel ? expression_block_size : 0);
+    double areas[expression_block_size];
+
+    // Calls function(first_index, count, y_values, x_values) on consecutive
+    // blocks of the range [range_start, range_end), wrapping around the channel
+    auto for_each_block = [&](int64_t range_start, int64_t range_end, auto&& function)
+    {
+        int64_t position = wrap(range_start);
+
+        for(int64_t index = range_start; index < range_end;)
+        {
+            uintptr_t count = std::min<int64_t>({int64_t(expression_block_size), range_end - index, channel_length - position});
+
+            const value_type* y_values = read_channel_block(source_matrix, channel, position, count, sample_rows, y_buffer.data());
+            const value_type* x_values = has_x_channel ? read_channel_block(source_matrix, x_channel, position, count, sample_rows, x_buffer.data()) : nullptr;
+
+            function(index, count, y_values, x_values);
+
+            index += count;
+            position += count;
+
+            if(position == channel_length)
+                position = 0;
+        }
+    };
+
+    auto every = static_cast<double>(source_size - 2) / static_cast<double>(destination_size - 2);
+
+    int64_t a_index = start_index;
+    double x0 = has_x_channel ? double(value_at(x_channel, wrap(a_index))) : double(a_index);
+    double y0 = double(value_at(channel, wrap(a_index)));
+
+    write_point(0, wrap(a_index));
+    uintptr_t dest_index = 1;
+
+    for(uintptr_t i = 0; i < destination_size - 2; ++i)
+    {
+        int64_t avg_range_start = start_index + static_cast<int64_t>((i + 1) * every) + 1;
+        int64_t avg_range_end = start_index + static_cast<int64_t>((i + 2) * every) + 1;
+        int64_t avg_range_length = std::abs(avg_range_end - avg_range_start);
+
+        // Average point of the bucket
+        double avg_x = 0, avg_y = 0;
+
+        for_each_block(avg_range_start, avg_range_end, [&](int64_t, uintptr_t count, const value_type* y_values, const value_type* x_values)
+        {
+            for(uintptr_t k = 0; k < count; ++k)
+                avg_y += y_values[k];
+
+            if(x_values)
+                for(uintptr_t k = 0; k < count; ++k)
+                    avg_x += x_values[k];
+        });
+
+        avg_y /= avg_range_length;
+
+        if(has_x_channel)
+            avg_x /= avg_range_length;
+        else
+            avg_x = (avg_range_start + avg_range_end) / 2.0;
+
+        // Point of the bucket forming the largest triangle
+        double max_area = -1;
+        int64_t next_a_index = a_index;
+        double next_x0 = x0, next_y0 = y0;
+
+        for_each_block(avg_range_start, avg_range_end, [&](int64_t first_index, uintptr_t count, const value_type* y_values, const value_type* x_values)
+        {
+            if(x_values)
+            {
+                for(uintptr_t k = 0; k < count; ++k)
+                {
+                    double x1 = x_values[k], y1 = y_values[k];
+                    areas[k] = std::abs((x0 - avg_x) * (y1 - y0) - (x0 - x1) * (avg_y - y0)) / 2;
+                }
+            }
+            else
+            {
+                for(uintptr_t k = 0; k < count; ++k)
+                {
+                    double x1 = double(first_index + int64_t(k)), y1 = y_values[k];
+                    areas[k] = std::abs((x0 - avg_x) * (y1 - y0) - (x0 - x1) * (avg_y - y0)) / 2;
+                }
+            }
+
+            for(uintptr_t k = 0; k < count; ++k)
+            {
+                if(areas[k] > max_area)
+                {
+                    max_area = areas[k];
+                    next_a_index = first_index + k;
+                    next_y0 = y_values[k];
+                    next_x0 = x_values ? double(x_values[k]) : double(next_a_index);
+                }
+            }
+        });
+
+        write_point(dest_index++, wrap(next_a_index));
+
+        a_index = next_a_index;
+        x0 = next_x0;
+        y0 = next_y0;
+    }
+
+    write_point(dest_index, wrap(end_index));
+}
+//-------------------------------------------------------------------
+
+
+
 //-------------------------------------------------------------------
 /**
  * @brief Downsamples each column or row of a matrix using the Largest Triangle Three Buckets (LTTB) algorithm.
@@ -334,11 +612,16 @@ inline void downsample_lttb_xy(const ReferenceType1& x_source,
  * This function applies the LTTB algorithm to independently downsample each column or row of the source matrix.
  * It is useful for reducing the number of data points in a matrix while preserving the visual shape of the data.
  *
+ * The rows (or columns) are downsampled in parallel on the thread pool (see downsample_lttb_channel).
+ * The source is read from every thread of the pool, the overload below without a pool only reads
+ * sources with has_contiguous_storage from several threads.
+ *
  * @param source_matrix The source matrix containing the original data points.
  * @param destination_matrix The destination matrix where the downsampled data will be stored.
  * @param start_index The starting index for downsampling.
  * @param end_index The ending index for downsampling.
  * @param sample_rows If true, rows will be downsampled; if false, columns will be downsampled.
+ * @param thread_pool Thread pool used to downsample the rows (or columns).
  *
  * Example usage:
  * - Downsample columns:
@@ -356,26 +639,45 @@ inline void downsample_lttb_matrix(const ReferenceType1& source_matrix,
                                    ReferenceType2 destination_matrix,
                                    int64_t start_index,
                                    int64_t end_index,
-                                   bool sample_rows)
+                                   bool sample_rows,
+                                   ThreadPool& thread_pool)
 {
-    if (sample_rows)
+    uintptr_t number_of_channels = sample_rows ? source_matrix.rows() : source_matrix.columns();
+
+    auto downsample_channel = [&](uintptr_t channel)
     {
-        for (size_t row = 0; row < source_matrix.rows(); ++row)
-        {
-            auto current_source_row = select_a_single_row(source_matrix, row);
-            auto current_destination_row = select_a_single_row_view(destination_matrix, row);
-            downsample_lttb(current_source_row, current_destination_row, start_index, end_index);
-        }
-    }
+        downsample_lttb_channel(source_matrix, destination_matrix, channel, -1, false, start_index, end_index, sample_rows);
+    };
+
+    thread_pool.parallel_for(number_of_channels, downsample_channel);
+}
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+/**
+ * @brief Downsamples each column or row of a matrix using the LTTB algorithm (see above), on the
+ *        default thread pool for sources with has_contiguous_storage and on the calling thread for
+ *        any other source, since lazy views and file or database backed matrices might not be safe
+ *        to read from several threads at once.
+ */
+//-------------------------------------------------------------------
+template<typename ReferenceType1,
+         typename ReferenceType2,
+         std::enable_if_t<is_matrix_reference<ReferenceType1>{}>* = nullptr,
+         std::enable_if_t<is_matrix_reference<ReferenceType2>{}>* = nullptr>
+
+inline void downsample_lttb_matrix(const ReferenceType1& source_matrix,
+                                   ReferenceType2 destination_matrix,
+                                   int64_t start_index,
+                                   int64_t end_index,
+                                   bool sample_rows)
+{
+    if constexpr(has_contiguous_storage<typename ReferenceType1::matrix_type>::value)
+        downsample_lttb_matrix(source_matrix, destination_matrix, start_index, end_index, sample_rows, get_default_thread_pool());
     else
-    {
-        for (size_t column = 0; column < source_matrix.columns(); ++column)
-        {
-            auto current_source_column = select_a_single_column(source_matrix, column);
-            auto current_destination_column = select_a_single_column_view(destination_matrix, column);
-            downsample_lttb(current_source_column, current_destination_column, start_index, end_index);
-        }
-    }
+        downsample_lttb_matrix(source_matrix, destination_matrix, start_index, end_index, sample_rows, get_serial_thread_pool());
 }
 //-------------------------------------------------------------------
 
@@ -387,7 +689,12 @@ inline void downsample_lttb_matrix(const ReferenceType1& source_matrix,
  *
  * This function applies the LTTB algorithm to independently downsample each column or row of the source matrix
  * in the context of x/y graph data. One row (or column) is used as the x-axis data for all downsampled y-axis data.
- * The x_index can be any integer, as circ_at handles circular and negative indexing.
+ * The x_index can be any integer, as it wraps around like circ_at. The x row (or column) of the destination gets
+ * the x values of the points selected for the last y row (or column).
+ *
+ * The rows (or columns) are downsampled in parallel on the thread pool (see downsample_lttb_channel).
+ * The source is read from every thread of the pool, the overload below without a pool only reads
+ * sources with has_contiguous_storage from several threads.
  *
  * @param source_matrix The source matrix containing the original data points.
  * @param destination_matrix The destination matrix where the downsampled data will be stored.
@@ -395,6 +702,7 @@ inline void downsample_lttb_matrix(const ReferenceType1& source_matrix,
  * @param start_index The starting index for downsampling.
  * @param end_index The ending index for downsampling.
  * @param sample_rows If true, rows will be downsampled; if false, columns will be downsampled.
+ * @param thread_pool Thread pool used to downsample the rows (or columns).
  *
  * Note: The function returns immediately if the size of either source or destination matrix is zero.
  */
@@ -402,47 +710,59 @@ inline void downsample_lttb_matrix(const ReferenceType1& source_matrix,
 template<typename ReferenceType1,
          typename ReferenceType2,
          std::enable_if_t<is_matrix_reference<ReferenceType1>{} && is_matrix_reference<ReferenceType2>{}>* = nullptr>
-         
+
 inline void downsample_lttb_matrix_xy(const ReferenceType1& source_matrix,
                                       ReferenceType2 destination_matrix,
                                       int64_t x_index,
                                       int64_t start_index,
                                       int64_t end_index,
-                                      bool sample_rows)
+                                      bool sample_rows,
+                                      ThreadPool& thread_pool)
 {
     if (source_matrix.size() == 0 || destination_matrix.size() == 0)
         return; // Return immediately if source or destination matrix is empty
 
-    if (sample_rows)
+    int64_t number_of_channels = sample_rows ? source_matrix.rows() : source_matrix.columns();
+    int64_t x_channel = (number_of_channels + x_index % number_of_channels) % number_of_channels;
+
+    // The last y channel also writes the x values
+    int64_t last_y_channel = (x_channel == number_of_channels - 1) ? number_of_channels - 2 : number_of_channels - 1;
+
+    auto downsample_channel = [&](uintptr_t channel)
     {
-        auto x_source_row = select_a_single_row(source_matrix, x_index);
-        auto x_destination_row = select_a_single_row_view(destination_matrix, x_index);
+        if (int64_t(channel) == x_channel) return; // Skip x-axis row (or column)
 
-        for (size_t row = 0; row < source_matrix.rows(); ++row)
-        {
-            if (row == x_index) continue; // Skip x-axis row
+        downsample_lttb_channel(source_matrix, destination_matrix, channel, x_channel, int64_t(channel) == last_y_channel, start_index, end_index, sample_rows);
+    };
 
-            auto y_source_row = select_a_single_row(source_matrix, row);
-            auto y_destination_row = select_a_single_row_view(destination_matrix, row);
+    thread_pool.parallel_for(number_of_channels, downsample_channel);
+}
+//-------------------------------------------------------------------
 
-            downsample_lttb_xy(x_source_row, y_source_row, x_destination_row, y_destination_row, start_index, end_index);
-        }
-    }
-    else
-    {
-        auto x_source_column = select_a_single_column(source_matrix, x_index);
-        auto x_destination_column = select_a_single_column_view(destination_matrix, x_index);
 
-        for (size_t column = 0; column < source_matrix.columns(); ++column)
-        {
-            if (column == x_index) continue; // Skip x-axis column
 
-            auto y_source_column = select_a_single_column(source_matrix, column);
-            auto y_destination_column = select_a_single_column_view(destination_matrix, column);
+//-------------------------------------------------------------------
+/**
+ * @brief Downsamples each column or row of a matrix for x/y graphs using the LTTB algorithm (see
+ *        above), on the default thread pool for sources with has_contiguous_storage and on the
+ *        calling thread for any other source.
+ */
+//-------------------------------------------------------------------
+template<typename ReferenceType1,
+         typename ReferenceType2,
+         std::enable_if_t<is_matrix_reference<ReferenceType1>{} && is_matrix_reference<ReferenceType2>{}>* = nullptr>
 
-            downsample_lttb_xy(x_source_column, y_source_column, x_destination_column, y_destination_column, start_index, end_index);
-        }
-    }
+inline void downsample_lttb_matrix_xy(const ReferenceType1& source_matrix,
+                                      ReferenceType2 destination_matrix,
+                                      int64_t x_index,
+                                      int64_t start_index,
+                                      int64_t end_index,
+                                      bool sample_rows)
+{
+    if constexpr(has_contiguous_storage<typename ReferenceType1::matrix_type>::value)
+        downsample_lttb_matrix_xy(source_matrix, destination_matrix, x_index, start_index, end_index, sample_rows, get_default_thread_pool());
+    else
+        downsample_lttb_matrix_xy(source_matrix, destination_matrix, x_index, start_index, end_index, sample_rows, get_serial_thread_pool());
 }
 //-------------------------------------------------------------------
 
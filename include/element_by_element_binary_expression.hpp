@@ -29,6 +29,7 @@
 #include <complex>
 #include "base_matrix.hpp"
 #include "shared_references.hpp"
+#include "expression_evaluation.hpp"
 //-------------------------------------------------------------------
 
 
@@ -50,16 +51,22 @@ namespace LazyMatrix
  * to be applied element-wise between two matrices. It uses a functional approach to define 
  * the operation that should be applied to corresponding elements of the matrices.
  *
+ * The operation is a template parameter, so that when the expression is
+ * evaluated a row block at a time (see evaluate_row_block()) the operation
+ * gets inlined into the loop over the block.
+ *
  * @tparam ReferenceType1 Type of the first matrix (left operand).
  * @tparam ReferenceType2 Type of the second matrix (right operand).
+ * @tparam OperationType Type of the function object combining both operands.
  */
 //-------------------------------------------------------------------
 template<typename ReferenceType1,
          typename ReferenceType2,
+         typename OperationType = std::function<typename ReferenceType1::value_type(typename ReferenceType1::value_type, typename ReferenceType1::value_type)>,
          std::enable_if_t<is_matrix_reference<ReferenceType1>{}>* = nullptr,
          std::enable_if_t<is_matrix_reference<ReferenceType2>{}>* = nullptr>
 
-class ElementByElementBinaryExpression : public BaseMatrix<ElementByElementBinaryExpression<ReferenceType1, ReferenceType2>,false>
+class ElementByElementBinaryExpression : public BaseMatrix<ElementByElementBinaryExpression<ReferenceType1, ReferenceType2, OperationType>,false>
 {
 public:
 
@@ -67,9 +74,9 @@ public:
     using value_type = typename ReferenceType1::value_type;
 
     // The operation function type
-    using operation_type = std::function<value_type(value_type, value_type)>;
+    using operation_type = OperationType;
 
-    friend class BaseMatrix<ElementByElementBinaryExpression<ReferenceType1, ReferenceType2>,false>;
+    friend class BaseMatrix<ElementByElementBinaryExpression<ReferenceType1, ReferenceType2, OperationType>,false>;
 
     /**
      * @brief Construct a new Element By Element Binary Expression<Reference Type 1,Reference Type 2> object
@@ -82,10 +89,10 @@ public:
     ElementByElementBinaryExpression(ReferenceType1 left_side_expression,
                                      ReferenceType2 right_side_expression,
                                      const operation_type& operation_function)
+    : operation_function_(operation_function)
     {
         set_left_side_expression(left_side_expression);
         set_right_side_expression(right_side_expression);
-        set_operation_function(operation_function);
     }
 
     /**
@@ -136,6 +143,28 @@ public:
         return this->left_side_expression_.columns();
     }
 
+    /**
+     * @brief Evaluates count consecutive elements of a row, starting
+     *        at (row, column), one operand block at a time.
+     * @param row The row of the elements.
+     * @param column The column of the first element.
+     * @param count The number of elements (at most expression_block_size).
+     * @param output Where the elements are written.
+     * @return Pointer to the evaluated elements (always output).
+     */
+    const value_type* evaluate_row_block(int64_t row, int64_t column, uintptr_t count, value_type* output)const
+    {
+        typename ReferenceType2::value_type right_side_buffer[expression_block_size];
+
+        const auto* left_side_values = LazyMatrix::evaluate_row_block(left_side_expression_, row, column, count, output);
+        const auto* right_side_values = LazyMatrix::evaluate_row_block(right_side_expression_, row, column, count, right_side_buffer);
+
+        for(uintptr_t j = 0; j < count; ++j)
+            output[j] = static_cast<value_type>(operation_function_(left_side_values[j], right_side_values[j]));
+
+        return output;
+    }
+
     // Functions used to handle row and column header names
     std::string get_row_header(int64_t row_index) const { return this->headers_.get_row_header(row_index); }
     std::string get_column_header(int64_t column_index) const { return this->headers_.get_column_header(column_index); }
@@ -174,9 +203,24 @@ private: // Private variables
 // Compile time functions to check if the type is an expression type
 //-------------------------------------------------------------------
 template<typename ReferenceType1,
-         typename ReferenceType2>
+         typename ReferenceType2,
+         typename OperationType>
 
-struct is_type_a_matrix< ElementByElementBinaryExpression<ReferenceType1, ReferenceType2> > : std::true_type
+struct is_type_a_matrix< ElementByElementBinaryExpression<ReferenceType1, ReferenceType2, OperationType> > : std::true_type
+{
+};
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+// Binary expressions evaluate whole row blocks at a time
+//-------------------------------------------------------------------
+template<typename ReferenceType1,
+         typename ReferenceType2,
+         typename OperationType>
+
+struct has_block_evaluation< ElementByElementBinaryExpression<ReferenceType1, ReferenceType2, OperationType> > : std::true_type
 {
 };
 //-------------------------------------------------------------------
@@ -206,9 +250,13 @@ operator+(ReferenceType1 m1,
 {
     using value_type = typename std::remove_const<typename std::remove_reference<decltype(std::declval<ReferenceType1>()(0,0))>::type>::type;
 
-    auto view = std::make_shared<ElementByElementBinaryExpression<ReferenceType1,ReferenceType2>>(m1, m2, std::plus<value_type>());
+    auto operation = std::plus<value_type>();
+
+    using expression_type = ElementByElementBinaryExpression<ReferenceType1,ReferenceType2,decltype(operation)>;
 
-    return ConstSharedMatrixRef<ElementByElementBinaryExpression<ReferenceType1,ReferenceType2>>(view);
+    auto view = std::make_shared<expression_type>(m1, m2, operation);
+
+    return ConstSharedMatrixRef<expression_type>(view);
 }
 //-------------------------------------------------------------------
 
@@ -237,9 +285,13 @@ operator-(ReferenceType1 m1,
 {
     using value_type = typename std::remove_const<typename std::remove_reference<decltype(std::declval<ReferenceType1>()(0,0))>::type>::type;
 
-    auto view = std::make_shared<ElementByElementBinaryExpression<ReferenceType1,ReferenceType2>>(m1, m2, std::minus<value_type>());
+    auto operation = std::minus<value_type>();
+
+    using expression_type = ElementByElementBinaryExpression<ReferenceType1,ReferenceType2,decltype(operation)>;
 
-    return ConstSharedMatrixRef<ElementByElementBinaryExpression<ReferenceType1,ReferenceType2>>(view);
+    auto view = std::make_shared<expression_type>(m1, m2, operation);
+
+    return ConstSharedMatrixRef<expression_type>(view);
 }
 //-------------------------------------------------------------------
 
@@ -268,9 +320,13 @@ operator%(ReferenceType1 m1,
 {
     using value_type = typename std::remove_const<typename std::remove_reference<decltype(std::declval<ReferenceType1>()(0,0))>::type>::type;
 
-    auto view = std::make_shared<ElementByElementBinaryExpression<ReferenceType1,ReferenceType2>>(m1, m2, std::fmod<value_type>());
+    auto operation = [](value_type a, value_type b) { return std::fmod(a,b); };
+
+    using expression_type = ElementByElementBinaryExpression<ReferenceType1,ReferenceType2,decltype(operation)>;
 
-    return ConstSharedMatrixRef<ElementByElementBinaryExpression<ReferenceType1,ReferenceType2>>(view);
+    auto view = std::make_shared<expression_type>(m1, m2, operation);
+
+    return ConstSharedMatrixRef<expression_type>(view);
 }
 //-------------------------------------------------------------------
 
@@ -299,9 +355,13 @@ elem_by_elem_multiply(ReferenceType1 m1,
 {
     using value_type = typename std::remove_const<typename std::remove_reference<decltype(std::declval<ReferenceType1>()(0,0))>::type>::type;
 
-    auto view = std::make_shared<ElementByElementBinaryExpression<ReferenceType1,ReferenceType2>>(m1, m2, std::multiplies<value_type>());
+    auto operation = std::multiplies<value_type>();
+
+    using expression_type = ElementByElementBinaryExpression<ReferenceType1,ReferenceType2,decltype(operation)>;
 
-    return ConstSharedMatrixRef<ElementByElementBinaryExpression<ReferenceType1,ReferenceType2>>(view);
+    auto view = std::make_shared<expression_type>(m1, m2, operation);
+
+    return ConstSharedMatrixRef<expression_type>(view);
 }
 //-------------------------------------------------------------------
 
@@ -330,9 +390,13 @@ elem_by_elem_divide(ReferenceType1 m1,
 {
     using value_type = typename std::remove_const<typename std::remove_reference<decltype(std::declval<ReferenceType1>()(0,0))>::type>::type;
 
-    auto view = std::make_shared<ElementByElementBinaryExpression<ReferenceType1,ReferenceType2>>(m1, m2, std::divides<value_type>());
+    auto operation = std::divides<value_type>();
+
+    using expression_type = ElementByElementBinaryExpression<ReferenceType1,ReferenceType2,decltype(operation)>;
+
+    auto view = std::make_shared<expression_type>(m1, m2, operation);
 
-    return ConstSharedMatrixRef<ElementByElementBinaryExpression<ReferenceType1,ReferenceType2>>(view);
+    return ConstSharedMatrixRef<expression_type>(view);
 }
 //-------------------------------------------------------------------
 
@@ -361,9 +425,13 @@ elem_by_elem_pow(ReferenceType1 m1,
 {
     using value_type = typename std::remove_const<typename std::remove_reference<decltype(std::declval<ReferenceType1>()(0,0))>::type>::type;
 
-    auto view = std::make_shared<ElementByElementBinaryExpression<ReferenceType1,ReferenceType2>>(m1, m2, [](value_type a, value_type b) { return std::pow(a,b); });
+    auto operation = [](value_type a, value_type b) { return std::pow(a,b); };
+
+    using expression_type = ElementByElementBinaryExpression<ReferenceType1,ReferenceType2,decltype(operation)>;
+
+    auto view = std::make_shared<expression_type>(m1, m2, operation);
 
-    return ConstSharedMatrixRef<ElementByElementBinaryExpression<ReferenceType1,ReferenceType2>>(view);
+    return ConstSharedMatrixRef<expression_type>(view);
 }
 //-------------------------------------------------------------------
 
@@ -392,9 +460,13 @@ min(ReferenceType1 m1,
 {
     using value_type = typename std::remove_const<typename std::remove_reference<decltype(std::declval<ReferenceType1>()(0,0))>::type>::type;
 
-    auto view = std::make_shared<ElementByElementBinaryExpression<ReferenceType1,ReferenceType2>>(m1, m2, [](value_type a, value_type b) { return std::min(a,b); });
+    auto operation = [](value_type a, value_type b) { return std::min(a,b); };
 
-    return ConstSharedMatrixRef<ElementByElementBinaryExpression<ReferenceType1,ReferenceType2>>(view);
+    using expression_type = ElementByElementBinaryExpression<ReferenceType1,ReferenceType2,decltype(operation)>;
+
+    auto view = std::make_shared<expression_type>(m1, m2, operation);
+
+    return ConstSharedMatrixRef<expression_type>(view);
 }
 //-------------------------------------------------------------------
 
@@ -423,9 +495,13 @@ max(ReferenceType1 m1,
 {
     using value_type = typename std::remove_const<typename std::remove_reference<decltype(std::declval<ReferenceType1>()(0,0))>::type>::type;
 
-    auto view = std::make_shared<ElementByElementBinaryExpression<ReferenceType1,ReferenceType2>>(m1, m2, [](value_type a, value_type b) { return std::max(a,b); });
+    auto operation = [](value_type a, value_type b) { return std::max(a,b); };
+
+    using expression_type = ElementByElementBinaryExpression<ReferenceType1,ReferenceType2,decltype(operation)>;
+
+    auto view = std::make_shared<expression_type>(m1, m2, operation);
 
-    return ConstSharedMatrixRef<ElementByElementBinaryExpression<ReferenceType1,ReferenceType2>>(view);
+    return ConstSharedMatrixRef<expression_type>(view);
 }
 //-------------------------------------------------------------------
 
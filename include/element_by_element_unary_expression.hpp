@@ -29,6 +29,7 @@
 #include <complex>
 #include "base_matrix.hpp"
 #include "shared_references.hpp"
+#include "expression_evaluation.hpp"
 //-------------------------------------------------------------------
 
 
@@ -50,13 +51,19 @@ namespace LazyMatrix
  * to be applied element-wise on a matrix. It uses a functional approach to define 
  * the operation that should be applied to each element of the matrix.
  *
+ * The operation is a template parameter, so that when the expression is
+ * evaluated a row block at a time (see evaluate_row_block()) the operation
+ * gets inlined into the loop over the block.
+ *
  * @tparam ReferenceType Type of the matrix.
+ * @tparam OperationType Type of the function object applied to each element.
  */
 //-------------------------------------------------------------------
 template<typename ReferenceType,
+         typename OperationType = std::function<typename ReferenceType::value_type(typename ReferenceType::value_type)>,
          std::enable_if_t<is_matrix_reference<ReferenceType>{}>* = nullptr>
 
-class ElementByElementUnaryExpression : public BaseMatrix<ElementByElementUnaryExpression<ReferenceType>,false>
+class ElementByElementUnaryExpression : public BaseMatrix<ElementByElementUnaryExpression<ReferenceType, OperationType>,false>
 {
 public:
 
@@ -64,9 +71,9 @@ public:
     using value_type = typename ReferenceType::value_type;
 
     // The operation function type
-    using operation_type = std::function<value_type(value_type)>;
+    using operation_type = OperationType;
 
-    friend class BaseMatrix<ElementByElementUnaryExpression<ReferenceType>,false>;
+    friend class BaseMatrix<ElementByElementUnaryExpression<ReferenceType, OperationType>,false>;
 
     /**
      * @brief Construct a new Element By Element Unary Expression< Reference Type> object
@@ -76,9 +83,9 @@ public:
      */
     ElementByElementUnaryExpression(ReferenceType expression,
                                     const operation_type& operation_function)
+    : operation_function_(operation_function)
     {
         set_expression(expression);
-        set_operation_function(operation_function);
     }
 
     /**
@@ -116,6 +123,25 @@ public:
         return expression_.columns();
     }
 
+    /**
+     * @brief Evaluates count consecutive elements of a row, starting
+     *        at (row, column), applying the operation on the whole block.
+     * @param row The row of the elements.
+     * @param column The column of the first element.
+     * @param count The number of elements (at most expression_block_size).
+     * @param output Where the elements are written.
+     * @return Pointer to the evaluated elements (always output).
+     */
+    const value_type* evaluate_row_block(int64_t row, int64_t column, uintptr_t count, value_type* output)const
+    {
+        const auto* values = LazyMatrix::evaluate_row_block(expression_, row, column, count, output);
+
+        for(uintptr_t j = 0; j < count; ++j)
+            output[j] = static_cast<value_type>(operation_function_(values[j]));
+
+        return output;
+    }
+
     // Functions used to handle row and column header names
     std::string get_row_header(int64_t row_index) const { return this->headers_.get_row_header(row_index); }
     std::string get_column_header(int64_t column_index) const { return this->headers_.get_column_header(column_index); }
@@ -151,9 +177,23 @@ private: // Private variables
 //-------------------------------------------------------------------
 // Compile time functions to check if the type is an expression type
 //-------------------------------------------------------------------
-template<typename ReferenceType>
+template<typename ReferenceType,
+         typename OperationType>
 
-struct is_type_a_matrix< ElementByElementUnaryExpression<ReferenceType> > : std::true_type
+struct is_type_a_matrix< ElementByElementUnaryExpression<ReferenceType, OperationType> > : std::true_type
+{
+};
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+// Unary expressions evaluate whole row blocks at a time
+//-------------------------------------------------------------------
+template<typename ReferenceType,
+         typename OperationType>
+
+struct has_block_evaluation< ElementByElementUnaryExpression<ReferenceType, OperationType> > : std::true_type
 {
 };
 //-------------------------------------------------------------------
@@ -178,9 +218,13 @@ operator-(ReferenceType m)
 {
     using value_type = typename std::remove_const<typename std::remove_reference<decltype(std::declval<ReferenceType>()(0,0))>::type>::type;
 
-    auto view = std::make_shared<ElementByElementUnaryExpression<ReferenceType>>(m, std::negate<value_type>());
+    auto operation = std::negate<value_type>();
+
+    using expression_type = ElementByElementUnaryExpression<ReferenceType,decltype(operation)>;
+
+    auto view = std::make_shared<expression_type>(m, operation);
 
-    return ConstSharedMatrixRef<ElementByElementUnaryExpression<ReferenceType>>(view);
+    return ConstSharedMatrixRef<expression_type>(view);
 }
 //-------------------------------------------------------------------
 
@@ -204,17 +248,17 @@ sign(ReferenceType m)
 {
     using value_type = typename std::remove_const<typename std::remove_reference<decltype(std::declval<ReferenceType>()(0,0))>::type>::type;
 
-    auto view = std::make_shared<ElementByElementUnaryExpression<ReferenceType>>
-                                                      (
-                                                       m,
-                                                       [](value_type number)
-                                                       {
-                                                            value_type zero = static_cast<value_type>(0);
-                                                            return static_cast<decltype(number)>( (zero < number) - (number < zero) );
-                                                       }
-                                                      );
-
-    return ConstSharedMatrixRef<ElementByElementUnaryExpression<ReferenceType>>(view);
+    auto operation = [](value_type number)
+    {
+        value_type zero = static_cast<value_type>(0);
+        return static_cast<decltype(number)>( (zero < number) - (number < zero) );
+    };
+
+    using expression_type = ElementByElementUnaryExpression<ReferenceType,decltype(operation)>;
+
+    auto view = std::make_shared<expression_type>(m, operation);
+
+    return ConstSharedMatrixRef<expression_type>(view);
 }
 //-------------------------------------------------------------------
 
@@ -238,9 +282,13 @@ abs(ReferenceType m)
 {
     using value_type = typename std::remove_const<typename std::remove_reference<decltype(std::declval<ReferenceType>()(0,0))>::type>::type;
 
-    auto view = std::make_shared<ElementByElementUnaryExpression<ReferenceType>>(m, [](const value_type& number){ return std::abs(number); });
+    auto operation = [](const value_type& number){ return std::abs(number); };
 
-    return ConstSharedMatrixRef<ElementByElementUnaryExpression<ReferenceType>>(view);
+    using expression_type = ElementByElementUnaryExpression<ReferenceType,decltype(operation)>;
+
+    auto view = std::make_shared<expression_type>(m, operation);
+
+    return ConstSharedMatrixRef<expression_type>(view);
 }
 //-------------------------------------------------------------------
 
@@ -264,9 +312,13 @@ sqrt(ReferenceType m)
 {
     using value_type = typename std::remove_const<typename std::remove_reference<decltype(std::declval<ReferenceType>()(0,0))>::type>::type;
 
-    auto view = std::make_shared<ElementByElementUnaryExpression<ReferenceType>>(m, [](const value_type& number){ return std::sqrt(number); });
+    auto operation = [](const value_type& number){ return std::sqrt(number); };
+
+    using expression_type = ElementByElementUnaryExpression<ReferenceType,decltype(operation)>;
+
+    auto view = std::make_shared<expression_type>(m, operation);
 
-    return ConstSharedMatrixRef<ElementByElementUnaryExpression<ReferenceType>>(view);
+    return ConstSharedMatrixRef<expression_type>(view);
 }
 //-------------------------------------------------------------------
 
@@ -290,9 +342,13 @@ exp(ReferenceType m)
 {
     using value_type = typename std::remove_const<typename std::remove_reference<decltype(std::declval<ReferenceType>()(0,0))>::type>::type;
 
-    auto view = std::make_shared<ElementByElementUnaryExpression<ReferenceType>>(m, [](const value_type& number){ return std::exp(number); });
+    auto operation = [](const value_type& number){ return std::exp(number); };
 
-    return ConstSharedMatrixRef<ElementByElementUnaryExpression<ReferenceType>>(view);
+    using expression_type = ElementByElementUnaryExpression<ReferenceType,decltype(operation)>;
+
+    auto view = std::make_shared<expression_type>(m, operation);
+
+    return ConstSharedMatrixRef<expression_type>(view);
 }
 //-------------------------------------------------------------------
 
@@ -316,9 +372,13 @@ exp2(ReferenceType m)
 {
     using value_type = typename std::remove_const<typename std::remove_reference<decltype(std::declval<ReferenceType>()(0,0))>::type>::type;
 
-    auto view = std::make_shared<ElementByElementUnaryExpression<ReferenceType>>(m, [](const value_type& number){ return std::exp2(number); });
+    auto operation = [](const value_type& number){ return std::exp2(number); };
+
+    using expression_type = ElementByElementUnaryExpression<ReferenceType,decltype(operation)>;
+
+    auto view = std::make_shared<expression_type>(m, operation);
 
-    return ConstSharedMatrixRef<ElementByElementUnaryExpression<ReferenceType>>(view);
+    return ConstSharedMatrixRef<expression_type>(view);
 }
 //-------------------------------------------------------------------
 
@@ -0,0 +1,188 @@
+//-------------------------------------------------------------------
+/**
+ * @file expression_evaluation.hpp
+ * @brief Block-at-a-time evaluation of lazy matrix expressions.
+ *
+ * Reading a lazy expression through at() evaluates one element per call,
+ * going through every node of the expression for each element. The
+ * functions defined here instead evaluate a block of consecutive elements
+ * of a row at a time:
+ * - Matrices with contiguous rows are copied straight from memory.
+ * - Expression nodes that support it (has_block_evaluation) evaluate their
+ *   operands block by block and apply their operation on the whole block
+ *   in a tight loop the compiler can vectorize.
+ * - Any other expression falls back to at().
+ *
+ * @author Vincenzo Barbato
+ *
+ * Additional Information:
+ * - GitHub Project: [LazyMatrix](https://github.com/navyenzo/LazyMatrix.git)
+ * - LinkedIn: [Vincenzo Barbato](https://www.linkedin.com/in/vincenzobarbato/)
+ */
+//-------------------------------------------------------------------
+
+
+
+#ifndef INCLUDE_EXPRESSION_EVALUATION_HPP_
+#define INCLUDE_EXPRESSION_EVALUATION_HPP_
+
+
+
+//-------------------------------------------------------------------
+#include <algorithm>
+#include <cstdint>
+#include <type_traits>
+
+#include "base_matrix.hpp"
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+namespace LazyMatrix
+{
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+/**
+ * @brief Maximum number of elements evaluated at once by
+ *        evaluate_row_block() (small enough for the temporary
+ *        blocks of every node of an expression to stay in L1 cache)
+ */
+//-------------------------------------------------------------------
+constexpr uintptr_t expression_block_size = 256;
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+/**
+ * @brief Trait to check if a matrix expression type has its own
+ *        evaluate_row_block(row, column, count, output) function.
+ *
+ * @tparam MatrixType The matrix type to check.
+ */
+//-------------------------------------------------------------------
+template<typename MatrixType>
+struct has_block_evaluation : std::false_type
+{
+};
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+/**
+ * @brief Evaluates count consecutive elements of a row of a matrix
+ *        expression, starting at (row, column).
+ *
+ * Matrices with contiguous rows aren't copied, the returned pointer
+ * points straight into their memory. Every other expression is
+ * evaluated into the given buffer.
+ *
+ * @tparam ReferenceType The reference type of the matrix expression.
+ * @param expression The matrix expression.
+ * @param row The row of the elements.
+ * @param column The column of the first element.
+ * @param count The number of elements (at most expression_block_size).
+ * @param buffer Where the elements are written if they need evaluating.
+ * @return Pointer to the evaluated elements.
+ */
+//-------------------------------------------------------------------
+template<typename ReferenceType>
+
+inline const typename ReferenceType::value_type* evaluate_row_block(const ReferenceType& expression,
+                                                                    int64_t row,
+                                                                    int64_t column,
+                                                                    uintptr_t count,
+                                                                    typename ReferenceType::value_type* buffer)
+{
+    using matrix_type = typename ReferenceType::matrix_type;
+
+    if constexpr(has_block_evaluation<matrix_type>::value)
+    {
+        return expression.get_ptr()->evaluate_row_block(row, column, count, buffer);
+    }
+    else
+    {
+        if constexpr(has_contiguous_rows<matrix_type>::value)
+        {
+            auto row_span = expression.row_span(row);
+
+            if(!row_span.empty())
+                return row_span.data() + column;
+        }
+
+        for(uintptr_t j = 0; j < count; ++j)
+            buffer[j] = expression.at(row, column + j);
+
+        return buffer;
+    }
+}
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+/**
+ * @brief Evaluates a whole matrix expression into a destination matrix
+ *        (already sized like the expression), one row block at a time.
+ *
+ * Blocks are fully evaluated before being copied into the destination,
+ * so the expression can safely read the destination matrix itself.
+ *
+ * @tparam ReferenceType The reference type of the matrix expression.
+ * @tparam MatrixType The type of the destination matrix.
+ * @param expression The matrix expression to evaluate.
+ * @param destination The destination matrix.
+ */
+//-------------------------------------------------------------------
+template<typename ReferenceType,
+         typename MatrixType>
+
+inline void materialize_into(const ReferenceType& expression, MatrixType& destination)
+{
+    using value_type = typename ReferenceType::value_type;
+
+    int64_t rows = expression.rows();
+    int64_t columns = expression.columns();
+
+    value_type block[expression_block_size];
+
+    for(int64_t i = 0; i < rows; ++i)
+    {
+        for(int64_t j = 0; j < columns; j += expression_block_size)
+        {
+            uintptr_t count = std::min<uintptr_t>(expression_block_size, columns - j);
+
+            const value_type* values = evaluate_row_block(expression, i, j, count, block);
+
+            if constexpr(has_contiguous_rows<MatrixType>::value)
+            {
+                auto row_data = destination.row_data(i);
+
+                if(row_data)
+                {
+                    std::copy(values, values + count, row_data + j);
+                    continue;
+                }
+            }
+
+            for(uintptr_t k = 0; k < count; ++k)
+                destination(i, j + k) = values[k];
+        }
+    }
+}
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+} // namespace LazyMatrix
+//-------------------------------------------------------------------
+
+
+
+#endif  // INCLUDE_EXPRESSION_EVALUATION_HPP_
@@ -8,6 +8,11 @@
  * Eigen library's FFT capabilities to provide efficient and accurate 
  * frequency domain transformations.
  *
+ * The ShortTimeFFT class computes spectrograms (short-time Fourier transforms)
+ * of the rows of matrix expressions, either all at once or incrementally as
+ * new samples are appended, with the library native FFT kernel (see
+ * fft_kernel.hpp) instead of Eigen.
+ *
  * @author Vincenzo Barbato
  * 
  * Additional Information:
@@ -24,10 +29,23 @@
 
 
 //-------------------------------------------------------------------
+#include <algorithm>
+#include <cmath>
 #include <complex>
+#include <cstdint>
+#include <vector>
+
 #include "Eigen/Eigen"
 #include "Eigen/Dense"
 #include "unsupported/Eigen/FFT"
+
+#include "base_matrix.hpp"
+#include "expression_evaluation.hpp"
+#include "fft_kernel.hpp"
+#include "matrix3d.hpp"
+#include "numerical_constants.hpp"
+#include "shared_references.hpp"
+#include "thread_pool.hpp"
 //-------------------------------------------------------------------
 
 
@@ -41,15 +59,46 @@ namespace LazyMatrix
 
 
 
+//-------------------------------------------------------------------
+/**
+ * @brief Computes the non-redundant half (size / 2 + 1 elements) of the
+ *        spectrum of real samples with an FFT object using the
+ *        HalfSpectrum flag.
+ *
+ * Eigen's kissfft can't plan transforms of a single element, whose
+ * spectrum is the element itself.
+ */
+//-------------------------------------------------------------------
+template<typename Scalar>
+
+inline void fft_real_half_spectrum(Eigen::FFT<Scalar>& fft,
+                                   std::complex<Scalar>* spectrum,
+                                   const Scalar* samples,
+                                   uintptr_t size)
+{
+    if(size == 1)
+        spectrum[0] = samples[0];
+    else
+        fft.fwd(spectrum, samples, size);
+}
+//-------------------------------------------------------------------
+
+
+
 //-------------------------------------------------------------------
 /**
  * @brief Computes the moving FFT of a matrix.
- * 
- * This function applies a moving window FFT to a matrix of data, typically used 
- * for analyzing time series or signal data. The FFT is computed for each window, 
- * and the results are stored in a matrix. Overlapping windows can be specified 
+ *
+ * This function applies a moving window FFT to a matrix of data, typically used
+ * for analyzing time series or signal data. The FFT is computed for each window,
+ * and the results are stored in a matrix. Overlapping windows can be specified
  * for more continuous analysis.
- * 
+ *
+ * Each row of the data is a channel. The result has one row per channel and
+ * window (the windows of channel i are rows i * number_of_windows to
+ * (i + 1) * number_of_windows - 1) and window_size / 2 + 1 columns.
+ * See ShortTimeFFT for tapered windows and lazy matrix expressions.
+ *
  * @tparam Scalar The data type of the matrix elements (typically double or float).
  * @param data The input matrix of data.
  * @param result The output matrix where FFT results will be stored.
@@ -66,17 +115,29 @@ inline void fft_moving_window(const Eigen::Matrix<Scalar, Eigen::Dynamic, Eigen:
                               const double sampling_period_sec, // Sampling period or frequency of the data in seconds
                               const int num_overlap_steps) // Number of overlap steps between successive windows
 {
-    // Create an FFT object for computing the FFT
-    Eigen::FFT<typename Eigen::Matrix<Scalar, Eigen::Dynamic, 1>::Index> fft;
+    // Create an FFT object computing only the non-redundant half of the spectrum
+    Eigen::FFT<Scalar> fft;
+    fft.SetFlag(Eigen::FFT<Scalar>::HalfSpectrum);
 
     // Compute the size of the time window and the number of steps for the moving FFT
     const int window_size = static_cast<int>(window_duration_sec / sampling_period_sec);
+    const int step_size = window_size - num_overlap_steps;
     const int num_channels = data.rows();
     const int num_samples = data.cols();
-    const int num_steps = (num_samples - window_size) / (window_size - num_overlap_steps) + 1;
 
-    // Resize the output matrix to hold the FFT results
-    result.resize(num_channels, window_size / 2 + 1);
+    if (window_size <= 0 || step_size <= 0 || num_samples < window_size)
+    {
+        result.resize(0, std::max(window_size, 0) / 2 + 1);
+        return;
+    }
+
+    const int num_steps = (num_samples - window_size) / step_size + 1;
+
+    // Resize the output matrix to hold the FFT results of every window
+    result.resize(num_channels * num_steps, window_size / 2 + 1);
+
+    std::vector<Scalar> window(window_size);
+    std::vector<std::complex<Scalar>> spectrum(window_size / 2 + 1);
 
     // Loop over each channel in the input data
     for (int i = 0; i < num_channels; ++i)
@@ -85,15 +146,16 @@ inline void fft_moving_window(const Eigen::Matrix<Scalar, Eigen::Dynamic, Eigen:
         for (int j = 0; j < num_steps; ++j)
         {
             // Extract the current window of data from the input matrix
-            Eigen::Matrix<Scalar, Eigen::Dynamic, 1> window = data.block(i, j * (window_size - num_overlap_steps), 1, window_size).transpose();
+            for (int k = 0; k < window_size; ++k)
+                window[k] = data(i, j * step_size + k);
 
             // Compute the FFT of the window
-            auto fft_result = fft.fwd(window);
+            fft_real_half_spectrum(fft, spectrum.data(), window.data(), window_size);
 
             // Copy the non-redundant half of the FFT output to the output matrix
             for (int k = 0; k < window_size / 2 + 1; ++k)
             {
-                result(i, k) = fft_result(k);
+                result(i * num_steps + j, k) = spectrum[k];
             }
         }
     }
@@ -102,6 +164,397 @@ inline void fft_moving_window(const Eigen::Matrix<Scalar, Eigen::Dynamic, Eigen:
 
 
 
+//-------------------------------------------------------------------
+/**
+ * @brief Taper applied to each window of a short-time FFT.
+ */
+//-------------------------------------------------------------------
+enum class FFTWindowFunction : int
+{
+    Rectangular = 0,    ///< No taper.
+    Hann = 1,           ///< Periodic Hann window, 0.5 - 0.5 * cos(2 pi n / N).
+    Hamming = 2         ///< Periodic Hamming window, 0.54 - 0.46 * cos(2 pi n / N).
+};
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+/**
+ * @brief Computes the coefficients of a window function.
+ *
+ * The windows are periodic (their period is the window size), which is
+ * what spectral analysis with overlapping windows uses.
+ *
+ * @tparam Scalar The type of the coefficients.
+ * @param window_function The window function.
+ * @param window_size The number of coefficients.
+ * @return The coefficients of the window function.
+ */
+//-------------------------------------------------------------------
+template<typename Scalar>
+
+inline std::vector<Scalar> create_fft_window(FFTWindowFunction window_function, uintptr_t window_size)
+{
+    std::vector<Scalar> coefficients(window_size, Scalar(1));
+
+    for(uintptr_t n = 0; n < window_size; ++n)
+    {
+        double phase = 2.0 * PI * double(n) / double(window_size);
+
+        if(window_function == FFTWindowFunction::Hann)
+            coefficients[n] = Scalar(0.5 - 0.5 * std::cos(phase));
+        else if(window_function == FFTWindowFunction::Hamming)
+            coefficients[n] = Scalar(0.54 - 0.46 * std::cos(phase));
+    }
+
+    return coefficients;
+}
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+/**
+ * @class ShortTimeFFT
+ * @brief Computes short-time Fourier transforms (spectrograms) of the
+ *        rows of matrix expressions.
+ *
+ * Each row of the signal is a channel, and each column a sample. Windows of
+ * window_size samples, hop_size samples apart, are multiplied by the window
+ * function and transformed with a real-to-complex FFT, keeping the
+ * window_size / 2 + 1 non-redundant frequencies.
+ *
+ * The results are memory mapped 3d matrices (Matrix3D) with one page per
+ * channel, one row per window and one column per frequency, so long signals
+ * don't need to fit their spectrogram in memory.
+ *
+ * Windows are transformed with the library native real FFT kernel (see
+ * fft_kernel.hpp). The cached plan of the window size (twiddle factors) and
+ * the window coefficients are fetched once by the constructor and shared
+ * by every window. Windows are transformed in parallel on a thread pool, in
+ * tiles of windows of a channel. Samples are read a block at a time (see evaluate_row_block), so
+ * rows of matrices with contiguous storage are read straight from memory. Since compute() reads
+ * the signal from every thread of the pool, without a pool it only uses several threads for
+ * signals with has_contiguous_storage.
+ *
+ * For signals that keep growing, append() takes the new samples only and
+ * returns the windows completed by them, keeping the samples needed by the
+ * following windows. Appending a signal in any number of pieces gives the
+ * same windows as compute() on the whole signal.
+ *
+ * @tparam Scalar The type of the samples (float or double).
+ */
+//-------------------------------------------------------------------
+template<typename Scalar = double>
+
+class ShortTimeFFT
+{
+public:
+
+    // Type of the results
+    using value_type = std::complex<Scalar>;
+    using result_type = SharedMatrix3DRef<Matrix3D<value_type>>;
+
+    // Number of windows of a channel transformed by each task
+    static constexpr uintptr_t windows_per_task = 32;
+
+    /**
+     * @brief Creates the FFT plan and the window coefficients.
+     * @param window_size Number of samples of each window (at least 1).
+     * @param hop_size Number of samples between consecutive windows (at least 1).
+     * @param window_function Taper applied to each window.
+     */
+    ShortTimeFFT(uintptr_t window_size,
+                 uintptr_t hop_size,
+                 FFTWindowFunction window_function = FFTWindowFunction::Hann)
+    : window_size_(std::max<uintptr_t>(1, window_size)),
+      hop_size_(std::max<uintptr_t>(1, hop_size)),
+      window_function_(window_function),
+      window_coefficients_(create_fft_window<Scalar>(window_function, window_size_)),
+      fft_plan_(get_real_fft_plan<Scalar>(window_size_))
+    {
+    }
+
+    uintptr_t window_size()const
+    {
+        return window_size_;
+    }
+
+    uintptr_t hop_size()const
+    {
+        return hop_size_;
+    }
+
+    FFTWindowFunction window_function()const
+    {
+        return window_function_;
+    }
+
+    uintptr_t number_of_frequencies()const
+    {
+        return window_size_ / 2 + 1;
+    }
+
+    /**
+     * @brief Number of complete windows in a signal.
+     * @param number_of_samples Number of samples of the signal.
+     */
+    uintptr_t number_of_windows(uintptr_t number_of_samples)const
+    {
+        if(number_of_samples < window_size_)
+            return 0;
+
+        return (number_of_samples - window_size_) / hop_size_ + 1;
+    }
+
+    /**
+     * @brief Computes the short-time FFT of every row of a signal, on the
+     *        default thread pool for signals with has_contiguous_storage
+     *        and on the calling thread for any other signal.
+     * @param signal The signal (one channel per row).
+     * @return 3d matrix with (channel, window, frequency) elements.
+     */
+    template<typename ReferenceType,
+             std::enable_if_t<is_matrix_reference<ReferenceType>{}>* = nullptr>
+
+    result_type compute(const ReferenceType& signal)const
+    {
+        if constexpr(has_contiguous_storage<typename ReferenceType::matrix_type>::value)
+            return compute(signal, get_default_thread_pool());
+        else
+            return compute(signal, get_serial_thread_pool());
+    }
+
+    /**
+     * @brief Computes the short-time FFT of every row of a signal.
+     * @param signal The signal (one channel per row), read from every thread of the pool.
+     * @param thread_pool Thread pool used to transform the windows.
+     * @return 3d matrix with (channel, window, frequency) elements.
+     */
+    template<typename ReferenceType,
+             std::enable_if_t<is_matrix_reference<ReferenceType>{}>* = nullptr>
+
+    result_type compute(const ReferenceType& signal,
+                        ThreadPool& thread_pool)const
+    {
+        using signal_value_type = typename ReferenceType::value_type;
+
+        auto read_samples = [&signal](int64_t channel, int64_t first_sample, uintptr_t count, signal_value_type* buffer)
+        {
+            return evaluate_row_block(signal, channel, first_sample, count, buffer);
+        };
+
+        return transform_windows<signal_value_type>(signal.rows(), number_of_windows(signal.columns()), read_samples, thread_pool);
+    }
+
+    /**
+     * @brief Appends new samples to a streamed signal and computes the
+     *        windows they complete.
+     *
+     * The first call sets the number of channels. Appending a different
+     * number of channels starts a new stream (see reset()).
+     *
+     * @param new_samples The new samples (one channel per row).
+     * @param thread_pool Thread pool used to transform the windows.
+     * @return 3d matrix with (channel, window, frequency) elements of the new windows.
+     */
+    template<typename ReferenceType,
+             std::enable_if_t<is_matrix_reference<ReferenceType>{}>* = nullptr>
+
+    result_type append(const ReferenceType& new_samples,
+                       ThreadPool& thread_pool = get_default_thread_pool())
+    {
+        using signal_value_type = typename ReferenceType::value_type;
+
+        uintptr_t number_of_channels = new_samples.rows();
+        uintptr_t number_of_new_samples = new_samples.columns();
+
+        if(number_of_channels != pending_samples_.size())
+        {
+            reset();
+            pending_samples_.resize(number_of_channels);
+        }
+
+        // Samples before the next window (when the hop is bigger than the window)
+        uintptr_t skipped_samples = std::min(samples_to_skip_, number_of_new_samples);
+        samples_to_skip_ -= skipped_samples;
+
+        signal_value_type buffer[expression_block_size];
+
+        for(uintptr_t i = 0; i < number_of_channels; ++i)
+        {
+            auto& samples = pending_samples_[i];
+
+            for(uintptr_t j = skipped_samples; j < number_of_new_samples; j += expression_block_size)
+            {
+                uintptr_t count = std::min<uintptr_t>(expression_block_size, number_of_new_samples - j);
+                const signal_value_type* values = evaluate_row_block(new_samples, i, j, count, buffer);
+
+                samples.insert(samples.end(), values, values + count);
+            }
+        }
+
+        uintptr_t number_of_pending_samples = pending_samples_.empty() ? 0 : pending_samples_[0].size();
+        uintptr_t number_of_new_windows = number_of_windows(number_of_pending_samples);
+
+        auto read_samples = [this](int64_t channel, int64_t first_sample, uintptr_t, Scalar*)
+        {
+            return pending_samples_[channel].data() + first_sample;
+        };
+
+        auto new_windows = transform_windows<Scalar>(number_of_channels, number_of_new_windows, read_samples, thread_pool);
+
+        // Drop the samples that no following window needs
+        uintptr_t number_of_used_samples = number_of_new_windows * hop_size_;
+        uintptr_t number_of_dropped_samples = std::min(number_of_used_samples, number_of_pending_samples);
+
+        samples_to_skip_ += number_of_used_samples - number_of_dropped_samples;
+
+        for(auto& samples : pending_samples_)
+            samples.erase(samples.begin(), samples.begin() + number_of_dropped_samples);
+
+        return new_windows;
+    }
+
+    /**
+     * @brief Forgets the samples of a streamed signal.
+     */
+    void reset()
+    {
+        pending_samples_.clear();
+        samples_to_skip_ = 0;
+    }
+
+
+
+private:
+
+    /**
+     * @brief Transforms windows of a signal in parallel.
+     *
+     * read_samples(channel, first_sample, count, buffer) returns a pointer
+     * to count (at most expression_block_size) consecutive samples of a
+     * channel, either pointing into the signal or to the buffer.
+     */
+    template<typename SampleType,
+             typename ReadSamplesFunction>
+
+    result_type transform_windows(uintptr_t number_of_channels,
+                                  uintptr_t number_of_windows,
+                                  const ReadSamplesFunction& read_samples,
+                                  ThreadPool& thread_pool)const
+    {
+        uintptr_t number_of_frequencies = this->number_of_frequencies();
+
+        result_type result(std::make_shared<Matrix3D<value_type>>(number_of_channels, number_of_windows, number_of_frequencies));
+
+        uintptr_t tiles_per_channel = (number_of_windows + windows_per_task - 1) / windows_per_task;
+
+        auto transform_tile = [&](uintptr_t tile_index)
+        {
+            uintptr_t channel = tile_index / tiles_per_channel;
+            uintptr_t first_window = (tile_index % tiles_per_channel) * windows_per_task;
+            uintptr_t last_window = std::min(first_window + windows_per_task, number_of_windows);
+
+            std::vector<Scalar> windowed_samples(window_size_);
+            std::vector<Scalar> scratch(fft_plan_->scratch_size());
+            std::vector<value_type> spectrum(number_of_frequencies);
+            SampleType buffer[expression_block_size];
+
+            for(uintptr_t window = first_window; window < last_window; ++window)
+            {
+                uintptr_t first_sample = window * hop_size_;
+
+                for(uintptr_t j = 0; j < window_size_; j += expression_block_size)
+                {
+                    uintptr_t count = std::min<uintptr_t>(expression_block_size, window_size_ - j);
+                    const SampleType* samples = read_samples(channel, first_sample + j, count, buffer);
+
+                    for(uintptr_t k = 0; k < count; ++k)
+                        windowed_samples[j + k] = static_cast<Scalar>(samples[k]) * window_coefficients_[j + k];
+                }
+
+                fft_plan_->forward(windowed_samples.data(), spectrum.data(), scratch.data());
+
+                for(uintptr_t k = 0; k < number_of_frequencies; ++k)
+                    result(channel, window, k) = spectrum[k];
+            }
+        };
+
+        thread_pool.parallel_for(number_of_channels * tiles_per_channel, transform_tile);
+
+        return result;
+    }
+
+    uintptr_t window_size_ = 1;                                 ///< Samples of each window.
+    uintptr_t hop_size_ = 1;                                    ///< Samples between consecutive windows.
+    FFTWindowFunction window_function_ = FFTWindowFunction::Hann; ///< Taper of each window.
+    std::vector<Scalar> window_coefficients_;                   ///< Coefficients of the taper.
+    std::shared_ptr<const RealFFTPlan<Scalar>> fft_plan_;       ///< Real FFT plan of the window size.
+
+    std::vector<std::vector<Scalar>> pending_samples_;          ///< Streamed samples needed by the next windows.
+    uintptr_t samples_to_skip_ = 0;                             ///< Streamed samples to skip before the next window.
+};
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+/**
+ * @brief Computes the short-time FFT (spectrogram) of every row of a
+ *        signal (see ShortTimeFFT).
+ *
+ * @param signal The signal (one channel per row).
+ * @param window_size Number of samples of each window.
+ * @param hop_size Number of samples between consecutive windows.
+ * @param window_function Taper applied to each window.
+ * @param thread_pool Thread pool used to transform the windows (the signal is read from every thread).
+ * @return A SharedMatrix3DRef to a Matrix3D with (channel, window, frequency) elements.
+ */
+//-------------------------------------------------------------------
+template<typename ReferenceType,
+         std::enable_if_t<is_matrix_reference<ReferenceType>{}>* = nullptr>
+
+inline auto short_time_fft(const ReferenceType& signal,
+                           uintptr_t window_size,
+                           uintptr_t hop_size,
+                           FFTWindowFunction window_function,
+                           ThreadPool& thread_pool)
+{
+    using value_type = typename ReferenceType::value_type;
+    using scalar_type = std::conditional_t<std::is_same_v<value_type, float>, float, double>;
+
+    return ShortTimeFFT<scalar_type>(window_size, hop_size, window_function).compute(signal, thread_pool);
+}
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+/**
+ * @brief Computes the short-time FFT of every row of a signal (see above),
+ *        on the default thread pool for signals with has_contiguous_storage
+ *        and on the calling thread for any other signal.
+ */
+//-------------------------------------------------------------------
+template<typename ReferenceType,
+         std::enable_if_t<is_matrix_reference<ReferenceType>{}>* = nullptr>
+
+inline auto short_time_fft(const ReferenceType& signal,
+                           uintptr_t window_size,
+                           uintptr_t hop_size,
+                           FFTWindowFunction window_function = FFTWindowFunction::Hann)
+{
+    using value_type = typename ReferenceType::value_type;
+    using scalar_type = std::conditional_t<std::is_same_v<value_type, float>, float, double>;
+
+    return ShortTimeFFT<scalar_type>(window_size, hop_size, window_function).compute(signal);
+}
+//-------------------------------------------------------------------
+
+
+
 //-------------------------------------------------------------------
 } // namespace LazyMatrix
 //-------------------------------------------------------------------
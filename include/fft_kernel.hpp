@@ -0,0 +1,730 @@
+//-------------------------------------------------------------------
+/**
+ * @file fft_kernel.hpp
+ * @brief Library native FFT kernel working directly on the rows of
+ *        matrix expressions.
+ *
+ * The transforms are computed without going through Eigen:
+ * - FFTPlan computes complex FFTs of any size with the Stockham autosort
+ *   algorithm, splitting the size in radix 4, 2, 3 and 5 stages plus
+ *   generic stages for the other prime factors. The real and imaginary
+ *   parts are kept in separate arrays, so the butterflies of a stage run
+ *   in plain loops over contiguous memory the compiler can vectorize.
+ * - RealFFTPlan computes the FFT of real samples of even size N with a
+ *   complex FFT of size N / 2 (the even samples as the real parts and the
+ *   odd samples as the imaginary parts), followed by one pass separating
+ *   the two spectra.
+ * - The twiddle factors of every stage are computed once per plan, and
+ *   plans are cached by size (see get_real_fft_plan). Plans are never
+ *   modified after they are built, so one plan can be used by many
+ *   threads at once.
+ * - real_fft transforms every row of a matrix expression in parallel on
+ *   the thread pool, reading the rows a block at a time (straight from
+ *   memory for contiguous rows) and writing the spectra straight into the
+ *   rows of the result.
+ *
+ * @author Vincenzo Barbato
+ *
+ * Additional Information:
+ * - GitHub Project: [LazyMatrix](https://github.com/navyenzo/LazyMatrix.git)
+ * - LinkedIn: [Vincenzo Barbato](https://www.linkedin.com/in/vincenzobarbato/)
+ */
+//-------------------------------------------------------------------
+
+
+
+#ifndef INCLUDE_FFT_KERNEL_HPP_
+#define INCLUDE_FFT_KERNEL_HPP_
+
+
+
+//-------------------------------------------------------------------
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <type_traits>
+#include <vector>
+
+#include "base_matrix.hpp"
+#include "expression_evaluation.hpp"
+#include "numerical_constants.hpp"
+#include "shared_references.hpp"
+#include "simple_matrix.hpp"
+#include "thread_pool.hpp"
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+// Define every thing within the namespace LazyMatrix
+//-------------------------------------------------------------------
+namespace LazyMatrix
+{
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+/**
+ * @class FFTPlan
+ * @brief Forward complex FFT of a given size.
+ *
+ * The size n is split into factors (4s first, then 2s, 3s, 5s and the
+ * other prime factors). Each factor p is one stage of the Stockham algorithm,
+ * which with n_s the size of the transforms left at that stage
+ * (n_s = n at the first stage), m = n_s / p and s = n / n_s computes:
+ *
+ *     y[q + s * (p * j + t)] = w^(j * t) * sum_r x[q + s * (j + r * m)] * e^(-2 pi i r t / p)
+ *
+ * for j < m, q < s and t < p, with w = e^(-2 pi i / n_s). The output of
+ * the last stage is in natural order.
+ *
+ * @tparam Scalar The type of the real and imaginary parts (float or double).
+ */
+//-------------------------------------------------------------------
+template<typename Scalar>
+
+class FFTPlan
+{
+public:
+
+    /**
+     * @brief Builds the stages and twiddle factors of the plan.
+     * @param size Size of the transform.
+     */
+    explicit FFTPlan(uintptr_t size = 1)
+    : size_(std::max<uintptr_t>(1, size))
+    {
+        uintptr_t remaining_size = size_;
+        uintptr_t stride = 1;
+
+        while(remaining_size > 1)
+        {
+            uintptr_t radix = get_next_radix(remaining_size);
+
+            Stage stage;
+            stage.radix = radix;
+            stage.m = remaining_size / radix;
+            stage.s = stride;
+
+            // Twiddle factors w^(j * t), stored as [(t - 1) * m + j]
+            stage.twiddle_real.resize((radix - 1) * stage.m);
+            stage.twiddle_imag.resize((radix - 1) * stage.m);
+
+            for(uintptr_t t = 1; t < radix; ++t)
+            {
+                for(uintptr_t j = 0; j < stage.m; ++j)
+                {
+                    double angle = -2.0 * PI * double((j * t) % remaining_size) / double(remaining_size);
+
+                    stage.twiddle_real[(t - 1) * stage.m + j] = Scalar(std::cos(angle));
+                    stage.twiddle_imag[(t - 1) * stage.m + j] = Scalar(std::sin(angle));
+                }
+            }
+
+            // Roots of unity of generic radix stages
+            if(radix > 5)
+            {
+                stage.root_real.resize(radix);
+                stage.root_imag.resize(radix);
+
+                for(uintptr_t k = 0; k < radix; ++k)
+                {
+                    double angle = -2.0 * PI * double(k) / double(radix);
+
+                    stage.root_real[k] = Scalar(std::cos(angle));
+                    stage.root_imag[k] = Scalar(std::sin(angle));
+                }
+            }
+
+            stages_.push_back(std::move(stage));
+
+            remaining_size /= radix;
+            stride *= radix;
+        }
+    }
+
+    uintptr_t size()const
+    {
+        return size_;
+    }
+
+    /**
+     * @brief Computes the FFT in place.
+     * @param real Real parts of the size() elements to transform.
+     * @param imag Imaginary parts of the size() elements to transform.
+     * @param work_real Work buffer of size() elements.
+     * @param work_imag Work buffer of size() elements.
+     */
+    void forward(Scalar* real, Scalar* imag, Scalar* work_real, Scalar* work_imag)const
+    {
+        Scalar* x_real = real;
+        Scalar* x_imag = imag;
+        Scalar* y_real = work_real;
+        Scalar* y_imag = work_imag;
+
+        for(const auto& stage : stages_)
+        {
+            if(stage.radix == 4)
+                radix_4_stage(stage, x_real, x_imag, y_real, y_imag);
+            else if(stage.radix == 2)
+                radix_2_stage(stage, x_real, x_imag, y_real, y_imag);
+            else if(stage.radix == 3)
+                radix_3_stage(stage, x_real, x_imag, y_real, y_imag);
+            else if(stage.radix == 5)
+                radix_5_stage(stage, x_real, x_imag, y_real, y_imag);
+            else
+                generic_stage(stage, x_real, x_imag, y_real, y_imag);
+
+            std::swap(x_real, y_real);
+            std::swap(x_imag, y_imag);
+        }
+
+        if(x_real != real)
+        {
+            std::copy(x_real, x_real + size_, real);
+            std::copy(x_imag, x_imag + size_, imag);
+        }
+    }
+
+
+
+private:
+
+    struct Stage
+    {
+        uintptr_t radix = 2;                ///< Radix of the butterflies.
+        uintptr_t m = 1;                    ///< Size of the remaining transforms divided by the radix.
+        uintptr_t s = 1;                    ///< Number of interleaved transforms.
+        std::vector<Scalar> twiddle_real;   ///< Real parts of the twiddle factors.
+        std::vector<Scalar> twiddle_imag;   ///< Imaginary parts of the twiddle factors.
+        std::vector<Scalar> root_real;      ///< Real parts of the roots of unity (generic stages).
+        std::vector<Scalar> root_imag;      ///< Imaginary parts of the roots of unity (generic stages).
+    };
+
+    static uintptr_t get_next_radix(uintptr_t n)
+    {
+        if(n % 4 == 0)
+            return 4;
+
+        if(n % 2 == 0)
+            return 2;
+
+        if(n % 3 == 0)
+            return 3;
+
+        if(n % 5 == 0)
+            return 5;
+
+        for(uintptr_t p = 7; p * p <= n; p += 2)
+            if(n % p == 0)
+                return p;
+
+        return n;
+    }
+
+    /**
+     * @brief Calls butterfly(j, q) for every butterfly of a stage, with
+     *        the longest of the two loops innermost.
+     */
+    template<typename ButterflyFunction>
+
+    static void for_each_butterfly(const Stage& stage, const ButterflyFunction& butterfly)
+    {
+        if(stage.s >= stage.m)
+        {
+            for(uintptr_t j = 0; j < stage.m; ++j)
+                for(uintptr_t q = 0; q < stage.s; ++q)
+                    butterfly(j, q);
+        }
+        else
+        {
+            for(uintptr_t q = 0; q < stage.s; ++q)
+                for(uintptr_t j = 0; j < stage.m; ++j)
+                    butterfly(j, q);
+        }
+    }
+
+    static void radix_2_stage(const Stage& stage,
+                              const Scalar* x_real, const Scalar* x_imag,
+                              Scalar* y_real, Scalar* y_imag)
+    {
+        uintptr_t m = stage.m;
+        uintptr_t s = stage.s;
+        const Scalar* w_real = stage.twiddle_real.data();
+        const Scalar* w_imag = stage.twiddle_imag.data();
+
+        for_each_butterfly(stage, [&](uintptr_t j, uintptr_t q)
+        {
+            uintptr_t input = q + s * j;
+            uintptr_t output = q + s * 2 * j;
+
+            Scalar a_real = x_real[input], a_imag = x_imag[input];
+            Scalar b_real = x_real[input + s * m], b_imag = x_imag[input + s * m];
+
+            Scalar d_real = a_real - b_real, d_imag = a_imag - b_imag;
+
+            y_real[output] = a_real + b_real;
+            y_imag[output] = a_imag + b_imag;
+            y_real[output + s] = d_real * w_real[j] - d_imag * w_imag[j];
+            y_imag[output + s] = d_real * w_imag[j] + d_imag * w_real[j];
+        });
+    }
+
+    static void radix_4_stage(const Stage& stage,
+                              const Scalar* x_real, const Scalar* x_imag,
+                              Scalar* y_real, Scalar* y_imag)
+    {
+        uintptr_t m = stage.m;
+        uintptr_t s = stage.s;
+        const Scalar* w_real = stage.twiddle_real.data();
+        const Scalar* w_imag = stage.twiddle_imag.data();
+
+        for_each_butterfly(stage, [&](uintptr_t j, uintptr_t q)
+        {
+            uintptr_t input = q + s * j;
+            uintptr_t output = q + s * 4 * j;
+
+            Scalar a0_real = x_real[input], a0_imag = x_imag[input];
+            Scalar a1_real = x_real[input + s * m], a1_imag = x_imag[input + s * m];
+            Scalar a2_real = x_real[input + 2 * s * m], a2_imag = x_imag[input + 2 * s * m];
+            Scalar a3_real = x_real[input + 3 * s * m], a3_imag = x_imag[input + 3 * s * m];
+
+            Scalar t0_real = a0_real + a2_real, t0_imag = a0_imag + a2_imag;
+            Scalar t1_real = a0_real - a2_real, t1_imag = a0_imag - a2_imag;
+            Scalar t2_real = a1_real + a3_real, t2_imag = a1_imag + a3_imag;
+
+            // (a1 - a3) * -i
+            Scalar t3_real = a1_imag - a3_imag, t3_imag = a3_real - a1_real;
+
+            Scalar b1_real = t1_real + t3_real, b1_imag = t1_imag + t3_imag;
+            Scalar b2_real = t0_real - t2_real, b2_imag = t0_imag - t2_imag;
+            Scalar b3_real = t1_real - t3_real, b3_imag = t1_imag - t3_imag;
+
+            Scalar w1_real = w_real[j], w1_imag = w_imag[j];
+            Scalar w2_real = w_real[m + j], w2_imag = w_imag[m + j];
+            Scalar w3_real = w_real[2 * m + j], w3_imag = w_imag[2 * m + j];
+
+            y_real[output] = t0_real + t2_real;
+            y_imag[output] = t0_imag + t2_imag;
+            y_real[output + s] = b1_real * w1_real - b1_imag * w1_imag;
+            y_imag[output + s] = b1_real * w1_imag + b1_imag * w1_real;
+            y_real[output + 2 * s] = b2_real * w2_real - b2_imag * w2_imag;
+            y_imag[output + 2 * s] = b2_real * w2_imag + b2_imag * w2_real;
+            y_real[output + 3 * s] = b3_real * w3_real - b3_imag * w3_imag;
+            y_imag[output + 3 * s] = b3_real * w3_imag + b3_imag * w3_real;
+        });
+    }
+
+    static void radix_3_stage(const Stage& stage,
+                              const Scalar* x_real, const Scalar* x_imag,
+                              Scalar* y_real, Scalar* y_imag)
+    {
+        uintptr_t m = stage.m;
+        uintptr_t s = stage.s;
+        const Scalar* w_real = stage.twiddle_real.data();
+        const Scalar* w_imag = stage.twiddle_imag.data();
+
+        const Scalar sin_60 = Scalar(0.86602540378443864676);
+
+        for_each_butterfly(stage, [&](uintptr_t j, uintptr_t q)
+        {
+            uintptr_t input = q + s * j;
+            uintptr_t output = q + s * 3 * j;
+
+            Scalar a0_real = x_real[input], a0_imag = x_imag[input];
+            Scalar a1_real = x_real[input + s * m], a1_imag = x_imag[input + s * m];
+            Scalar a2_real = x_real[input + 2 * s * m], a2_imag = x_imag[input + 2 * s * m];
+
+            Scalar t1_real = a1_real + a2_real, t1_imag = a1_imag + a2_imag;
+            Scalar t2_real = a0_real - Scalar(0.5) * t1_real, t2_imag = a0_imag - Scalar(0.5) * t1_imag;
+
+            // sin(60) * (a1 - a2) * -i
+            Scalar t3_real = sin_60 * (a1_imag - a2_imag), t3_imag = sin_60 * (a2_real - a1_real);
+
+            Scalar b1_real = t2_real + t3_real, b1_imag = t2_imag + t3_imag;
+            Scalar b2_real = t2_real - t3_real, b2_imag = t2_imag - t3_imag;
+
+            Scalar w1_real = w_real[j], w1_imag = w_imag[j];
+            Scalar w2_real = w_real[m + j], w2_imag = w_imag[m + j];
+
+            y_real[output] = a0_real + t1_real;
+            y_imag[output] = a0_imag + t1_imag;
+            y_real[output + s] = b1_real * w1_real - b1_imag * w1_imag;
+            y_imag[output + s] = b1_real * w1_imag + b1_imag * w1_real;
+            y_real[output + 2 * s] = b2_real * w2_real - b2_imag * w2_imag;
+            y_imag[output + 2 * s] = b2_real * w2_imag + b2_imag * w2_real;
+        });
+    }
+
+    static void radix_5_stage(const Stage& stage,
+                              const Scalar* x_real, const Scalar* x_imag,
+                              Scalar* y_real, Scalar* y_imag)
+    {
+        uintptr_t m = stage.m;
+        uintptr_t s = stage.s;
+        const Scalar* w_real = stage.twiddle_real.data();
+        const Scalar* w_imag = stage.twiddle_imag.data();
+
+        const Scalar cos_72 = Scalar(0.30901699437494742410);
+        const Scalar cos_144 = Scalar(-0.80901699437494742410);
+        const Scalar sin_72 = Scalar(0.95105651629515357212);
+        const Scalar sin_144 = Scalar(0.58778525229247312917);
+
+        for_each_butterfly(stage, [&](uintptr_t j, uintptr_t q)
+        {
+            uintptr_t input = q + s * j;
+            uintptr_t output = q + s * 5 * j;
+
+            Scalar a0_real = x_real[input], a0_imag = x_imag[input];
+            Scalar a1_real = x_real[input + s * m], a1_imag = x_imag[input + s * m];
+            Scalar a2_real = x_real[input + 2 * s * m], a2_imag = x_imag[input + 2 * s * m];
+            Scalar a3_real = x_real[input + 3 * s * m], a3_imag = x_imag[input + 3 * s * m];
+            Scalar a4_real = x_real[input + 4 * s * m], a4_imag = x_imag[input + 4 * s * m];
+
+            Scalar t1_real = a1_real + a4_real, t1_imag = a1_imag + a4_imag;
+            Scalar t2_real = a2_real + a3_real, t2_imag = a2_imag + a3_imag;
+            Scalar t3_real = a1_real - a4_real, t3_imag = a1_imag - a4_imag;
+            Scalar t4_real = a2_real - a3_real, t4_imag = a2_imag - a3_imag;
+
+            Scalar c1_real = a0_real + cos_72 * t1_real + cos_144 * t2_real;
+            Scalar c1_imag = a0_imag + cos_72 * t1_imag + cos_144 * t2_imag;
+            Scalar c2_real = a0_real + cos_144 * t1_real + cos_72 * t2_real;
+            Scalar c2_imag = a0_imag + cos_144 * t1_imag + cos_72 * t2_imag;
+
+            // -i * (sin(72) * t3 + sin(144) * t4) and -i * (sin(144) * t3 - sin(72) * t4)
+            Scalar d1_real = sin_72 * t3_imag + sin_144 * t4_imag, d1_imag = -(sin_72 * t3_real + sin_144 * t4_real);
+            Scalar d2_real = sin_144 * t3_imag - sin_72 * t4_imag, d2_imag = sin_72 * t4_real - sin_144 * t3_real;
+
+            Scalar b1_real = c1_real + d1_real, b1_imag = c1_imag + d1_imag;
+            Scalar b2_real = c2_real + d2_real, b2_imag = c2_imag + d2_imag;
+            Scalar b3_real = c2_real - d2_real, b3_imag = c2_imag - d2_imag;
+            Scalar b4_real = c1_real - d1_real, b4_imag = c1_imag - d1_imag;
+
+            Scalar w1_real = w_real[j], w1_imag = w_imag[j];
+            Scalar w2_real = w_real[m + j], w2_imag = w_imag[m + j];
+            Scalar w3_real = w_real[2 * m + j], w3_imag = w_imag[2 * m + j];
+            Scalar w4_real = w_real[3 * m + j], w4_imag = w_imag[3 * m + j];
+
+            y_real[output] = a0_real + t1_real + t2_real;
+            y_imag[output] = a0_imag + t1_imag + t2_imag;
+            y_real[output + s] = b1_real * w1_real - b1_imag * w1_imag;
+            y_imag[output + s] = b1_real * w1_imag + b1_imag * w1_real;
+            y_real[output + 2 * s] = b2_real * w2_real - b2_imag * w2_imag;
+            y_imag[output + 2 * s] = b2_real * w2_imag + b2_imag * w2_real;
+            y_real[output + 3 * s] = b3_real * w3_real - b3_imag * w3_imag;
+            y_imag[output + 3 * s] = b3_real * w3_imag + b3_imag * w3_real;
+            y_real[output + 4 * s] = b4_real * w4_real - b4_imag * w4_imag;
+            y_imag[output + 4 * s] = b4_real * w4_imag + b4_imag * w4_real;
+        });
+    }
+
+    static void generic_stage(const Stage& stage,
+                              const Scalar* x_real, const Scalar* x_imag,
+                              Scalar* y_real, Scalar* y_imag)
+    {
+        uintptr_t p = stage.radix;
+        uintptr_t m = stage.m;
+        uintptr_t s = stage.s;
+
+        std::vector<Scalar> a_real(p), a_imag(p);
+
+        for_each_butterfly(stage, [&](uintptr_t j, uintptr_t q)
+        {
+            uintptr_t input = q + s * j;
+            uintptr_t output = q + s * p * j;
+
+            for(uintptr_t r = 0; r < p; ++r)
+            {
+                a_real[r] = x_real[input + r * s * m];
+                a_imag[r] = x_imag[input + r * s * m];
+            }
+
+            for(uintptr_t t = 0; t < p; ++t)
+            {
+                Scalar b_real = 0, b_imag = 0;
+
+                for(uintptr_t r = 0, k = 0; r < p; ++r, k = (k + t) % p)
+                {
+                    b_real += a_real[r] * stage.root_real[k] - a_imag[r] * stage.root_imag[k];
+                    b_imag += a_real[r] * stage.root_imag[k] + a_imag[r] * stage.root_real[k];
+                }
+
+                if(t == 0)
+                {
+                    y_real[output] = b_real;
+                    y_imag[output] = b_imag;
+                }
+                else
+                {
+                    Scalar w_real = stage.twiddle_real[(t - 1) * m + j];
+                    Scalar w_imag = stage.twiddle_imag[(t - 1) * m + j];
+
+                    y_real[output + t * s] = b_real * w_real - b_imag * w_imag;
+                    y_imag[output + t * s] = b_real * w_imag + b_imag * w_real;
+                }
+            }
+        });
+    }
+
+    uintptr_t size_ = 1;            ///< Size of the transform.
+    std::vector<Stage> stages_;     ///< Stages of the transform.
+};
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+/**
+ * @class RealFFTPlan
+ * @brief Forward FFT of real samples, computing the size() / 2 + 1
+ *        non-redundant frequencies.
+ *
+ * For even sizes N the samples are transformed as N / 2 complex numbers
+ * z[k] = x[2k] + i x[2k+1], and the spectrum is recovered from the
+ * spectrum Z of z with
+ *
+ *     X[k] = (Z[k] + conj(Z[N/2 - k])) / 2 - i e^(-2 pi i k / N) (Z[k] - conj(Z[N/2 - k])) / 2
+ *
+ * Odd sizes use a complex FFT of size N.
+ *
+ * @tparam Scalar The type of the samples (float or double).
+ */
+//-------------------------------------------------------------------
+template<typename Scalar>
+
+class RealFFTPlan
+{
+public:
+
+    /**
+     * @brief Builds the complex plan and the twiddle factors.
+     * @param size Number of real samples.
+     */
+    explicit RealFFTPlan(uintptr_t size = 1)
+    : size_(std::max<uintptr_t>(1, size)),
+      is_packed_(size_ % 2 == 0),
+      complex_plan_(is_packed_ ? size_ / 2 : size_)
+    {
+        if(is_packed_)
+        {
+            uintptr_t half_size = size_ / 2;
+
+            twiddle_real_.resize(half_size + 1);
+            twiddle_imag_.resize(half_size + 1);
+
+            for(uintptr_t k = 0; k <= half_size; ++k)
+            {
+                double angle = -2.0 * PI * double(k) / double(size_);
+
+                twiddle_real_[k] = Scalar(std::cos(angle));
+                twiddle_imag_[k] = Scalar(std::sin(angle));
+            }
+        }
+    }
+
+    uintptr_t size()const
+    {
+        return size_;
+    }
+
+    uintptr_t number_of_frequencies()const
+    {
+        return size_ / 2 + 1;
+    }
+
+    /**
+     * @brief Number of elements of the scratch buffer used by forward().
+     */
+    uintptr_t scratch_size()const
+    {
+        return 4 * complex_plan_.size();
+    }
+
+    /**
+     * @brief Computes the spectrum of real samples.
+     * @param samples The size() samples.
+     * @param spectrum Where the number_of_frequencies() frequencies are written.
+     * @param scratch Scratch buffer of scratch_size() elements.
+     */
+    void forward(const Scalar* samples, std::complex<Scalar>* spectrum, Scalar* scratch)const
+    {
+        uintptr_t n = complex_plan_.size();
+
+        Scalar* z_real = scratch;
+        Scalar* z_imag = scratch + n;
+
+        if(is_packed_)
+        {
+            for(uintptr_t k = 0; k < n; ++k)
+            {
+                z_real[k] = samples[2 * k];
+                z_imag[k] = samples[2 * k + 1];
+            }
+        }
+        else
+        {
+            std::copy(samples, samples + n, z_real);
+            std::fill(z_imag, z_imag + n, Scalar(0));
+        }
+
+        complex_plan_.forward(z_real, z_imag, scratch + 2 * n, scratch + 3 * n);
+
+        if(!is_packed_)
+        {
+            for(uintptr_t k = 0; k < number_of_frequencies(); ++k)
+                spectrum[k] = std::complex<Scalar>(z_real[k], z_imag[k]);
+
+            return;
+        }
+
+        for(uintptr_t k = 0; k <= n; ++k)
+        {
+            uintptr_t a = (k == n) ? 0 : k;
+            uintptr_t b = (k == 0) ? 0 : n - k;
+
+            Scalar even_real = (z_real[a] + z_real[b]) * Scalar(0.5);
+            Scalar even_imag = (z_imag[a] - z_imag[b]) * Scalar(0.5);
+            Scalar odd_real = (z_imag[a] + z_imag[b]) * Scalar(0.5);
+            Scalar odd_imag = (z_real[b] - z_real[a]) * Scalar(0.5);
+
+            spectrum[k] = std::complex<Scalar>(even_real + twiddle_real_[k] * odd_real - twiddle_imag_[k] * odd_imag,
+                                               even_imag + twiddle_real_[k] * odd_imag + twiddle_imag_[k] * odd_real);
+        }
+    }
+
+
+
+private:
+
+    uintptr_t size_ = 1;                ///< Number of real samples.
+    bool is_packed_ = false;            ///< True if the samples are packed in size() / 2 complex numbers.
+    FFTPlan<Scalar> complex_plan_;      ///< Complex FFT of the packed (or unpacked) samples.
+    std::vector<Scalar> twiddle_real_;  ///< Real parts of e^(-2 pi i k / size()).
+    std::vector<Scalar> twiddle_imag_;  ///< Imaginary parts of e^(-2 pi i k / size()).
+};
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+/**
+ * @brief Gets the real FFT plan of a given size, building it on first use.
+ *
+ * Plans are cached for the lifetime of the program and can be used by
+ * multiple threads at once.
+ *
+ * @tparam Scalar The type of the samples (float or double).
+ * @param size Number of real samples.
+ * @return Shared pointer to the plan.
+ */
+//-------------------------------------------------------------------
+template<typename Scalar>
+
+inline std::shared_ptr<const RealFFTPlan<Scalar>> get_real_fft_plan(uintptr_t size)
+{
+    static std::mutex plans_mutex;
+    static std::map<uintptr_t, std::shared_ptr<const RealFFTPlan<Scalar>>> plans;
+
+    std::lock_guard<std::mutex> lock(plans_mutex);
+
+    auto& plan = plans[size];
+
+    if(!plan)
+        plan = std::make_shared<const RealFFTPlan<Scalar>>(size);
+
+    return plan;
+}
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+/**
+ * @brief Computes the FFT of every row of a matrix expression.
+ *
+ * Rows are transformed in parallel on the thread pool with the cached
+ * real FFT plan of the number of columns. Rows of matrices with contiguous
+ * storage are read straight from memory, other expressions are evaluated
+ * a block at a time, and the spectra are written straight into the rows of
+ * the result. Samples are transformed in single precision if the matrix
+ * holds floats, and in double precision otherwise.
+ *
+ * @param m The matrix expression (one signal per row).
+ * @param thread_pool Thread pool used to transform the rows.
+ * @return A SharedMatrixRef to a SimpleMatrix with the columns() / 2 + 1
+ *         frequencies of each row.
+ */
+//-------------------------------------------------------------------
+template<typename ReferenceType,
+         std::enable_if_t<is_matrix_reference<ReferenceType>{}>* = nullptr>
+
+inline auto real_fft(const ReferenceType& m,
+                     ThreadPool& thread_pool = get_default_thread_pool())
+{
+    using value_type = typename ReferenceType::value_type;
+    using scalar_type = std::conditional_t<std::is_same_v<value_type, float>, float, double>;
+
+    uintptr_t rows = m.rows();
+    uintptr_t columns = m.columns();
+
+    auto plan = get_real_fft_plan<scalar_type>(columns);
+
+    SharedMatrixRef<SimpleMatrix<std::complex<scalar_type>>> spectra(std::make_shared<SimpleMatrix<std::complex<scalar_type>>>(rows, plan->number_of_frequencies()));
+
+    if(rows == 0 || columns == 0)
+        return spectra;
+
+    auto transform_row = [&](uintptr_t row)
+    {
+        std::vector<scalar_type> samples;
+        std::vector<scalar_type> scratch(plan->scratch_size());
+        const scalar_type* row_samples = nullptr;
+
+        if constexpr(std::is_same_v<value_type, scalar_type> && has_contiguous_rows<typename ReferenceType::matrix_type>::value)
+        {
+            auto row_span = m.row_span(row);
+
+            if(!row_span.empty())
+                row_samples = row_span.data();
+        }
+
+        if(!row_samples)
+        {
+            samples.resize(columns);
+            value_type buffer[expression_block_size];
+
+            for(uintptr_t j = 0; j < columns; j += expression_block_size)
+            {
+                uintptr_t count = std::min<uintptr_t>(expression_block_size, columns - j);
+                const value_type* values = evaluate_row_block(m, row, j, count, buffer);
+
+                for(uintptr_t k = 0; k < count; ++k)
+                    samples[j + k] = static_cast<scalar_type>(values[k]);
+            }
+
+            row_samples = samples.data();
+        }
+
+        plan->forward(row_samples, spectra.row_span(row).data(), scratch.data());
+    };
+
+    thread_pool.parallel_for(rows, transform_row);
+
+    return spectra;
+}
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+} // namespace LazyMatrix
+//-------------------------------------------------------------------
+
+
+
+#endif  // INCLUDE_FFT_KERNEL_HPP_
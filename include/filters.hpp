@@ -26,9 +26,16 @@
 //-------------------------------------------------------------------
 #include <time.h>
 #include <cstdint>
+#include <cmath>
+#include <algorithm>
+#include <limits>
+#include <vector>
+#include <type_traits>
 
 #include "numerical_constants.hpp"
-#include "border_functor_view.hpp"
+#include "convolution.hpp"
+#include "thread_pool.hpp"
+#include "image_matrix.hpp"
 #include "matrix_factory.hpp"
 #include "shared_references.hpp"
 //-------------------------------------------------------------------
@@ -59,7 +66,7 @@ namespace LazyMatrix
 inline auto create_gaussian_kernel(uintptr_t kernel_size, double sigma)
 {
     uintptr_t actual_kernel_size = (kernel_size / 2) * 2 + 1;
-    uintptr_t half_kernel_size = (kernel_size / 2);
+    int64_t half_kernel_size = (kernel_size / 2);
 
     auto kernel = MatrixFactory::create_simple_matrix<double>(actual_kernel_size, actual_kernel_size, 0);
 
@@ -71,9 +78,9 @@ inline auto create_gaussian_kernel(uintptr_t kernel_size, double sigma)
 
     double sum = 0.0;
 
-    for(int row = -half_kernel_size; row <= half_kernel_size; row++)
+    for(int64_t row = -half_kernel_size; row <= half_kernel_size; row++)
     {
-        for(int column = -half_kernel_size; column <= half_kernel_size; column++)
+        for(int64_t column = -half_kernel_size; column <= half_kernel_size; column++)
         {
             r = std::sqrt(row * row + column * column);
 
@@ -123,13 +130,58 @@ inline auto create_laplacian_kernel()
 
 
 
+//-------------------------------------------------------------------
+/**
+ * @brief Converts a filtered value to the type of a pixel channel.
+ *
+ * Values for integer types are rounded and clamped to the range of the type.
+ */
+//-------------------------------------------------------------------
+template<typename ChannelType>
+
+inline ChannelType convert_filtered_value(double value)
+{
+    if constexpr (std::is_integral_v<ChannelType>)
+    {
+        value = std::round(value);
+        value = std::max(value, static_cast<double>(std::numeric_limits<ChannelType>::lowest()));
+        value = std::min(value, static_cast<double>(std::numeric_limits<ChannelType>::max()));
+    }
+
+    return static_cast<ChannelType>(value);
+}
+//-------------------------------------------------------------------
+
+
+
 //-------------------------------------------------------------------
 /**
  * @brief Applies a filter kernel to a source matrix.
+ *
+ * Each output element is the sum of the kernel elements multiplied by the
+ * source elements around it (the kernel is centered on the element), with
+ * the border values of the source repeated outside of it.
+ *
+ * The output rows are split in tiles filtered in parallel on the thread
+ * pool. Each tile reads its source rows plus a halo of half a kernel on
+ * every side once into a local buffer, and applies the kernel with the
+ * convolution engine (see convolution.hpp), which uses two 1D passes for
+ * separable kernels (such as gaussian kernels) and FFTs for big kernels
+ * that aren't separable. The source is read from every thread of the
+ * pool, the overload below without a pool only reads sources with
+ * has_contiguous_storage from several threads.
+ *
+ * Grayscale sources and dlib pixel types (see pixel_channels) are
+ * supported, with every channel of a pixel filtered on its own. The sums
+ * are computed in double precision, and for integer channels they are
+ * rounded and clamped to the range of the type.
+ *
  * @tparam ReferenceType1 The type of the source matrix.
  * @tparam ReferenceType2 The type of the filter kernel.
  * @param source_matrix Shared reference to the source matrix.
  * @param filter_kernel Shared reference to the filter kernel.
+ * @param method Method used to apply the kernel.
+ * @param thread_pool Thread pool used to filter the tiles.
  * @return A SharedMatrixRef to the SimpleMatrix (the filtered matrix).
  */
 //-------------------------------------------------------------------
@@ -138,32 +190,96 @@ template<typename ReferenceType1, typename ReferenceType2,
             std::enable_if_t<is_matrix_reference<ReferenceType2>{}>* = nullptr>
 
 inline auto filter(const ReferenceType1& source_matrix,
-                   ReferenceType2 filter_kernel)
+                   ReferenceType2 filter_kernel,
+                   ConvolutionMethod method,
+                   ThreadPool& thread_pool)
 {
     using value_type = typename ReferenceType1::value_type;
+    using channels = pixel_channels<value_type>;
+
+    static_assert(channels::count > 0, "filter needs a source matrix with an arithmetic or a dlib pixel value type");
+
+    uintptr_t rows = source_matrix.rows();
+    uintptr_t columns = source_matrix.columns();
+
+    auto filtered_output = MatrixFactory::create_simple_matrix<value_type>(rows, columns, get_default_pixel_value<value_type>());
+
+    uintptr_t kernel_rows = filter_kernel.rows();
+    uintptr_t kernel_columns = filter_kernel.columns();
+
+    if(rows == 0 || columns == 0 || kernel_rows == 0 || kernel_columns == 0)
+        return filtered_output;
 
-    auto source_matrix_with_border = repeated_border(source_matrix);
+    std::vector<double> kernel_elements(kernel_rows * kernel_columns);
 
-    int64_t half_kernel_size = filter_kernel.rows() / 2;
+    for(uintptr_t i = 0; i < kernel_rows; ++i)
+        for(uintptr_t j = 0; j < kernel_columns; ++j)
+            kernel_elements[i * kernel_columns + j] = static_cast<double>(filter_kernel(i,j));
 
-    int64_t rows = source_matrix.rows();
-    int64_t columns = source_matrix.columns();
+    auto kernel = create_convolution_kernel(std::move(kernel_elements), kernel_rows, kernel_columns, method);
 
-    auto filtered_output = MatrixFactory::create_simple_matrix<value_type>(rows, columns, 0);
+    int64_t half_kernel_rows = kernel_rows / 2;
+    int64_t half_kernel_columns = kernel_columns / 2;
 
-    for(int i = 0; i < rows; ++i)
+    uintptr_t padded_columns = columns + kernel_columns - 1;
+
+    // Source column of every padded column, repeating the border values
+    std::vector<uintptr_t> source_columns(padded_columns);
+
+    for(uintptr_t j = 0; j < padded_columns; ++j)
+        source_columns[j] = std::clamp<int64_t>(int64_t(j) - half_kernel_columns, 0, int64_t(columns) - 1);
+
+    uintptr_t tile_rows = ConvolutionParameters::tile_rows;
+
+    if(kernel.method == ConvolutionMethod::fft)
+        tile_rows = std::max(tile_rows, ConvolutionParameters::fft_tile_rows_per_kernel_row * kernel_rows);
+
+    uintptr_t number_of_tiles = (rows + tile_rows - 1) / tile_rows;
+
+    auto filter_tile = [&](uintptr_t tile_index)
     {
-        for(int j = 0; j < columns; ++j)
+        uintptr_t first_row = tile_index * tile_rows;
+        uintptr_t number_of_rows = std::min(tile_rows, rows - first_row);
+        uintptr_t halo_rows = number_of_rows + kernel_rows - 1;
+
+        uintptr_t halo_size = halo_rows * padded_columns;
+        uintptr_t output_size = number_of_rows * columns;
+
+        std::vector<double> halo(channels::count * halo_size);
+        std::vector<double> output(channels::count * output_size);
+
+        // Read the tile and its halo once
+        for(uintptr_t i = 0; i < halo_rows; ++i)
         {
-            for(int ki = 0; ki < filter_kernel.rows(); ++ki)
+            uintptr_t source_row = std::clamp<int64_t>(int64_t(first_row + i) - half_kernel_rows, 0, int64_t(rows) - 1);
+
+            for(uintptr_t j = 0; j < padded_columns; ++j)
             {
-                for(int kj = 0; kj < filter_kernel.columns(); ++kj)
-                {
-                    filtered_output(i,j) += filter_kernel(ki,kj) * source_matrix_with_border(i + ki - half_kernel_size, j + kj - half_kernel_size);
-                }
+                const value_type& pixel = source_matrix(source_row, source_columns[j]);
+
+                for(uintptr_t channel = 0; channel < channels::count; ++channel)
+                    halo[channel * halo_size + i * padded_columns + j] = static_cast<double>(channels::get(pixel, channel));
             }
         }
-    }
+
+        for(uintptr_t channel = 0; channel < channels::count; ++channel)
+            correlate(kernel, halo.data() + channel * halo_size, output.data() + channel * output_size, number_of_rows, columns);
+
+        for(uintptr_t i = 0; i < number_of_rows; ++i)
+        {
+            for(uintptr_t j = 0; j < columns; ++j)
+            {
+                value_type pixel = get_default_pixel_value<value_type>();
+
+                for(uintptr_t channel = 0; channel < channels::count; ++channel)
+                    channels::get(pixel, channel) = convert_filtered_value<typename channels::channel_type>(output[channel * output_size + i * columns + j]);
+
+                filtered_output(first_row + i, j) = pixel;
+            }
+        }
+    };
+
+    thread_pool.parallel_for(number_of_tiles, filter_tile);
 
     return filtered_output;
 }
@@ -171,6 +287,37 @@ inline auto filter(const ReferenceType1& source_matrix,
 
 
 
+//-------------------------------------------------------------------
+/**
+ * @brief Applies a filter kernel to a source matrix (see above), on the
+ *        default thread pool for sources with has_contiguous_storage and
+ *        on the calling thread for any other source, since lazy views and
+ *        file or database backed matrices might not be safe to read from
+ *        several threads at once.
+ *
+ * @param source_matrix Shared reference to the source matrix.
+ * @param filter_kernel Shared reference to the filter kernel.
+ * @param method Method used to apply the kernel (picked automatically by default).
+ * @return A SharedMatrixRef to the SimpleMatrix (the filtered matrix).
+ */
+//-------------------------------------------------------------------
+template<typename ReferenceType1, typename ReferenceType2,
+            std::enable_if_t<is_matrix_reference<ReferenceType1>{}>* = nullptr,
+            std::enable_if_t<is_matrix_reference<ReferenceType2>{}>* = nullptr>
+
+inline auto filter(const ReferenceType1& source_matrix,
+                   ReferenceType2 filter_kernel,
+                   ConvolutionMethod method = ConvolutionMethod::automatic)
+{
+    if constexpr(has_contiguous_storage<typename ReferenceType1::matrix_type>::value)
+        return filter(source_matrix, filter_kernel, method, get_default_thread_pool());
+    else
+        return filter(source_matrix, filter_kernel, method, get_serial_thread_pool());
+}
+//-------------------------------------------------------------------
+
+
+
 //-------------------------------------------------------------------
 } // namespace LazyMatrix
 //-------------------------------------------------------------------
@@ -94,6 +94,73 @@ template<> struct is_valid_dlib_pixel_type<int> : std::true_type {};
 
 
 
+//-------------------------------------------------------------------
+/**
+ * @brief Trait giving access to the channels of a pixel type.
+ *
+ * Specializations define the type of the channels, their count and a
+ * get(pixel, channel) function returning a reference to a channel.
+ * Pixel types without channel access (such as complex numbers) have a
+ * count of zero.
+ */
+//-------------------------------------------------------------------
+template<typename PixelType, typename Enable = void>
+struct pixel_channels
+{
+    static constexpr uintptr_t count = 0;
+};
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+// Grayscale pixels have a single channel
+template<typename PixelType>
+struct pixel_channels<PixelType, std::enable_if_t<std::is_arithmetic_v<PixelType>>>
+{
+    using channel_type = PixelType;
+
+    static constexpr uintptr_t count = 1;
+
+    static channel_type& get(PixelType& pixel, uintptr_t) { return pixel; }
+    static const channel_type& get(const PixelType& pixel, uintptr_t) { return pixel; }
+};
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+// dlib pixels list their channels as pointers to members
+template<typename PixelType, typename ChannelType, ChannelType PixelType::*... Channels>
+struct dlib_pixel_channels
+{
+    using channel_type = ChannelType;
+
+    static constexpr uintptr_t count = sizeof...(Channels);
+
+    static channel_type& get(PixelType& pixel, uintptr_t channel)
+    {
+        constexpr ChannelType PixelType::* members[] = {Channels...};
+        return pixel.*members[channel];
+    }
+
+    static const channel_type& get(const PixelType& pixel, uintptr_t channel)
+    {
+        constexpr ChannelType PixelType::* members[] = {Channels...};
+        return pixel.*members[channel];
+    }
+};
+
+template<> struct pixel_channels<dlib::rgb_pixel> : dlib_pixel_channels<dlib::rgb_pixel, unsigned char, &dlib::rgb_pixel::red, &dlib::rgb_pixel::green, &dlib::rgb_pixel::blue> {};
+template<> struct pixel_channels<dlib::bgr_pixel> : dlib_pixel_channels<dlib::bgr_pixel, unsigned char, &dlib::bgr_pixel::blue, &dlib::bgr_pixel::green, &dlib::bgr_pixel::red> {};
+template<> struct pixel_channels<dlib::rgb_alpha_pixel> : dlib_pixel_channels<dlib::rgb_alpha_pixel, unsigned char, &dlib::rgb_alpha_pixel::red, &dlib::rgb_alpha_pixel::green, &dlib::rgb_alpha_pixel::blue, &dlib::rgb_alpha_pixel::alpha> {};
+template<> struct pixel_channels<dlib::bgr_alpha_pixel> : dlib_pixel_channels<dlib::bgr_alpha_pixel, unsigned char, &dlib::bgr_alpha_pixel::blue, &dlib::bgr_alpha_pixel::green, &dlib::bgr_alpha_pixel::red, &dlib::bgr_alpha_pixel::alpha> {};
+template<> struct pixel_channels<dlib::hsi_pixel> : dlib_pixel_channels<dlib::hsi_pixel, unsigned char, &dlib::hsi_pixel::h, &dlib::hsi_pixel::s, &dlib::hsi_pixel::i> {};
+template<> struct pixel_channels<dlib::lab_pixel> : dlib_pixel_channels<dlib::lab_pixel, unsigned char, &dlib::lab_pixel::l, &dlib::lab_pixel::a, &dlib::lab_pixel::b> {};
+//-------------------------------------------------------------------
+
+
+
 //-------------------------------------------------------------------
 template<typename PixelType>
 
@@ -225,6 +292,40 @@ public:
         return image_data_.nc();
     }
 
+    /**
+     * @brief Gets a pointer to the contiguous row-major array of pixels.
+     * 
+     * @return const PixelType* Pointer to the first pixel, nullptr for an empty image.
+     */
+    const PixelType* data() const
+    {
+        if(image_data_.size() == 0)
+            return nullptr;
+
+        return &image_data_(0, 0);
+    }
+
+    /**
+     * @brief Gets a pointer to the contiguous row-major array of pixels.
+     * 
+     * @return PixelType* Pointer to the first pixel, nullptr for an empty image.
+     */
+    PixelType* data()
+    {
+        if(image_data_.size() == 0)
+            return nullptr;
+
+        return &image_data_(0, 0);
+    }
+
+    /**
+     * @brief Returns the distance (in pixels) between the starts of consecutive rows.
+     */
+    uintptr_t row_stride() const
+    {
+        return image_data_.nc();
+    }
+
     // Functions used to handle row and column header names
     std::string get_row_header(int64_t row_index) const { return this->headers_.get_row_header(row_index); }
     std::string get_column_header(int64_t column_index) const { return this->headers_.get_column_header(column_index); }
@@ -294,6 +395,18 @@ struct is_type_a_matrix< ImageMatrix<DataType> > : std::true_type
 
 
 
+//-------------------------------------------------------------------
+// dlib matrices store their pixels contiguously, row by row
+//-------------------------------------------------------------------
+template<typename DataType>
+
+struct has_contiguous_storage< ImageMatrix<DataType> > : std::true_type
+{
+};
+//-------------------------------------------------------------------
+
+
+
 //-------------------------------------------------------------------
 }  // namespace LazyMatrix
 //-------------------------------------------------------------------
@@ -33,6 +33,9 @@
 // Robust mutex for thread synchronization
 #include "robust_mutex.hpp"
 
+// Access pattern, prefaulting and huge page hints for memory mapped files
+#include "memory_mapping_hints.hpp"
+
 // Constants for numerical computations
 #include "numerical_constants.hpp"
 
@@ -55,6 +58,9 @@
 // Shared Reference to 2d and 3d Matrix expressions
 #include "shared_references.hpp"
 
+// Block-at-a-time evaluation of lazy matrix expressions
+#include "expression_evaluation.hpp"
+
 // Custom eigen matrix wrappers for LazyMatrix matrix expressions
 #include "eigen_wrappers.hpp"
 
@@ -82,6 +88,12 @@
 // 3D matrix with memory-mapped file storage
 #include "matrix3d.hpp"
 
+// Memory-mapped ring buffer of rows with lock-free readers
+#include "ring_buffer_matrix.hpp"
+
+// Vectorized delimiter/quote scanner used to parse CSV files
+#include "csv_structural_scanner.hpp"
+
 // Matrix representation of CSV files
 #include "csv_matrix.hpp"
 
@@ -125,18 +137,33 @@
 // Moving average calculation for matrices
 #include "moving_average.hpp"
 
+// Moving variance, min/max, percentiles and exponential moving average
+#include "moving_window_statistics.hpp"
+
 // Generators for creating specific types of matrices
 #include "matrix_generators.hpp"
 
+// Thread pool used to run work in parallel
+#include "thread_pool.hpp"
+
+// Cache-blocked kernel used to multiply matrices with contiguous storage
+#include "blocked_matrix_multiplication.hpp"
+
 // Matrix multiplication operations
 #include "matrix_multiplication.hpp"
 
 // Differential operation for matrices
 #include "diff.hpp"
 
+// Separable, direct and FFT based convolution used by filters
+#include "convolution.hpp"
+
 // Filters for processing matrix data
 #include "filters.hpp"
 
+// Library native real and complex FFT kernel
+#include "fft_kernel.hpp"
+
 // Fast Fourier Transform (FFT) operations
 #include "fft.hpp"
 
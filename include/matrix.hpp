@@ -32,11 +32,16 @@
 #include <vector>
 #include <fstream>
 #include <mutex>
+#include <algorithm>
+#include <new>
 
 #include "files.hpp"
+#include "robust_mutex.hpp"
+#include "memory_mapping_hints.hpp"
 
 #include "base_matrix.hpp"
 #include "shared_references.hpp"
+#include "expression_evaluation.hpp"
 
 // mio library for cross-platform memory-mapping
 #include <single_include/mio/mio.hpp>
@@ -61,6 +66,7 @@ namespace LazyMatrix
 
 //-------------------------------------------------------------------
 const std::string matrix_header_byte_sequence = "::---begin---::\n";
+const std::string aligned_matrix_header_byte_sequence = "::-begin-v2--::\n";
 const std::string matrix_footer_byte_sequence = "::----end----::\n";
 //-------------------------------------------------------------------
 
@@ -68,19 +74,41 @@ const std::string matrix_footer_byte_sequence = "::----end----::\n";
 
 //-------------------------------------------------------------------
 /**
- * @brief Struct representing the header of a memory-mapped matrix.
+ * @brief Struct representing the header of a memory-mapped matrix in the
+ *        older (version 1) format.
  * 
- * Contains metadata for the matrix including its size, row and column count. 
- * It also contains a mutex for synchronizing access in a multi-threaded environment.
+ * Contains metadata for the matrix including its size, row and column count.
+ * Its layout is frozen: version 1 files store their data right after it.
  */
 //-------------------------------------------------------------------
-struct MatrixHeader
+struct LegacyMatrixHeader
 {
     char header[16] = {':', ':', '-', '-', '-', 'b', 'e', 'g', 'i', 'n', '-', '-', '-', ':', ':', '\n'};
     uintptr_t size_of_data_type = 8;
     uintptr_t rows = 0;
     uintptr_t columns = 0;
 };
+
+static_assert(sizeof(LegacyMatrixHeader) == 16 + 3 * sizeof(uintptr_t),
+              "The layout of version 1 matrix files can't change");
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+/**
+ * @brief Struct representing the header of a memory-mapped matrix in the
+ *        current (version 2) format.
+ * 
+ * Starts like the LegacyMatrixHeader, followed by a process-shared lock
+ * (see SharedMemoryLock) for synchronizing writers and lock-free readers
+ * across processes. Version 1 files have no shared lock.
+ */
+//-------------------------------------------------------------------
+struct MatrixHeader : public LegacyMatrixHeader
+{
+    SharedMemoryLock shared_lock;
+};
 //-------------------------------------------------------------------
 
 
@@ -100,12 +128,153 @@ struct MatrixFooter
 
 
 
+//-------------------------------------------------------------------
+/**
+ * @brief Struct describing where the data of a memory-mapped matrix resides.
+ *
+ * Files in the current format (version 2) start with the
+ * aligned_matrix_header_byte_sequence and store this struct right
+ * after the MatrixHeader. The data starts at an aligned offset so
+ * that aligned SIMD loads can be used, and rows can be padded so that
+ * every row starts at an aligned address too.
+ *
+ * Files in the older format (version 1) start with the
+ * matrix_header_byte_sequence, have no layout stored in them, and
+ * their data starts right after the LegacyMatrixHeader with no padding.
+ */
+//-------------------------------------------------------------------
+struct MatrixDataLayout
+{
+    uintptr_t format_version = 2;           ///< Version of the file format.
+    uintptr_t data_offset = 0;              ///< Offset (in bytes) of the data from the start of the file.
+    uintptr_t row_stride = 0;               ///< Distance (in elements) between the starts of consecutive rows.
+};
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+/**
+ * @brief Options used to lay out the data of newly created matrix files.
+ *
+ * The alignment has to be a power of two no larger than a memory page,
+ * since memory mapped files always start at a page boundary. Rows are
+ * only padded when the alignment is a multiple of the size of an entry.
+ */
+//-------------------------------------------------------------------
+struct MatrixDataLayoutOptions
+{
+    uintptr_t alignment = 64;               ///< Alignment (in bytes) of the start of the data.
+    bool pad_rows = false;                  ///< Pad rows so each one starts at an aligned address.
+};
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+/**
+ * @brief Rounds a value up to a multiple of a power of two.
+ */
+//-------------------------------------------------------------------
+inline uintptr_t round_up_to_alignment(uintptr_t value, uintptr_t alignment)
+{
+    if(alignment <= 1)
+        return value;
+
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+/**
+ * @brief Calculates the data layout of a new matrix file.
+ *
+ * @param columns Number of columns of the matrix.
+ * @param size_of_data_type Size (in bytes) of an entry of the matrix.
+ * @param options Alignment and padding of the data.
+ * @return MatrixDataLayout The layout of the data.
+ */
+//-------------------------------------------------------------------
+inline MatrixDataLayout calculate_matrix_data_layout(uintptr_t columns,
+                                                     uintptr_t size_of_data_type,
+                                                     const MatrixDataLayoutOptions& options)
+{
+    MatrixDataLayout layout;
+
+    // Alignments that are not a power of two are ignored
+    uintptr_t alignment = (options.alignment & (options.alignment - 1)) == 0 ? options.alignment : 1;
+
+    layout.data_offset = round_up_to_alignment(sizeof(MatrixHeader) + sizeof(MatrixDataLayout), alignment);
+    layout.row_stride = columns;
+
+    if(options.pad_rows && size_of_data_type > 0 && alignment % size_of_data_type == 0)
+        layout.row_stride = round_up_to_alignment(columns * size_of_data_type, alignment) / size_of_data_type;
+
+    return layout;
+}
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+/**
+ * @brief Checks whether the memory region starts with a matrix header
+ *        of the current (version 2) format.
+ */
+//-------------------------------------------------------------------
+inline bool does_memory_contain_aligned_matrix_header(const char* memory_mapped_matrix,
+                                                      uintptr_t memory_size_in_bytes)
+{
+    if(memory_size_in_bytes < sizeof(MatrixHeader) + sizeof(MatrixDataLayout))
+        return false;
+
+    return std::equal(aligned_matrix_header_byte_sequence.cbegin(),
+                      aligned_matrix_header_byte_sequence.cend(),
+                      memory_mapped_matrix);
+}
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+/**
+ * @brief Reads the data layout of a memory-mapped matrix, for both
+ *        the current and the older file formats.
+ *
+ * @param memory_mapped_matrix Pointer to the start of the memory-mapped region
+ *        (it has to be at least as big as the LegacyMatrixHeader).
+ * @param memory_size_in_bytes Size of the memory region in bytes.
+ * @return MatrixDataLayout The layout of the data.
+ */
+//-------------------------------------------------------------------
+inline MatrixDataLayout get_matrix_data_layout(const char* memory_mapped_matrix,
+                                               uintptr_t memory_size_in_bytes)
+{
+    if(does_memory_contain_aligned_matrix_header(memory_mapped_matrix, memory_size_in_bytes))
+        return *reinterpret_cast<const MatrixDataLayout*>(memory_mapped_matrix + sizeof(MatrixHeader));
+
+    const LegacyMatrixHeader* header = reinterpret_cast<const LegacyMatrixHeader*>(memory_mapped_matrix);
+
+    MatrixDataLayout layout;
+    layout.format_version = 1;
+    layout.data_offset = sizeof(LegacyMatrixHeader);
+    layout.row_stride = header->columns;
+
+    return layout;
+}
+//-------------------------------------------------------------------
+
+
+
 //-------------------------------------------------------------------
 /**
  * @brief Checks if the given memory region contains a memory-mapped matrix.
  * 
  * It inspects the memory region to determine if it adheres to the layout 
- * and size requirements of a memory-mapped matrix, as specified by the MatrixHeader.
+ * and size requirements of a memory-mapped matrix, as specified by the MatrixHeader
+ * and, for files in the current format, the MatrixDataLayout.
  * 
  * @param memory_mapped_matrix Pointer to the start of the memory-mapped region.
  * @param memory_size_in_bytes Size of the memory region in bytes.
@@ -116,14 +285,21 @@ struct MatrixFooter
 inline bool does_memory_contain_mapped_matrix(const char* memory_mapped_matrix,
                                               uintptr_t memory_size_in_bytes)
 {
-    uintptr_t minimum_size = sizeof(MatrixHeader) + sizeof(MatrixFooter);
+    uintptr_t minimum_size = sizeof(LegacyMatrixHeader) + sizeof(MatrixFooter);
 
     if(memory_size_in_bytes < minimum_size)
         return false;
     
-    const MatrixHeader* header = reinterpret_cast<const MatrixHeader*>(memory_mapped_matrix);
+    const LegacyMatrixHeader* header = reinterpret_cast<const LegacyMatrixHeader*>(memory_mapped_matrix);
+
+    MatrixDataLayout layout = get_matrix_data_layout(memory_mapped_matrix, memory_size_in_bytes);
 
-    uintptr_t expected_size = minimum_size + header->size_of_data_type * header->rows * header->columns;
+    uintptr_t minimum_data_offset = (layout.format_version == 1) ? sizeof(LegacyMatrixHeader) : sizeof(MatrixHeader) + sizeof(MatrixDataLayout);
+
+    if(layout.row_stride < header->columns || layout.data_offset < minimum_data_offset)
+        return false;
+
+    uintptr_t expected_size = layout.data_offset + sizeof(MatrixFooter) + header->size_of_data_type * header->rows * layout.row_stride;
 
     return memory_size_in_bytes >= expected_size;
 }
@@ -257,6 +433,10 @@ public:
 
     /**
      * @brief Get the number of rows in the matrix.
+     *
+     * When another process appended rows past the end of our mapping,
+     * only the rows inside it are counted, call refresh_mapping to see
+     * the others.
      */
     uintptr_t rows()const;
 
@@ -265,10 +445,19 @@ public:
      */
     uintptr_t columns()const;
 
+    /**
+     * @brief Get the distance (in entries) between the starts of
+     *        consecutive rows in the memory mapped file.
+     *
+     * It's equal to the number of columns unless the rows are padded
+     * (see MatrixDataLayoutOptions).
+     */
+    uintptr_t row_stride()const;
+
     /**
      * @brief Get the capacity of the memory mapped file.
      * @return The number of entries the matrix can contain in the
-     *         memory mapped file.
+     *         memory mapped file (padding included).
      */
     uintptr_t capacity()const;
 
@@ -277,6 +466,38 @@ public:
      */
     std::size_t get_mapped_file_size()const;
 
+    /**
+     * @brief Set the hints applied to the memory mapped file, now and
+     *        every time the file is mapped again (for example when it grows).
+     * @param hints Access pattern, prefaulting and huge pages.
+     * @return std::error_code Error returned by the operating system while
+     *         applying the hints (the hints are kept anyway).
+     */
+    std::error_code set_memory_mapping_hints(const MemoryMappingHints& hints);
+
+    /**
+     * @brief Get the hints applied to the memory mapped file.
+     */
+    const MemoryMappingHints& get_memory_mapping_hints()const;
+
+    /**
+     * @brief Set the alignment and padding used the next time
+     *        a memory mapped file is created for this matrix.
+     * @param options Alignment of the data and padding of the rows.
+     */
+    void set_data_layout_options(const MatrixDataLayoutOptions& options);
+
+    /**
+     * @brief Get the alignment and padding used when creating
+     *        memory mapped files for this matrix.
+     */
+    const MatrixDataLayoutOptions& get_data_layout_options()const;
+
+    /**
+     * @brief Get the layout of the data in the memory mapped file.
+     */
+    MatrixDataLayout get_data_layout()const;
+
     /**
      * @brief Get the filename of the memory mapped file containing this matrix.
      */
@@ -311,6 +532,125 @@ public:
      */
     std::error_code load_matrix(const std::string& file_to_load_matrix_from);
 
+    /**
+     * @brief Grows the memory mapped file in place so it can hold at
+     *        least the specified number of entries.
+     *
+     * Unlike create_matrix, the same file is resized and mapped again, so
+     * the current values are kept. Pointers to the matrix data are no
+     * longer valid afterwards. Other Matrix objects mapping the same file
+     * keep seeing the old size until they load the matrix again.
+     *
+     * @param number_of_entries The number of entries the matrix needs to hold.
+     * @return Error code indicating success or failure of the operation.
+     */
+    std::error_code reserve(uintptr_t number_of_entries);
+
+    /**
+     * @brief Appends rows at the end of the matrix.
+     *
+     * When the memory mapped file is full, its capacity is multiplied by
+     * capacity_growth_factor (see reserve), so appending rows one at a
+     * time has an amortized constant cost per row.
+     *
+     * @param number_of_rows Number of rows to append.
+     * @param initial_value The value used to fill the new rows.
+     * @return Error code indicating success or failure of the operation
+     *         (the matrix needs to have columns to append rows to it).
+     */
+    std::error_code append_rows(uintptr_t number_of_rows, const DataType& initial_value = static_cast<DataType>(0));
+
+    /**
+     * @brief Appends the rows of a matrix expression at the end of the matrix.
+     *
+     * An empty matrix takes the number of columns of the expression,
+     * otherwise the number of columns has to match.
+     *
+     * @param rows_to_append The matrix expression with the rows to append.
+     * @return Error code indicating success or failure of the operation.
+     */
+    template<typename ReferenceType, std::enable_if_t<is_matrix_reference<ReferenceType>{}>* = nullptr>
+    std::error_code append_rows(ReferenceType rows_to_append);
+
+    // Factor by which append_rows grows the capacity of a full matrix
+    static constexpr uintptr_t capacity_growth_factor = 2;
+
+    /**
+     * @brief Maps the file again if another process grew it (for example
+     *        by appending rows), so everything it wrote becomes reachable.
+     * @return Error code indicating success or failure of the operation.
+     */
+    std::error_code refresh_mapping();
+
+    /**
+     * @brief Locks the process-shared mutex in the matrix header.
+     *
+     * Writers shared with other processes lock the matrix and wrap their
+     * changes between begin_write and end_write, so readers can use
+     * read_consistently or copy_rows without locking. If the previous
+     * owner died, the lock is recovered and EOWNERDEAD is returned.
+     *
+     * @return int Returns 0 on success, EOWNERDEAD if the previous owner
+     *         died, or an error code on failure.
+     */
+    int lock();
+
+    /**
+     * @brief Unlocks the process-shared mutex in the matrix header.
+     */
+    void unlock();
+
+    /**
+     * @brief Marks the start of a change to the matrix (the lock must be held).
+     */
+    void begin_write();
+
+    /**
+     * @brief Marks the end of a change to the matrix (the lock must be held).
+     */
+    void end_write();
+
+    /**
+     * @brief Get the version of the matrix, which changes with every write
+     *        (0 when no file is mapped).
+     */
+    uint64_t get_version()const;
+
+    /**
+     * @brief Calls read_function until it read the matrix without a write
+     *        happening at the same time (see SharedMemoryLock).
+     * @param read_function Callable copying data out of the matrix.
+     * @return The version of the data that was read.
+     */
+    template<typename Function>
+    uint64_t read_consistently(Function&& read_function)const;
+
+    /**
+     * @brief Copies rows of the matrix without locking, getting a
+     *        consistent snapshot even while a writer appends rows.
+     *
+     * @param first_row The first row to copy.
+     * @param number_of_rows The number of rows to copy.
+     * @param destination Where to copy number_of_rows * columns() values.
+     * @return false if the rows don't exist or are beyond the part of the
+     *         file mapped by this object (load the matrix again to see them).
+     */
+    bool copy_rows(uintptr_t first_row, uintptr_t number_of_rows, DataType* destination)const;
+
+    /**
+     * @brief Get a pointer to the row-major matrix data inside the
+     *        memory mapped file (rows are row_stride() entries apart),
+     *        nullptr if no file is mapped.
+     */
+    const DataType* data()const;
+
+    /**
+     * @brief Get a pointer to the row-major matrix data inside the
+     *        memory mapped file (rows are row_stride() entries apart),
+     *        nullptr if no file is mapped.
+     */
+    DataType* data();
+
     // Functions used to handle row and column header names
     std::string get_row_header(int64_t row_index) const { return this->headers_.get_row_header(row_index); }
     std::string get_column_header(int64_t column_index) const { return this->headers_.get_column_header(column_index); }
@@ -321,6 +661,22 @@ public:
 
 private: // Private functions
 
+    /**
+     * @brief Applies the memory mapping hints to the current mapping.
+     */
+    std::error_code apply_memory_mapping_hints_();
+
+    /**
+     * @brief Reads the offset of the data from the current mapping.
+     */
+    void update_data_offset_();
+
+    /**
+     * @brief Get the layout stored in the memory mapped file,
+     *        nullptr for files in the older format.
+     */
+    MatrixDataLayout* get_stored_data_layout_();
+
     /**
      * @brief Resizes the matrix to a specified size.
      * @param rows The new number of rows.
@@ -383,6 +739,23 @@ private: // Private variables
     // its filename
     mio::shared_mmap_sink mapped_file_;
     fs::path filename_of_memory_mapped_file_;
+
+    // Hints applied every time the file is mapped
+    MemoryMappingHints memory_mapping_hints_;
+
+    // Alignment and padding of newly created files
+    MatrixDataLayoutOptions data_layout_options_;
+
+    // Offset of the data from the start of the
+    // mapped file and whether the file stores its
+    // own layout and shared lock (files in the
+    // older format don't)
+    uintptr_t data_offset_ = sizeof(MatrixHeader);
+    bool is_data_layout_stored_ = false;
+
+    // Version of files in the older format, which
+    // have no shared lock, only seen by this object
+    uint64_t local_version_ = 0;
 };
 //-------------------------------------------------------------------
 
@@ -400,6 +773,30 @@ struct is_type_a_matrix< Matrix<DataType> > : std::true_type
 
 
 
+//-------------------------------------------------------------------
+// Matrix stores its elements contiguously in the memory mapped file
+//-------------------------------------------------------------------
+template<typename DataType>
+
+struct has_contiguous_storage< Matrix<DataType> > : std::true_type
+{
+};
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+// Matrix versions its data with the seqlock in its header
+//-------------------------------------------------------------------
+template<typename DataType>
+
+struct has_data_version< Matrix<DataType> > : std::true_type
+{
+};
+//-------------------------------------------------------------------
+
+
+
 //-------------------------------------------------------------------
 // Default constructor from rows, columns and initial value
 //-------------------------------------------------------------------
@@ -421,9 +818,17 @@ template<typename DataType>
 inline Matrix<DataType>::Matrix(const Matrix<DataType>& matrix)
 {
     filename_of_memory_mapped_file_ = matrix.get_filename_of_memory_mapped_file();
+    memory_mapping_hints_ = matrix.get_memory_mapping_hints();
+    data_layout_options_ = matrix.get_data_layout_options();
 
     std::error_code mapping_error;
     mapped_file_.map(filename_of_memory_mapped_file_.string(), mapping_error);
+
+    if(!mapping_error)
+    {
+        this->update_data_offset_();
+        this->apply_memory_mapping_hints_();
+    }
 }
 //-------------------------------------------------------------------
 
@@ -497,15 +902,10 @@ inline Matrix<DataType>::Matrix(ReferenceType matrix_expression)
     uintptr_t rows = matrix_expression.rows();
     uintptr_t columns = matrix_expression.columns();
 
-    this->resize_(rows,columns);
+    std::error_code error = this->resize_(rows,columns);
 
-    for(int64_t i = 0; i < rows; ++i)
-    {
-        for(int64_t j = 0; j < columns; ++j)
-        {
-            (*this)(i,j) = matrix_expression(i,j);
-        }
-    }
+    if(!error)
+        materialize_into(matrix_expression, *this);
 }
 //-------------------------------------------------------------------
 
@@ -519,10 +919,18 @@ template<typename DataType>
 inline Matrix<DataType>& Matrix<DataType>::operator=(const Matrix<DataType>& matrix)
 {
     filename_of_memory_mapped_file_ = matrix.get_filename_of_memory_mapped_file();
+    memory_mapping_hints_ = matrix.get_memory_mapping_hints();
+    data_layout_options_ = matrix.get_data_layout_options();
 
     std::error_code mapping_error;
     mapped_file_.map(filename_of_memory_mapped_file_.string(), mapping_error);
 
+    if(!mapping_error)
+    {
+        this->update_data_offset_();
+        this->apply_memory_mapping_hints_();
+    }
+
     return (*this);
 }
 //-------------------------------------------------------------------
@@ -593,9 +1001,7 @@ inline Matrix<DataType>& Matrix<DataType>::operator=(ReferenceType matrix_expres
     if(error)
         return (*this);
 
-    for(int64_t i = 0; i < rows; ++i)
-        for(int64_t j = 0; j < columns; ++j)
-            (*this)(i,j) = matrix_expression(i,j);
+    materialize_into(matrix_expression, *this);
 
     return (*this);
 }
@@ -619,7 +1025,16 @@ template<typename DataType>
 
 inline uintptr_t Matrix<DataType>::rows()const
 {
-    return this->get_header()->rows;
+    uintptr_t rows = this->get_header()->rows;
+
+    // Rows appended by another process can lie past the end
+    // of our mapping if the file grew after we mapped it
+    uintptr_t row_stride = this->row_stride();
+
+    if(row_stride > 0)
+        rows = std::min(rows, this->capacity() / row_stride);
+
+    return rows;
 }
 
 
@@ -633,11 +1048,23 @@ inline uintptr_t Matrix<DataType>::columns()const
 
 
 
+template<typename DataType>
+
+inline uintptr_t Matrix<DataType>::row_stride()const
+{
+    if(is_data_layout_stored_)
+        return reinterpret_cast<const MatrixDataLayout*>(mapped_file_.cbegin() + sizeof(MatrixHeader))->row_stride;
+
+    return this->columns();
+}
+
+
+
 template<typename DataType>
 
 inline uintptr_t Matrix<DataType>::capacity()const
 {
-    return (get_mapped_file_size() - sizeof(MatrixHeader) + sizeof(MatrixFooter)) / sizeof(DataType);
+    return (get_mapped_file_size() - data_offset_ - sizeof(MatrixFooter)) / sizeof(DataType);
 }
 
 
@@ -648,9 +1075,100 @@ inline uintptr_t Matrix<DataType>::get_mapped_file_size()const
 {
     return mapped_file_.size();
 }
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+// Memory mapping hints
+//-------------------------------------------------------------------
+template<typename DataType>
+
+inline std::error_code Matrix<DataType>::set_memory_mapping_hints(const MemoryMappingHints& hints)
+{
+    memory_mapping_hints_ = hints;
+
+    return this->apply_memory_mapping_hints_();
+}
+
+
+
+template<typename DataType>
+
+inline const MemoryMappingHints& Matrix<DataType>::get_memory_mapping_hints()const
+{
+    return memory_mapping_hints_;
+}
 
 
 
+template<typename DataType>
+
+inline std::error_code Matrix<DataType>::apply_memory_mapping_hints_()
+{
+    if(!mapped_file_.is_open())
+        return std::error_code();
+
+    return apply_memory_mapping_hints(mapped_file_.begin(), mapped_file_.size(), memory_mapping_hints_);
+}
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+// Layout of the data in the memory mapped file
+//-------------------------------------------------------------------
+template<typename DataType>
+
+inline void Matrix<DataType>::set_data_layout_options(const MatrixDataLayoutOptions& options)
+{
+    data_layout_options_ = options;
+}
+
+
+
+template<typename DataType>
+
+inline const MatrixDataLayoutOptions& Matrix<DataType>::get_data_layout_options()const
+{
+    return data_layout_options_;
+}
+
+
+
+template<typename DataType>
+
+inline MatrixDataLayout Matrix<DataType>::get_data_layout()const
+{
+    return get_matrix_data_layout(mapped_file_.data(), mapped_file_.size());
+}
+
+
+
+template<typename DataType>
+
+inline void Matrix<DataType>::update_data_offset_()
+{
+    is_data_layout_stored_ = does_memory_contain_aligned_matrix_header(mapped_file_.data(), mapped_file_.size());
+    data_offset_ = get_matrix_data_layout(mapped_file_.data(), mapped_file_.size()).data_offset;
+}
+
+
+
+template<typename DataType>
+
+inline MatrixDataLayout* Matrix<DataType>::get_stored_data_layout_()
+{
+    if(!is_data_layout_stored_)
+        return nullptr;
+
+    return reinterpret_cast<MatrixDataLayout*>(mapped_file_.begin() + sizeof(MatrixHeader));
+}
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
 template<typename DataType>
 
 inline const fs::path& Matrix<DataType>::get_filename_of_memory_mapped_file()const
@@ -682,7 +1200,7 @@ template<typename DataType>
 
 inline const MatrixFooter* Matrix<DataType>::get_footer()const
 {
-    return reinterpret_cast<const MatrixFooter*>(mapped_file_.cbegin() + sizeof(MatrixHeader) + this->size()*sizeof(DataType));
+    return reinterpret_cast<const MatrixFooter*>(mapped_file_.cbegin() + data_offset_ + this->rows()*this->row_stride()*sizeof(DataType));
 }
 
 
@@ -691,7 +1209,7 @@ template<typename DataType>
 
 inline MatrixFooter* Matrix<DataType>::get_footer()
 {
-    return reinterpret_cast<MatrixFooter*>(mapped_file_.begin() + sizeof(MatrixHeader) + this->size()*sizeof(DataType));
+    return reinterpret_cast<MatrixFooter*>(mapped_file_.begin() + data_offset_ + this->rows()*this->row_stride()*sizeof(DataType));
 }
 //-------------------------------------------------------------------
 
@@ -704,7 +1222,7 @@ template<typename DataType>
 
 inline DataType Matrix<DataType>::const_at_(int64_t row, int64_t column)const
 {
-    return reinterpret_cast<const DataType*>(mapped_file_.cbegin() + sizeof(MatrixHeader))[row*columns() + column];
+    return reinterpret_cast<const DataType*>(mapped_file_.cbegin() + data_offset_)[row*row_stride() + column];
 }
 
 
@@ -713,7 +1231,35 @@ template<typename DataType>
 
 inline DataType& Matrix<DataType>::non_const_at_(int64_t row, int64_t column)
 {
-    return reinterpret_cast<DataType*>(mapped_file_.begin() + sizeof(MatrixHeader))[row*columns() + column];
+    return reinterpret_cast<DataType*>(mapped_file_.begin() + data_offset_)[row*row_stride() + column];
+}
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+// Raw access to the matrix data
+//-------------------------------------------------------------------
+template<typename DataType>
+
+inline const DataType* Matrix<DataType>::data()const
+{
+    if(!mapped_file_.is_open())
+        return nullptr;
+
+    return reinterpret_cast<const DataType*>(mapped_file_.cbegin() + data_offset_);
+}
+
+
+
+template<typename DataType>
+
+inline DataType* Matrix<DataType>::data()
+{
+    if(!mapped_file_.is_open())
+        return nullptr;
+
+    return reinterpret_cast<DataType*>(mapped_file_.begin() + data_offset_);
 }
 //-------------------------------------------------------------------
 
@@ -770,7 +1316,13 @@ Matrix<DataType>::create_matrix(uintptr_t rows,
     // already the correct size
     if(mapped_file_.is_open())
     {
-        if(this->capacity() >= rows * columns)
+        // Rows of files in the older format are never padded
+        uintptr_t row_stride = columns;
+
+        if(is_data_layout_stored_)
+            row_stride = calculate_matrix_data_layout(columns, sizeof(DataType), data_layout_options_).row_stride;
+
+        if(this->capacity() >= rows * row_stride)
         {
             // This means the matrix we are currently
             // mapped to is of equal or greater size
@@ -782,6 +1334,9 @@ Matrix<DataType>::create_matrix(uintptr_t rows,
             {
                 this->get_header()->rows = 0;
                 this->get_header()->columns = 0;
+
+                if(is_data_layout_stored_)
+                    this->get_stored_data_layout_()->row_stride = 0;
             }
             else
             {
@@ -791,6 +1346,9 @@ Matrix<DataType>::create_matrix(uintptr_t rows,
                 this->get_header()->rows = rows;
                 this->get_header()->columns = columns;
 
+                if(is_data_layout_stored_)
+                    this->get_stored_data_layout_()->row_stride = row_stride;
+
                 for(int64_t i = old_number_of_rows; i < this->rows(); ++i)
                 {
                     for(int64_t j = old_number_of_columns; j < this->columns(); ++j)
@@ -806,9 +1364,11 @@ Matrix<DataType>::create_matrix(uintptr_t rows,
 
     mapped_file_.unmap();
 
-    // Calculate the necessary size of the file
-    // so that it can hold the matrix
-    uintptr_t size_of_file = sizeof(MatrixHeader) + sizeof(MatrixFooter) + rows*columns*sizeof(DataType);
+    // Calculate where the data goes and the necessary
+    // size of the file so that it can hold the matrix
+    MatrixDataLayout layout = calculate_matrix_data_layout(columns, sizeof(DataType), data_layout_options_);
+
+    uintptr_t size_of_file = layout.data_offset + sizeof(MatrixFooter) + rows*layout.row_stride*sizeof(DataType);
 
     // Create the file and size it accordingly
     filename_of_memory_mapped_file_ = create_file_with_specified_size_and_unique_name(size_of_file,
@@ -824,15 +1384,25 @@ Matrix<DataType>::create_matrix(uintptr_t rows,
 
     if(mapping_error)
         return mapping_error;
+
+    // Apply the hints before initializing, which touches every page
+    this->apply_memory_mapping_hints_();
     
-    // Write the Matrix Header
-    std::copy(matrix_header_byte_sequence.cbegin(),
-              matrix_header_byte_sequence.cend(),
-              &this->get_header()->header[0]);
+    // Write the Matrix Header, constructing the shared lock in place,
+    // followed by the layout of the data
+    new (mapped_file_.begin()) MatrixHeader();
     this->get_header()->size_of_data_type = sizeof(DataType);
     this->get_header()->rows = rows;
     this->get_header()->columns = columns;
 
+    std::copy(aligned_matrix_header_byte_sequence.cbegin(),
+              aligned_matrix_header_byte_sequence.cend(),
+              &this->get_header()->header[0]);
+
+    new (mapped_file_.begin() + sizeof(MatrixHeader)) MatrixDataLayout(layout);
+
+    this->update_data_offset_();
+
     // Write the Matrix Footer
     std::copy(matrix_footer_byte_sequence.cbegin(),
               matrix_footer_byte_sequence.cend(),
@@ -872,7 +1442,7 @@ inline std::error_code Matrix<DataType>::load_matrix(const std::string& file_to_
     // We now know the file exists, so we check its size
     // to make sure it is sized correctly to host the
     // matrix it supposedly hosts
-    uintptr_t minimum_file_size_needed_to_hold_a_matrix = sizeof(MatrixHeader) + sizeof(MatrixFooter);
+    uintptr_t minimum_file_size_needed_to_hold_a_matrix = sizeof(LegacyMatrixHeader) + sizeof(MatrixFooter);
 
     if(fs::file_size(filename_of_memory_mapped_file_) < minimum_file_size_needed_to_hold_a_matrix)
     {
@@ -900,6 +1470,9 @@ inline std::error_code Matrix<DataType>::load_matrix(const std::string& file_to_
         return mapping_error;
     }
 
+    this->update_data_offset_();
+    this->apply_memory_mapping_hints_();
+
     // We are done
     return mapping_error;
 }
@@ -907,6 +1480,304 @@ inline std::error_code Matrix<DataType>::load_matrix(const std::string& file_to_
 
 
 
+//-------------------------------------------------------------------
+// Function used to grow the memory mapped file in place
+//-------------------------------------------------------------------
+template<typename DataType>
+
+inline std::error_code Matrix<DataType>::reserve(uintptr_t number_of_entries)
+{
+    std::error_code mapping_error;
+
+    if(!mapped_file_.is_open())
+    {
+        mapping_error = this->create_matrix(0, 0);
+
+        if(mapping_error)
+            return mapping_error;
+    }
+
+    if(this->capacity() >= number_of_entries)
+        return mapping_error;
+
+    // Another process might have grown the file already,
+    // in which case resizing it would cut off its rows
+    mapping_error = this->refresh_mapping();
+
+    if(mapping_error || this->capacity() >= number_of_entries)
+        return mapping_error;
+
+    uintptr_t size_of_file = data_offset_ + sizeof(MatrixFooter) + number_of_entries*sizeof(DataType);
+
+    // The file can't be resized while mapped on some platforms,
+    // growing it keeps its contents so we just map it again
+    mapped_file_.unmap();
+
+    fs::resize_file(filename_of_memory_mapped_file_, size_of_file, mapping_error);
+
+    std::error_code remapping_error;
+    mapped_file_.map(filename_of_memory_mapped_file_.string(), remapping_error);
+
+    if(!remapping_error)
+        this->apply_memory_mapping_hints_();
+
+    if(mapping_error)
+        return mapping_error;
+
+    return remapping_error;
+}
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+// Function used to map the file again after another process grew it
+//-------------------------------------------------------------------
+template<typename DataType>
+
+inline std::error_code Matrix<DataType>::refresh_mapping()
+{
+    std::error_code mapping_error;
+
+    if(!mapped_file_.is_open())
+        return mapping_error;
+
+    uintptr_t size_of_file = fs::file_size(filename_of_memory_mapped_file_, mapping_error);
+
+    if(mapping_error || size_of_file <= mapped_file_.size())
+        return mapping_error;
+
+    mapped_file_.unmap();
+    mapped_file_.map(filename_of_memory_mapped_file_.string(), mapping_error);
+
+    if(!mapping_error)
+        this->apply_memory_mapping_hints_();
+
+    return mapping_error;
+}
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+// Function used to append rows to the matrix
+//-------------------------------------------------------------------
+template<typename DataType>
+
+inline std::error_code Matrix<DataType>::append_rows(uintptr_t number_of_rows, const DataType& initial_value)
+{
+    std::error_code mapping_error;
+
+    if(!mapped_file_.is_open() || this->columns() == 0)
+    {
+        // We don't know how many columns the new rows should have
+        mapping_error.assign(1,std::iostream_category());
+        return mapping_error;
+    }
+
+    // If another process appended rows past the end of our
+    // mapping, we have to see them before adding ours
+    if(this->get_header()->rows * this->row_stride() > this->capacity())
+    {
+        mapping_error = this->refresh_mapping();
+
+        if(mapping_error)
+            return mapping_error;
+    }
+
+    // Padding included
+    uintptr_t old_size = this->rows() * this->row_stride();
+    uintptr_t new_size = (this->rows() + number_of_rows) * this->row_stride();
+
+    if(new_size > this->capacity())
+    {
+        mapping_error = this->reserve(std::max(new_size, capacity_growth_factor * this->capacity()));
+
+        if(mapping_error)
+            return mapping_error;
+    }
+
+    this->get_header()->rows += number_of_rows;
+
+    std::fill(this->data() + old_size, this->data() + new_size, initial_value);
+
+    // The footer moves to the end of the new rows
+    std::copy(matrix_footer_byte_sequence.cbegin(),
+              matrix_footer_byte_sequence.cend(),
+              &this->get_footer()->footer[0]);
+
+    return mapping_error;
+}
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+// Function used to append the rows of a matrix expression
+//-------------------------------------------------------------------
+template<typename DataType>
+template<typename ReferenceType, std::enable_if_t<is_matrix_reference<ReferenceType>{}>*>
+
+inline std::error_code Matrix<DataType>::append_rows(ReferenceType rows_to_append)
+{
+    std::error_code mapping_error;
+
+    if(!mapped_file_.is_open())
+    {
+        mapping_error = this->create_matrix(0, 0);
+
+        if(mapping_error)
+            return mapping_error;
+    }
+
+    if(rows_to_append.rows() == 0)
+        return mapping_error;
+
+    // An empty matrix takes the columns of the rows to append
+    if(this->size() == 0)
+    {
+        this->get_header()->rows = 0;
+        this->get_header()->columns = rows_to_append.columns();
+
+        if(is_data_layout_stored_)
+            this->get_stored_data_layout_()->row_stride = calculate_matrix_data_layout(this->columns(), sizeof(DataType), data_layout_options_).row_stride;
+    }
+
+    if(this->columns() != rows_to_append.columns())
+    {
+        mapping_error.assign(1,std::iostream_category());
+        return mapping_error;
+    }
+
+    uintptr_t first_new_row = this->rows();
+
+    mapping_error = this->append_rows(rows_to_append.rows());
+
+    if(mapping_error)
+        return mapping_error;
+
+    for(int64_t i = 0; i < rows_to_append.rows(); ++i)
+        for(int64_t j = 0; j < rows_to_append.columns(); ++j)
+            (*this)(first_new_row + i, j) = rows_to_append(i,j);
+
+    return mapping_error;
+}
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+// Synchronization across processes
+//-------------------------------------------------------------------
+template<typename DataType>
+
+inline int Matrix<DataType>::lock()
+{
+    // Files in the older format have no shared lock
+    if(!is_data_layout_stored_)
+        return 0;
+
+    return this->get_header()->shared_lock.lock();
+}
+
+
+
+template<typename DataType>
+
+inline void Matrix<DataType>::unlock()
+{
+    if(is_data_layout_stored_)
+        this->get_header()->shared_lock.unlock();
+}
+
+
+
+template<typename DataType>
+
+inline void Matrix<DataType>::begin_write()
+{
+    if(is_data_layout_stored_)
+        this->get_header()->shared_lock.begin_write();
+    else
+        ++local_version_;
+}
+
+
+
+template<typename DataType>
+
+inline void Matrix<DataType>::end_write()
+{
+    if(is_data_layout_stored_)
+        this->get_header()->shared_lock.end_write();
+    else
+        ++local_version_;
+}
+
+
+
+template<typename DataType>
+
+inline uint64_t Matrix<DataType>::get_version()const
+{
+    if(!mapped_file_.is_open())
+        return 0;
+
+    if(!is_data_layout_stored_)
+        return local_version_;
+
+    return this->get_header()->shared_lock.get_version();
+}
+
+
+
+template<typename DataType>
+template<typename Function>
+
+inline uint64_t Matrix<DataType>::read_consistently(Function&& read_function)const
+{
+    if(!is_data_layout_stored_)
+    {
+        read_function();
+        return local_version_;
+    }
+
+    return this->get_header()->shared_lock.read_consistently(std::forward<Function>(read_function));
+}
+
+
+
+template<typename DataType>
+
+inline bool Matrix<DataType>::copy_rows(uintptr_t first_row, uintptr_t number_of_rows, DataType* destination)const
+{
+    bool are_rows_available = false;
+
+    this->read_consistently([&]()
+    {
+        uintptr_t columns = this->columns();
+        uintptr_t row_stride = this->row_stride();
+        uintptr_t end_of_rows = (first_row + number_of_rows) * row_stride;
+
+        are_rows_available = (first_row + number_of_rows <= this->rows()) && (end_of_rows <= this->capacity());
+
+        if(are_rows_available)
+        {
+            // The padding at the end of each row is not copied
+            for(uintptr_t i = 0; i < number_of_rows; ++i)
+            {
+                const DataType* row = this->data() + (first_row + i) * row_stride;
+                std::copy(row, row + columns, destination + i * columns);
+            }
+        }
+    });
+
+    return are_rows_available;
+}
+//-------------------------------------------------------------------
+
+
+
 //-------------------------------------------------------------------
 } // namespace LazyMatrix
 //-------------------------------------------------------------------
@@ -34,8 +34,11 @@
 #include <vector>
 #include <fstream>
 #include <mutex>
+#include <new>
 
 #include "files.hpp"
+#include "robust_mutex.hpp"
+#include "memory_mapping_hints.hpp"
 
 #include "base_matrix3d.hpp"
 #include "shared_references.hpp"
@@ -58,12 +61,18 @@ namespace LazyMatrix
 //-------------------------------------------------------------------
 /**
  * @brief Header and Footer sections for a 3d matrix
+ *
+ * Files in the older format start with the legacy_matrix3d_header_byte_sequence
+ * and store their data right after the LegacyMatrix3DHeader. Files in the
+ * current format start with the matrix3d_header_byte_sequence and add a
+ * process-shared lock (see SharedMemoryLock) before the data.
  */
 //-------------------------------------------------------------------
-const std::string matrix3d_header_byte_sequence = "---begin_3d_---\n";
+const std::string legacy_matrix3d_header_byte_sequence = "---begin_3d_---\n";
+const std::string matrix3d_header_byte_sequence = "--begin_3d_v2--\n";
 const std::string matrix3d_footer_byte_sequence = ":---end_3d_---:\n";
 
-struct Matrix3DHeader
+struct LegacyMatrix3DHeader
 {
     char header[16] = {'-', '-', '-', 'b', 'e', 'g', 'i', 'n', '_', '3', 'd', '_', '-', '-', '-', '\n'};
     uintptr_t size_of_data_type = 8;
@@ -73,6 +82,14 @@ struct Matrix3DHeader
     uintptr_t columns = 0;
 };
 
+static_assert(sizeof(LegacyMatrix3DHeader) == 16 + 4 * sizeof(uintptr_t),
+              "The layout of older 3d matrix files can't change");
+
+struct Matrix3DHeader : public LegacyMatrix3DHeader
+{
+    SharedMemoryLock shared_lock;
+};
+
 struct Matrix3DFooter
 {
     char footer[16] = {':', '-', '-', '-', 'e', 'n', 'd', '_', '3', 'd', '_', '-', '-', '-', ':', '\n'};
@@ -96,14 +113,28 @@ struct Matrix3DFooter
 inline bool does_memory_contain_mapped_matrix3d(const char* memory_mapped_matrix3d,
                                                 uintptr_t memory_size_in_bytes)
 {
-    uintptr_t minimum_size = sizeof(Matrix3DHeader) + sizeof(Matrix3DFooter);
+    if(memory_size_in_bytes < sizeof(LegacyMatrix3DHeader) + sizeof(Matrix3DFooter))
+        return false;
+
+    // The tag tells us whether the file is in the older
+    // format, which has a smaller header with no shared lock
+    uintptr_t size_of_header = 0;
+
+    if(std::equal(matrix3d_header_byte_sequence.cbegin(), matrix3d_header_byte_sequence.cend(), memory_mapped_matrix3d))
+        size_of_header = sizeof(Matrix3DHeader);
+    else if(std::equal(legacy_matrix3d_header_byte_sequence.cbegin(), legacy_matrix3d_header_byte_sequence.cend(), memory_mapped_matrix3d))
+        size_of_header = sizeof(LegacyMatrix3DHeader);
+    else
+        return false;
+
+    uintptr_t minimum_size = size_of_header + sizeof(Matrix3DFooter);
 
     if(memory_size_in_bytes < minimum_size)
         return false;
     
-    const Matrix3DHeader* header = reinterpret_cast<const Matrix3DHeader*>(memory_mapped_matrix3d);
+    const LegacyMatrix3DHeader* header = reinterpret_cast<const LegacyMatrix3DHeader*>(memory_mapped_matrix3d);
 
-    uintptr_t expected_size = minimum_size + header->size_of_data_type * header->rows * header->columns;
+    uintptr_t expected_size = minimum_size + header->size_of_data_type * header->pages * header->rows * header->columns;
 
     return memory_size_in_bytes >= expected_size;
 }
@@ -202,6 +233,44 @@ public:
      */
     std::size_t get_mapped_file_size()const;
 
+    /**
+     * @brief Get a pointer to the contiguous 3d matrix data inside the
+     *        memory mapped file (pages one after the other, each page
+     *        stored row-major), nullptr if no file is mapped.
+     */
+    const DataType* data()const;
+
+    /**
+     * @brief Get a pointer to the contiguous 3d matrix data inside the
+     *        memory mapped file (pages one after the other, each page
+     *        stored row-major), nullptr if no file is mapped.
+     */
+    DataType* data();
+
+    /**
+     * @brief Get the distance (in entries) between the starts of consecutive rows.
+     */
+    uintptr_t row_stride()const;
+
+    /**
+     * @brief Get the distance (in entries) between the starts of consecutive pages.
+     */
+    uintptr_t page_stride()const;
+
+    /**
+     * @brief Set the hints applied to the memory mapped file, now and
+     *        every time the file is mapped again (for example when it grows).
+     * @param hints Access pattern, prefaulting and huge pages.
+     * @return std::error_code Error returned by the operating system while
+     *         applying the hints (the hints are kept anyway).
+     */
+    std::error_code set_memory_mapping_hints(const MemoryMappingHints& hints);
+
+    /**
+     * @brief Get the hints applied to the memory mapped file.
+     */
+    const MemoryMappingHints& get_memory_mapping_hints()const;
+
     /**
      * @brief Get the filename of the memory mapped file containing this 3d matrix.
      */
@@ -254,6 +323,47 @@ public:
      */
     std::error_code load_matrix(const std::string& file_to_load_matrix_from);
 
+    /**
+     * @brief Locks the process-shared mutex in the 3d matrix header.
+     *
+     * Works like Matrix::lock, writers wrap their changes between
+     * begin_write and end_write so readers can use read_consistently.
+     * Files in the older format have no shared lock, so for them
+     * locking does nothing and the version is only seen by this object.
+     *
+     * @return int Returns 0 on success, EOWNERDEAD if the previous owner
+     *         died, or an error code on failure.
+     */
+    int lock();
+
+    /**
+     * @brief Unlocks the process-shared mutex in the 3d matrix header.
+     */
+    void unlock();
+
+    /**
+     * @brief Marks the start of a change to the 3d matrix (the lock must be held).
+     */
+    void begin_write();
+
+    /**
+     * @brief Marks the end of a change to the 3d matrix (the lock must be held).
+     */
+    void end_write();
+
+    /**
+     * @brief Get the version of the 3d matrix, which changes with every write.
+     */
+    uint64_t get_version()const;
+
+    /**
+     * @brief Calls read_function until it read the 3d matrix without a
+     *        write happening at the same time (see SharedMemoryLock).
+     * @return The version of the data that was read.
+     */
+    template<typename Function>
+    uint64_t read_consistently(Function&& read_function)const;
+
     // Functions used to handle page, row and column header names
     std::string get_page_header(int64_t page_index) const { return this->headers_.get_page_header(page_index); }
     std::string get_row_header(int64_t row_index) const { return this->headers_.get_row_header(row_index); }
@@ -266,6 +376,17 @@ public:
 
 private: // Private functions
 
+    /**
+     * @brief Applies the memory mapping hints to the current mapping.
+     */
+    std::error_code apply_memory_mapping_hints_();
+
+    /**
+     * @brief Reads from the tag of the mapped file whether it is in the
+     *        older format, which has no shared lock in its header.
+     */
+    void update_data_offset_();
+
     /**
      * @brief Resize the current 3d matrix to user specified size.
      * 
@@ -334,6 +455,11 @@ private: // Private variables
     
     mio::shared_mmap_sink mapped_file_;             ///< The memory mapped file containing the 3d matrix object.
     fs::path filename_of_memory_mapped_file_;       ///< The filename of the memory mapped file.
+    MemoryMappingHints memory_mapping_hints_;       ///< Hints applied every time the file is mapped.
+
+    uintptr_t data_offset_ = sizeof(Matrix3DHeader);///< Offset of the data from the start of the mapped file.
+    bool is_shared_lock_stored_ = true;             ///< Files in the older format have no shared lock.
+    uint64_t local_version_ = 0;                    ///< Version of files in the older format, only seen by this object.
 };
 //-------------------------------------------------------------------
 
@@ -351,6 +477,18 @@ struct is_type_a_matrix3d< Matrix3D<DataType> > : std::true_type
 
 
 
+//-------------------------------------------------------------------
+// Matrix3D stores its elements contiguously in the memory mapped file
+//-------------------------------------------------------------------
+template<typename DataType>
+
+struct has_contiguous_storage< Matrix3D<DataType> > : std::true_type
+{
+};
+//-------------------------------------------------------------------
+
+
+
 //-------------------------------------------------------------------
 // Function definitions
 //-------------------------------------------------------------------
@@ -374,9 +512,16 @@ template<typename DataType>
 inline Matrix3D<DataType>::Matrix3D(const Matrix3D<DataType>& matrix)
 {
     filename_of_memory_mapped_file_ = matrix.get_filename_of_memory_mapped_file();
+    memory_mapping_hints_ = matrix.get_memory_mapping_hints();
 
     std::error_code mapping_error;
     mapped_file_.map(filename_of_memory_mapped_file_, mapping_error);
+
+    if(!mapping_error)
+    {
+        this->update_data_offset_();
+        this->apply_memory_mapping_hints_();
+    }
 }
 //-------------------------------------------------------------------
 
@@ -423,9 +568,16 @@ template<typename DataType>
 inline Matrix3D<DataType>& Matrix3D<DataType>::operator=(const Matrix3D<DataType>& matrix)
 {
     filename_of_memory_mapped_file_ = matrix.get_filename_of_memory_mapped_file();
+    memory_mapping_hints_ = matrix.get_memory_mapping_hints();
 
     std::error_code mapping_error;
     mapped_file_.map(filename_of_memory_mapped_file_.string(), mapping_error);
+
+    if(!mapping_error)
+    {
+        this->update_data_offset_();
+        this->apply_memory_mapping_hints_();
+    }
     
     return (*this);
 }
@@ -508,7 +660,7 @@ template<typename DataType>
 
 inline uintptr_t Matrix3D<DataType>::capacity()const
 {
-    return (get_mapped_file_size() - sizeof(Matrix3DHeader) + sizeof(Matrix3DFooter)) / sizeof(DataType);
+    return (get_mapped_file_size() - data_offset_ - sizeof(Matrix3DFooter)) / sizeof(DataType);
 }
 //-------------------------------------------------------------------
 
@@ -525,6 +677,139 @@ inline std::size_t Matrix3D<DataType>::get_mapped_file_size()const
 
 
 
+//-------------------------------------------------------------------
+// Memory mapping hints
+//-------------------------------------------------------------------
+template<typename DataType>
+
+inline std::error_code Matrix3D<DataType>::set_memory_mapping_hints(const MemoryMappingHints& hints)
+{
+    memory_mapping_hints_ = hints;
+
+    return this->apply_memory_mapping_hints_();
+}
+
+
+
+template<typename DataType>
+
+inline const MemoryMappingHints& Matrix3D<DataType>::get_memory_mapping_hints()const
+{
+    return memory_mapping_hints_;
+}
+
+
+
+template<typename DataType>
+
+inline std::error_code Matrix3D<DataType>::apply_memory_mapping_hints_()
+{
+    if(!mapped_file_.is_open())
+        return std::error_code();
+
+    return apply_memory_mapping_hints(mapped_file_.begin(), mapped_file_.size(), memory_mapping_hints_);
+}
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+template<typename DataType>
+
+inline void Matrix3D<DataType>::update_data_offset_()
+{
+    is_shared_lock_stored_ = std::equal(matrix3d_header_byte_sequence.cbegin(),
+                                        matrix3d_header_byte_sequence.cend(),
+                                        mapped_file_.cbegin());
+
+    data_offset_ = is_shared_lock_stored_ ? sizeof(Matrix3DHeader) : sizeof(LegacyMatrix3DHeader);
+}
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+// Synchronization across processes
+//-------------------------------------------------------------------
+template<typename DataType>
+
+inline int Matrix3D<DataType>::lock()
+{
+    // Files in the older format have no shared lock
+    if(!is_shared_lock_stored_)
+        return 0;
+
+    return this->get_header()->shared_lock.lock();
+}
+
+
+
+template<typename DataType>
+
+inline void Matrix3D<DataType>::unlock()
+{
+    if(is_shared_lock_stored_)
+        this->get_header()->shared_lock.unlock();
+}
+
+
+
+template<typename DataType>
+
+inline void Matrix3D<DataType>::begin_write()
+{
+    if(is_shared_lock_stored_)
+        this->get_header()->shared_lock.begin_write();
+    else
+        ++local_version_;
+}
+
+
+
+template<typename DataType>
+
+inline void Matrix3D<DataType>::end_write()
+{
+    if(is_shared_lock_stored_)
+        this->get_header()->shared_lock.end_write();
+    else
+        ++local_version_;
+}
+
+
+
+template<typename DataType>
+
+inline uint64_t Matrix3D<DataType>::get_version()const
+{
+    if(!mapped_file_.is_open())
+        return 0;
+
+    if(!is_shared_lock_stored_)
+        return local_version_;
+
+    return this->get_header()->shared_lock.get_version();
+}
+
+
+
+template<typename DataType>
+template<typename Function>
+
+inline uint64_t Matrix3D<DataType>::read_consistently(Function&& read_function)const
+{
+    if(!is_shared_lock_stored_)
+    {
+        read_function();
+        return local_version_;
+    }
+
+    return this->get_header()->shared_lock.read_consistently(std::forward<Function>(read_function));
+}
+//-------------------------------------------------------------------
+
+
+
 //-------------------------------------------------------------------
 template<typename DataType>
 
@@ -575,7 +860,7 @@ template<typename DataType>
 
 inline DataType Matrix3D<DataType>::const_at_(int64_t page, int64_t row, int64_t column)const
 {
-    return reinterpret_cast<const DataType*>(mapped_file_.cbegin() + sizeof(Matrix3DHeader))[page*rows()*columns() + row*columns() + column];
+    return reinterpret_cast<const DataType*>(mapped_file_.cbegin() + data_offset_)[page*rows()*columns() + row*columns() + column];
 }
 //-------------------------------------------------------------------
 
@@ -586,7 +871,53 @@ template<typename DataType>
 
 inline DataType& Matrix3D<DataType>::non_const_at_(int64_t page, int64_t row, int64_t column)
 {
-    return reinterpret_cast<DataType*>(mapped_file_.begin() + sizeof(Matrix3DHeader))[page*rows()*columns() + row*columns() + column];
+    return reinterpret_cast<DataType*>(mapped_file_.begin() + data_offset_)[page*rows()*columns() + row*columns() + column];
+}
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+// Raw access to the 3d matrix data
+//-------------------------------------------------------------------
+template<typename DataType>
+
+inline const DataType* Matrix3D<DataType>::data()const
+{
+    if(!mapped_file_.is_open())
+        return nullptr;
+
+    return reinterpret_cast<const DataType*>(mapped_file_.cbegin() + data_offset_);
+}
+
+
+
+template<typename DataType>
+
+inline DataType* Matrix3D<DataType>::data()
+{
+    if(!mapped_file_.is_open())
+        return nullptr;
+
+    return reinterpret_cast<DataType*>(mapped_file_.begin() + data_offset_);
+}
+
+
+
+template<typename DataType>
+
+inline uintptr_t Matrix3D<DataType>::row_stride()const
+{
+    return this->columns();
+}
+
+
+
+template<typename DataType>
+
+inline uintptr_t Matrix3D<DataType>::page_stride()const
+{
+    return this->rows() * this->columns();
 }
 //-------------------------------------------------------------------
 
@@ -619,7 +950,7 @@ template<typename DataType>
 
 inline const Matrix3DFooter* Matrix3D<DataType>::get_footer()const
 {
-    return reinterpret_cast<const Matrix3DFooter*>(mapped_file_.cbegin() + sizeof(Matrix3DHeader) + this->size()*sizeof(DataType));
+    return reinterpret_cast<const Matrix3DFooter*>(mapped_file_.cbegin() + data_offset_ + this->size()*sizeof(DataType));
 }
 //-------------------------------------------------------------------
 
@@ -630,7 +961,7 @@ template<typename DataType>
 
 inline Matrix3DFooter* Matrix3D<DataType>::get_footer()
 {
-    return reinterpret_cast<Matrix3DFooter*>(mapped_file_.begin() + sizeof(Matrix3DHeader) + this->size()*sizeof(DataType));
+    return reinterpret_cast<Matrix3DFooter*>(mapped_file_.begin() + data_offset_ + this->size()*sizeof(DataType));
 }
 //-------------------------------------------------------------------
 
@@ -714,11 +1045,18 @@ Matrix3D<DataType>::create_matrix(uintptr_t pages,
 
     if(mapping_error)
         return mapping_error;
+
+    // Apply the hints before initializing, which touches every page
+    this->apply_memory_mapping_hints_();
     
-    // Write the Matrix Header
+    // Write the Matrix Header, constructing the shared lock in place,
+    // and tag it so it isn't mistaken for a file in the older format
+    new (mapped_file_.begin()) Matrix3DHeader();
     std::copy(matrix3d_header_byte_sequence.cbegin(),
               matrix3d_header_byte_sequence.cend(),
               &this->get_header()->header[0]);
+    is_shared_lock_stored_ = true;
+    data_offset_ = sizeof(Matrix3DHeader);
     this->get_header()->size_of_data_type = sizeof(DataType);
     this->get_header()->pages = pages;
     this->get_header()->rows = rows;
@@ -761,7 +1099,7 @@ inline std::error_code Matrix3D<DataType>::load_matrix(const std::string& file_t
     // We now know the file exists, so we check its size
     // to make sure it is sized correctly to host the
     // matrix it supposedly hosts
-    uintptr_t minimum_file_size_needed_to_hold_a_matrix = sizeof(Matrix3DHeader) + sizeof(Matrix3DFooter);
+    uintptr_t minimum_file_size_needed_to_hold_a_matrix = sizeof(LegacyMatrix3DHeader) + sizeof(Matrix3DFooter);
 
     if(fs::file_size(filename_of_memory_mapped_file_) < minimum_file_size_needed_to_hold_a_matrix)
     {
@@ -789,6 +1127,9 @@ inline std::error_code Matrix3D<DataType>::load_matrix(const std::string& file_t
         return mapping_error;
     }
 
+    this->update_data_offset_();
+    this->apply_memory_mapping_hints_();
+
     // We are done
     return mapping_error;
 }
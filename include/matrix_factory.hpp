@@ -23,8 +23,14 @@
 
 //-------------------------------------------------------------------
 #include <memory>
+#include <thread>
+#include <vector>
+#include <fstream>
+#include <algorithm>
+#include "files.hpp"
 #include "matrix.hpp"
 #include "matrix3d.hpp"
+#include "ring_buffer_matrix.hpp"
 #include "simple_matrix.hpp"
 #include "simple_matrix3d.hpp"
 #include "csv_matrix.hpp"
@@ -42,6 +48,170 @@ namespace LazyMatrix
 
 
 
+//-------------------------------------------------------------------
+/**
+ * @brief Describes the CSV file a Matrix file was converted from.
+ *
+ * It is stored next to the converted Matrix file (same filename with
+ * a ".source" extension appended) and it is used to skip the conversion
+ * when the CSV file has not changed since it was converted.
+ * It also stores the row and column header names of the CSV file
+ * because those are not part of the Matrix file.
+ * The stamp includes the data type and the delimiters used to parse the
+ * CSV file, so changing either of them converts the file again.
+ */
+//-------------------------------------------------------------------
+struct CSVConversionStamp
+{
+    uintmax_t csv_file_size = 0;
+    int64_t csv_last_write_time = 0;
+    uintptr_t size_of_data_type = 0;
+    std::string data_type_tag;
+    bool does_first_row_contain_column_header_names = false;
+    bool does_first_column_contain_row_header_names = false;
+
+    char string_delimiter = 0;
+    char decimal_point_delimiter = 0;
+    std::string row_delimiters;
+    std::string column_delimiters;
+
+    std::vector<std::string> row_headers;
+    std::vector<std::string> column_headers;
+
+    // Two stamps match when they describe the same csv file and settings
+    bool matches(const CSVConversionStamp& other)const
+    {
+        return csv_file_size == other.csv_file_size &&
+               csv_last_write_time == other.csv_last_write_time &&
+               size_of_data_type == other.size_of_data_type &&
+               data_type_tag == other.data_type_tag &&
+               does_first_row_contain_column_header_names == other.does_first_row_contain_column_header_names &&
+               does_first_column_contain_row_header_names == other.does_first_column_contain_row_header_names &&
+               string_delimiter == other.string_delimiter &&
+               decimal_point_delimiter == other.decimal_point_delimiter &&
+               row_delimiters == other.row_delimiters &&
+               column_delimiters == other.column_delimiters;
+    }
+
+    // Tells apart data types of the same size ("f4" for float,
+    // "i4" for int32_t, "u1" for uint8_t, "b1" for bool...)
+    template<typename DataType>
+    static std::string get_data_type_tag()
+    {
+        const char* kind = std::is_same_v<DataType, bool> ? "b" :
+                           std::is_floating_point_v<DataType> ? "f" :
+                           std::is_signed_v<DataType> ? "i" : "u";
+
+        return kind + std::to_string(sizeof(DataType));
+    }
+
+    // Creates the stamp of a csv file (without header names)
+    template<typename DataType>
+    static CSVConversionStamp from_csv_file(const fs::path& csv_filename,
+                                            bool does_first_row_contain_column_header_names,
+                                            bool does_first_column_contain_row_header_names,
+                                            const CSVMatrix<DataType>& csv_format,
+                                            std::error_code& error)
+    {
+        CSVConversionStamp stamp;
+
+        stamp.csv_file_size = fs::file_size(csv_filename, error);
+
+        if(error)
+            return stamp;
+
+        stamp.csv_last_write_time = int64_t(fs::last_write_time(csv_filename, error).time_since_epoch().count());
+        stamp.size_of_data_type = sizeof(DataType);
+        stamp.data_type_tag = get_data_type_tag<DataType>();
+        stamp.does_first_row_contain_column_header_names = does_first_row_contain_column_header_names;
+        stamp.does_first_column_contain_row_header_names = does_first_column_contain_row_header_names;
+        stamp.string_delimiter = csv_format.get_string_delimiter();
+        stamp.decimal_point_delimiter = csv_format.get_decimal_point_delimiter();
+        stamp.row_delimiters = csv_format.get_row_delimiters();
+        stamp.column_delimiters = csv_format.get_column_delimiters();
+
+        return stamp;
+    }
+
+    // Delimiters and header names are written with their length
+    // first so that they can contain any character (delimiters
+    // usually are whitespace)
+    std::error_code save(const fs::path& stamp_filename)const
+    {
+        std::ofstream file(stamp_filename, std::ios::binary | std::ios::trunc);
+
+        if(!file)
+            return std::make_error_code(std::errc::io_error);
+
+        file << csv_file_size << " " << csv_last_write_time << " " << size_of_data_type << " " << data_type_tag << " "
+             << does_first_row_contain_column_header_names << " " << does_first_column_contain_row_header_names << " "
+             << int(string_delimiter) << " " << int(decimal_point_delimiter) << "\n";
+
+        for(const auto* delimiters : {&row_delimiters, &column_delimiters})
+            file << delimiters->size() << " " << *delimiters << "\n";
+
+        for(const auto* headers : {&row_headers, &column_headers})
+        {
+            file << headers->size() << "\n";
+
+            for(const auto& header : *headers)
+                file << header.size() << " " << header << "\n";
+        }
+
+        return file ? std::error_code() : std::make_error_code(std::errc::io_error);
+    }
+
+    std::error_code load(const fs::path& stamp_filename)
+    {
+        std::ifstream file(stamp_filename, std::ios::binary);
+
+        int string_delimiter_code = 0;
+        int decimal_point_delimiter_code = 0;
+
+        file >> csv_file_size >> csv_last_write_time >> size_of_data_type >> data_type_tag
+             >> does_first_row_contain_column_header_names >> does_first_column_contain_row_header_names
+             >> string_delimiter_code >> decimal_point_delimiter_code;
+
+        string_delimiter = char(string_delimiter_code);
+        decimal_point_delimiter = char(decimal_point_delimiter_code);
+
+        for(auto* delimiters : {&row_delimiters, &column_delimiters})
+        {
+            uintptr_t delimiters_size = 0;
+            file >> delimiters_size;
+            file.get();
+
+            delimiters->assign(delimiters_size, ' ');
+            file.read(delimiters->data(), delimiters_size);
+        }
+
+        for(auto* headers : {&row_headers, &column_headers})
+        {
+            uintptr_t number_of_headers = 0;
+            file >> number_of_headers;
+
+            headers->clear();
+
+            for(uintptr_t i = 0; i < number_of_headers && file; ++i)
+            {
+                uintptr_t header_size = 0;
+                file >> header_size;
+                file.get();
+
+                std::string header(header_size, ' ');
+                file.read(header.data(), header_size);
+
+                headers->push_back(std::move(header));
+            }
+        }
+
+        return file ? std::error_code() : std::make_error_code(std::errc::io_error);
+    }
+};
+//-------------------------------------------------------------------
+
+
+
 //-------------------------------------------------------------------
 /**
  * @brief Factory class used to create a SharedMatrixRef reference of
@@ -70,6 +240,21 @@ public:
         return SharedMatrixRef<Matrix<DataType>>(matrix_ptr);
     }
 
+    /**
+     * @brief Create a RingBufferMatrix object
+     * 
+     * @tparam DataType 
+     * @tparam Args 
+     * @param args 
+     * @return ConstSharedMatrixRef<RingBufferMatrix<DataType>> 
+     */
+    template<typename DataType, typename... Args>
+    static ConstSharedMatrixRef<RingBufferMatrix<DataType>> create_ring_buffer_matrix(Args&&... args)
+    {
+        auto matrix_ptr = std::make_shared<RingBufferMatrix<DataType>>(std::forward<Args>(args)...);
+        return ConstSharedMatrixRef<RingBufferMatrix<DataType>>(matrix_ptr);
+    }
+
     /**
      * @brief Create a CSVMatrix object
      * 
@@ -85,6 +270,159 @@ public:
         return ConstSharedMatrixRef<CSVMatrix<DataType>>(matrix_ptr);
     }
 
+    /**
+     * @brief Create a Matrix object holding the numeric contents of a CSV file
+     * 
+     * The CSV file is parsed once with a multithreaded pass (each thread converts
+     * a block of rows) and stored into a memory mapped Matrix file. The header names
+     * of the CSV file are copied to the returned Matrix. When the Matrix file already
+     * exists and the CSV file size and last write time have not changed since it was
+     * converted, the conversion is skipped and the existing Matrix file is just mapped.
+     * 
+     * @tparam DataType Numeric type of the entries of the Matrix
+     * @param csv_filename The CSV file to convert
+     * @param does_first_row_contain_column_header_names 
+     * @param does_first_column_contain_row_header_names 
+     * @param matrix_filename Where the converted Matrix file is stored
+     * @param conversion_error Error encountered while converting/mapping, if any
+     * @param number_of_threads Number of threads used to parse the CSV file (0 uses all hardware threads)
+     * @param csv_format CSVMatrix whose delimiters are used to parse the CSV file
+     * @return SharedMatrixRef<Matrix<DataType>> (empty in case of errors)
+     */
+    template<typename DataType>
+    static SharedMatrixRef<Matrix<DataType>> create_matrix_from_csv(const fs::path& csv_filename,
+                                                                    bool does_first_row_contain_column_header_names,
+                                                                    bool does_first_column_contain_row_header_names,
+                                                                    const fs::path& matrix_filename,
+                                                                    std::error_code& conversion_error,
+                                                                    uintptr_t number_of_threads = 0,
+                                                                    const CSVMatrix<DataType>& csv_format = CSVMatrix<DataType>())
+    {
+        static_assert(std::is_arithmetic_v<DataType>, "CSV files can only be converted to numeric matrices");
+
+        conversion_error.clear();
+
+        fs::path stamp_filename = matrix_filename;
+        stamp_filename += ".source";
+
+        CSVConversionStamp stamp = CSVConversionStamp::from_csv_file<DataType>(csv_filename,
+                                                                                does_first_row_contain_column_header_names,
+                                                                                does_first_column_contain_row_header_names,
+                                                                                csv_format,
+                                                                                conversion_error);
+
+        if(conversion_error)
+            return SharedMatrixRef<Matrix<DataType>>();
+
+        auto matrix_ptr = std::make_shared<Matrix<DataType>>();
+
+        // If the csv file did not change since the last conversion
+        // we just map the previously converted matrix
+        CSVConversionStamp previous_stamp;
+
+        if(fs::exists(matrix_filename) && fs::exists(stamp_filename) &&
+           !previous_stamp.load(stamp_filename) && previous_stamp.matches(stamp) &&
+           !matrix_ptr->load_matrix(matrix_filename.string()))
+        {
+            apply_csv_header_names(*matrix_ptr, previous_stamp);
+            return SharedMatrixRef<Matrix<DataType>>(matrix_ptr);
+        }
+
+        // Map the csv file
+        CSVMatrix<DataType> csv(csv_format.get_string_delimiter(),
+                                csv_format.get_row_delimiters(),
+                                csv_format.get_column_delimiters(),
+                                csv_format.get_decimal_point_delimiter());
+
+        if(number_of_threads == 0)
+            number_of_threads = std::max(1u, std::thread::hardware_concurrency());
+
+        csv.set_number_of_loading_threads(number_of_threads);
+
+        conversion_error = csv.load(csv_filename.string(),
+                                    does_first_row_contain_column_header_names,
+                                    does_first_column_contain_row_header_names);
+
+        if(conversion_error)
+            return SharedMatrixRef<Matrix<DataType>>();
+
+        // We convert into a temporary file in the destination
+        // directory and rename it once the conversion is done
+        // so that a failed conversion never leaves a partially
+        // converted matrix behind
+        fs::path directory = matrix_filename.has_parent_path() ? matrix_filename.parent_path() : fs::current_path();
+
+        matrix_ptr->mapped_file_.unmap();
+
+        conversion_error = matrix_ptr->create_matrix(csv.rows(),
+                                                     csv.columns(),
+                                                     static_cast<DataType>(0),
+                                                     matrix_filename.filename().string() + "XXXXXX",
+                                                     directory);
+
+        if(conversion_error)
+            return SharedMatrixRef<Matrix<DataType>>();
+
+        // Each thread converts a contiguous block of rows
+        uintptr_t rows = csv.rows();
+        uintptr_t rows_per_thread = (rows + number_of_threads - 1) / std::max<uintptr_t>(1, number_of_threads);
+
+        auto convert_rows = [&](uintptr_t first_row)
+        {
+            csv.for_each_value_in_rows(first_row, first_row + rows_per_thread,
+                                       [&](uintptr_t row, uintptr_t column, DataType value)
+                                       {
+                                           matrix_ptr->non_const_at_(row, column) = value;
+                                       });
+        };
+
+        std::vector<std::thread> threads;
+
+        for(uintptr_t first_row = rows_per_thread; first_row < rows; first_row += rows_per_thread)
+            threads.emplace_back(convert_rows, first_row);
+
+        convert_rows(0);
+
+        for(auto& thread : threads)
+            thread.join();
+
+        // Store the header names in the stamp
+        if(does_first_column_contain_row_header_names)
+            for(uintptr_t i = 0; i < csv.rows(); ++i)
+                stamp.row_headers.push_back(csv.get_row_header(i));
+
+        if(does_first_row_contain_column_header_names)
+            for(uintptr_t j = 0; j < csv.columns(); ++j)
+                stamp.column_headers.push_back(csv.get_column_header(j));
+
+        // Move the converted matrix into place
+        fs::path converted_filename = matrix_ptr->get_filename_of_memory_mapped_file();
+
+        matrix_ptr->mapped_file_.unmap();
+
+        fs::rename(converted_filename, matrix_filename, conversion_error);
+
+        if(conversion_error)
+        {
+            fs::remove(converted_filename);
+            return SharedMatrixRef<Matrix<DataType>>();
+        }
+
+        conversion_error = stamp.save(stamp_filename);
+
+        if(conversion_error)
+            return SharedMatrixRef<Matrix<DataType>>();
+
+        conversion_error = matrix_ptr->load_matrix(matrix_filename.string());
+
+        if(conversion_error)
+            return SharedMatrixRef<Matrix<DataType>>();
+
+        apply_csv_header_names(*matrix_ptr, stamp);
+
+        return SharedMatrixRef<Matrix<DataType>>(matrix_ptr);
+    }
+
     /**
      * @brief Create an ImageMatrix object
      * 
@@ -158,6 +496,21 @@ public:
         auto matrix3d_ptr = std::make_shared<SimpleMatrix3D<DataType>>(std::forward<Args>(args)...);
         return SharedMatrix3DRef<SimpleMatrix3D<DataType>>(matrix3d_ptr);
     }
+
+
+
+private:
+
+    // Copies the csv header names stored in a conversion stamp
+    template<typename DataType>
+    static void apply_csv_header_names(const Matrix<DataType>& matrix, const CSVConversionStamp& stamp)
+    {
+        for(uintptr_t i = 0; i < stamp.row_headers.size(); ++i)
+            matrix.set_row_header(i, stamp.row_headers[i]);
+
+        for(uintptr_t j = 0; j < stamp.column_headers.size(); ++j)
+            matrix.set_column_header(j, stamp.column_headers[j]);
+    }
 };
 //-------------------------------------------------------------------
 
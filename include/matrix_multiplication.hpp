@@ -7,6 +7,9 @@
  * supporting matrices of different types. The multiplication follows the standard matrix
  * multiplication algorithm with a time complexity of O(n^3). If dimensions are not compatible
  * for multiplication, an empty matrix is returned.
+ * When both matrices store their data contiguously (SimpleMatrix and Matrix) the product
+ * is computed with the cache-blocked kernel in blocked_matrix_multiplication.hpp, lazy
+ * views use the generic element access path.
  *
  * @author Vincenzo Barbato
  * 
@@ -27,6 +30,7 @@
 #include "simple_matrix.hpp"
 #include "matrix_factory.hpp"
 #include "shared_references.hpp"
+#include "blocked_matrix_multiplication.hpp"
 //-------------------------------------------------------------------
 
 
@@ -49,6 +53,10 @@ namespace LazyMatrix
  * different types. The function employs the classical matrix multiplication 
  * algorithm with a time complexity of O(n^3).
  * 
+ * If both matrices have contiguous storage and the same arithmetic value type,
+ * the product runs on the raw data with the blocked (packed, register tiled)
+ * kernel, otherwise each element is accessed through the matrix references.
+ * 
  * @tparam ReferenceType1 Type of the left side matrix.
  * @tparam ReferenceType2 Type of the right side matrix.
  * 
@@ -78,6 +86,27 @@ operator*(const ReferenceType1& m1,
     {
         auto result = MatrixFactory::create_simple_matrix<value_type>(m1.rows(), m2.columns());
 
+        if constexpr (has_contiguous_storage<typename ReferenceType1::matrix_type>{} &&
+                      has_contiguous_storage<typename ReferenceType2::matrix_type>{} &&
+                      std::is_same_v<value_type, typename ReferenceType2::value_type> &&
+                      std::is_arithmetic_v<value_type> &&
+                      !std::is_same_v<value_type, bool>)
+        {
+            // Views (like a reversed ROI) might not be contiguous
+            const value_type* data1 = m1.data();
+            const value_type* data2 = m2.data();
+
+            if(data1 != nullptr && data2 != nullptr)
+            {
+                blocked_matrix_multiply_add(m1.rows(), m2.columns(), m1.columns(),
+                                            data1, m1.row_stride(),
+                                            data2, m2.row_stride(),
+                                            result.get_ptr()->data(), result.get_ptr()->row_stride());
+
+                return result;
+            }
+        }
+
         for(int i = 0; i < result.rows(); ++i)
         {
             for(int j = 0; j < result.columns(); ++j)
@@ -0,0 +1,201 @@
+//-------------------------------------------------------------------
+/**
+ * @file memory_mapping_hints.hpp
+ * @brief Access pattern, prefaulting and huge page hints for memory mapped files.
+ *
+ * Scanning very large memory mapped matrices spends a lot of time in page
+ * faults and TLB misses. This file defines the MemoryMappingHints struct,
+ * which memory mapped matrices apply to their mapping every time they map
+ * their file, telling the operating system how the mapping is going to be
+ * accessed (using madvise on POSIX systems), whether to fault all its pages
+ * in up front and whether to back it with transparent huge pages.
+ *
+ * @author Vincenzo Barbato
+ *
+ * Additional Information:
+ * - GitHub Project: [LazyMatrix](https://github.com/navyenzo/LazyMatrix.git)
+ * - LinkedIn: [Vincenzo Barbato](https://www.linkedin.com/in/vincenzobarbato/)
+ */
+//-------------------------------------------------------------------
+
+
+
+#ifndef INCLUDE_MEMORY_MAPPING_HINTS_HPP_
+#define INCLUDE_MEMORY_MAPPING_HINTS_HPP_
+
+
+
+//-------------------------------------------------------------------
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <system_error>
+
+#ifndef _WIN32
+    #include <sys/mman.h>
+    #include <unistd.h>
+#endif
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+namespace LazyMatrix
+{
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+/**
+ * @brief How a memory mapped file is going to be accessed.
+ *
+ * - normal: No particular pattern (the operating system default).
+ * - sequential: Scanned from beginning to end, pages are read ahead
+ *               aggressively and dropped soon after being used.
+ * - random: Accessed in no particular order, no read ahead.
+ * - will_need: Going to be accessed soon, pages are read ahead now.
+ * - dont_need: Not going to be accessed soon, pages can be dropped
+ *              from memory (modified pages are still written to the file).
+ */
+//-------------------------------------------------------------------
+enum class MemoryAccessPattern
+{
+    normal,
+    sequential,
+    random,
+    will_need,
+    dont_need
+};
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+/**
+ * @brief Hints applied to the mapping of a memory mapped file.
+ */
+//-------------------------------------------------------------------
+struct MemoryMappingHints
+{
+    MemoryAccessPattern access_pattern = MemoryAccessPattern::normal;   ///< Expected access pattern.
+    bool prefault = false;                                              ///< Fault every page in when mapping.
+    bool use_huge_pages = false;                                        ///< Back the mapping with transparent huge pages.
+};
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+/**
+ * @brief Faults every page of a memory region in, so that it's not
+ *        done one page fault at a time while the region is used.
+ *
+ * On Linux 5.14 and later this is a single madvise(MADV_POPULATE_WRITE)
+ * call, which also maps the pages writable. Otherwise one byte of every
+ * page is read.
+ *
+ * @param memory Start of the memory region.
+ * @param size_in_bytes Size of the memory region in bytes.
+ */
+//-------------------------------------------------------------------
+inline void prefault_memory(char* memory, std::size_t size_in_bytes)
+{
+    if(memory == nullptr || size_in_bytes == 0)
+        return;
+
+    #if defined(MADV_POPULATE_WRITE)
+        uintptr_t page_size = static_cast<uintptr_t>(sysconf(_SC_PAGESIZE));
+        uintptr_t page_start = reinterpret_cast<uintptr_t>(memory) & ~(page_size - 1);
+
+        // Not supported by older kernels, in which case we touch the pages
+        if(madvise(reinterpret_cast<void*>(page_start), reinterpret_cast<uintptr_t>(memory) + size_in_bytes - page_start, MADV_POPULATE_WRITE) == 0)
+            return;
+    #endif
+
+    // Small enough to be a page on every platform
+    const std::size_t step = 4096;
+
+    volatile char sink = 0;
+
+    for(std::size_t i = 0; i < size_in_bytes; i += step)
+        sink = sink + memory[i];
+
+    sink = sink + memory[size_in_bytes - 1];
+}
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+/**
+ * @brief Applies memory mapping hints to a memory mapped region.
+ *
+ * On platforms without madvise only the prefault hint is applied.
+ *
+ * @param memory Start of the mapped region.
+ * @param size_in_bytes Size of the mapped region in bytes.
+ * @param hints The hints to apply.
+ * @return std::error_code Error returned by the operating system, for example
+ *         when asking for huge pages on a file system that doesn't support them.
+ */
+//-------------------------------------------------------------------
+inline std::error_code apply_memory_mapping_hints(char* memory,
+                                                  std::size_t size_in_bytes,
+                                                  const MemoryMappingHints& hints)
+{
+    std::error_code error;
+
+    if(memory == nullptr || size_in_bytes == 0)
+        return error;
+
+    #ifndef _WIN32
+        // madvise needs a page aligned address
+        uintptr_t page_size = static_cast<uintptr_t>(sysconf(_SC_PAGESIZE));
+        uintptr_t page_start = reinterpret_cast<uintptr_t>(memory) & ~(page_size - 1);
+
+        void* address = reinterpret_cast<void*>(page_start);
+        std::size_t length = reinterpret_cast<uintptr_t>(memory) + size_in_bytes - page_start;
+
+        // Huge pages first, so that prefaulting already uses them
+        if(hints.use_huge_pages)
+        {
+            #if defined(MADV_HUGEPAGE)
+                if(madvise(address, length, MADV_HUGEPAGE) != 0)
+                    error.assign(errno, std::generic_category());
+            #else
+                error = std::make_error_code(std::errc::not_supported);
+            #endif
+        }
+
+        int advice = MADV_NORMAL;
+
+        switch(hints.access_pattern)
+        {
+            case MemoryAccessPattern::sequential: advice = MADV_SEQUENTIAL; break;
+            case MemoryAccessPattern::random:     advice = MADV_RANDOM;     break;
+            case MemoryAccessPattern::will_need:  advice = MADV_WILLNEED;   break;
+            case MemoryAccessPattern::dont_need:  advice = MADV_DONTNEED;   break;
+            default:                              advice = MADV_NORMAL;     break;
+        }
+
+        if(madvise(address, length, advice) != 0 && !error)
+            error.assign(errno, std::generic_category());
+    #endif
+
+    if(hints.prefault)
+        prefault_memory(memory, size_in_bytes);
+
+    return error;
+}
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+} // namespace LazyMatrix
+//-------------------------------------------------------------------
+
+
+
+#endif  // INCLUDE_MEMORY_MAPPING_HINTS_HPP_
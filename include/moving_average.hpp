@@ -24,8 +24,15 @@
 
 
 //-------------------------------------------------------------------
+#include <cmath>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <type_traits>
+
 #include "base_matrix.hpp"
 #include "shared_references.hpp"
+#include "expression_evaluation.hpp"
 //-------------------------------------------------------------------
 
 
@@ -54,6 +61,129 @@ enum class MovingAverageDirection : int
 
 
 
+//-------------------------------------------------------------------
+/**
+ * @brief MovingAverageEvaluation enum used to choose how the elements
+ *        of a moving average are calculated.
+ *
+ * - Direct: Sums the whole window for every element (no extra memory,
+ *           each element costs as much as the window size).
+ * - PrefixSums: On first access, caches the prefix sums of every row
+ *               (or column) so that each element costs O(1). The cache
+ *               uses one value per element of the input matrix.
+ * - RunningSum: Keeps the sum of the last window that was read, so that
+ *               reading the elements of a row (or column) in order costs
+ *               O(1) per element. Out of order reads sum the whole window.
+ *
+ * Cached sums can only tell that the input changed through its version,
+ * so PrefixSums and RunningSum are only used for inputs with
+ * has_data_version (like Matrix), and are evaluated like Direct otherwise.
+ * Writes to those inputs have to go between begin_write and end_write.
+ */
+//-------------------------------------------------------------------
+enum class MovingAverageEvaluation : int
+{
+    Direct = 0,
+    PrefixSums = 1,
+    RunningSum = 2
+};
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+/**
+ * @brief A sum that keeps track of the rounding error of floating
+ *        point additions (Kahan-Babuska/Neumaier summation), so that
+ *        long prefix sums and running sums don't drift.
+ *
+ * @tparam SumType The type of the sum.
+ */
+//-------------------------------------------------------------------
+template<typename SumType>
+struct CompensatedSum
+{
+    SumType sum = static_cast<SumType>(0);
+    SumType compensation = static_cast<SumType>(0);
+
+    void add(SumType value)
+    {
+        if constexpr(std::is_floating_point<SumType>::value)
+        {
+            SumType new_sum = sum + value;
+
+            if(std::abs(sum) >= std::abs(value))
+                compensation += (sum - new_sum) + value;
+            else
+                compensation += (value - new_sum) + sum;
+
+            sum = new_sum;
+        }
+        else
+        {
+            sum += value;
+        }
+    }
+
+    SumType value()const
+    {
+        return sum + compensation;
+    }
+};
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+/**
+ * @brief The size and version of an input matrix, used by views that
+ *        cache values computed from it to know when to recalculate them.
+ */
+//-------------------------------------------------------------------
+struct MatrixSourceState
+{
+    uintptr_t rows = 0;
+    uintptr_t columns = 0;
+    uint64_t version = 0;
+
+    bool operator==(const MatrixSourceState& other)const
+    {
+        return rows == other.rows && columns == other.columns && version == other.version;
+    }
+
+    bool operator!=(const MatrixSourceState& other)const
+    {
+        return !(*this == other);
+    }
+};
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+/**
+ * @brief Gets the size of a matrix expression and, for matrices with
+ *        has_data_version, its version.
+ */
+//-------------------------------------------------------------------
+template<typename ReferenceType>
+
+inline MatrixSourceState get_matrix_source_state(const ReferenceType& expression)
+{
+    MatrixSourceState state;
+
+    state.rows = expression.rows();
+    state.columns = expression.columns();
+
+    if constexpr(has_data_version<typename ReferenceType::matrix_type>::value)
+        state.version = expression.get_ptr()->get_version();
+
+    return state;
+}
+//-------------------------------------------------------------------
+
+
+
 //-------------------------------------------------------------------
 /**
  * @class SimpleMovingAverageOfRows
@@ -65,30 +195,42 @@ enum class MovingAverageDirection : int
 template<typename ReferenceType,
          std::enable_if_t<is_matrix_reference<ReferenceType>{}>* = nullptr>
 
-class SimpleMovingAverage : public BaseMatrix<SimpleMovingAverage<ReferenceType>,
-                                              has_non_const_access<ReferenceType>::value>
+class SimpleMovingAverage : public BaseMatrix<SimpleMovingAverage<ReferenceType>,false>
 {
 public:
 
     // Type of value that is stored in left side expression
     using value_type = typename ReferenceType::value_type;
 
-    friend class BaseMatrix<SimpleMovingAverage<ReferenceType>,
-                            has_non_const_access<ReferenceType>::value>;
+    // Type used to sum values (integers are summed with 64 bits, floats
+    // and doubles with a wider type, since a window is the difference
+    // of two prefix sums that can be much larger than the window itself)
+    using sum_type = std::conditional_t<std::is_integral<value_type>::value, int64_t,
+                     std::conditional_t<std::is_same<value_type, float>::value, double,
+                     std::conditional_t<std::is_same<value_type, double>::value, long double, value_type>>>;
+
+    friend class BaseMatrix<SimpleMovingAverage<ReferenceType>,false>;
+
+    // Sums are only cached for inputs that tell us when they change
+    static constexpr bool can_cache_sums = has_data_version<typename ReferenceType::matrix_type>::value;
 
     /**
      * @brief Construct a new Simple Moving Average Of Rows< Reference Type> object
      * 
      * @param expression The input matrix expression
      * @param number_of_data_points_to_average The number of data points to average
+     * @param moving_average_direction Whether to average rows or columns
+     * @param evaluation How the elements are calculated
      */
     SimpleMovingAverage(ReferenceType expression,
                         int64_t number_of_data_points_to_average,
-                        MovingAverageDirection moving_average_direction)
+                        MovingAverageDirection moving_average_direction,
+                        MovingAverageEvaluation evaluation = MovingAverageEvaluation::Direct)
     {
         set_expression(expression);
         set_number_of_data_points_to_average(number_of_data_points_to_average);
         set_moving_average_direction(moving_average_direction);
+        set_evaluation(evaluation);
     }
 
     /**
@@ -98,6 +240,7 @@ public:
     void set_expression(ReferenceType expression)
     {
         expression_ = expression;
+        invalidate_cache();
     }
 
     /**
@@ -106,6 +249,7 @@ public:
     void set_number_of_data_points_to_average(int64_t number_of_data_points_to_average)
     {
         number_of_data_points_to_average_ = std::max(int64_t(1), std::abs(number_of_data_points_to_average));
+        invalidate_cache();
     }
 
     /**
@@ -114,6 +258,41 @@ public:
     void set_moving_average_direction(MovingAverageDirection moving_average_direction)
     {
         moving_average_direction_ = moving_average_direction;
+        invalidate_cache();
+    }
+
+    /**
+     * @brief Set how the elements are calculated (see MovingAverageEvaluation).
+     */
+    void set_evaluation(MovingAverageEvaluation evaluation)
+    {
+        evaluation_ = evaluation;
+        invalidate_cache();
+    }
+
+    /**
+     * @brief Get how the elements are calculated (Direct when the input
+     *        has no has_data_version, whatever was set).
+     */
+    MovingAverageEvaluation get_evaluation()const
+    {
+        return can_cache_sums ? evaluation_ : MovingAverageEvaluation::Direct;
+    }
+
+    /**
+     * @brief Drops the cached prefix sums and running sum.
+     *
+     * The cache is dropped automatically when the size or the version of
+     * the input matrix changes. Writes to a Matrix that don't go between
+     * begin_write and end_write don't change its version, call this after them.
+     */
+    void invalidate_cache()const
+    {
+        std::lock_guard<std::mutex> lock(cache_mutex_);
+
+        std::atomic_store(&prefix_sums_, std::shared_ptr<const PrefixSums>());
+        running_line_ = -1;
+        running_position_ = -1;
     }
 
     /**
@@ -132,6 +311,49 @@ public:
         return expression_.columns();
     }
 
+    /**
+     * @brief Evaluates count consecutive elements of a row, starting
+     *        at (row, column).
+     *
+     * Row averages slide one running sum over the block, so the window
+     * is only summed once per block.
+     *
+     * @param row The row of the elements.
+     * @param column The column of the first element.
+     * @param count The number of elements (at most expression_block_size).
+     * @param output Where the elements are written.
+     * @return Pointer to the evaluated elements (always output).
+     */
+    const value_type* evaluate_row_block(int64_t row, int64_t column, uintptr_t count, value_type* output)const
+    {
+        if(this->get_evaluation() == MovingAverageEvaluation::PrefixSums ||
+           moving_average_direction_ == MovingAverageDirection::ColumnAverage)
+        {
+            for(uintptr_t j = 0; j < count; ++j)
+                output[j] = const_at_(row, column + j);
+
+            return output;
+        }
+
+        CompensatedSum<sum_type> window_sum = sum_window_(row, column);
+
+        output[0] = average_(window_sum.value(), column);
+
+        for(uintptr_t j = 1; j < count; ++j)
+        {
+            int64_t position = column + j;
+
+            window_sum.add(static_cast<sum_type>(element_(row, position)));
+
+            if(position >= number_of_data_points_to_average_)
+                window_sum.add(-static_cast<sum_type>(element_(row, position - number_of_data_points_to_average_)));
+
+            output[j] = average_(window_sum.value(), position);
+        }
+
+        return output;
+    }
+
     // Functions used to handle row and column header names
     std::string get_row_header(int64_t row_index) const { return expression_.get_row_header(row_index); }
     std::string get_column_header(int64_t column_index) const { return expression_.get_column_header(column_index); }
@@ -163,36 +385,210 @@ private: // Private functions
      */
     value_type const_at_(int64_t row, int64_t column)const
     {
-        if(moving_average_direction_ == MovingAverageDirection::RowAverage)
+        int64_t line = this->line_of_(row, column);
+        int64_t position = this->position_of_(row, column);
+
+        switch(this->get_evaluation())
         {
-            int64_t first_column = std::max(int64_t(0), column - number_of_data_points_to_average_ + 1);
+            case MovingAverageEvaluation::PrefixSums:
+                return this->prefix_sums_average_(line, position);
+
+            case MovingAverageEvaluation::RunningSum:
+                return this->running_sum_average_(line, position);
+
+            default:
+                return this->average_(this->sum_window_(line, position).value(), position);
+        }
+    }
+
+    /**
+     * @brief The rows (row average) or columns (column average) are
+     *        the "lines" being averaged, the position is the index
+     *        of an element along its line.
+     */
+    int64_t line_of_(int64_t row, int64_t column)const
+    {
+        return moving_average_direction_ == MovingAverageDirection::RowAverage ? row : column;
+    }
+
+    int64_t position_of_(int64_t row, int64_t column)const
+    {
+        return moving_average_direction_ == MovingAverageDirection::RowAverage ? column : row;
+    }
+
+    decltype(auto) element_(int64_t line, int64_t position)const
+    {
+        if(moving_average_direction_ == MovingAverageDirection::RowAverage)
+            return expression_(line, position);
+        else
+            return expression_(position, line);
+    }
+
+    /**
+     * @brief Number of data points in the window ending at position.
+     */
+    int64_t window_size_(int64_t position)const
+    {
+        return std::min(position + 1, number_of_data_points_to_average_);
+    }
+
+    value_type average_(sum_type window_sum, int64_t position)const
+    {
+        return static_cast<value_type>(window_sum / static_cast<sum_type>(this->window_size_(position)));
+    }
+
+    /**
+     * @brief Sums the whole window ending at position.
+     */
+    CompensatedSum<sum_type> sum_window_(int64_t line, int64_t position)const
+    {
+        CompensatedSum<sum_type> window_sum;
+
+        for(int64_t i = position + 1 - this->window_size_(position); i <= position; ++i)
+            window_sum.add(static_cast<sum_type>(this->element_(line, i)));
+
+        return window_sum;
+    }
+
+    /**
+     * @brief Prefix sums of every line of the input matrix, and the
+     *        input matrix they were calculated from.
+     *
+     * Once published they're never changed, readers keep the ones they
+     * loaded alive while the cache is replaced by another thread.
+     */
+    struct PrefixSums
+    {
+        MatrixSourceState source_state;
+        std::vector<sum_type> sums;
+    };
+
+    /**
+     * @brief Index of the prefix sum of the first k elements of a line
+     *        (laid out like the input matrix, so that it's filled row
+     *        by row for both directions).
+     */
+    uintptr_t prefix_sum_index_(int64_t line, int64_t k, uintptr_t columns)const
+    {
+        if(moving_average_direction_ == MovingAverageDirection::RowAverage)
+            return line * (columns + 1) + k;
+        else
+            return k * columns + line;
+    }
+
+    /**
+     * @brief Calculates the prefix sums of every line of the input matrix.
+     */
+    std::shared_ptr<const PrefixSums> calculate_prefix_sums_()const
+    {
+        auto prefix_sums = std::make_shared<PrefixSums>();
+
+        prefix_sums->source_state = get_matrix_source_state(expression_);
 
-            auto avg = expression_(row, first_column);
+        uintptr_t rows = prefix_sums->source_state.rows;
+        uintptr_t columns = prefix_sums->source_state.columns;
 
-            for(int64_t i = first_column + 1; i <= column; ++ i)
+        auto& sums = prefix_sums->sums;
+
+        if(moving_average_direction_ == MovingAverageDirection::RowAverage)
+        {
+            sums.assign(rows * (columns + 1), static_cast<sum_type>(0));
+
+            for(int64_t i = 0; i < rows; ++i)
             {
-                avg += expression_(row, i);
+                CompensatedSum<sum_type> row_sum;
+
+                for(int64_t j = 0; j < columns; ++j)
+                {
+                    row_sum.add(static_cast<sum_type>(expression_(i, j)));
+                    sums[this->prefix_sum_index_(i, j + 1, columns)] = row_sum.value();
+                }
             }
+        }
+        else
+        {
+            sums.assign((rows + 1) * columns, static_cast<sum_type>(0));
 
-            avg /= static_cast<value_type>(column + 1 - first_column);
+            std::vector<CompensatedSum<sum_type>> column_sums(columns);
 
-            return avg;
+            for(int64_t i = 0; i < rows; ++i)
+            {
+                for(int64_t j = 0; j < columns; ++j)
+                {
+                    column_sums[j].add(static_cast<sum_type>(expression_(i, j)));
+                    sums[this->prefix_sum_index_(j, i + 1, columns)] = column_sums[j].value();
+                }
+            }
         }
-        else
+
+        return prefix_sums;
+    }
+
+    /**
+     * @brief Average using the cached prefix sums, which are calculated
+     *        on first access and whenever the input matrix changes.
+     */
+    value_type prefix_sums_average_(int64_t line, int64_t position)const
+    {
+        auto prefix_sums = std::atomic_load(&prefix_sums_);
+
+        if(!prefix_sums || prefix_sums->source_state != get_matrix_source_state(expression_))
         {
-            int64_t first_row = std::max(int64_t(0), row - number_of_data_points_to_average_ + 1);
+            std::lock_guard<std::mutex> lock(cache_mutex_);
 
-            auto avg = expression_(first_row, column);
+            prefix_sums = std::atomic_load(&prefix_sums_);
 
-            for(int64_t i = first_row + 1; i <= row; ++ i)
+            if(!prefix_sums || prefix_sums->source_state != get_matrix_source_state(expression_))
             {
-                avg += expression_(i, column);
+                prefix_sums = this->calculate_prefix_sums_();
+                std::atomic_store(&prefix_sums_, prefix_sums);
             }
+        }
+
+        uintptr_t columns = prefix_sums->source_state.columns;
+        int64_t first_position = position + 1 - this->window_size_(position);
+
+        sum_type window_sum = prefix_sums->sums[this->prefix_sum_index_(line, position + 1, columns)] -
+                              prefix_sums->sums[this->prefix_sum_index_(line, first_position, columns)];
+
+        return this->average_(window_sum, position);
+    }
 
-            avg /= static_cast<value_type>(row + 1 - first_row);
+    /**
+     * @brief Average updating the running sum of the previous read when
+     *        reading the next element of the same line.
+     *
+     * Only one thread at a time uses the running sum, other threads
+     * reading at the same time sum their window directly.
+     */
+    value_type running_sum_average_(int64_t line, int64_t position)const
+    {
+        std::unique_lock<std::mutex> lock(cache_mutex_, std::try_to_lock);
+
+        if(!lock.owns_lock())
+            return this->average_(this->sum_window_(line, position).value(), position);
 
-            return avg;
+        MatrixSourceState source_state = get_matrix_source_state(expression_);
+
+        bool is_running_sum_valid = (line == running_line_ && source_state == running_source_state_);
+
+        if(is_running_sum_valid && position == running_position_ + 1)
+        {
+            running_sum_.add(static_cast<sum_type>(this->element_(line, position)));
+
+            if(position >= number_of_data_points_to_average_)
+                running_sum_.add(-static_cast<sum_type>(this->element_(line, position - number_of_data_points_to_average_)));
+        }
+        else if(!is_running_sum_valid || position != running_position_)
+        {
+            running_sum_ = this->sum_window_(line, position);
         }
+
+        running_line_ = line;
+        running_position_ = position;
+        running_source_state_ = source_state;
+
+        return this->average_(running_sum_.value(), position);
     }
 
 
@@ -202,6 +598,16 @@ private: // Private variables
     ReferenceType expression_;
     int64_t number_of_data_points_to_average_ = 1;
     MovingAverageDirection moving_average_direction_ = MovingAverageDirection::RowAverage;
+    MovingAverageEvaluation evaluation_ = MovingAverageEvaluation::Direct;
+
+    mutable std::mutex cache_mutex_;                                ///< Guards the running sum and prefix sums updates.
+
+    mutable std::shared_ptr<const PrefixSums> prefix_sums_;        ///< Prefix sums, loaded and stored atomically.
+
+    mutable int64_t running_line_ = -1;                             ///< Line of the last running sum read.
+    mutable int64_t running_position_ = -1;                         ///< Position of the last running sum read.
+    mutable MatrixSourceState running_source_state_;                ///< Input matrix of the last running sum read.
+    mutable CompensatedSum<sum_type> running_sum_;                  ///< Sum of the window of the last read.
 };
 //-------------------------------------------------------------------
 
@@ -219,12 +625,27 @@ struct is_type_a_matrix< SimpleMovingAverage<ReferenceType> > : std::true_type
 
 
 
+//-------------------------------------------------------------------
+// Moving averages of rows slide a running sum over each row block
+//-------------------------------------------------------------------
+template<typename ReferenceType>
+
+struct has_block_evaluation< SimpleMovingAverage<ReferenceType> > : std::true_type
+{
+};
+//-------------------------------------------------------------------
+
+
+
 //-------------------------------------------------------------------
 /**
  * @brief Creates a matrix whose elements are the moving average of
  *        either the rows or columns of the input matrix expression.
  * @tparam ReferenceType Type of the input matrix.
  * @param m Shared reference to the input matrix.
+ * @param number_of_data_points_to_average The number of data points to average.
+ * @param moving_average_direction Whether to average rows or columns.
+ * @param evaluation How the elements are calculated (see MovingAverageEvaluation).
  * @return A SharedMatrixRef to the SimpleMovingAverage matrix object.
  */
 //-------------------------------------------------------------------
@@ -235,9 +656,10 @@ inline auto
 
 simple_moving_average(ReferenceType m,
                       int64_t number_of_data_points_to_average,
-                      MovingAverageDirection moving_average_direction)
+                      MovingAverageDirection moving_average_direction,
+                      MovingAverageEvaluation evaluation = MovingAverageEvaluation::Direct)
 {
-    auto view = std::make_shared<SimpleMovingAverage<ReferenceType>>(m, number_of_data_points_to_average, moving_average_direction);
+    auto view = std::make_shared<SimpleMovingAverage<ReferenceType>>(m, number_of_data_points_to_average, moving_average_direction, evaluation);
     return ConstSharedMatrixRef<SimpleMovingAverage<ReferenceType>>(view);
 }
 //-------------------------------------------------------------------
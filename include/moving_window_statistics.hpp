@@ -0,0 +1,839 @@
+//-------------------------------------------------------------------
+/**
+ * @file moving_window_statistics.hpp
+ * @brief Provides moving window statistics of matrix rows or columns.
+ *
+ * This file defines the MovingWindowStatistic view, which computes a
+ * statistic over a sliding window along the rows or columns of a matrix
+ * expression, together with the streaming statistics it can use:
+ * - MovingVariance (Welford's algorithm with removals)
+ * - MovingMin / MovingMax (monotonic deque, O(1) amortized)
+ * - MovingPercentile / MovingMedian (two balanced multisets, O(log n))
+ * - ExponentialMovingAverage
+ *
+ * Each row (or column) is calculated in one streaming pass the first time
+ * one of its elements is read, and is cached until the input changes.
+ *
+ * @author Vincenzo Barbato
+ *
+ * Additional Information:
+ * - GitHub Project: [LazyMatrix](https://github.com/navyenzo/LazyMatrix.git)
+ * - LinkedIn: [Vincenzo Barbato](https://www.linkedin.com/in/vincenzobarbato/)
+ */
+//-------------------------------------------------------------------
+
+
+
+#ifndef INCLUDE_MOVING_WINDOW_STATISTICS_HPP_
+#define INCLUDE_MOVING_WINDOW_STATISTICS_HPP_
+
+
+
+//-------------------------------------------------------------------
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <deque>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <vector>
+#include <type_traits>
+
+#include "base_matrix.hpp"
+#include "shared_references.hpp"
+#include "moving_average.hpp"
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+// Define every thing within the namespace LazyMatrix
+//-------------------------------------------------------------------
+namespace LazyMatrix
+{
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+/**
+ * @brief Variance of a sliding window, updated with Welford's algorithm
+ *        as values enter and leave the window.
+ *
+ * Window statistics are used by MovingWindowStatistic, which calls
+ * reset() at the start of every row (or column) and then next() for
+ * each of its positions in order.
+ *
+ * @tparam DataType The type of the values.
+ */
+//-------------------------------------------------------------------
+template<typename DataType>
+class MovingVarianceStatistic
+{
+public:
+
+    // Integers are averaged with doubles
+    using float_type = std::conditional_t<std::is_floating_point<DataType>::value, DataType, double>;
+
+    /**
+     * @param number_of_data_points The size of the window.
+     * @param is_sample_variance Whether to divide by n - 1 (sample variance)
+     *                           or by n (population variance).
+     */
+    MovingVarianceStatistic(int64_t number_of_data_points, bool is_sample_variance = true)
+    : number_of_data_points_(std::max(int64_t(1), std::abs(number_of_data_points))),
+      is_sample_variance_(is_sample_variance)
+    {
+    }
+
+    void reset()
+    {
+        count_ = 0;
+        mean_ = 0;
+        sum_of_squared_differences_ = 0;
+    }
+
+    DataType next(const DataType* line_values, int64_t position)
+    {
+        this->add_(static_cast<float_type>(line_values[position]));
+
+        if(position >= number_of_data_points_)
+            this->remove_(static_cast<float_type>(line_values[position - number_of_data_points_]));
+
+        int64_t divisor = is_sample_variance_ ? count_ - 1 : count_;
+
+        if(divisor <= 0)
+            return static_cast<DataType>(0);
+
+        return static_cast<DataType>(std::max(float_type(0), sum_of_squared_differences_) / static_cast<float_type>(divisor));
+    }
+
+
+
+private:
+
+    void add_(float_type value)
+    {
+        ++count_;
+        float_type delta = value - mean_;
+        mean_ += delta / static_cast<float_type>(count_);
+        sum_of_squared_differences_ += delta * (value - mean_);
+    }
+
+    void remove_(float_type value)
+    {
+        --count_;
+        float_type delta = value - mean_;
+        mean_ -= delta / static_cast<float_type>(count_);
+        sum_of_squared_differences_ -= delta * (value - mean_);
+    }
+
+    int64_t number_of_data_points_ = 1;
+    bool is_sample_variance_ = true;
+
+    int64_t count_ = 0;
+    float_type mean_ = 0;
+    float_type sum_of_squared_differences_ = 0;
+};
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+/**
+ * @brief Minimum (or maximum) of a sliding window, using a deque of the
+ *        positions of the values that can still become the extremum
+ *        (each position enters and leaves the deque once).
+ *
+ * @tparam DataType The type of the values.
+ * @tparam CompareType std::less for the minimum, std::greater for the maximum.
+ */
+//-------------------------------------------------------------------
+template<typename DataType,
+         typename CompareType>
+
+class MovingExtremumStatistic
+{
+public:
+
+    /**
+     * @param number_of_data_points The size of the window.
+     */
+    MovingExtremumStatistic(int64_t number_of_data_points)
+    : number_of_data_points_(std::max(int64_t(1), std::abs(number_of_data_points)))
+    {
+    }
+
+    void reset()
+    {
+        candidate_positions_.clear();
+    }
+
+    DataType next(const DataType* line_values, int64_t position)
+    {
+        // Values that aren't better than the new one can't be the extremum anymore
+        while(!candidate_positions_.empty() && !compare_(line_values[candidate_positions_.back()], line_values[position]))
+            candidate_positions_.pop_back();
+
+        candidate_positions_.push_back(position);
+
+        if(candidate_positions_.front() <= position - number_of_data_points_)
+            candidate_positions_.pop_front();
+
+        return line_values[candidate_positions_.front()];
+    }
+
+
+
+private:
+
+    int64_t number_of_data_points_ = 1;
+    CompareType compare_;
+    std::deque<int64_t> candidate_positions_;
+};
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+/**
+ * @brief Percentile of a sliding window, keeping the window split in two
+ *        sorted multisets: the values up to the percentile and the values
+ *        above it. Each new value costs O(log n).
+ *
+ * Percentiles between two values are linearly interpolated (like the
+ * default of numpy.percentile), so the 50th percentile is the median.
+ * NaN values can't be sorted, so they're left out of the window (like
+ * numpy.nanpercentile), and a window of only NaN values gives NaN.
+ *
+ * @tparam DataType The type of the values.
+ */
+//-------------------------------------------------------------------
+template<typename DataType>
+class MovingPercentileStatistic
+{
+public:
+
+    /**
+     * @param number_of_data_points The size of the window.
+     * @param percentile The percentile, between 0 and 100.
+     */
+    MovingPercentileStatistic(int64_t number_of_data_points, double percentile = 50)
+    : number_of_data_points_(std::max(int64_t(1), std::abs(number_of_data_points))),
+      percentile_(std::clamp(percentile, 0.0, 100.0))
+    {
+    }
+
+    void reset()
+    {
+        lower_values_.clear();
+        upper_values_.clear();
+    }
+
+    DataType next(const DataType* line_values, int64_t position)
+    {
+        this->insert_(line_values[position]);
+
+        if(position >= number_of_data_points_)
+            this->erase_(line_values[position - number_of_data_points_]);
+
+        // The lower values hold everything up to the rank of the percentile
+        uintptr_t count = lower_values_.size() + upper_values_.size();
+
+        if(count == 0)
+            return std::numeric_limits<DataType>::quiet_NaN();
+
+        double rank = percentile_ / 100.0 * double(count - 1);
+        uintptr_t lower_count = uintptr_t(std::floor(rank)) + 1;
+
+        while(lower_values_.size() > lower_count)
+        {
+            upper_values_.insert(*std::prev(lower_values_.end()));
+            lower_values_.erase(std::prev(lower_values_.end()));
+        }
+
+        while(lower_values_.size() < lower_count)
+        {
+            lower_values_.insert(*upper_values_.begin());
+            upper_values_.erase(upper_values_.begin());
+        }
+
+        DataType value = *std::prev(lower_values_.end());
+        double fraction = rank - std::floor(rank);
+
+        if(fraction > 0 && !upper_values_.empty())
+            return static_cast<DataType>(value + fraction * (*upper_values_.begin() - value));
+
+        return value;
+    }
+
+
+
+private:
+
+    static bool is_nan_(const DataType& value)
+    {
+        if constexpr(std::is_floating_point<DataType>::value)
+            return std::isnan(value);
+        else
+            return false;
+    }
+
+    void insert_(const DataType& value)
+    {
+        if(is_nan_(value))
+            return;
+
+        if(lower_values_.empty() || !(*std::prev(lower_values_.end()) < value))
+            lower_values_.insert(value);
+        else
+            upper_values_.insert(value);
+    }
+
+    void erase_(const DataType& value)
+    {
+        if(is_nan_(value))
+            return;
+
+        if(!lower_values_.empty() && !(*std::prev(lower_values_.end()) < value))
+            lower_values_.erase(lower_values_.find(value));
+        else
+            upper_values_.erase(upper_values_.find(value));
+    }
+
+    int64_t number_of_data_points_ = 1;
+    double percentile_ = 50;
+
+    std::multiset<DataType> lower_values_;
+    std::multiset<DataType> upper_values_;
+};
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+/**
+ * @brief Exponential moving average, y(k) = a * x(k) + (1 - a) * y(k - 1),
+ *        starting from the first value of the row (or column).
+ *
+ * @tparam DataType The type of the values.
+ */
+//-------------------------------------------------------------------
+template<typename DataType>
+class ExponentialMovingAverageStatistic
+{
+public:
+
+    // Integers are averaged with doubles
+    using float_type = std::conditional_t<std::is_floating_point<DataType>::value, DataType, double>;
+
+    /**
+     * @param smoothing_factor The weight of each new value, between 0 and 1
+     *                         (2 / (n + 1) is comparable to an n points
+     *                         simple moving average).
+     */
+    ExponentialMovingAverageStatistic(double smoothing_factor)
+    : smoothing_factor_(static_cast<float_type>(std::clamp(smoothing_factor, 0.0, 1.0)))
+    {
+    }
+
+    void reset()
+    {
+        average_ = 0;
+    }
+
+    DataType next(const DataType* line_values, int64_t position)
+    {
+        if(position == 0)
+            average_ = static_cast<float_type>(line_values[0]);
+        else
+            average_ += smoothing_factor_ * (static_cast<float_type>(line_values[position]) - average_);
+
+        return static_cast<DataType>(average_);
+    }
+
+
+
+private:
+
+    float_type smoothing_factor_ = 1;
+    float_type average_ = 0;
+};
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+/**
+ * @class MovingWindowStatistic
+ * @brief View whose elements are a streaming statistic (see the window
+ *        statistics above) of the rows or columns of a matrix expression.
+ *
+ * For inputs with has_data_version (like Matrix), the first time an element
+ * of a row (or column) is read, the whole row is calculated in one pass and
+ * cached, so reading a matrix costs O(1) per element (O(log n) for
+ * percentiles) regardless of the window size. The cache is dropped when the
+ * size or the version of the input matrix changes, so writes to it have to
+ * go between begin_write and end_write (or be followed by invalidate_cache()).
+ *
+ * Other inputs can't tell us when they change, so nothing is cached and
+ * every element is calculated from the start of its row (or column).
+ *
+ * @tparam ReferenceType The type of the matrix expression.
+ * @tparam WindowStatisticType The statistic calculated on each row (or column).
+ */
+//-------------------------------------------------------------------
+template<typename ReferenceType,
+         typename WindowStatisticType,
+         std::enable_if_t<is_matrix_reference<ReferenceType>{}>* = nullptr>
+
+class MovingWindowStatistic : public BaseMatrix<MovingWindowStatistic<ReferenceType, WindowStatisticType>,false>
+{
+public:
+
+    // Type of value that is stored in left side expression
+    using value_type = typename ReferenceType::value_type;
+
+    friend class BaseMatrix<MovingWindowStatistic<ReferenceType, WindowStatisticType>,false>;
+
+    // Lines are only cached for inputs that tell us when they change
+    static constexpr bool can_cache_lines = has_data_version<typename ReferenceType::matrix_type>::value;
+
+    /**
+     * @brief Construct a new Moving Window Statistic object
+     *
+     * @param expression The input matrix expression
+     * @param statistic The statistic calculated on each row (or column)
+     * @param moving_average_direction Whether to go along rows or columns
+     */
+    MovingWindowStatistic(ReferenceType expression,
+                          const WindowStatisticType& statistic,
+                          MovingAverageDirection moving_average_direction)
+    : statistic_(statistic)
+    {
+        set_expression(expression);
+        set_moving_average_direction(moving_average_direction);
+    }
+
+    /**
+     * @brief Sets the reference to the input matrix expression.
+     */
+    void set_expression(ReferenceType expression)
+    {
+        expression_ = expression;
+        invalidate_cache();
+    }
+
+    /**
+     * @brief Set the direction of the statistic (rows or columns).
+     */
+    void set_moving_average_direction(MovingAverageDirection moving_average_direction)
+    {
+        moving_average_direction_ = moving_average_direction;
+        invalidate_cache();
+    }
+
+    /**
+     * @brief Drops the cached rows (or columns).
+     */
+    void invalidate_cache()const
+    {
+        std::lock_guard<std::mutex> lock(cache_mutex_);
+
+        std::atomic_store(&cache_, std::shared_ptr<LineCache>());
+    }
+
+    /**
+     * @brief Returns the number of rows in the resulting matrix.
+     */
+    uintptr_t rows()const
+    {
+        return expression_.rows();
+    }
+
+    /**
+     * @brief Returns the number of columns in the resulting matrix.
+     */
+    uintptr_t columns()const
+    {
+        return expression_.columns();
+    }
+
+    // Functions used to handle row and column header names
+    std::string get_row_header(int64_t row_index) const { return expression_.get_row_header(row_index); }
+    std::string get_column_header(int64_t column_index) const { return expression_.get_column_header(column_index); }
+    void set_row_header(int64_t row_index, const std::string& row_header) const { expression_.set_row_header(row_index, row_header); }
+    void set_column_header(int64_t column_index, const std::string& column_header) const { expression_.set_column_header(column_index, column_header); }
+
+
+
+private: // Private functions
+
+    /**
+     * @brief Dummy "resize" function needed for the matrix interface, but
+     *        here it doesn't do anything
+     */
+    std::error_code resize_(uintptr_t rows, uintptr_t columns)
+    {
+        return std::error_code();
+    }
+
+    /**
+     * @brief Rows (or columns) calculated so far, and the input matrix
+     *        they were calculated from.
+     *
+     * Its storage is allocated once and never moved, lines are written
+     * under the cache mutex and published through is_line_cached. When
+     * the input matrix changes a new cache replaces it, readers keep the
+     * one they loaded alive until they're done with it.
+     */
+    struct LineCache
+    {
+        MatrixSourceState source_state;
+        uintptr_t line_length = 0;
+        std::unique_ptr<std::atomic<bool>[]> is_line_cached;
+        std::vector<value_type> values;
+    };
+
+    /**
+     * @brief Accesses the element at the specified position.
+     * @param row Row index.
+     * @param column Column index.
+     * @return A copy of the value of the element at the specified position.
+     */
+    value_type const_at_(int64_t row, int64_t column)const
+    {
+        bool is_row_direction = (moving_average_direction_ == MovingAverageDirection::RowAverage);
+
+        int64_t line = is_row_direction ? row : column;
+        int64_t position = is_row_direction ? column : row;
+
+        if constexpr(!can_cache_lines)
+            return this->calculate_element_(line, position);
+
+        auto cache = this->cache_line_(line);
+
+        return cache->values[line * cache->line_length + position];
+    }
+
+    /**
+     * @brief Calculates an element without caching anything, running a
+     *        copy of the statistic from the start of its row (or column).
+     */
+    value_type calculate_element_(int64_t line, int64_t position)const
+    {
+        bool is_row_direction = (moving_average_direction_ == MovingAverageDirection::RowAverage);
+
+        std::vector<value_type> line_values(position + 1);
+
+        for(int64_t i = 0; i <= position; ++i)
+            line_values[i] = is_row_direction ? expression_(line, i) : expression_(i, line);
+
+        WindowStatisticType statistic = statistic_;
+        statistic.reset();
+
+        value_type value = value_type();
+
+        for(int64_t i = 0; i <= position; ++i)
+            value = statistic.next(line_values.data(), i);
+
+        return value;
+    }
+
+    /**
+     * @brief Calculates a row (or column) if it isn't cached yet.
+     * @return The cache holding the row (or column).
+     */
+    std::shared_ptr<const LineCache> cache_line_(int64_t line)const
+    {
+        auto cache = std::atomic_load(&cache_);
+
+        if(cache &&
+           cache->source_state == get_matrix_source_state(expression_) &&
+           cache->is_line_cached[line].load(std::memory_order_acquire))
+        {
+            return cache;
+        }
+
+        std::lock_guard<std::mutex> lock(cache_mutex_);
+
+        bool is_row_direction = (moving_average_direction_ == MovingAverageDirection::RowAverage);
+
+        cache = std::atomic_load(&cache_);
+
+        if(!cache || cache->source_state != get_matrix_source_state(expression_))
+        {
+            cache = std::make_shared<LineCache>();
+
+            cache->source_state = get_matrix_source_state(expression_);
+            cache->line_length = is_row_direction ? cache->source_state.columns : cache->source_state.rows;
+
+            uintptr_t number_of_lines = is_row_direction ? cache->source_state.rows : cache->source_state.columns;
+
+            cache->values.assign(cache->source_state.rows * cache->source_state.columns, value_type());
+            cache->is_line_cached.reset(new std::atomic<bool>[number_of_lines]);
+
+            for(uintptr_t i = 0; i < number_of_lines; ++i)
+                cache->is_line_cached[i].store(false, std::memory_order_relaxed);
+
+            std::atomic_store(&cache_, cache);
+        }
+
+        if(cache->is_line_cached[line].load(std::memory_order_relaxed))
+            return cache;
+
+        uintptr_t line_length = cache->line_length;
+
+        line_values_.resize(line_length);
+
+        for(int64_t i = 0; i < line_length; ++i)
+            line_values_[i] = is_row_direction ? expression_(line, i) : expression_(i, line);
+
+        value_type* output = cache->values.data() + line * line_length;
+
+        statistic_.reset();
+
+        for(int64_t i = 0; i < line_length; ++i)
+            output[i] = statistic_.next(line_values_.data(), i);
+
+        cache->is_line_cached[line].store(true, std::memory_order_release);
+
+        return cache;
+    }
+
+
+
+private: // Private variables
+
+    ReferenceType expression_;
+    MovingAverageDirection moving_average_direction_ = MovingAverageDirection::RowAverage;
+
+    mutable std::mutex cache_mutex_;                                ///< Guards the cache updates.
+    mutable WindowStatisticType statistic_;                         ///< Statistic used to calculate rows (or columns).
+
+    mutable std::shared_ptr<LineCache> cache_;                      ///< Calculated rows (or columns), loaded and stored atomically.
+    mutable std::vector<value_type> line_values_;                   ///< Input values of the row (or column) being calculated.
+};
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+// Compile time functions to check if the type is an expression type
+//-------------------------------------------------------------------
+template<typename ReferenceType,
+         typename WindowStatisticType>
+
+struct is_type_a_matrix< MovingWindowStatistic<ReferenceType, WindowStatisticType> > : std::true_type
+{
+};
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+// Names of the moving window statistic views
+//-------------------------------------------------------------------
+template<typename ReferenceType>
+using MovingVariance = MovingWindowStatistic<ReferenceType, MovingVarianceStatistic<typename ReferenceType::value_type>>;
+
+template<typename ReferenceType>
+using MovingMin = MovingWindowStatistic<ReferenceType, MovingExtremumStatistic<typename ReferenceType::value_type, std::less<typename ReferenceType::value_type>>>;
+
+template<typename ReferenceType>
+using MovingMax = MovingWindowStatistic<ReferenceType, MovingExtremumStatistic<typename ReferenceType::value_type, std::greater<typename ReferenceType::value_type>>>;
+
+template<typename ReferenceType>
+using MovingPercentile = MovingWindowStatistic<ReferenceType, MovingPercentileStatistic<typename ReferenceType::value_type>>;
+
+template<typename ReferenceType>
+using ExponentialMovingAverage = MovingWindowStatistic<ReferenceType, ExponentialMovingAverageStatistic<typename ReferenceType::value_type>>;
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+/**
+ * @brief Creates a matrix whose elements are the moving variance of
+ *        either the rows or columns of the input matrix expression.
+ * @tparam ReferenceType Type of the input matrix.
+ * @param m Shared reference to the input matrix.
+ * @param number_of_data_points The size of the window.
+ * @param moving_average_direction Whether to go along rows or columns.
+ * @param is_sample_variance Whether to divide by n - 1 or by n.
+ * @return A SharedMatrixRef to the MovingVariance matrix object.
+ */
+//-------------------------------------------------------------------
+template<typename ReferenceType,
+         std::enable_if_t<is_matrix_reference<ReferenceType>{}>* = nullptr>
+
+inline auto
+
+moving_variance(ReferenceType m,
+                int64_t number_of_data_points,
+                MovingAverageDirection moving_average_direction,
+                bool is_sample_variance = true)
+{
+    using statistic_type = MovingVarianceStatistic<typename ReferenceType::value_type>;
+
+    auto view = std::make_shared<MovingVariance<ReferenceType>>(m, statistic_type(number_of_data_points, is_sample_variance), moving_average_direction);
+    return ConstSharedMatrixRef<MovingVariance<ReferenceType>>(view);
+}
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+/**
+ * @brief Creates a matrix whose elements are the moving minimum of
+ *        either the rows or columns of the input matrix expression.
+ * @tparam ReferenceType Type of the input matrix.
+ * @param m Shared reference to the input matrix.
+ * @param number_of_data_points The size of the window.
+ * @param moving_average_direction Whether to go along rows or columns.
+ * @return A SharedMatrixRef to the MovingMin matrix object.
+ */
+//-------------------------------------------------------------------
+template<typename ReferenceType,
+         std::enable_if_t<is_matrix_reference<ReferenceType>{}>* = nullptr>
+
+inline auto
+
+moving_min(ReferenceType m,
+           int64_t number_of_data_points,
+           MovingAverageDirection moving_average_direction)
+{
+    using statistic_type = MovingExtremumStatistic<typename ReferenceType::value_type, std::less<typename ReferenceType::value_type>>;
+
+    auto view = std::make_shared<MovingMin<ReferenceType>>(m, statistic_type(number_of_data_points), moving_average_direction);
+    return ConstSharedMatrixRef<MovingMin<ReferenceType>>(view);
+}
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+/**
+ * @brief Creates a matrix whose elements are the moving maximum of
+ *        either the rows or columns of the input matrix expression.
+ * @tparam ReferenceType Type of the input matrix.
+ * @param m Shared reference to the input matrix.
+ * @param number_of_data_points The size of the window.
+ * @param moving_average_direction Whether to go along rows or columns.
+ * @return A SharedMatrixRef to the MovingMax matrix object.
+ */
+//-------------------------------------------------------------------
+template<typename ReferenceType,
+         std::enable_if_t<is_matrix_reference<ReferenceType>{}>* = nullptr>
+
+inline auto
+
+moving_max(ReferenceType m,
+           int64_t number_of_data_points,
+           MovingAverageDirection moving_average_direction)
+{
+    using statistic_type = MovingExtremumStatistic<typename ReferenceType::value_type, std::greater<typename ReferenceType::value_type>>;
+
+    auto view = std::make_shared<MovingMax<ReferenceType>>(m, statistic_type(number_of_data_points), moving_average_direction);
+    return ConstSharedMatrixRef<MovingMax<ReferenceType>>(view);
+}
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+/**
+ * @brief Creates a matrix whose elements are a moving percentile of
+ *        either the rows or columns of the input matrix expression.
+ * @tparam ReferenceType Type of the input matrix.
+ * @param m Shared reference to the input matrix.
+ * @param number_of_data_points The size of the window.
+ * @param percentile The percentile, between 0 and 100.
+ * @param moving_average_direction Whether to go along rows or columns.
+ * @return A SharedMatrixRef to the MovingPercentile matrix object.
+ */
+//-------------------------------------------------------------------
+template<typename ReferenceType,
+         std::enable_if_t<is_matrix_reference<ReferenceType>{}>* = nullptr>
+
+inline auto
+
+moving_percentile(ReferenceType m,
+                  int64_t number_of_data_points,
+                  double percentile,
+                  MovingAverageDirection moving_average_direction)
+{
+    using statistic_type = MovingPercentileStatistic<typename ReferenceType::value_type>;
+
+    auto view = std::make_shared<MovingPercentile<ReferenceType>>(m, statistic_type(number_of_data_points, percentile), moving_average_direction);
+    return ConstSharedMatrixRef<MovingPercentile<ReferenceType>>(view);
+}
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+/**
+ * @brief Creates a matrix whose elements are the moving median of
+ *        either the rows or columns of the input matrix expression.
+ * @tparam ReferenceType Type of the input matrix.
+ * @param m Shared reference to the input matrix.
+ * @param number_of_data_points The size of the window.
+ * @param moving_average_direction Whether to go along rows or columns.
+ * @return A SharedMatrixRef to the MovingPercentile matrix object.
+ */
+//-------------------------------------------------------------------
+template<typename ReferenceType,
+         std::enable_if_t<is_matrix_reference<ReferenceType>{}>* = nullptr>
+
+inline auto
+
+moving_median(ReferenceType m,
+              int64_t number_of_data_points,
+              MovingAverageDirection moving_average_direction)
+{
+    return moving_percentile(m, number_of_data_points, 50.0, moving_average_direction);
+}
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+/**
+ * @brief Creates a matrix whose elements are the exponential moving
+ *        average of either the rows or columns of the input matrix expression.
+ * @tparam ReferenceType Type of the input matrix.
+ * @param m Shared reference to the input matrix.
+ * @param smoothing_factor The weight of each new value, between 0 and 1.
+ * @param moving_average_direction Whether to go along rows or columns.
+ * @return A SharedMatrixRef to the ExponentialMovingAverage matrix object.
+ */
+//-------------------------------------------------------------------
+template<typename ReferenceType,
+         std::enable_if_t<is_matrix_reference<ReferenceType>{}>* = nullptr>
+
+inline auto
+
+exponential_moving_average(ReferenceType m,
+                           double smoothing_factor,
+                           MovingAverageDirection moving_average_direction)
+{
+    using statistic_type = ExponentialMovingAverageStatistic<typename ReferenceType::value_type>;
+
+    auto view = std::make_shared<ExponentialMovingAverage<ReferenceType>>(m, statistic_type(smoothing_factor), moving_average_direction);
+    return ConstSharedMatrixRef<ExponentialMovingAverage<ReferenceType>>(view);
+}
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+} // namespace LazyMatrix
+//-------------------------------------------------------------------
+
+
+
+#endif  // INCLUDE_MOVING_WINDOW_STATISTICS_HPP_
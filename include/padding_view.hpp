@@ -137,6 +137,52 @@ public:
         return padded_columns_;
     }
 
+    /**
+     * @brief Raw access to the padded matrix, when the viewed matrix has
+     *        contiguous storage (see has_contiguous_storage).
+     * @return Pointer to the first element, nullptr if the padding adds
+     *         rows or columns (only views that fit inside the viewed
+     *         matrix are contiguous).
+     */
+    template<typename T = ReferenceType,
+             std::enable_if_t<has_contiguous_storage<typename T::matrix_type>::value>* = nullptr>
+    const value_type* data()const
+    {
+        if(!this->is_inside_expression_())
+            return nullptr;
+
+        return static_cast<const typename T::matrix_type&>(*expression_.get_ptr()).data();
+    }
+
+    /**
+     * @brief Raw access to the padded matrix, when the viewed matrix has
+     *        contiguous storage (see has_contiguous_storage).
+     * @return Pointer to the first element, nullptr if the padding adds
+     *         rows or columns (only views that fit inside the viewed
+     *         matrix are contiguous).
+     */
+    template<typename T = ReferenceType,
+             std::enable_if_t<has_contiguous_storage<typename T::matrix_type>::value &&
+                              has_non_const_access<T>::value>* = nullptr>
+    value_type* data()
+    {
+        if(!this->is_inside_expression_())
+            return nullptr;
+
+        return expression_.get_ptr()->data();
+    }
+
+    /**
+     * @brief Distance (in elements) between the starts of consecutive rows,
+     *        the same as in the viewed matrix.
+     */
+    template<typename T = ReferenceType,
+             std::enable_if_t<has_contiguous_storage<typename T::matrix_type>::value>* = nullptr>
+    uintptr_t row_stride()const
+    {
+        return expression_.get_ptr()->row_stride();
+    }
+
     // Functions used to handle row and column header names
     std::string get_row_header(int64_t row_index) const
     {
@@ -185,6 +231,15 @@ private: // Private functions
     {
         return std::error_code();
     }
+
+    /**
+     * @brief Checks whether the padded matrix fits inside the viewed
+     *        matrix, so that no padding value is ever returned.
+     */
+    bool is_inside_expression_()const
+    {
+        return padded_rows_ <= expression_.rows() && padded_columns_ <= expression_.columns();
+    }
     
     /**
      * @brief Accesses the element at the specified position.
@@ -241,6 +296,19 @@ struct is_type_a_matrix< PaddedMatrixView<ReferenceType> > : std::true_type
 
 
 
+//-------------------------------------------------------------------
+// A padded view that doesn't add padding keeps the storage
+// of the matrix it views
+//-------------------------------------------------------------------
+template<typename ReferenceType>
+
+struct has_contiguous_storage< PaddedMatrixView<ReferenceType> > : has_contiguous_storage<typename ReferenceType::matrix_type>
+{
+};
+//-------------------------------------------------------------------
+
+
+
 //-------------------------------------------------------------------
 /**
  * @brief Creates a padded view of a matrix.
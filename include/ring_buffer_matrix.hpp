@@ -0,0 +1,750 @@
+//-------------------------------------------------------------------
+/**
+ * @file ring_buffer_matrix.hpp
+ * @brief Defines the RingBufferMatrix class, a memory-mapped ring buffer of rows
+ *        with one writer and any number of lock-free readers.
+ *
+ * The RingBufferMatrix class keeps the last "capacity" rows pushed into it inside
+ * a memory mapped file, so that it can be used to stream data (for example sensor
+ * samples) from one process to many others. The head and tail of the ring buffer
+ * live in the file header as atomics, and every row slot has its own sequence number
+ * which the writer publishes with release semantics after the row values are written.
+ * Readers never take a lock: they copy a row and check its sequence number before and
+ * after the copy, retrying if the writer overwrote the row in the meantime. Readers
+ * that want to sleep until new rows arrive use the SharedMemoryEvent in the header.
+ *
+ * @author Vincenzo Barbato
+ *
+ * Additional Information:
+ * - GitHub Project: [LazyMatrix](https://github.com/navyenzo/LazyMatrix.git)
+ * - LinkedIn: [Vincenzo Barbato](https://www.linkedin.com/in/vincenzobarbato/)
+ */
+//-------------------------------------------------------------------
+
+
+
+#ifndef INCLUDE_RING_BUFFER_MATRIX_HPP_
+#define INCLUDE_RING_BUFFER_MATRIX_HPP_
+
+
+
+//-------------------------------------------------------------------
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <algorithm>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+#include "files.hpp"
+#include "robust_mutex.hpp"
+
+#include "base_matrix.hpp"
+#include "shared_references.hpp"
+
+// mio library for cross-platform memory-mapping
+#include <single_include/mio/mio.hpp>
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+// Define every thing within the namespace LazyMatrix
+//-------------------------------------------------------------------
+namespace LazyMatrix
+{
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+const std::string ring_buffer_matrix_header_byte_sequence = "::-ring-begin-:\n";
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+/**
+ * @brief Struct representing the header of a memory-mapped ring buffer matrix.
+ *
+ * The head is the number of rows ever pushed into the ring buffer, while
+ * the tail is the index of the oldest row still in it, so the rows currently
+ * held are the ones with indices in [tail, head). Row indices keep growing,
+ * the slot holding row i is i % capacity.
+ */
+//-------------------------------------------------------------------
+struct RingBufferMatrixHeader
+{
+    char header[16] = {':', ':', '-', 'r', 'i', 'n', 'g', '-', 'b', 'e', 'g', 'i', 'n', '-', ':', '\n'};
+    uintptr_t size_of_data_type = 8;
+    uintptr_t capacity = 0;
+    uintptr_t columns = 0;
+    std::atomic<uint64_t> head{0};
+    std::atomic<uint64_t> tail{0};
+    SharedMemoryEvent new_rows_event;
+};
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+/**
+ * @brief Size in bytes of the memory mapped file holding a ring buffer matrix.
+ *
+ * The header is followed by one sequence number per row slot and then by
+ * the row slots themselves.
+ */
+//-------------------------------------------------------------------
+template<typename DataType>
+
+inline uintptr_t get_ring_buffer_matrix_file_size(uintptr_t capacity, uintptr_t columns)
+{
+    return sizeof(RingBufferMatrixHeader) + capacity * sizeof(std::atomic<uint64_t>) + capacity * columns * sizeof(DataType);
+}
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+/**
+ * @brief Template class for a ring buffer of rows stored in a memory-mapped file.
+ *
+ * A single writer (which can be in any process) pushes rows with push_row,
+ * overwriting the oldest rows once the ring buffer is full. Readers in any
+ * number of processes load the same file and use copy_row or copy_latest_rows
+ * to get consistent copies of rows without ever locking.
+ *
+ * As a matrix expression the ring buffer shows the rows it currently holds,
+ * oldest first. That view reads the mapped memory directly, so it isn't a
+ * consistent snapshot while the writer is pushing rows; use copy_latest_rows
+ * for that.
+ *
+ * @tparam DataType The type of data stored in the ring buffer, it has to be
+ *                  trivially copyable.
+ */
+//-------------------------------------------------------------------
+template<typename DataType>
+class RingBufferMatrix : public BaseMatrix<RingBufferMatrix<DataType>,false>
+{
+public:
+
+    static_assert(std::is_trivially_copyable<DataType>::value, "RingBufferMatrix can only hold trivially copyable types");
+
+    // Type of value that is stored in the matrix
+    using value_type = DataType;
+
+    friend class MatrixFactory;
+
+    friend class BaseMatrix<RingBufferMatrix<DataType>,false>;
+
+    /**
+     * @brief Constructor creating a new ring buffer.
+     * @param capacity Number of rows the ring buffer can hold.
+     * @param columns Number of columns of each row.
+     */
+    RingBufferMatrix(uintptr_t capacity = 0, uintptr_t columns = 0);
+
+    /**
+     * @brief Constructor to memory map an existing ring buffer from a file.
+     * @param file_to_load_ring_buffer_from The file path to load the ring buffer from.
+     */
+    RingBufferMatrix(const std::string& file_to_load_ring_buffer_from);
+
+    /**
+     * @brief Checks whether the memory mapped file actually contains a ring buffer.
+     */
+    bool is_valid()const;
+
+    /**
+     * @brief Get the number of rows currently held by the ring buffer.
+     */
+    uintptr_t rows()const;
+
+    /**
+     * @brief Get the number of columns of each row.
+     */
+    uintptr_t columns()const;
+
+    /**
+     * @brief Get the number of rows the ring buffer can hold.
+     */
+    uintptr_t capacity()const;
+
+    /**
+     * @brief Get the filename of the memory mapped file containing this ring buffer.
+     */
+    const fs::path& get_filename_of_memory_mapped_file()const;
+
+    /**
+     * @brief Create the memory mapped file to hold the ring buffer.
+     *
+     * @param capacity Number of rows the ring buffer can hold.
+     * @param columns Number of columns of each row.
+     * @param filename_template The template used to create a unique filename.
+     * @param directory_where_file_will_reside The directory where the file will be created.
+     * @return std::error_code Error encountered while trying to create the memory mapped file.
+     */
+    std::error_code create_ring_buffer(uintptr_t capacity,
+                                       uintptr_t columns,
+                                       const fs::path& filename_template = "XXXXXX",
+                                       const fs::path& directory_where_file_will_reside = fs::temp_directory_path());
+
+    /**
+     * @brief Memory map an existing ring buffer from a file.
+     * @param file_to_load_ring_buffer_from The file path to load the ring buffer from.
+     * @return std::error_code Error encountered while trying to load the ring buffer.
+     */
+    std::error_code load_ring_buffer(const std::string& file_to_load_ring_buffer_from);
+
+    /**
+     * @brief Pushes a row into the ring buffer, overwriting the oldest row if it's full.
+     *
+     * Only one writer at a time is allowed to push rows. The row is published
+     * to readers (and sleeping readers are woken up) once all its values are
+     * written.
+     *
+     * @param row Pointer to the columns() values of the row.
+     */
+    void push_row(const DataType* row);
+
+    /**
+     * @brief Pushes every row of a matrix expression into the ring buffer.
+     * @return Error if the number of columns doesn't match the ring buffer's.
+     */
+    template<typename ReferenceType, std::enable_if_t<is_matrix_reference<ReferenceType>{}>* = nullptr>
+    std::error_code push_rows(ReferenceType rows_to_push);
+
+    /**
+     * @brief Get the number of rows ever pushed into the ring buffer.
+     */
+    uint64_t get_head()const;
+
+    /**
+     * @brief Get the index of the oldest row still held by the ring buffer.
+     */
+    uint64_t get_tail()const;
+
+    /**
+     * @brief Copies a row without locking.
+     *
+     * @param row_index Index of the row (from 0 for the first row ever pushed).
+     * @param destination Where to copy the columns() values of the row.
+     * @return true If the copy is consistent.
+     * @return false If the row hasn't been pushed yet or was overwritten
+     *               (in which case the destination holds garbage).
+     */
+    bool copy_row(uint64_t row_index, DataType* destination)const;
+
+    /**
+     * @brief Copies the latest rows without locking, oldest first.
+     *
+     * @param number_of_rows Maximum number of rows to copy.
+     * @param destination Where to copy the rows, one after the other.
+     * @return The number of rows copied, less than number_of_rows if the
+     *         ring buffer doesn't hold that many rows.
+     */
+    uint64_t copy_latest_rows(uint64_t number_of_rows, DataType* destination)const;
+
+    /**
+     * @brief Sleeps until rows beyond known_head are pushed or the timeout expires.
+     *
+     * @param known_head The head the caller already consumed up to.
+     * @param timeout Maximum time to wait.
+     * @return The current head, equal to known_head if the wait timed out.
+     */
+    uint64_t wait_for_rows(uint64_t known_head, std::chrono::nanoseconds timeout)const;
+
+
+
+private: // Private functions
+
+    /**
+     * @brief Access operator for constant access.
+     * @param row Row index, 0 being the oldest row held.
+     * @param column Column index.
+     * @return The data at the specified index.
+     */
+    DataType const_at_(int64_t row, int64_t column)const;
+
+    /**
+     * @brief Get the Header section.
+     *
+     * @return const RingBufferMatrixHeader*
+     */
+    const RingBufferMatrixHeader* get_header()const;
+
+    /**
+     * @brief Get the Header section.
+     *
+     * @return RingBufferMatrixHeader*
+     */
+    RingBufferMatrixHeader* get_header();
+
+    // Sequence number of each row slot, row i is published
+    // in its slot once the slot's sequence number is i + 1
+    const std::atomic<uint64_t>* get_sequences()const;
+    std::atomic<uint64_t>* get_sequences();
+
+    const DataType* get_slot(uint64_t row_index)const;
+    DataType* get_slot(uint64_t row_index);
+
+
+
+private: // Private variables
+
+    // The mapped file used as the memory
+    // for this ring buffer and its filename
+    mio::shared_mmap_sink mapped_file_;
+    fs::path filename_of_memory_mapped_file_;
+
+    static_assert(std::atomic<uint64_t>::is_always_lock_free, "RingBufferMatrix needs lock free 64 bit atomics to work across processes");
+};
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+// Compile time functions to check if the type is a matrix expression type
+//-------------------------------------------------------------------
+template<typename DataType>
+
+struct is_type_a_matrix< RingBufferMatrix<DataType> > : std::true_type
+{
+};
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+// Constructors
+//-------------------------------------------------------------------
+template<typename DataType>
+
+inline RingBufferMatrix<DataType>::RingBufferMatrix(uintptr_t capacity, uintptr_t columns)
+{
+    this->create_ring_buffer(capacity, columns);
+}
+
+
+
+template<typename DataType>
+
+inline RingBufferMatrix<DataType>::RingBufferMatrix(const std::string& file_to_load_ring_buffer_from)
+{
+    this->load_ring_buffer(file_to_load_ring_buffer_from);
+}
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+// Size and validity
+//-------------------------------------------------------------------
+template<typename DataType>
+
+inline bool RingBufferMatrix<DataType>::is_valid()const
+{
+    return mapped_file_.is_open() && mapped_file_.size() >= sizeof(RingBufferMatrixHeader);
+}
+
+
+
+template<typename DataType>
+
+inline uintptr_t RingBufferMatrix<DataType>::rows()const
+{
+    if(!this->is_valid())
+        return 0;
+
+    // Loading the tail first makes sure it's never ahead of the head
+    uint64_t tail = this->get_tail();
+    uint64_t head = this->get_head();
+
+    return (std::min)(head - tail, static_cast<uint64_t>(this->capacity()));
+}
+
+
+
+template<typename DataType>
+
+inline uintptr_t RingBufferMatrix<DataType>::columns()const
+{
+    if(!this->is_valid())
+        return 0;
+
+    return this->get_header()->columns;
+}
+
+
+
+template<typename DataType>
+
+inline uintptr_t RingBufferMatrix<DataType>::capacity()const
+{
+    if(!this->is_valid())
+        return 0;
+
+    return this->get_header()->capacity;
+}
+
+
+
+template<typename DataType>
+
+inline const fs::path& RingBufferMatrix<DataType>::get_filename_of_memory_mapped_file()const
+{
+    return filename_of_memory_mapped_file_;
+}
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+// Header, sequences and row slots
+//-------------------------------------------------------------------
+template<typename DataType>
+
+inline const RingBufferMatrixHeader* RingBufferMatrix<DataType>::get_header()const
+{
+    return reinterpret_cast<const RingBufferMatrixHeader*>(mapped_file_.cbegin());
+}
+
+
+
+template<typename DataType>
+
+inline RingBufferMatrixHeader* RingBufferMatrix<DataType>::get_header()
+{
+    return reinterpret_cast<RingBufferMatrixHeader*>(mapped_file_.begin());
+}
+
+
+
+template<typename DataType>
+
+inline const std::atomic<uint64_t>* RingBufferMatrix<DataType>::get_sequences()const
+{
+    return reinterpret_cast<const std::atomic<uint64_t>*>(mapped_file_.cbegin() + sizeof(RingBufferMatrixHeader));
+}
+
+
+
+template<typename DataType>
+
+inline std::atomic<uint64_t>* RingBufferMatrix<DataType>::get_sequences()
+{
+    return reinterpret_cast<std::atomic<uint64_t>*>(mapped_file_.begin() + sizeof(RingBufferMatrixHeader));
+}
+
+
+
+template<typename DataType>
+
+inline const DataType* RingBufferMatrix<DataType>::get_slot(uint64_t row_index)const
+{
+    uintptr_t offset = sizeof(RingBufferMatrixHeader) + this->capacity() * sizeof(std::atomic<uint64_t>);
+
+    return reinterpret_cast<const DataType*>(mapped_file_.cbegin() + offset) + (row_index % this->capacity()) * this->columns();
+}
+
+
+
+template<typename DataType>
+
+inline DataType* RingBufferMatrix<DataType>::get_slot(uint64_t row_index)
+{
+    uintptr_t offset = sizeof(RingBufferMatrixHeader) + this->capacity() * sizeof(std::atomic<uint64_t>);
+
+    return reinterpret_cast<DataType*>(mapped_file_.begin() + offset) + (row_index % this->capacity()) * this->columns();
+}
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+// Access operator
+//-------------------------------------------------------------------
+template<typename DataType>
+
+inline DataType RingBufferMatrix<DataType>::const_at_(int64_t row, int64_t column)const
+{
+    return this->get_slot(this->get_tail() + row)[column];
+}
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+// Function used to create a ring buffer
+//-------------------------------------------------------------------
+template<typename DataType>
+
+inline std::error_code
+
+RingBufferMatrix<DataType>::create_ring_buffer(uintptr_t capacity,
+                                               uintptr_t columns,
+                                               const fs::path& filename_template,
+                                               const fs::path& directory_where_file_will_reside)
+{
+    std::error_code mapping_error;
+
+    mapped_file_.unmap();
+
+    // Create the file and size it accordingly
+    filename_of_memory_mapped_file_ = create_file_with_specified_size_and_unique_name(get_ring_buffer_matrix_file_size<DataType>(capacity, columns),
+                                                                                      mapping_error,
+                                                                                      filename_template,
+                                                                                      directory_where_file_will_reside);
+
+    if(mapping_error)
+        return mapping_error;
+
+    // Finally we memory map the entire file
+    mapped_file_.map(filename_of_memory_mapped_file_.string(), mapping_error);
+
+    if(mapping_error)
+        return mapping_error;
+
+    // Write the header and the sequence numbers, constructing the atomics in place
+    new (mapped_file_.begin()) RingBufferMatrixHeader();
+    this->get_header()->size_of_data_type = sizeof(DataType);
+    this->get_header()->capacity = capacity;
+    this->get_header()->columns = columns;
+
+    for(uintptr_t i = 0; i < capacity; ++i)
+        new (this->get_sequences() + i) std::atomic<uint64_t>(0);
+
+    // We are done
+    return mapping_error;
+}
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+// Function used to load a ring buffer from file
+//-------------------------------------------------------------------
+template<typename DataType>
+
+inline std::error_code RingBufferMatrix<DataType>::load_ring_buffer(const std::string& file_to_load_ring_buffer_from)
+{
+    std::error_code mapping_error;
+
+    mapped_file_.unmap();
+    filename_of_memory_mapped_file_ = file_to_load_ring_buffer_from;
+
+    // First we check if the file exists and
+    // is big enough to hold the header
+    if(!fs::exists(filename_of_memory_mapped_file_) ||
+       fs::file_size(filename_of_memory_mapped_file_) < sizeof(RingBufferMatrixHeader))
+    {
+        mapping_error.assign(1,std::iostream_category());
+        return mapping_error;
+    }
+
+    // Memory map the entire file
+    mapped_file_.map(filename_of_memory_mapped_file_.string(), mapping_error);
+
+    if(mapping_error)
+        return mapping_error;
+
+    // Now that we have mapped the file, we check
+    // whether it is actually storing a ring buffer
+    // of the same data type
+    const RingBufferMatrixHeader* header = this->get_header();
+
+    bool is_ring_buffer = std::equal(ring_buffer_matrix_header_byte_sequence.cbegin(),
+                                     ring_buffer_matrix_header_byte_sequence.cend(),
+                                     &header->header[0]);
+
+    if(!is_ring_buffer ||
+       header->size_of_data_type != sizeof(DataType) ||
+       mapped_file_.size() < get_ring_buffer_matrix_file_size<DataType>(header->capacity, header->columns))
+    {
+        mapped_file_.unmap();
+        mapping_error.assign(1,std::iostream_category());
+        return mapping_error;
+    }
+
+    // We are done
+    return mapping_error;
+}
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+// Writer
+//-------------------------------------------------------------------
+template<typename DataType>
+
+inline void RingBufferMatrix<DataType>::push_row(const DataType* row)
+{
+    if(this->capacity() == 0)
+        return;
+
+    RingBufferMatrixHeader* header = this->get_header();
+
+    // Only this writer changes the head
+    uint64_t row_index = header->head.load(std::memory_order_relaxed);
+
+    std::atomic<uint64_t>& sequence = this->get_sequences()[row_index % this->capacity()];
+
+    // Retire the oldest row before overwriting its slot
+    if(row_index >= this->capacity())
+        header->tail.store(row_index + 1 - this->capacity(), std::memory_order_release);
+
+    // Readers copying the old row see the change of
+    // sequence number before any of the new values
+    sequence.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    std::memcpy(this->get_slot(row_index), row, this->columns() * sizeof(DataType));
+
+    // Publish the row, then the new head
+    sequence.store(row_index + 1, std::memory_order_release);
+    header->head.store(row_index + 1, std::memory_order_release);
+
+    header->new_rows_event.notify_all();
+}
+
+
+
+template<typename DataType>
+template<typename ReferenceType, std::enable_if_t<is_matrix_reference<ReferenceType>{}>*>
+
+inline std::error_code RingBufferMatrix<DataType>::push_rows(ReferenceType rows_to_push)
+{
+    std::error_code error;
+
+    if(rows_to_push.rows() > 0 && rows_to_push.columns() != this->columns())
+    {
+        error.assign(1,std::iostream_category());
+        return error;
+    }
+
+    std::vector<DataType> row(this->columns());
+
+    for(int64_t i = 0; i < rows_to_push.rows(); ++i)
+    {
+        for(int64_t j = 0; j < rows_to_push.columns(); ++j)
+            row[j] = rows_to_push(i,j);
+
+        this->push_row(row.data());
+    }
+
+    return error;
+}
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+// Lock-free readers
+//-------------------------------------------------------------------
+template<typename DataType>
+
+inline uint64_t RingBufferMatrix<DataType>::get_head()const
+{
+    return this->get_header()->head.load(std::memory_order_acquire);
+}
+
+
+
+template<typename DataType>
+
+inline uint64_t RingBufferMatrix<DataType>::get_tail()const
+{
+    return this->get_header()->tail.load(std::memory_order_acquire);
+}
+
+
+
+template<typename DataType>
+
+inline bool RingBufferMatrix<DataType>::copy_row(uint64_t row_index, DataType* destination)const
+{
+    if(this->capacity() == 0)
+        return false;
+
+    const std::atomic<uint64_t>& sequence = this->get_sequences()[row_index % this->capacity()];
+
+    if(sequence.load(std::memory_order_acquire) != row_index + 1)
+        return false;
+
+    std::memcpy(destination, this->get_slot(row_index), this->columns() * sizeof(DataType));
+
+    // The copy is good only if the writer didn't start
+    // overwriting the slot while we were copying it
+    std::atomic_thread_fence(std::memory_order_acquire);
+
+    return sequence.load(std::memory_order_relaxed) == row_index + 1;
+}
+
+
+
+template<typename DataType>
+
+inline uint64_t RingBufferMatrix<DataType>::copy_latest_rows(uint64_t number_of_rows, DataType* destination)const
+{
+    if(this->capacity() == 0)
+        return 0;
+
+    while(true)
+    {
+        uint64_t tail = this->get_tail();
+        uint64_t head = this->get_head();
+
+        uint64_t number_of_rows_to_copy = (std::min)({number_of_rows, head - tail, static_cast<uint64_t>(this->capacity())});
+        uint64_t first_row = head - number_of_rows_to_copy;
+
+        bool were_all_rows_copied = true;
+
+        for(uint64_t i = 0; i < number_of_rows_to_copy && were_all_rows_copied; ++i)
+            were_all_rows_copied = this->copy_row(first_row + i, destination + i * this->columns());
+
+        // Rows overwritten while copying, try again with the newer rows
+        if(were_all_rows_copied)
+            return number_of_rows_to_copy;
+    }
+}
+
+
+
+template<typename DataType>
+
+inline uint64_t RingBufferMatrix<DataType>::wait_for_rows(uint64_t known_head, std::chrono::nanoseconds timeout)const
+{
+    auto deadline = std::chrono::steady_clock::now() + timeout;
+
+    const SharedMemoryEvent& new_rows_event = this->get_header()->new_rows_event;
+
+    while(true)
+    {
+        // Get the state before checking the head so
+        // that a row pushed in between isn't missed
+        uint32_t state = new_rows_event.get_state();
+
+        uint64_t head = this->get_head();
+
+        if(head != known_head)
+            return head;
+
+        auto remaining_time = std::chrono::duration_cast<std::chrono::nanoseconds>(deadline - std::chrono::steady_clock::now());
+
+        if(remaining_time.count() <= 0 || !new_rows_event.wait(state, remaining_time))
+            return this->get_head();
+    }
+}
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+} // namespace LazyMatrix
+//-------------------------------------------------------------------
+
+
+
+#endif  // INCLUDE_RING_BUFFER_MATRIX_HPP_
@@ -8,6 +8,12 @@
  * handle ownership issues effectively. It provides a cross-platform implementation, supporting
  * both Windows and POSIX (Linux) environments.
  *
+ * It also defines the SharedMemoryLock class, which combines a RobustMutex for writers with
+ * a version counter (seqlock) that lets readers take consistent snapshots without locking.
+ * The SharedMemoryEvent class lets processes sleep until another process notifies them
+ * (using a futex on Linux). They're all meant to be placed inside memory mapped files
+ * shared between processes.
+ *
  * @author Vincenzo Barbato
  * 
  * Additional Information:
@@ -25,6 +31,11 @@
 
 //-------------------------------------------------------------------
 #include <atomic>
+#include <cerrno>
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <thread>
 
 // Check if we are compiling on Windows
 #ifdef _WIN32
@@ -40,6 +51,14 @@
     // POSIX headers
     #include <pthread.h>
 #endif
+
+#ifdef __linux__
+    #include <ctime>
+    #include <climits>
+    #include <linux/futex.h>
+    #include <sys/syscall.h>
+    #include <unistd.h>
+#endif
 //-------------------------------------------------------------------
 
 
@@ -59,6 +78,10 @@ namespace LazyMatrix
  * RobustMutex uses platform-specific implementations to create a mutex that is robust and 
  * suitable for use across multiple processes. It ensures that mutexes are not orphaned due
  * to abrupt termination of a process, providing consistent locking behavior.
+ *
+ * The mutex can be placed in shared memory: it's constructed once by the process creating
+ * the memory, and every other process uses it as is. On POSIX it's a process-shared robust
+ * pthread mutex, on Windows it's a named mutex which each process opens when locking.
  */
 //-------------------------------------------------------------------
 class RobustMutex 
@@ -113,7 +136,8 @@ private:
     void ensure_initialized();
 
 #ifdef _WIN32
-    HANDLE mtx_handle_; ///< Windows HANDLE for the mutex.
+    char name_[64] = {};            ///< Name of the Windows mutex object.
+    HANDLE owner_handle_ = NULL;    ///< Handle opened by the owner (only valid in the owner process).
 #else
     pthread_mutex_t mtx; ///< POSIX thread mutex used for synchronization.
 #endif
@@ -147,10 +171,7 @@ inline RobustMutex::RobustMutex()
 inline RobustMutex::~RobustMutex()
 {
     #ifdef _WIN32
-        if (mtx_handle_ != NULL)
-        {
-            CloseHandle(mtx_handle_);
-        }
+        // The mutex object goes away with the last handle opened by lock()
     #else
         if (initialization_status_.load() == INITIALIZED)
         {
@@ -166,12 +187,22 @@ inline RobustMutex::~RobustMutex()
 inline int RobustMutex::lock()
 {
     #ifdef _WIN32
-        DWORD wait_result = WaitForSingleObject(mtx_handle_, INFINITE);
+        HANDLE handle = CreateMutexA(NULL, FALSE, name_);
+
+        if (handle == NULL)
+            return -1;
+
+        DWORD wait_result = WaitForSingleObject(handle, INFINITE);
         switch (wait_result)
         {
             case WAIT_OBJECT_0:
+                owner_handle_ = handle;
                 return 0; // Success
+            case WAIT_ABANDONED:
+                owner_handle_ = handle;
+                return EOWNERDEAD; // The previous owner died, we own it now
             default:
+                CloseHandle(handle);
                 return -1; // Error
         }
     #else
@@ -192,7 +223,10 @@ inline int RobustMutex::lock()
 inline void RobustMutex::unlock()
 {
     #ifdef _WIN32
-        ReleaseMutex(mtx_handle_);
+        HANDLE handle = owner_handle_;
+        owner_handle_ = NULL;
+        ReleaseMutex(handle);
+        CloseHandle(handle);
     #else
         pthread_mutex_unlock(&mtx);
     #endif
@@ -205,7 +239,13 @@ inline void RobustMutex::unlock()
 inline void RobustMutex::initialize_mutex()
 {
     #ifdef _WIN32
-        mtx_handle_ = CreateMutex(NULL, FALSE, NULL);
+        // Unique name shared by every process mapping this memory
+        static std::atomic<uint64_t> number_of_mutexes(0);
+
+        wsprintfA(name_, "LazyMatrixRobustMutex_%lu_%lu_%lu",
+                  GetCurrentProcessId(),
+                  static_cast<unsigned long>(GetTickCount64()),
+                  static_cast<unsigned long>(number_of_mutexes.fetch_add(1)));
     #else
         pthread_mutexattr_t attr;
         pthread_mutexattr_init(&attr);
@@ -235,6 +275,225 @@ inline void RobustMutex::ensure_initialized()
 
 
 
+//-------------------------------------------------------------------
+/**
+ * @class SharedMemoryLock
+ * @brief A RobustMutex for writers plus a version counter for lock-free readers.
+ *
+ * Writers lock the mutex and wrap their changes between begin_write and
+ * end_write, which make the version odd while the data is changing. Readers
+ * don't lock anything, they use read_consistently, which reads again until
+ * the version was even and didn't change while reading (a seqlock).
+ *
+ * Like RobustMutex, it's meant to live in memory shared between processes
+ * and to be constructed once by the process creating the memory.
+ */
+//-------------------------------------------------------------------
+class SharedMemoryLock
+{
+public:
+
+    /**
+     * @brief Locks the mutex for writing.
+     *
+     * If the previous owner died while writing, the version is made even
+     * again so readers don't wait forever, and EOWNERDEAD is returned.
+     *
+     * @return int Returns 0 on success, EOWNERDEAD if the previous owner
+     *         died, or an error code on failure.
+     */
+    int lock()
+    {
+        int result = mutex_.lock();
+
+        if(result == EOWNERDEAD && (version_.load(std::memory_order_relaxed) & 1))
+            version_.fetch_add(1, std::memory_order_release);
+
+        return result;
+    }
+
+    /**
+     * @brief Unlocks the mutex.
+     */
+    void unlock()
+    {
+        mutex_.unlock();
+    }
+
+    /**
+     * @brief Marks the start of a change (the lock must be held).
+     */
+    void begin_write()
+    {
+        version_.fetch_add(1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+    }
+
+    /**
+     * @brief Marks the end of a change (the lock must be held).
+     */
+    void end_write()
+    {
+        version_.fetch_add(1, std::memory_order_release);
+    }
+
+    /**
+     * @brief Get the current version (odd while a change is in progress).
+     */
+    uint64_t get_version()const
+    {
+        return version_.load(std::memory_order_acquire);
+    }
+
+    /**
+     * @brief Calls read_function until it ran without any change
+     *        happening at the same time.
+     *
+     * read_function may run more than once and may see inconsistent data
+     * in the runs that get discarded, so it should only copy data.
+     *
+     * @param read_function Callable reading the shared data.
+     * @return The version of the data that was read.
+     */
+    template<typename Function>
+    uint64_t read_consistently(Function&& read_function)const
+    {
+        while(true)
+        {
+            uint64_t version = version_.load(std::memory_order_acquire);
+
+            if(version & 1)
+            {
+                std::this_thread::yield();
+                continue;
+            }
+
+            read_function();
+
+            std::atomic_thread_fence(std::memory_order_acquire);
+
+            if(version_.load(std::memory_order_relaxed) == version)
+                return version;
+        }
+    }
+
+private:
+
+    RobustMutex mutex_;                     ///< Mutex serializing the writers.
+    std::atomic<uint64_t> version_{0};      ///< Even when no change is in progress.
+
+    static_assert(std::atomic<uint64_t>::is_always_lock_free, "SharedMemoryLock needs lock free 64 bit atomics to work across processes");
+};
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+/**
+ * @class SharedMemoryEvent
+ * @brief Lets processes sleep until another process notifies them.
+ *
+ * A waiter first gets the current state, checks whatever condition it's
+ * waiting for, and then calls wait with that state. Since notify_all
+ * changes the state before waking anyone up, a notification arriving
+ * between the check and the call to wait isn't lost.
+ *
+ * On Linux this is a process-shared futex, on other platforms waiters
+ * poll the state with short sleeps. Like SharedMemoryLock, it's meant to
+ * live in memory shared between processes.
+ */
+//-------------------------------------------------------------------
+class SharedMemoryEvent
+{
+public:
+
+    /**
+     * @brief Get the current state, to be passed to wait.
+     */
+    uint32_t get_state()const
+    {
+        return state_.load(std::memory_order_acquire);
+    }
+
+    /**
+     * @brief Waits until notify_all is called after get_state returned state.
+     *
+     * @param state The state returned by get_state before checking the condition.
+     * @param timeout Maximum time to wait.
+     * @return false if the timeout expired before a notification.
+     */
+    bool wait(uint32_t state, std::chrono::nanoseconds timeout)const
+    {
+        auto deadline = std::chrono::steady_clock::now() + timeout;
+
+        number_of_waiters_.fetch_add(1, std::memory_order_seq_cst);
+
+        bool was_notified = true;
+
+        #ifdef __linux__
+            while(state_.load(std::memory_order_acquire) == state)
+            {
+                auto remaining_time = std::chrono::duration_cast<std::chrono::nanoseconds>(deadline - std::chrono::steady_clock::now());
+
+                if(remaining_time.count() <= 0)
+                {
+                    was_notified = false;
+                    break;
+                }
+
+                timespec relative_timeout;
+                relative_timeout.tv_sec = remaining_time.count() / 1000000000;
+                relative_timeout.tv_nsec = remaining_time.count() % 1000000000;
+
+                // Returns right away if the state already changed
+                syscall(SYS_futex, reinterpret_cast<uint32_t*>(&state_), FUTEX_WAIT, state, &relative_timeout, nullptr, 0);
+            }
+        #else
+            auto sleep_time = std::chrono::microseconds(1);
+
+            while(state_.load(std::memory_order_acquire) == state)
+            {
+                if(std::chrono::steady_clock::now() >= deadline)
+                {
+                    was_notified = false;
+                    break;
+                }
+
+                std::this_thread::sleep_for(sleep_time);
+                sleep_time = (std::min)(2 * sleep_time, std::chrono::microseconds(1000));
+            }
+        #endif
+
+        number_of_waiters_.fetch_sub(1, std::memory_order_seq_cst);
+
+        return was_notified;
+    }
+
+    /**
+     * @brief Wakes up every process and thread waiting on this event.
+     */
+    void notify_all()
+    {
+        state_.fetch_add(1, std::memory_order_seq_cst);
+
+        #ifdef __linux__
+            // Skip the system call when nobody is sleeping
+            if(number_of_waiters_.load(std::memory_order_seq_cst) > 0)
+                syscall(SYS_futex, reinterpret_cast<uint32_t*>(&state_), FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+        #endif
+    }
+
+private:
+
+    mutable std::atomic<uint32_t> state_{0};                ///< Changed by every notification.
+    mutable std::atomic<uint32_t> number_of_waiters_{0};    ///< Number of processes and threads waiting.
+
+    static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t), "SharedMemoryEvent uses the state as a futex word");
+};
+//-------------------------------------------------------------------
+
+
+
 //-------------------------------------------------------------------
 } // namespace LazyMatrix
 //-------------------------------------------------------------------
@@ -118,6 +118,58 @@ public:
         return std::abs(column2_ - column1_) + 1;
     }
 
+    /**
+     * @brief Raw access to the region of interest, when the viewed matrix
+     *        has contiguous storage (see has_contiguous_storage).
+     * @return Pointer to the first element of the region, nullptr if the
+     *         region is reversed or wraps around the viewed matrix.
+     */
+    template<typename T = ReferenceType,
+             std::enable_if_t<has_contiguous_storage<typename T::matrix_type>::value>* = nullptr>
+    const value_type* data()const
+    {
+        const auto& matrix = static_cast<const typename T::matrix_type&>(*expression_.get_ptr());
+
+        const value_type* pointer = matrix.data();
+
+        if(pointer == nullptr || !this->is_inside_expression_())
+            return nullptr;
+
+        return pointer + row1_ * matrix.row_stride() + column1_;
+    }
+
+    /**
+     * @brief Raw access to the region of interest, when the viewed matrix
+     *        has contiguous storage (see has_contiguous_storage).
+     * @return Pointer to the first element of the region, nullptr if the
+     *         region is reversed or wraps around the viewed matrix.
+     */
+    template<typename T = ReferenceType,
+             std::enable_if_t<has_contiguous_storage<typename T::matrix_type>::value &&
+                              has_non_const_access<T>::value>* = nullptr>
+    value_type* data()
+    {
+        auto& matrix = *expression_.get_ptr();
+
+        value_type* pointer = matrix.data();
+
+        if(pointer == nullptr || !this->is_inside_expression_())
+            return nullptr;
+
+        return pointer + row1_ * matrix.row_stride() + column1_;
+    }
+
+    /**
+     * @brief Distance (in elements) between the starts of consecutive rows,
+     *        the same as in the viewed matrix.
+     */
+    template<typename T = ReferenceType,
+             std::enable_if_t<has_contiguous_storage<typename T::matrix_type>::value>* = nullptr>
+    uintptr_t row_stride()const
+    {
+        return expression_.get_ptr()->row_stride();
+    }
+
     // Functions used to handle row and column header names
     std::string get_row_header(int64_t row_index) const
     {
@@ -214,6 +266,16 @@ private: // Private functions
         return std::error_code();
     }
 
+    /**
+     * @brief Checks whether the region is inside the viewed matrix
+     *        and not reversed, so it doesn't need circular access.
+     */
+    bool is_inside_expression_()const
+    {
+        return row1_ >= 0 && row1_ <= row2_ && row2_ < int64_t(expression_.rows()) &&
+               column1_ >= 0 && column1_ <= column2_ && column2_ < int64_t(expression_.columns());
+    }
+
     /**
      * @brief Accesses the element at the specified position.
      * @param row Row index.
@@ -303,6 +365,18 @@ struct is_type_a_matrix< ROIView<ReferenceType> > : std::true_type
 
 
 
+//-------------------------------------------------------------------
+// A ROI keeps the storage of the matrix it views
+//-------------------------------------------------------------------
+template<typename ReferenceType>
+
+struct has_contiguous_storage< ROIView<ReferenceType> > : has_contiguous_storage<typename ReferenceType::matrix_type>
+{
+};
+//-------------------------------------------------------------------
+
+
+
 //-------------------------------------------------------------------
 /**
  * @brief Creates a ROI of an input matrix (Region Of Interest).
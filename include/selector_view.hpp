@@ -129,6 +129,57 @@ public:
             return uintptr_t(1);
     }
 
+    /**
+     * @brief Raw access to the selected row or column, when the viewed
+     *        matrix has contiguous storage (see has_contiguous_storage).
+     * @return Pointer to the first element of the selected vector.
+     */
+    template<typename T = ReferenceType,
+             std::enable_if_t<has_contiguous_storage<typename T::matrix_type>::value>* = nullptr>
+    const value_type* data()const
+    {
+        const auto& matrix = static_cast<const typename T::matrix_type&>(*expression_.get_ptr());
+
+        const value_type* pointer = matrix.data();
+
+        if(pointer == nullptr || expression_.size() == 0)
+            return nullptr;
+
+        return pointer + this->offset_of_selected_vector_(matrix.row_stride());
+    }
+
+    /**
+     * @brief Raw access to the selected row or column, when the viewed
+     *        matrix has contiguous storage (see has_contiguous_storage).
+     * @return Pointer to the first element of the selected vector.
+     */
+    template<typename T = ReferenceType,
+             std::enable_if_t<has_contiguous_storage<typename T::matrix_type>::value &&
+                              has_non_const_access<T>::value>* = nullptr>
+    value_type* data()
+    {
+        auto& matrix = *expression_.get_ptr();
+
+        value_type* pointer = matrix.data();
+
+        if(pointer == nullptr || expression_.size() == 0)
+            return nullptr;
+
+        return pointer + this->offset_of_selected_vector_(matrix.row_stride());
+    }
+
+    /**
+     * @brief Distance (in elements) between the starts of consecutive rows,
+     *        the same as in the viewed matrix (a selected column has one
+     *        element per row).
+     */
+    template<typename T = ReferenceType,
+             std::enable_if_t<has_contiguous_storage<typename T::matrix_type>::value>* = nullptr>
+    uintptr_t row_stride()const
+    {
+        return expression_.get_ptr()->row_stride();
+    }
+
     // Functions used to handle row and column header names
     std::string get_row_header(int64_t row_index) const
     {
@@ -179,6 +230,22 @@ private: // Private functions
         return std::error_code();
     }
 
+    /**
+     * @brief Offset of the first element of the selected vector in the
+     *        storage of the viewed matrix (wrapping around like circ_at).
+     */
+    int64_t offset_of_selected_vector_(uintptr_t row_stride)const
+    {
+        if(are_we_selecting_a_row_)
+        {
+            int64_t rows = int64_t(expression_.rows());
+            return ((rows + selected_vector_ % rows) % rows) * int64_t(row_stride);
+        }
+
+        int64_t columns = int64_t(expression_.columns());
+        return (columns + selected_vector_ % columns) % columns;
+    }
+
     /**
      * @brief Accesses the element at the specified position.
      * @param row Row index.
@@ -233,6 +300,18 @@ struct is_type_a_matrix< SingleVectorSelectorView<ReferenceType> > : std::true_t
 
 
 
+//-------------------------------------------------------------------
+// A selected row or column keeps the storage of the matrix it views
+//-------------------------------------------------------------------
+template<typename ReferenceType>
+
+struct has_contiguous_storage< SingleVectorSelectorView<ReferenceType> > : has_contiguous_storage<typename ReferenceType::matrix_type>
+{
+};
+//-------------------------------------------------------------------
+
+
+
 //-------------------------------------------------------------------
 /**
  * @class MultipleVectorSelectorView
@@ -323,6 +402,49 @@ public:
             return selected_vectors_.size();
     }
 
+    /**
+     * @brief Raw access to a selected row, when the rows of the viewed
+     *        matrix are contiguous (see has_contiguous_rows).
+     * @param row Row index.
+     * @return Pointer to the first element of the row, nullptr when
+     *         selecting columns.
+     */
+    template<typename T = ReferenceType,
+             std::enable_if_t<has_contiguous_rows<typename T::matrix_type>::value>* = nullptr>
+    decltype(auto) row_data(int64_t row)const
+    {
+        const auto& matrix = static_cast<const typename T::matrix_type&>(*expression_.get_ptr());
+
+        decltype(matrix.row_data(0)) pointer = nullptr;
+
+        if(!are_we_selecting_rows_ || expression_.rows() == 0)
+            return pointer;
+
+        return matrix.row_data(this->selected_row_(row));
+    }
+
+    /**
+     * @brief Raw access to a selected row, when the rows of the viewed
+     *        matrix are contiguous (see has_contiguous_rows).
+     * @param row Row index.
+     * @return Pointer to the first element of the row, nullptr when
+     *         selecting columns.
+     */
+    template<typename T = ReferenceType,
+             std::enable_if_t<has_contiguous_rows<typename T::matrix_type>::value &&
+                              has_non_const_access<T>::value>* = nullptr>
+    decltype(auto) row_data(int64_t row)
+    {
+        auto& matrix = *expression_.get_ptr();
+
+        decltype(matrix.row_data(0)) pointer = nullptr;
+
+        if(!are_we_selecting_rows_ || expression_.rows() == 0)
+            return pointer;
+
+        return matrix.row_data(this->selected_row_(row));
+    }
+
     // Functions used to handle row and column header names
     std::string get_row_header(int64_t row_index) const
     {
@@ -373,6 +495,16 @@ private: // Private functions
         return std::error_code();
     }
 
+    /**
+     * @brief Row of the viewed matrix selected by a row of this view
+     *        (wrapping around like circ_at).
+     */
+    int64_t selected_row_(int64_t row)const
+    {
+        int64_t rows = int64_t(expression_.rows());
+        return (rows + selected_vectors_[row] % rows) % rows;
+    }
+
     /**
      * @brief Accesses the element at the specified position.
      * @param row Row index.
@@ -427,6 +559,19 @@ struct is_type_a_matrix< MultipleVectorSelectorView<ReferenceType> > : std::true
 
 
 
+//-------------------------------------------------------------------
+// Selected rows are contiguous when the rows of the matrix they
+// come from are, but they are not evenly spaced
+//-------------------------------------------------------------------
+template<typename ReferenceType>
+
+struct has_contiguous_rows< MultipleVectorSelectorView<ReferenceType> > : has_contiguous_rows<typename ReferenceType::matrix_type>
+{
+};
+//-------------------------------------------------------------------
+
+
+
 //-------------------------------------------------------------------
 /**
  * @class RowAndColumnSelectorView
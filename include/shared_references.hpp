@@ -299,6 +299,38 @@ public:
         return ptr_->circ_at(index);
     }
 
+    /**
+     * @brief Forwards the call to the data() method of the underlying matrix
+     *        (only for matrices with has_contiguous_storage).
+     * @return A const pointer to the first element, nullptr if the matrix
+     *         is not contiguous.
+     */
+    decltype(auto) data() const
+    {
+        return static_cast<const MatrixType&>(*ptr_).data();
+    }
+
+    /**
+     * @brief Forwards the call to the row_stride() method of the underlying matrix
+     *        (only for matrices with has_contiguous_storage).
+     * @return The distance (in elements) between the starts of consecutive rows.
+     */
+    uintptr_t row_stride() const
+    {
+        return ptr_->row_stride();
+    }
+
+    /**
+     * @brief Forwards the call to the row_span() method of the underlying matrix
+     *        (only for matrices with has_contiguous_rows).
+     * @param row The row index.
+     * @return A read-only span of the row, empty if the row is not contiguous.
+     */
+    decltype(auto) row_span(int64_t row) const
+    {
+        return static_cast<const MatrixType&>(*ptr_).row_span(row);
+    }
+
     /**
      * @brief Return underlying shared_ptr pointer
      */
@@ -377,6 +409,8 @@ public:
     using ConstSharedMatrixRef<MatrixType>::at;
     using ConstSharedMatrixRef<MatrixType>::circ_at;
     using ConstSharedMatrixRef<MatrixType>::operator();
+    using ConstSharedMatrixRef<MatrixType>::data;
+    using ConstSharedMatrixRef<MatrixType>::row_span;
 
     /**
      * @brief Constructs a SharedMatrixRef object.
@@ -487,6 +521,28 @@ public:
     {
         return this->ptr_->circ_at(index);
     }
+
+    /**
+     * @brief Forwards the call to the data() method of the underlying matrix
+     *        (only for matrices with has_contiguous_storage).
+     * @return A pointer to the first element, nullptr if the matrix
+     *         is not contiguous.
+     */
+    decltype(auto) data()
+    {
+        return this->ptr_->data();
+    }
+
+    /**
+     * @brief Forwards the call to the row_span() method of the underlying matrix
+     *        (only for matrices with has_contiguous_rows).
+     * @param row The row index.
+     * @return A span of the row, empty if the row is not contiguous.
+     */
+    decltype(auto) row_span(int64_t row)
+    {
+        return this->ptr_->row_span(row);
+    }
     
     /**
      * @brief This function is used for python bindings, it sets the value at
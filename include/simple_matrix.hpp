@@ -30,6 +30,7 @@
 
 #include "base_matrix.hpp"
 #include "shared_references.hpp"
+#include "expression_evaluation.hpp"
 
 // eigen library for fast/efficient matrix math
 #include "Eigen/Eigen"
@@ -180,6 +181,33 @@ public:
         return columns_;
     }
 
+    /**
+     * Gets the distance (in elements) between the starts of consecutive rows.
+     * @return The number of columns, rows are never padded.
+     */
+    uintptr_t row_stride() const
+    {
+        return columns_;
+    }
+
+    /**
+     * Gets a pointer to the contiguous row-major array of matrix elements.
+     * @return Pointer to the first element.
+     */
+    const DataType* data() const
+    {
+        return data_.data();
+    }
+
+    /**
+     * Gets a pointer to the contiguous row-major array of matrix elements.
+     * @return Pointer to the first element.
+     */
+    DataType* data()
+    {
+        return data_.data();
+    }
+
     // Functions used to handle row and column header names
     std::string get_row_header(int64_t row_index) const { return this->headers_.get_row_header(row_index); }
     std::string get_column_header(int64_t column_index) const { return this->headers_.get_column_header(column_index); }
@@ -264,6 +292,18 @@ struct is_type_a_matrix< SimpleMatrix<MatrixType> > : std::true_type
 
 
 
+//-------------------------------------------------------------------
+// SimpleMatrix stores its elements in a contiguous std::vector
+//-------------------------------------------------------------------
+template<typename DataType>
+
+struct has_contiguous_storage< SimpleMatrix<DataType> > : std::true_type
+{
+};
+//-------------------------------------------------------------------
+
+
+
 //-------------------------------------------------------------------
 // Default constructor from rows, columns and initial value
 //-------------------------------------------------------------------
@@ -335,15 +375,10 @@ inline SimpleMatrix<DataType>::SimpleMatrix(ReferenceType matrix_expression)
     uintptr_t rows = matrix_expression.rows();
     uintptr_t columns = matrix_expression.columns();
 
-    this->resize_(rows,columns);
+    std::error_code error = this->resize_(rows,columns);
 
-    for(int64_t i = 0; i < rows; ++i)
-    {
-        for(int64_t j = 0; j < columns; ++j)
-        {
-            (*this)(i,j) = matrix_expression(i,j);
-        }
-    }
+    if(!error)
+        materialize_into(matrix_expression, *this);
 }
 //-------------------------------------------------------------------
 
@@ -413,9 +448,7 @@ inline SimpleMatrix<DataType>& SimpleMatrix<DataType>::operator=(ReferenceType m
     if(error)
         return (*this);
 
-    for(int64_t i = 0; i < rows; ++i)
-        for(int64_t j = 0; j < columns; ++j)
-            (*this)(i,j) = matrix_expression(i,j);
+    materialize_into(matrix_expression, *this);
 
     return (*this);
 }
@@ -142,6 +142,42 @@ public:
         return columns_;
     }
 
+    /**
+     * Gets a pointer to the contiguous array of matrix elements
+     * (pages one after the other, each page stored row-major).
+     * @return Pointer to the first element.
+     */
+    const DataType* data() const
+    {
+        return data_.data();
+    }
+
+    /**
+     * Gets a pointer to the contiguous array of matrix elements
+     * (pages one after the other, each page stored row-major).
+     * @return Pointer to the first element.
+     */
+    DataType* data()
+    {
+        return data_.data();
+    }
+
+    /**
+     * Gets the distance (in elements) between the starts of consecutive rows.
+     */
+    uintptr_t row_stride() const
+    {
+        return columns_;
+    }
+
+    /**
+     * Gets the distance (in elements) between the starts of consecutive pages.
+     */
+    uintptr_t page_stride() const
+    {
+        return rows_ * columns_;
+    }
+
     // Functions used to handle page, row and column header names
     std::string get_page_header(int64_t page_index) const { return this->headers_.get_page_header(page_index); }
     std::string get_row_header(int64_t row_index) const { return this->headers_.get_row_header(row_index); }
@@ -234,6 +270,18 @@ struct is_type_a_matrix3d< SimpleMatrix3D<MatrixType> > : std::true_type
 
 
 
+//-------------------------------------------------------------------
+// SimpleMatrix3D stores its elements contiguously in a std::vector
+//-------------------------------------------------------------------
+template<typename DataType>
+
+struct has_contiguous_storage< SimpleMatrix3D<DataType> > : std::true_type
+{
+};
+//-------------------------------------------------------------------
+
+
+
 //-------------------------------------------------------------------
 // Default constructor from rows, columns and initial value
 //-------------------------------------------------------------------
@@ -9,6 +9,10 @@
  * This implementation optimizes matrix multiplication for large matrices by reducing the
  * number of recursive multiplications.
  *
+ * strassen_matrix_multiply uses the Strassen-Winograd variant, which works
+ * on strided blocks of a single workspace allocated up front and switches
+ * to the blocked dense kernel once the blocks reach a tunable crossover size.
+ *
  * @author Vincenzo Barbato
  * 
  * Additional Information:
@@ -29,6 +33,12 @@
 #include "simple_matrix.hpp"
 #include "shared_references.hpp"
 #include "padding_view.hpp"
+#include "thread_pool.hpp"
+#include "blocked_matrix_multiplication.hpp"
+
+#include <array>
+#include <vector>
+#include <algorithm>
 //-------------------------------------------------------------------
 
 
@@ -289,9 +299,17 @@ strassen_subtract(const MatrixType1& a, const MatrixType2& b)
  * form the final result. This implementation optimizes for generic matrix
  * expressions, using a concrete matrix type for internal computations.
  *
+ * The seven products are independent, so for matrices of at least
+ * minimum_size_for_multithreading rows they are computed in parallel on
+ * the thread pool. Each product is stored in its own slot and they are
+ * combined afterwards in a fixed order, so the result doesn't depend on
+ * the number of threads.
+ *
  * @tparam MatrixType Type of the matrices.
  * @param a First matrix operand.
  * @param b Second matrix operand.
+ * @param thread_pool Thread pool used to compute the seven products.
+ * @param minimum_size_for_multithreading Smallest size computed in parallel.
  * @return The result of multiplying matrices a and b.
  *
  * @note For matrices smaller than or equal to 2x2, the function falls
@@ -305,7 +323,10 @@ template<typename MatrixType1,
 
 inline auto
 
-strassen_multiply_recursive(const MatrixType1& a, const MatrixType2& b)
+strassen_multiply_recursive(const MatrixType1& a,
+                            const MatrixType2& b,
+                            ThreadPool& thread_pool = get_default_thread_pool(),
+                            int minimum_size_for_multithreading = 128)
 {
     using value_type = typename std::remove_const<typename std::remove_reference<decltype(std::declval<MatrixType1>()(0,0))>::type>::type;
 
@@ -346,13 +367,39 @@ strassen_multiply_recursive(const MatrixType1& a, const MatrixType2& b)
     strassen_split(b, b11, b12, b21, b22);
 
     // Compute the 7 products using the Strassen algorithm
-    auto p1 = strassen_multiply_recursive(a11, strassen_subtract(b12, b22));
-    auto p2 = strassen_multiply_recursive(strassen_add(a11, a12), b22);
-    auto p3 = strassen_multiply_recursive(strassen_add(a21, a22), b11);
-    auto p4 = strassen_multiply_recursive(a22, strassen_subtract(b21, b11));
-    auto p5 = strassen_multiply_recursive(strassen_add(a11, a22), strassen_add(b11, b22));
-    auto p6 = strassen_multiply_recursive(strassen_subtract(a12, a22), strassen_add(b21, b22));
-    auto p7 = strassen_multiply_recursive(strassen_subtract(a11, a21), strassen_add(b11, b12));
+    std::array<SimpleMatrix<value_type>, 7> p;
+
+    auto compute_product = [&](uintptr_t i)
+    {
+        switch(i)
+        {
+            case 0: p[0] = strassen_multiply_recursive(a11, strassen_subtract(b12, b22), thread_pool, minimum_size_for_multithreading); break;
+            case 1: p[1] = strassen_multiply_recursive(strassen_add(a11, a12), b22, thread_pool, minimum_size_for_multithreading); break;
+            case 2: p[2] = strassen_multiply_recursive(strassen_add(a21, a22), b11, thread_pool, minimum_size_for_multithreading); break;
+            case 3: p[3] = strassen_multiply_recursive(a22, strassen_subtract(b21, b11), thread_pool, minimum_size_for_multithreading); break;
+            case 4: p[4] = strassen_multiply_recursive(strassen_add(a11, a22), strassen_add(b11, b22), thread_pool, minimum_size_for_multithreading); break;
+            case 5: p[5] = strassen_multiply_recursive(strassen_subtract(a12, a22), strassen_add(b21, b22), thread_pool, minimum_size_for_multithreading); break;
+            case 6: p[6] = strassen_multiply_recursive(strassen_subtract(a11, a21), strassen_add(b11, b12), thread_pool, minimum_size_for_multithreading); break;
+        }
+    };
+
+    if(static_cast<int>(a.rows()) >= minimum_size_for_multithreading)
+    {
+        thread_pool.parallel_for(p.size(), compute_product);
+    }
+    else
+    {
+        for(uintptr_t i = 0; i < p.size(); ++i)
+            compute_product(i);
+    }
+
+    const auto& p1 = p[0];
+    const auto& p2 = p[1];
+    const auto& p3 = p[2];
+    const auto& p4 = p[3];
+    const auto& p5 = p[4];
+    const auto& p6 = p[5];
+    const auto& p7 = p[6];
 
     // Combine the products to form the final result
     auto c11 = strassen_add(strassen_subtract(strassen_add(p5, p4), p2), p6);
@@ -366,26 +413,264 @@ strassen_multiply_recursive(const MatrixType1& a, const MatrixType2& b)
 
 
 
+//-------------------------------------------------------------------
+/**
+ * @brief Computes z = x + y for n x n strided blocks.
+ */
+//-------------------------------------------------------------------
+template<typename DataType>
+
+inline void
+
+strassen_strided_add(uintptr_t n,
+                     const DataType* x, uintptr_t ldx,
+                     const DataType* y, uintptr_t ldy,
+                     DataType* z, uintptr_t ldz)
+{
+    for(uintptr_t i = 0; i < n; ++i)
+    {
+        for(uintptr_t j = 0; j < n; ++j)
+        {
+            z[i * ldz + j] = x[i * ldx + j] + y[i * ldy + j];
+        }
+    }
+}
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+/**
+ * @brief Computes z = x - y for n x n strided blocks.
+ */
+//-------------------------------------------------------------------
+template<typename DataType>
+
+inline void
+
+strassen_strided_subtract(uintptr_t n,
+                          const DataType* x, uintptr_t ldx,
+                          const DataType* y, uintptr_t ldy,
+                          DataType* z, uintptr_t ldz)
+{
+    for(uintptr_t i = 0; i < n; ++i)
+    {
+        for(uintptr_t j = 0; j < n; ++j)
+        {
+            z[i * ldz + j] = x[i * ldx + j] - y[i * ldy + j];
+        }
+    }
+}
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+/**
+ * @brief Get the size of the square matrices the Strassen-Winograd
+ *        recursion works on.
+ *
+ * Instead of padding to the next power of two, the size is padded to
+ * q * 2^levels, the smallest such number not less than n where q is not
+ * bigger than the crossover size. This way the blocks can be split in
+ * half at every level and the padding is at most 2^levels - 1.
+ *
+ * @param n The biggest dimension of the matrices being multiplied.
+ * @param crossover_size Blocks of this size or smaller use the dense kernel.
+ */
+//-------------------------------------------------------------------
+inline uintptr_t strassen_padded_size(uintptr_t n, uintptr_t crossover_size)
+{
+    crossover_size = std::max<uintptr_t>(1, crossover_size);
+
+    uintptr_t levels = 0;
+
+    while(((n + (uintptr_t(1) << levels) - 1) >> levels) > crossover_size)
+        ++levels;
+
+    return ((n + (uintptr_t(1) << levels) - 1) >> levels) << levels;
+}
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+/**
+ * @brief Get the number of elements of workspace needed to multiply
+ *        two n x n matrices with strassen_winograd_multiply.
+ *
+ * Every level of the recursion needs two (n/2) x (n/2) temporaries,
+ * so the total is about 2/3 of n * n.
+ */
+//-------------------------------------------------------------------
+inline uintptr_t strassen_workspace_size(uintptr_t n, uintptr_t crossover_size)
+{
+    uintptr_t size = 0;
+
+    while(n > crossover_size && n % 2 == 0)
+    {
+        n /= 2;
+        size += 2 * n * n;
+    }
+
+    return size;
+}
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+/**
+ * @brief Computes c = a * b for n x n strided blocks using the
+ *        Strassen-Winograd algorithm.
+ *
+ * The blocks are never copied, the quadrants are just offsets into a, b
+ * and c. The four quadrants of c are used as scratch space for the seven
+ * products, and only two (n/2) x (n/2) temporaries are taken from the
+ * workspace at every level (see strassen_workspace_size). The additions
+ * that combine the products are fused into a single pass.
+ *
+ * Blocks that are not bigger than the crossover size (or have an odd size)
+ * are multiplied with the blocked dense kernel on the thread pool (or with
+ * a plain loop for types that aren't arithmetic, like std::complex).
+ *
+ * @param n Number of rows and columns of the blocks.
+ * @param workspace Scratch memory of at least strassen_workspace_size elements.
+ */
+//-------------------------------------------------------------------
+template<typename DataType>
+
+inline void
+
+strassen_winograd_multiply(uintptr_t n,
+                           const DataType* a, uintptr_t lda,
+                           const DataType* b, uintptr_t ldb,
+                           DataType* c, uintptr_t ldc,
+                           DataType* workspace,
+                           uintptr_t crossover_size,
+                           ThreadPool& thread_pool = get_default_thread_pool())
+{
+    if(n <= crossover_size || n % 2 != 0)
+    {
+        for(uintptr_t i = 0; i < n; ++i)
+            std::fill(c + i * ldc, c + i * ldc + n, static_cast<DataType>(0));
+
+        if constexpr(std::is_arithmetic_v<DataType> && !std::is_same_v<DataType, bool>)
+        {
+            blocked_matrix_multiply_add(n, n, n, a, lda, b, ldb, c, ldc, thread_pool);
+        }
+        else
+        {
+            // The blocked kernel only handles arithmetic types,
+            // other types (like std::complex) use a plain loop
+            for(uintptr_t i = 0; i < n; ++i)
+                for(uintptr_t k = 0; k < n; ++k)
+                    for(uintptr_t j = 0; j < n; ++j)
+                        c[i * ldc + j] += a[i * lda + k] * b[k * ldb + j];
+        }
+
+        return;
+    }
+
+    uintptr_t h = n / 2;
+
+    const DataType* a11 = a;
+    const DataType* a12 = a + h;
+    const DataType* a21 = a + h * lda;
+    const DataType* a22 = a + h * lda + h;
+
+    const DataType* b11 = b;
+    const DataType* b12 = b + h;
+    const DataType* b21 = b + h * ldb;
+    const DataType* b22 = b + h * ldb + h;
+
+    DataType* c11 = c;
+    DataType* c12 = c + h;
+    DataType* c21 = c + h * ldc;
+    DataType* c22 = c + h * ldc + h;
+
+    // Two temporaries for this level, the rest is for the deeper levels
+    DataType* x = workspace;
+    DataType* y = workspace + h * h;
+    DataType* deeper_workspace = workspace + 2 * h * h;
+
+    auto multiply = [&](const DataType* left, uintptr_t ldl, const DataType* right, uintptr_t ldr, DataType* product, uintptr_t ldp)
+    {
+        strassen_winograd_multiply(h, left, ldl, right, ldr, product, ldp, deeper_workspace, crossover_size, thread_pool);
+    };
+
+    // c21 = p7 = (a11 - a21) * (b22 - b12)
+    strassen_strided_subtract(h, a11, lda, a21, lda, x, h);
+    strassen_strided_subtract(h, b22, ldb, b12, ldb, y, h);
+    multiply(x, h, y, h, c21, ldc);
+
+    // c22 = p5 = (a21 + a22) * (b12 - b11)
+    strassen_strided_add(h, a21, lda, a22, lda, x, h);
+    strassen_strided_subtract(h, b12, ldb, b11, ldb, y, h);
+    multiply(x, h, y, h, c22, ldc);
+
+    // c12 = p6 = (a21 + a22 - a11) * (b22 - b12 + b11)
+    strassen_strided_subtract(h, x, h, a11, lda, x, h);
+    strassen_strided_subtract(h, b22, ldb, y, h, y, h);
+    multiply(x, h, y, h, c12, ldc);
+
+    // c11 = p3 = (a12 - a21 - a22 + a11) * b22
+    strassen_strided_subtract(h, a12, lda, x, h, x, h);
+    multiply(x, h, b22, ldb, c11, ldc);
+
+    // x = p1 = a11 * b11
+    multiply(a11, lda, b11, ldb, x, h);
+
+    // Fused combination of the products computed so far:
+    // u2 = p1 + p6, u3 = u2 + p7, c12 = u2 + p5 + p3, c21 = u3, c22 = u3 + p5
+    for(uintptr_t i = 0; i < h; ++i)
+    {
+        for(uintptr_t j = 0; j < h; ++j)
+        {
+            DataType u2 = x[i * h + j] + c12[i * ldc + j];
+            DataType u3 = u2 + c21[i * ldc + j];
+            DataType p5 = c22[i * ldc + j];
+
+            c12[i * ldc + j] = u2 + p5 + c11[i * ldc + j];
+            c21[i * ldc + j] = u3;
+            c22[i * ldc + j] = u3 + p5;
+        }
+    }
+
+    // c11 = p4 = a22 * (b22 - b12 + b11 - b21), then c21 = u3 - p4
+    strassen_strided_subtract(h, y, h, b21, ldb, y, h);
+    multiply(a22, lda, y, h, c11, ldc);
+    strassen_strided_subtract(h, c21, ldc, c11, ldc, c21, ldc);
+
+    // c11 = p2 = a12 * b21, then c11 = p1 + p2
+    multiply(a12, lda, b21, ldb, c11, ldc);
+    strassen_strided_add(h, x, h, c11, ldc, c11, ldc);
+}
+//-------------------------------------------------------------------
+
+
+
 //-------------------------------------------------------------------
 /**
  * @brief Performs matrix multiplication using the Strassen algorithm.
  *
- * This function implements the Strassen algorithm for efficient matrix multiplication.
- * It first pads the input matrices to dimensions that are powers of two, 
- * which optimizes the recursive division process in the Strassen algorithm.
- * After the multiplication, it trims the result back to the original size.
- * This approach is particularly efficient for large matrices where the
- * conventional multiplication becomes computationally expensive.
+ * This function implements the Strassen-Winograd algorithm for efficient
+ * matrix multiplication. The matrices are copied once into zero padded
+ * square buffers (see strassen_padded_size), which together with the
+ * workspace for the recursion live in a single allocation made up front.
+ * The recursion then works on strided blocks of those buffers, and blocks
+ * not bigger than the crossover size are multiplied with the blocked dense
+ * kernel, which runs on the thread pool.
  *
- * @tparam MatrixType1 Type of the first matrix operand.
- * @tparam MatrixType2 Type of the second matrix operand.
+ * @tparam ReferenceType1 Type of the first matrix operand.
+ * @tparam ReferenceType2 Type of the second matrix operand.
  * @param a The first matrix operand, not modified by padding.
  * @param b The second matrix operand, not modified by padding.
+ * @param crossover_size Blocks of this size or smaller use the dense kernel.
+ * @param thread_pool Thread pool used by the dense kernel.
  * @return Matrix containing the result of the multiplication.
  * 
- * @note For matrices smaller or equal to 2x2, this function falls back to
- *       conventional matrix multiplication. Padding is applied internally
- *       and does not modify the input matrices.
+ * @note Padding is applied internally and does not modify the input matrices.
  */
 //-------------------------------------------------------------------
 template<typename ReferenceType1,
@@ -395,23 +680,47 @@ template<typename ReferenceType1,
 
 inline auto
 
-strassen_matrix_multiply(ReferenceType1 a, ReferenceType2 b)
+strassen_matrix_multiply(ReferenceType1 a,
+                         ReferenceType2 b,
+                         uintptr_t crossover_size = 128,
+                         ThreadPool& thread_pool = get_default_thread_pool())
 {
     using value_type = typename std::remove_const<typename std::remove_reference<decltype(std::declval<ReferenceType1>()(0,0))>::type>::type;
 
+    auto result = MatrixFactory::create_simple_matrix<value_type>(a.rows(), b.columns());
+
+    if(a.size() == 0 || b.size() == 0)
+        return result;
+
     // Calculate the size for padding
-    int max_dim = std::max({a.rows(), a.columns(), b.rows(), b.columns()});
-    int new_size = std::pow(2, std::ceil(std::log2(max_dim)));
+    uintptr_t max_dim = std::max({a.rows(), a.columns(), b.rows(), b.columns()});
+    uintptr_t n = strassen_padded_size(max_dim, crossover_size);
+
+    // Padded copies of a and b, the padded result and the workspace
+    // all come out of a single allocation
+    std::vector<value_type> arena(3 * n * n + strassen_workspace_size(n, crossover_size), static_cast<value_type>(0));
+
+    value_type* padded_a = arena.data();
+    value_type* padded_b = padded_a + n * n;
+    value_type* padded_c = padded_b + n * n;
+    value_type* workspace = padded_c + n * n;
 
-    // Apply padding
-    auto padded_a = create_padded_matrix_view(a, new_size, new_size, static_cast<value_type>(0));
-    auto padded_b = create_padded_matrix_view(b, new_size, new_size, static_cast<value_type>(0));
+    for(uintptr_t i = 0; i < a.rows(); ++i)
+        for(uintptr_t j = 0; j < a.columns(); ++j)
+            padded_a[i * n + j] = a(i, j);
 
-    // Perform Strassen multiplication on the padded matrices
-    auto result = strassen_multiply_recursive(*padded_a, *padded_b);
+    for(uintptr_t i = 0; i < b.rows(); ++i)
+        for(uintptr_t j = 0; j < b.columns(); ++j)
+            padded_b[i * n + j] = b(i, j);
+
+    strassen_winograd_multiply(n, padded_a, n, padded_b, n, padded_c, n, workspace, crossover_size, thread_pool);
 
     // Trim the result back to the size of the original matrix
-    return trim_matrix(result, a.rows(), b.columns());
+    for(uintptr_t i = 0; i < result.rows(); ++i)
+        for(uintptr_t j = 0; j < result.columns(); ++j)
+            result(i, j) = padded_c[i * n + j];
+
+    return result;
 }
 //-------------------------------------------------------------------
 
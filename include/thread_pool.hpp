@@ -0,0 +1,366 @@
+//-------------------------------------------------------------------
+/**
+ * @file thread_pool.hpp
+ * @brief Thread pool used by the LazyMatrix library to run work in parallel.
+ *
+ * The ThreadPool class keeps a set of worker threads alive and runs
+ * tasks on them. Work is submitted with parallel_for, which splits it
+ * into indexed tasks and returns once all of them are done. The calling
+ * thread helps run queued tasks while it waits, so parallel_for can be
+ * called from within a task (nested parallelism) without deadlocking.
+ *
+ * The library uses one default pool (see get_default_thread_pool), which
+ * the caller can size with set_default_thread_pool_size.
+ *
+ * @author Vincenzo Barbato
+ *
+ * Additional Information:
+ * - GitHub Project: [LazyMatrix](https://github.com/navyenzo/LazyMatrix.git)
+ * - LinkedIn: [Vincenzo Barbato](https://www.linkedin.com/in/vincenzobarbato/)
+ */
+//-------------------------------------------------------------------
+
+
+
+#ifndef INCLUDE_THREAD_POOL_HPP_
+#define INCLUDE_THREAD_POOL_HPP_
+
+
+
+//-------------------------------------------------------------------
+// Includes
+//-------------------------------------------------------------------
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+// Define every thing within the namespace LazyMatrix
+//-------------------------------------------------------------------
+namespace LazyMatrix
+{
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+/**
+ * @class ThreadPool
+ * @brief Fixed set of worker threads running indexed tasks.
+ *
+ * The number of threads includes the thread calling parallel_for, so a
+ * pool of N threads starts N-1 workers, and a pool of 1 thread runs
+ * everything on the calling thread.
+ */
+//-------------------------------------------------------------------
+class ThreadPool
+{
+public:
+
+    /**
+     * @brief Constructs a thread pool.
+     * @param number_of_threads Number of threads (0 uses all hardware threads).
+     */
+    explicit ThreadPool(uintptr_t number_of_threads = 0)
+    {
+        start_workers(number_of_threads);
+    }
+
+    /**
+     * @brief Finishes the queued tasks and stops the workers.
+     */
+    ~ThreadPool()
+    {
+        stop_workers();
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    /**
+     * @brief Get the number of threads (workers plus the calling thread).
+     */
+    uintptr_t get_number_of_threads()const
+    {
+        return workers_.size() + 1;
+    }
+
+    /**
+     * @brief Changes the number of threads of the pool.
+     *
+     * Must not be called while the pool is running work.
+     *
+     * @param number_of_threads Number of threads (0 uses all hardware threads).
+     */
+    void resize(uintptr_t number_of_threads)
+    {
+        stop_workers();
+        start_workers(number_of_threads);
+    }
+
+    /**
+     * @brief Calls function(i) for every i in [0, number_of_tasks) using
+     *        the pool threads, and returns when all calls are done.
+     *
+     * Task 0 runs on the calling thread. While waiting, the calling thread
+     * runs other queued tasks instead of blocking.
+     *
+     * If tasks throw, parallel_for still waits for all of them and then
+     * rethrows the first exception it caught.
+     *
+     * The order in which tasks run is not specified. To get reproducible
+     * results, each task should write to its own output and any reduction
+     * should be done afterwards in index order.
+     *
+     * @param number_of_tasks Number of tasks to run.
+     * @param function Callable taking the task index (uintptr_t).
+     */
+    template<typename Function>
+    void parallel_for(uintptr_t number_of_tasks, const Function& function)
+    {
+        if(number_of_tasks == 0)
+            return;
+
+        if(number_of_tasks == 1 || workers_.empty())
+        {
+            for(uintptr_t i = 0; i < number_of_tasks; ++i)
+                function(i);
+
+            return;
+        }
+
+        // The count is only changed and read under the completion mutex,
+        // so once we see it reach zero no task touches this frame again
+        uintptr_t number_of_remaining_tasks = number_of_tasks;
+        std::exception_ptr first_exception;
+        std::mutex completion_mutex;
+        std::condition_variable completion_condition;
+
+        auto run_task = [&](uintptr_t i)
+        {
+            std::exception_ptr exception;
+
+            try
+            {
+                function(i);
+            }
+            catch(...)
+            {
+                exception = std::current_exception();
+            }
+
+            std::lock_guard<std::mutex> lock(completion_mutex);
+
+            if(exception && !first_exception)
+                first_exception = exception;
+
+            if(--number_of_remaining_tasks == 0)
+                completion_condition.notify_all();
+        };
+
+        auto are_all_tasks_done = [&]()
+        {
+            std::lock_guard<std::mutex> lock(completion_mutex);
+            return number_of_remaining_tasks == 0;
+        };
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+
+            for(uintptr_t i = 1; i < number_of_tasks; ++i)
+            {
+                tasks_.emplace_back([&run_task, i]()
+                {
+                    run_task(i);
+                });
+            }
+        }
+
+        condition_.notify_all();
+
+        run_task(0);
+
+        // Help with the queued tasks until ours are all done, even when
+        // one of them threw, since the queued tasks refer to this frame
+        while(!are_all_tasks_done())
+        {
+            if(run_pending_task())
+                continue;
+
+            // Nothing left in the queue, our remaining tasks are running
+            // on other threads, so we just wait for them to finish
+            std::unique_lock<std::mutex> lock(completion_mutex);
+            completion_condition.wait(lock, [&]()
+            {
+                return number_of_remaining_tasks == 0;
+            });
+        }
+
+        if(first_exception)
+            std::rethrow_exception(first_exception);
+    }
+
+
+
+private: // Private functions
+
+    /**
+     * @brief Starts the worker threads.
+     */
+    void start_workers(uintptr_t number_of_threads)
+    {
+        if(number_of_threads == 0)
+            number_of_threads = std::max<uintptr_t>(1, std::thread::hardware_concurrency());
+
+        is_stopping_ = false;
+
+        for(uintptr_t i = 1; i < number_of_threads; ++i)
+        {
+            workers_.emplace_back([this]()
+            {
+                while(true)
+                {
+                    std::function<void()> task;
+
+                    {
+                        std::unique_lock<std::mutex> lock(mutex_);
+                        condition_.wait(lock, [this]() { return is_stopping_ || !tasks_.empty(); });
+
+                        if(tasks_.empty())
+                            return;
+
+                        task = std::move(tasks_.front());
+                        tasks_.pop_front();
+                    }
+
+                    task();
+                }
+            });
+        }
+    }
+
+    /**
+     * @brief Stops the workers once the queued tasks are done.
+     */
+    void stop_workers()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            is_stopping_ = true;
+        }
+
+        condition_.notify_all();
+
+        for(auto& worker : workers_)
+            worker.join();
+
+        workers_.clear();
+    }
+
+    /**
+     * @brief Runs one queued task on the calling thread.
+     * @return true if a task was run, false if the queue was empty.
+     */
+    bool run_pending_task()
+    {
+        std::function<void()> task;
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+
+            if(tasks_.empty())
+                return false;
+
+            task = std::move(tasks_.front());
+            tasks_.pop_front();
+        }
+
+        task();
+
+        return true;
+    }
+
+
+
+private: // Private variables
+
+    std::vector<std::thread> workers_;              ///< Worker threads.
+    std::deque<std::function<void()>> tasks_;       ///< Queued tasks.
+    std::mutex mutex_;                              ///< Protects the task queue.
+    std::condition_variable condition_;             ///< Wakes up workers.
+    bool is_stopping_ = false;                      ///< Tells workers to exit.
+};
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+/**
+ * @brief Get the thread pool used by default throughout the library.
+ *
+ * The pool is created on first use with one thread per hardware thread.
+ */
+//-------------------------------------------------------------------
+inline ThreadPool& get_default_thread_pool()
+{
+    static ThreadPool default_thread_pool;
+
+    return default_thread_pool;
+}
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+/**
+ * @brief Get a thread pool with a single thread, which runs every task
+ *        on the calling thread.
+ *
+ * Used by default by functions reading sources that might not be safe
+ * to read from several threads at once.
+ */
+//-------------------------------------------------------------------
+inline ThreadPool& get_serial_thread_pool()
+{
+    static ThreadPool serial_thread_pool(1);
+
+    return serial_thread_pool;
+}
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+/**
+ * @brief Sets the number of threads of the default thread pool.
+ *
+ * Must not be called while the library is running work on the pool.
+ *
+ * @param number_of_threads Number of threads (0 uses all hardware
+ *                          threads, 1 disables multithreading).
+ */
+//-------------------------------------------------------------------
+inline void set_default_thread_pool_size(uintptr_t number_of_threads)
+{
+    get_default_thread_pool().resize(number_of_threads);
+}
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+} // namespace LazyMatrix
+//-------------------------------------------------------------------
+
+
+
+#endif  // INCLUDE_THREAD_POOL_HPP_
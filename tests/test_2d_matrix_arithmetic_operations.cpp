@@ -25,6 +25,7 @@
 //-------------------------------------------------------------------
 #include <catch2/catch_all.hpp>
 #include <chrono>
+#include <complex>
 #include "lazy_matrix.hpp"
 //-------------------------------------------------------------------
 
@@ -213,5 +214,178 @@ TEST_CASE("Strassen vs Naive Matrix Multiplication", "[Matrix2D]")
             REQUIRE(result_naive(i, j) == result_strassen(i, j));
         }
     }
+
+    // A small crossover size forces a few levels of recursion
+    // on sizes that are not powers of two
+    auto rectangular_mat1 = LazyMatrix::MatrixFactory::create_simple_matrix<int>(LazyMatrix::generate_random_matrix<int>(37, 45, -10, 10));
+    auto rectangular_mat2 = LazyMatrix::MatrixFactory::create_simple_matrix<int>(LazyMatrix::generate_random_matrix<int>(45, 23, -10, 10));
+
+    auto rectangular_naive = rectangular_mat1 * rectangular_mat2;
+    auto rectangular_strassen = LazyMatrix::strassen_matrix_multiply(rectangular_mat1, rectangular_mat2, 4);
+
+    REQUIRE(rectangular_strassen.rows() == 37);
+    REQUIRE(rectangular_strassen.columns() == 23);
+
+    for (int64_t i = 0; i < 37; ++i)
+    {
+        for (int64_t j = 0; j < 23; ++j)
+        {
+            REQUIRE(rectangular_naive(i, j) == rectangular_strassen(i, j));
+        }
+    }
+
+    // Types that aren't arithmetic use a plain loop at the leaves
+    auto complex_mat1 = LazyMatrix::MatrixFactory::create_simple_matrix<std::complex<double>>(19, 13);
+    auto complex_mat2 = LazyMatrix::MatrixFactory::create_simple_matrix<std::complex<double>>(13, 11);
+
+    for (int64_t i = 0; i < 19; ++i)
+        for (int64_t j = 0; j < 13; ++j)
+            complex_mat1(i, j) = std::complex<double>(double(i - j), double((i * j) % 5));
+
+    for (int64_t i = 0; i < 13; ++i)
+        for (int64_t j = 0; j < 11; ++j)
+            complex_mat2(i, j) = std::complex<double>(double((i + j) % 7), double(j - i));
+
+    auto complex_naive = complex_mat1 * complex_mat2;
+    auto complex_strassen = LazyMatrix::strassen_matrix_multiply(complex_mat1, complex_mat2, 4);
+
+    REQUIRE(complex_strassen.rows() == 19);
+    REQUIRE(complex_strassen.columns() == 11);
+
+    for (int64_t i = 0; i < 19; ++i)
+    {
+        for (int64_t j = 0; j < 11; ++j)
+        {
+            REQUIRE(complex_naive(i, j) == complex_strassen(i, j));
+        }
+    }
+}
+//-------------------------------------------------------------------
+
+
+//-------------------------------------------------------------------
+TEST_CASE("Blocked vs Generic Matrix Multiplication", "[Matrix2D]")
+{
+    // Sizes that are not multiples of the kernel tiles and
+    // a shared dimension bigger than one packed block
+    int64_t rows = 37;
+    int64_t shared_dimension = 413;
+    int64_t columns = 29;
+
+    auto mat1 = LazyMatrix::MatrixFactory::create_simple_matrix<double>(LazyMatrix::generate_random_matrix<double>(rows, shared_dimension, -1, 1));
+    auto mat2 = LazyMatrix::MatrixFactory::create_simple_matrix<double>(LazyMatrix::generate_random_matrix<double>(shared_dimension, columns, -1, 1));
+
+    // Transposing twice gives lazy views which use the generic path
+    auto result_blocked = mat1 * mat2;
+    auto result_generic = LazyMatrix::transpose(LazyMatrix::transpose(mat1)) * mat2;
+
+    REQUIRE(result_blocked.rows() == rows);
+    REQUIRE(result_blocked.columns() == columns);
+
+    for (int64_t i = 0; i < rows; ++i)
+    {
+        for (int64_t j = 0; j < columns; ++j)
+        {
+            REQUIRE(result_blocked(i, j) == Catch::Approx(result_generic(i, j)));
+        }
+    }
+
+    // Memory mapped matrices and other data types
+    auto mapped_mat1 = LazyMatrix::MatrixFactory::create_matrix<float>(mat1);
+    auto mapped_mat2 = LazyMatrix::MatrixFactory::create_matrix<float>(mat2);
+    auto result_float = mapped_mat1 * mapped_mat2;
+
+    REQUIRE(result_float(rows - 1, columns - 1) == Catch::Approx(result_generic(rows - 1, columns - 1)).margin(1e-3));
+
+    auto int_mat1 = LazyMatrix::MatrixFactory::create_simple_matrix<int>(LazyMatrix::generate_random_matrix<int>(rows, shared_dimension, -10, 10));
+    auto int_mat2 = LazyMatrix::MatrixFactory::create_simple_matrix<int>(LazyMatrix::generate_random_matrix<int>(shared_dimension, columns, -10, 10));
+    auto int_result_blocked = int_mat1 * int_mat2;
+    auto int_result_generic = LazyMatrix::transpose(LazyMatrix::transpose(int_mat1)) * int_mat2;
+
+    for (int64_t i = 0; i < rows; ++i)
+    {
+        for (int64_t j = 0; j < columns; ++j)
+        {
+            REQUIRE(int_result_blocked(i, j) == int_result_generic(i, j));
+        }
+    }
 }
-//-------------------------------------------------------------------
\ No newline at end of file
+//-------------------------------------------------------------------
+
+
+//-------------------------------------------------------------------
+TEST_CASE("Multithreaded Matrix Multiplication is reproducible", "[Matrix2D]")
+{
+    int64_t dimension_length = 128;
+
+    auto mat1 = LazyMatrix::MatrixFactory::create_simple_matrix<double>(LazyMatrix::generate_random_matrix<double>(dimension_length, dimension_length, -1, 1));
+    auto mat2 = LazyMatrix::MatrixFactory::create_simple_matrix<double>(LazyMatrix::generate_random_matrix<double>(dimension_length, dimension_length, -1, 1));
+
+    // Single threaded results
+    LazyMatrix::set_default_thread_pool_size(1);
+    auto result_single_thread = mat1 * mat2;
+    auto strassen_single_thread = LazyMatrix::strassen_matrix_multiply(mat1, mat2);
+
+    // Multithreaded results have to be exactly the same
+    LazyMatrix::set_default_thread_pool_size(4);
+    auto result_multiple_threads = mat1 * mat2;
+    auto strassen_multiple_threads = LazyMatrix::strassen_matrix_multiply(mat1, mat2);
+
+    LazyMatrix::set_default_thread_pool_size(0);
+
+    for (int64_t i = 0; i < dimension_length; ++i)
+    {
+        for (int64_t j = 0; j < dimension_length; ++j)
+        {
+            REQUIRE(result_single_thread(i, j) == result_multiple_threads(i, j));
+            REQUIRE(strassen_single_thread(i, j) == strassen_multiple_threads(i, j));
+            REQUIRE(strassen_single_thread(i, j) == Catch::Approx(result_single_thread(i, j)).margin(1e-9));
+        }
+    }
+}
+//-------------------------------------------------------------------
+
+
+//-------------------------------------------------------------------
+TEST_CASE("Block evaluation of element by element expressions", "[Matrix2D]")
+{
+    // More columns than fit in one evaluation block
+    int64_t rows = 3;
+    int64_t columns = LazyMatrix::expression_block_size * 2 + 17;
+
+    auto a = LazyMatrix::MatrixFactory::create_simple_matrix<double>(LazyMatrix::generate_random_matrix<double>(rows, columns, -1, 1));
+    auto b = LazyMatrix::MatrixFactory::create_simple_matrix<double>(LazyMatrix::generate_random_matrix<double>(rows, columns, -1, 1));
+    auto c = LazyMatrix::MatrixFactory::create_matrix<double>(LazyMatrix::generate_random_matrix<double>(rows, columns, -1, 1));
+
+    // The double transpose is not contiguous, so it's read through at()
+    auto expression = LazyMatrix::sqrt(LazyMatrix::abs(-a + LazyMatrix::elem_by_elem_multiply(b, c))) - LazyMatrix::transpose(LazyMatrix::transpose(b));
+
+    auto simple_result = LazyMatrix::MatrixFactory::create_simple_matrix<double>(expression);
+    auto mapped_result = LazyMatrix::MatrixFactory::create_matrix<double>(expression);
+
+    REQUIRE(simple_result.rows() == rows);
+    REQUIRE(simple_result.columns() == columns);
+    REQUIRE(mapped_result.rows() == rows);
+    REQUIRE(mapped_result.columns() == columns);
+
+    for (int64_t i = 0; i < rows; ++i)
+    {
+        for (int64_t j = 0; j < columns; ++j)
+        {
+            double expected = std::sqrt(std::abs(-a(i,j) + b(i,j) * c(i,j))) - b(i,j);
+
+            REQUIRE(expression(i, j) == Catch::Approx(expected));
+            REQUIRE(simple_result(i, j) == Catch::Approx(expected));
+            REQUIRE(mapped_result(i, j) == Catch::Approx(expected));
+        }
+    }
+
+    // Assigning an expression that reads the destination itself
+    auto expected_sum = LazyMatrix::MatrixFactory::create_simple_matrix<double>(b + a);
+    (*a.get_ptr()) = b + a;
+
+    for (int64_t i = 0; i < rows; ++i)
+        for (int64_t j = 0; j < columns; ++j)
+            REQUIRE(a(i, j) == expected_sum(i, j));
+}
+//-------------------------------------------------------------------
@@ -224,4 +224,254 @@ TEST_CASE("CSVMatrix test \"dynamic_at\" function return type an value at (row,c
 
     std::remove(filename.c_str());
 }
-//-------------------------------------------------------------------
\ No newline at end of file
+//-------------------------------------------------------------------
+
+
+//-------------------------------------------------------------------
+/**
+ * @brief Test case for the CSVMatrix row offset index.
+ *
+ * Tests that sparse and dense row offset indices give the same
+ * values as scanning the csv file without an index, including
+ * empty rows and row delimiters inside quoted entries.
+ */
+//-------------------------------------------------------------------
+TEST_CASE("CSVMatrix row offset index", "[CSVMatrix]")
+{
+    std::string filename = "test_row_index.csv";
+
+    std::string content = "h1,h2,h3\n";
+
+    for(int i = 0; i < 10; ++i)
+    {
+        content += std::to_string(i) + "," + std::to_string(10 * i) + ",\"a\nb\"\n";
+
+        if(i % 3 == 0)
+            content += "\n";
+    }
+
+    createTestCSVFile(filename, content);
+
+    for(uintptr_t stride : {0, 1, 3, 4, 100})
+    {
+        LazyMatrix::CSVMatrix<double> matrix;
+        matrix.set_row_index_stride(stride);
+        matrix.load(filename, true, false);
+
+        REQUIRE(matrix.rows() == 10);
+        REQUIRE(matrix.columns() == 3);
+
+        for(int i = 0; i < 10; ++i)
+        {
+            REQUIRE(matrix(i, 0) == Catch::Approx(i));
+            REQUIRE(matrix(i, 1) == Catch::Approx(10 * i));
+        }
+    }
+
+    LazyMatrix::CSVMatrix<std::string> strings;
+    strings.set_row_index_stride(3);
+    strings.load(filename, true, false);
+
+    REQUIRE(strings(7, 2) == "a\nb");
+
+    std::remove(filename.c_str());
+}
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+/**
+ * @brief Test case for the CSVStructuralScanner.
+ *
+ * Tests that the block scanner finds the same delimiters as a
+ * character by character scan, with quoted regions and rows
+ * spanning multiple 64-byte blocks.
+ */
+//-------------------------------------------------------------------
+TEST_CASE("CSVStructuralScanner finds unquoted delimiters", "[CSVMatrix]")
+{
+    LazyMatrix::CSVStructuralScanner scanner('\"', "\n\r", ", ");
+
+    std::string csv;
+
+    for(int i = 0; i < 40; ++i)
+    {
+        csv += std::to_string(i * 1234567) + ",";
+        csv += (i % 5 == 0) ? "\"quoted, with\nrow and column delimiters\"" : "plain";
+        csv += (i % 7 == 0) ? "\r\n" : "\n";
+    }
+
+    // Reference character by character scan
+    std::vector<std::pair<uintptr_t,bool>> expected;
+    uintptr_t number_of_quotes = 0;
+
+    for(uintptr_t i = 0; i < csv.size(); ++i)
+    {
+        if(csv[i] == '\"')
+            ++number_of_quotes;
+        else if(number_of_quotes % 2 == 0 && (csv[i] == '\n' || csv[i] == '\r'))
+            expected.emplace_back(i, true);
+        else if(number_of_quotes % 2 == 0 && (csv[i] == ',' || csv[i] == ' '))
+            expected.emplace_back(i, false);
+    }
+
+    std::vector<std::pair<uintptr_t,bool>> found;
+
+    scanner.for_each_delimiter(csv.data(), 0, csv.size(),
+                               [&](uintptr_t position, bool is_row_delimiter)
+                               {
+                                   found.emplace_back(position, is_row_delimiter);
+                                   return true;
+                               });
+
+    REQUIRE(found == expected);
+
+    uintptr_t first_row_delimiter = expected[1].first;
+    REQUIRE(scanner.find_end_of_row(csv.data(), 0, csv.size()) == first_row_delimiter);
+    REQUIRE(scanner.find_end_of_column(csv.data(), 0, csv.size()) == expected[0].first);
+    REQUIRE(scanner.count_columns(csv.data(), 0, first_row_delimiter) == 2);
+}
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+/**
+ * @brief Test case for loading a CSVMatrix with multiple threads.
+ *
+ * Tests that splitting the file in chunks (with chunk boundaries
+ * falling inside quoted entries and rows) gives the same size and
+ * values as loading it with a single thread.
+ */
+//-------------------------------------------------------------------
+TEST_CASE("CSVMatrix parallel loading", "[CSVMatrix]")
+{
+    std::string filename = "test_parallel_loading.csv";
+
+    std::string content = "index,value,comment\n";
+
+    for(int i = 0; i < 20000; ++i)
+    {
+        content += std::to_string(i) + "," + std::to_string(i % 97) + ",";
+        content += (i % 3 == 0) ? "\"a long quoted comment,\nthat spans \"\"two\"\" lines\"" : "comment";
+        content += (i % 11 == 0) ? ",extra\n\n" : "\n";
+    }
+
+    createTestCSVFile(filename, content);
+
+    LazyMatrix::CSVMatrix<double> serial;
+    serial.load(filename, true, false);
+
+    for(uintptr_t number_of_threads : {2, 7, 0})
+    {
+        LazyMatrix::CSVMatrix<double> parallel;
+        parallel.set_number_of_loading_threads(number_of_threads);
+        parallel.set_row_index_stride(5);
+        parallel.load(filename, true, false);
+
+        REQUIRE(parallel.rows() == serial.rows());
+        REQUIRE(parallel.columns() == serial.columns());
+
+        for(int i = 0; i < int(serial.rows()); i += 37)
+        {
+            REQUIRE(parallel(i, 0) == serial(i, 0));
+            REQUIRE(parallel(i, 1) == serial(i, 1));
+        }
+    }
+
+    REQUIRE(serial.rows() == 20000);
+    REQUIRE(serial.columns() == 4);
+    REQUIRE(serial(19999, 0) == Catch::Approx(19999));
+
+    std::remove(filename.c_str());
+}
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+/**
+ * @brief Test case for converting a CSV file into a memory mapped Matrix.
+ *
+ * Tests that the converted matrix has the same values and header names
+ * as the CSVMatrix, that a second conversion of an unchanged CSV file
+ * reuses the converted matrix and that a changed CSV file, data type or
+ * delimiters convert it again.
+ */
+//-------------------------------------------------------------------
+TEST_CASE("MatrixFactory converts CSV files into Matrix files", "[CSVMatrix]")
+{
+    std::string filename = "test_conversion.csv";
+    fs::path matrix_filename = fs::temp_directory_path() / "test_conversion.lazymatrix";
+
+    std::string content = "name,a,b,c\n";
+
+    for(int i = 0; i < 1000; ++i)
+        content += "row" + std::to_string(i) + "," + std::to_string(i) + "," + std::to_string(i * 0.5) + ((i % 10 == 0) ? "\n" : ",7\n");
+
+    createTestCSVFile(filename, content);
+
+    std::error_code error;
+
+    auto matrix = LazyMatrix::MatrixFactory::create_matrix_from_csv<double>(filename, true, true, matrix_filename, error, 4);
+
+    REQUIRE_FALSE(error);
+    REQUIRE(matrix.rows() == 1000);
+    REQUIRE(matrix.columns() == 3);
+    REQUIRE(matrix(999, 0) == Catch::Approx(999));
+    REQUIRE(matrix(999, 1) == Catch::Approx(499.5));
+    REQUIRE(matrix(999, 2) == Catch::Approx(7));
+    REQUIRE(matrix(990, 2) == Catch::Approx(0));
+    REQUIRE(matrix.get_column_header(1) == "b");
+    REQUIRE(matrix.get_row_header(3) == "row3");
+
+    // Unchanged csv file, the converted matrix is reused
+    matrix(0, 0) = -1;
+
+    auto cached_matrix = LazyMatrix::MatrixFactory::create_matrix_from_csv<double>(filename, true, true, matrix_filename, error, 4);
+
+    REQUIRE_FALSE(error);
+    REQUIRE(cached_matrix(0, 0) == Catch::Approx(-1));
+    REQUIRE(cached_matrix.get_column_header(2) == "c");
+
+    // Same size but different data type, the matrix is converted again
+    auto integer_matrix = LazyMatrix::MatrixFactory::create_matrix_from_csv<int64_t>(filename, true, true, matrix_filename, error, 4);
+
+    REQUIRE_FALSE(error);
+    REQUIRE(integer_matrix(0, 0) == 0);
+    REQUIRE(integer_matrix(999, 0) == 999);
+
+    // Different delimiters, the matrix is converted again
+    integer_matrix(0, 0) = -1;
+
+    LazyMatrix::CSVMatrix<int64_t> csv_format('\"', "\n\r", ",; ", '.');
+
+    auto reformatted_matrix = LazyMatrix::MatrixFactory::create_matrix_from_csv<int64_t>(filename, true, true, matrix_filename, error, 4, csv_format);
+
+    REQUIRE_FALSE(error);
+    REQUIRE(reformatted_matrix(0, 0) == 0);
+    REQUIRE(reformatted_matrix(999, 0) == 999);
+
+    // Same delimiters, the converted matrix is reused
+    reformatted_matrix(0, 0) = -1;
+
+    auto cached_reformatted_matrix = LazyMatrix::MatrixFactory::create_matrix_from_csv<int64_t>(filename, true, true, matrix_filename, error, 4, csv_format);
+
+    REQUIRE_FALSE(error);
+    REQUIRE(cached_reformatted_matrix(0, 0) == -1);
+
+    // Changed csv file, the matrix is converted again
+    createTestCSVFile(filename, "name,a\nrow0,42\n");
+
+    auto converted_again = LazyMatrix::MatrixFactory::create_matrix_from_csv<double>(filename, true, true, matrix_filename, error, 4);
+
+    REQUIRE_FALSE(error);
+    REQUIRE(converted_again.rows() == 1);
+    REQUIRE(converted_again(0, 0) == Catch::Approx(42));
+
+    std::remove(filename.c_str());
+    fs::remove(matrix_filename);
+    fs::remove(fs::path(matrix_filename.string() + ".source"));
+}
+//-------------------------------------------------------------------
@@ -116,6 +116,213 @@ TEST_CASE("DatabaseMatrix operations", "[DatabaseMatrix]")
             auto name_row3 = matrix(2, 1).convert<std::string>();
             REQUIRE(name_row3 == "Alice"); // Third row should now be Alice
         }
+
+        SECTION("Test sequential scans across cache windows")
+        {
+            session << "DROP TABLE IF EXISTS large_table", now;
+            session << "CREATE TABLE large_table (id INTEGER PRIMARY KEY, value INTEGER)", now;
+
+            int number_of_rows = 1000;
+
+            for (int i = 1; i <= number_of_rows; ++i)
+                session << "INSERT INTO large_table (id, value) VALUES(" << i << ", " << 3 * i << ")", now;
+
+            LazyMatrix::SafeName large_table_name("large_table");
+
+            // Windows of 64 rows, paged with keyset pagination on the primary key
+            auto order = GENERATE(std::string("ASC"), std::string("DESC"));
+            LazyMatrix::SafeRowSortingMethod sort_by_id("id", order, true);
+
+            auto large_matrix = LazyMatrix::MatrixFactory::create_database_matrix(session, large_table_name, "value % 2 = 0", 64, sort_by_id, 3);
+
+            REQUIRE(large_matrix.rows() == number_of_rows / 2);
+
+            for (int64_t i = 0; i < int64_t(large_matrix.rows()); ++i)
+            {
+                int expected_id = (order == "ASC") ? 2 * (i + 1) : number_of_rows - 2 * i;
+
+                REQUIRE(large_matrix(i, 0).convert<int>() == expected_id);
+                REQUIRE(large_matrix(i, 1).convert<int>() == 3 * expected_id);
+            }
+
+            // Jumping around falls back to LIMIT and OFFSET
+            int expected_id = (order == "ASC") ? 2 * 301 : number_of_rows - 2 * 300;
+            REQUIRE(large_matrix(300, 0).convert<int>() == expected_id);
+            REQUIRE(large_matrix(0, 0).convert<int>() == ((order == "ASC") ? 2 : number_of_rows));
+        }
+
+        SECTION("Test typed cache")
+        {
+            session << "DROP TABLE IF EXISTS measurements", now;
+            session << "CREATE TABLE measurements (id INTEGER PRIMARY KEY, value REAL, label TEXT)", now;
+
+            for (int i = 1; i <= 300; ++i)
+            {
+                if (i % 7 == 0)
+                    session << "INSERT INTO measurements (id, value, label) VALUES(" << i << ", NULL, NULL)", now;
+                else
+                    session << "INSERT INTO measurements (id, value, label) VALUES(" << i << ", " << i << ".5, 'label " << i << "')", now;
+            }
+
+            LazyMatrix::SafeName measurements_name("measurements");
+            auto measurements = LazyMatrix::MatrixFactory::create_database_matrix(session, measurements_name, "", 32);
+
+            measurements->set_cache_mode(LazyMatrix::DatabaseCacheMode::Typed);
+
+            REQUIRE(measurements->get_column_type(0) == LazyMatrix::DatabaseColumnType::Integer);
+            REQUIRE(measurements->get_column_type(1) == LazyMatrix::DatabaseColumnType::Real);
+            REQUIRE(measurements->get_column_type(2) == LazyMatrix::DatabaseColumnType::Text);
+
+            auto values = LazyMatrix::typed_database_matrix<double>(measurements);
+
+            REQUIRE(values.rows() == 300);
+            REQUIRE(values.columns() == 3);
+
+            for (int64_t i = 0; i < 300; ++i)
+            {
+                int id = int(i) + 1;
+                bool is_null = (id % 7 == 0);
+
+                REQUIRE(values(i, 0) == id);
+                REQUIRE(values(i, 1) == (is_null ? 0.0 : id + 0.5));
+                REQUIRE(measurements->get_value<std::string>(i, 2) == (is_null ? std::string() : "label " + std::to_string(id)));
+
+                // Reading through Poco::Dynamic::Var still works in the typed cache mode
+                REQUIRE(measurements(i, 1).isEmpty() == is_null);
+            }
+        }
+
+        SECTION("Test typed cache with a column holding mixed types")
+        {
+            session << "DROP TABLE IF EXISTS mixed_table", now;
+            session << "CREATE TABLE mixed_table (id INTEGER PRIMARY KEY, value REAL)", now;
+
+            // SQLite keeps text that doesn't look like a number as text, even in a REAL column
+            for (int i = 1; i <= 100; ++i)
+            {
+                if (i == 10)
+                    session << "INSERT INTO mixed_table (id, value) VALUES(" << i << ", 'n/a')", now;
+                else
+                    session << "INSERT INTO mixed_table (id, value) VALUES(" << i << ", " << i << ".5)", now;
+            }
+
+            LazyMatrix::SafeName mixed_table_name("mixed_table");
+            auto mixed = LazyMatrix::MatrixFactory::create_database_matrix(session, mixed_table_name, "", 32);
+
+            mixed->set_cache_mode(LazyMatrix::DatabaseCacheMode::Typed);
+
+            // The window holding the text value is still fetched, and
+            // only that value can't be read as a number
+            REQUIRE_NOTHROW(mixed(9, 1));
+
+            for (int64_t i = 0; i < 100; ++i)
+            {
+                REQUIRE(mixed->get_value<int>(i, 0) == i + 1);
+
+                if (i != 9)
+                    REQUIRE(mixed->get_value<double>(i, 1) == i + 1.5);
+            }
+        }
+
+        SECTION("Test column, row range and predicate pushdown")
+        {
+            session << "DROP TABLE IF EXISTS wide_table", now;
+            session << "CREATE TABLE wide_table (id INTEGER PRIMARY KEY, a INTEGER, b INTEGER, c INTEGER, d INTEGER)", now;
+
+            for (int i = 1; i <= 200; ++i)
+                session << "INSERT INTO wide_table (id, a, b, c, d) VALUES(" << i << ", " << 10 * i + 1 << ", " << 10 * i + 2 << ", " << 10 * i + 3 << ", " << 10 * i + 4 << ")", now;
+
+            LazyMatrix::SafeName wide_table_name("wide_table");
+            LazyMatrix::SafeRowSortingMethod sort_by_id("id", "ASC", true);
+
+            auto wide_matrix = LazyMatrix::MatrixFactory::create_database_matrix(session, wide_table_name, "", 16, sort_by_id);
+
+            // Only columns b and d are queried
+            auto selected_columns = LazyMatrix::columns(wide_matrix, {2, 4, 2});
+
+            REQUIRE(selected_columns.rows() == 200);
+            REQUIRE(selected_columns.columns() == 3);
+            REQUIRE(selected_columns.get_column_header(1) == "d");
+
+            for (int64_t i = 0; i < 200; ++i)
+            {
+                REQUIRE(selected_columns(i, 0).convert<int>() == 10 * (i + 1) + 2);
+                REQUIRE(selected_columns(i, 1).convert<int>() == 10 * (i + 1) + 4);
+                REQUIRE(selected_columns(i, 2).convert<int>() == 10 * (i + 1) + 2);
+            }
+
+            // Only the rows and columns of the ROI are queried, keeping its direction
+            auto region = LazyMatrix::roi(wide_matrix, 150, 3, 101, 1);
+
+            REQUIRE(region.rows() == 50);
+            REQUIRE(region.columns() == 3);
+
+            for (int64_t i = 0; i < 50; ++i)
+                for (int64_t j = 0; j < 3; ++j)
+                    REQUIRE(region(i, j).convert<int>() == 10 * (151 - i) + 3 - j);
+
+            // Comparisons are added to the WHERE clause
+            auto filtered = LazyMatrix::where(LazyMatrix::where(wide_matrix, LazyMatrix::SafeRowPredicate("id", ">", 50)),
+                                              LazyMatrix::SafeRowPredicate("a", "<=", 1001));
+
+            REQUIRE(filtered->get_last_error().empty());
+            REQUIRE(filtered.rows() == 50);
+
+            auto filtered_column = LazyMatrix::column(filtered, 4);
+
+            for (int64_t i = 0; i < 50; ++i)
+                REQUIRE(filtered_column(i, 0).convert<int>() == 10 * (51 + i) + 4);
+
+            // Invalid comparisons give an empty matrix
+            auto invalid = LazyMatrix::where(wide_matrix, LazyMatrix::SafeRowPredicate("a", "LIKE", 1));
+
+            REQUIRE_FALSE(invalid->get_last_error().empty());
+            REQUIRE(invalid.rows() == 0);
+        }
+
+        SECTION("Test selections following later changes of their source")
+        {
+            session << "DROP TABLE IF EXISTS follow_table", now;
+            session << "CREATE TABLE follow_table (id INTEGER PRIMARY KEY, a INTEGER, b INTEGER)", now;
+
+            for (int i = 1; i <= 100; ++i)
+                session << "INSERT INTO follow_table (id, a, b) VALUES(" << i << ", " << 10 * i + 1 << ", " << 10 * i + 2 << ")", now;
+
+            LazyMatrix::SafeName follow_table_name("follow_table");
+            LazyMatrix::SafeRowSortingMethod sort_by_id("id", "ASC", true);
+
+            auto source = LazyMatrix::MatrixFactory::create_database_matrix(session, follow_table_name, "", 16, sort_by_id);
+
+            auto selected_column = LazyMatrix::column(source, 2);
+            auto region = LazyMatrix::roi(source, 0, 1, 9, 2);
+            auto filtered = LazyMatrix::where(source, LazyMatrix::SafeRowPredicate("a", ">", 501));
+
+            REQUIRE(selected_column.rows() == 100);
+            REQUIRE(filtered.rows() == 50);
+            REQUIRE(region(0, 0).convert<int>() == 11);
+
+            // The selections are narrowed down from the new condition
+            source->set_condition("id > 80");
+
+            REQUIRE(selected_column.rows() == 20);
+
+            for (int64_t i = 0; i < 20; ++i)
+                REQUIRE(selected_column(i, 0).convert<int>() == 10 * (81 + i) + 2);
+
+            for (int64_t i = 0; i < 10; ++i)
+                for (int64_t j = 0; j < 2; ++j)
+                    REQUIRE(region(i, j).convert<int>() == 10 * (81 + i) + 1 + j);
+
+            REQUIRE(filtered.rows() == 20);
+            REQUIRE(filtered(0, 0).convert<int>() == 81);
+
+            // Changing the sorting of a selection changes its source too
+            filtered->set_row_sorting_method(LazyMatrix::SafeRowSortingMethod("id", "DESC", true));
+
+            REQUIRE(filtered(0, 0).convert<int>() == 100);
+            REQUIRE(source(0, 0).convert<int>() == 100);
+            REQUIRE(selected_column(0, 0).convert<int>() == 1002);
+        }
     }
     catch (const Poco::Data::SQLite::SQLiteException& sqle)
     {
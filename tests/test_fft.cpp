@@ -0,0 +1,201 @@
+//-------------------------------------------------------------------
+/**
+ * @file test_fft.cpp
+ * @brief Test cases for the native real FFT, the moving window FFT and
+ *        the short-time FFT (spectrogram) of matrix rows.
+ *
+ * This file contains test cases checking the native real FFT kernel and
+ * the short-time FFT against a direct evaluation of the discrete Fourier
+ * transform (of tapered windows), that streaming a signal in pieces gives
+ * the same windows as transforming it at once, and that the moving window
+ * FFT keeps every window.
+ *
+ * @author Vincenzo Barbato
+ *
+ * Additional Information:
+ * - GitHub Project: [LazyMatrix](https://github.com/navyenzo/LazyMatrix.git)
+ * - LinkedIn: [Vincenzo Barbato](https://www.linkedin.com/in/vincenzobarbato/)
+ */
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+#include <catch2/catch_all.hpp>
+#include <complex>
+#include "lazy_matrix.hpp"
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+TEST_CASE("Native real FFT of every row of a matrix", "[FFT]")
+{
+    // Radix 4, 2, 3, 5 and generic stages, odd and prime sizes
+    int64_t columns = GENERATE(1, 2, 3, 8, 12, 30, 49, 97, 210, 1000);
+    int64_t rows = 4;
+
+    auto signal = LazyMatrix::MatrixFactory::create_simple_matrix<double>(LazyMatrix::generate_random_matrix<double>(rows, columns, -1, 1));
+
+    auto spectra = LazyMatrix::real_fft(signal);
+
+    // Lazy expressions without contiguous rows are evaluated a block at a time
+    auto transposed_spectra = LazyMatrix::real_fft(LazyMatrix::transpose(LazyMatrix::transpose(signal)));
+
+    REQUIRE(spectra.rows() == rows);
+    REQUIRE(spectra.columns() == columns / 2 + 1);
+
+    for(int64_t i = 0; i < rows; ++i)
+    {
+        for(int64_t k = 0; k < spectra.columns(); ++k)
+        {
+            std::complex<double> expected_value = 0;
+
+            for(int64_t n = 0; n < columns; ++n)
+                expected_value += signal(i,n) * std::polar(1.0, -2.0 * LazyMatrix::PI * double((k * n) % columns) / double(columns));
+
+            REQUIRE(spectra(i,k).real() == Catch::Approx(expected_value.real()).margin(1e-9));
+            REQUIRE(spectra(i,k).imag() == Catch::Approx(expected_value.imag()).margin(1e-9));
+            REQUIRE(transposed_spectra(i,k) == spectra(i,k));
+        }
+    }
+}
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+TEST_CASE("Short-time FFT of every row of a matrix", "[FFT]")
+{
+    int64_t channels = 3;
+    int64_t samples = 500;
+
+    auto signal = LazyMatrix::MatrixFactory::create_simple_matrix<double>(LazyMatrix::generate_random_matrix<double>(channels, samples, -1, 1));
+
+    uintptr_t window_size = GENERATE(1, 45, 64);
+    uintptr_t hop_size = GENERATE(16, 100);
+
+    auto window_function = GENERATE(LazyMatrix::FFTWindowFunction::Rectangular,
+                                    LazyMatrix::FFTWindowFunction::Hann,
+                                    LazyMatrix::FFTWindowFunction::Hamming);
+
+    LazyMatrix::ShortTimeFFT<double> stft(window_size, hop_size, window_function);
+
+    auto spectrogram = stft.compute(signal);
+
+    REQUIRE(spectrogram.pages() == channels);
+    REQUIRE(spectrogram.rows() == (samples - window_size) / hop_size + 1);
+    REQUIRE(spectrogram.columns() == window_size / 2 + 1);
+
+    auto window_coefficients = LazyMatrix::create_fft_window<double>(window_function, window_size);
+
+    for(int64_t channel = 0; channel < channels; ++channel)
+    {
+        for(int64_t window = 0; window < spectrogram.rows(); ++window)
+        {
+            for(int64_t k = 0; k < spectrogram.columns(); ++k)
+            {
+                std::complex<double> expected_value = 0;
+
+                for(uintptr_t n = 0; n < window_size; ++n)
+                    expected_value += signal(channel, window * hop_size + n) * window_coefficients[n] * std::polar(1.0, -2.0 * LazyMatrix::PI * double(k * n) / double(window_size));
+
+                REQUIRE(spectrogram(channel, window, k).real() == Catch::Approx(expected_value.real()).margin(1e-9));
+                REQUIRE(spectrogram(channel, window, k).imag() == Catch::Approx(expected_value.imag()).margin(1e-9));
+            }
+        }
+    }
+
+    // Streaming the signal in pieces gives the same windows
+    LazyMatrix::ShortTimeFFT<double> streamed_stft(window_size, hop_size, window_function);
+
+    int64_t number_of_streamed_windows = 0;
+
+    for(int64_t first_sample = 0; first_sample < samples; first_sample += 37)
+    {
+        int64_t piece_size = std::min<int64_t>(37, samples - first_sample);
+
+        auto piece = LazyMatrix::MatrixFactory::create_simple_matrix<double>(channels, piece_size, 0.0);
+
+        for(int64_t i = 0; i < channels; ++i)
+            for(int64_t j = 0; j < piece_size; ++j)
+                piece(i,j) = signal(i, first_sample + j);
+
+        auto new_windows = streamed_stft.append(piece);
+
+        for(int64_t channel = 0; channel < channels; ++channel)
+            for(int64_t window = 0; window < new_windows.rows(); ++window)
+                for(int64_t k = 0; k < new_windows.columns(); ++k)
+                    REQUIRE(new_windows(channel, window, k) == spectrogram(channel, number_of_streamed_windows + window, k));
+
+        number_of_streamed_windows += new_windows.rows();
+    }
+
+    REQUIRE(number_of_streamed_windows == spectrogram.rows());
+}
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+TEST_CASE("Moving window FFT keeps every window", "[FFT]")
+{
+    Eigen::MatrixXd data = Eigen::MatrixXd::Random(2, 100);
+    Eigen::MatrixXcd result;
+
+    // Windows of 16 samples overlapping by 8 samples
+    LazyMatrix::fft_moving_window(data, result, 16, 1, 8);
+
+    auto signal = LazyMatrix::MatrixFactory::create_simple_matrix<double>(2, 100, 0.0);
+
+    for(int64_t i = 0; i < 2; ++i)
+        for(int64_t j = 0; j < 100; ++j)
+            signal(i,j) = data(i,j);
+
+    auto spectrogram = LazyMatrix::short_time_fft(signal, 16, 8, LazyMatrix::FFTWindowFunction::Rectangular);
+
+    REQUIRE(result.rows() == 2 * spectrogram.rows());
+    REQUIRE(result.cols() == spectrogram.columns());
+
+    for(int64_t channel = 0; channel < 2; ++channel)
+    {
+        for(int64_t window = 0; window < spectrogram.rows(); ++window)
+        {
+            for(int64_t k = 0; k < spectrogram.columns(); ++k)
+            {
+                auto value = result(channel * spectrogram.rows() + window, k);
+
+                REQUIRE(value.real() == Catch::Approx(spectrogram(channel, window, k).real()).margin(1e-12));
+                REQUIRE(value.imag() == Catch::Approx(spectrogram(channel, window, k).imag()).margin(1e-12));
+            }
+        }
+    }
+}
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+TEST_CASE("Short-time FFT of a lazy view", "[FFT]")
+{
+    auto source = LazyMatrix::MatrixFactory::create_simple_matrix<double>(LazyMatrix::generate_random_matrix<double>(300, 2, -1, 1));
+
+    // A lazy view might not be safe to read from several threads, so
+    // without a pool it's transformed on the calling thread
+    auto signal = LazyMatrix::transpose(source);
+    auto spectrogram = LazyMatrix::short_time_fft(signal, 32, 4);
+
+    LazyMatrix::ThreadPool thread_pool(4);
+    auto materialized_signal = LazyMatrix::MatrixFactory::create_simple_matrix<double>(signal);
+    auto expected_spectrogram = LazyMatrix::short_time_fft(materialized_signal, 32, 4, LazyMatrix::FFTWindowFunction::Hann, thread_pool);
+
+    REQUIRE(spectrogram.pages() == 2);
+    REQUIRE(spectrogram.rows() == expected_spectrogram.rows());
+    REQUIRE(spectrogram.columns() == expected_spectrogram.columns());
+
+    for(int64_t channel = 0; channel < 2; ++channel)
+        for(int64_t window = 0; window < spectrogram.rows(); ++window)
+            for(int64_t k = 0; k < spectrogram.columns(); ++k)
+                REQUIRE(spectrogram(channel, window, k) == expected_spectrogram(channel, window, k));
+}
+//-------------------------------------------------------------------
@@ -0,0 +1,187 @@
+//-------------------------------------------------------------------
+/**
+ * @file test_filters.cpp
+ * @brief Test cases for filtering matrices with filter kernels.
+ *
+ * This file contains test cases for the filter function, checking that
+ * the separable, FFT based and direct methods of applying a kernel all
+ * match a plain reference implementation, borders included, for scalar
+ * matrices and color images filtered on thread pools.
+ *
+ * @author Vincenzo Barbato
+ *
+ * Additional Information:
+ * - GitHub Project: [LazyMatrix](https://github.com/navyenzo/LazyMatrix.git)
+ * - LinkedIn: [Vincenzo Barbato](https://www.linkedin.com/in/vincenzobarbato/)
+ */
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+#include <catch2/catch_all.hpp>
+#include <algorithm>
+#include "lazy_matrix.hpp"
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+/**
+ * @brief Reference filter with the border values repeated outside the source
+ */
+//-------------------------------------------------------------------
+template<typename ReferenceType1, typename ReferenceType2>
+
+std::vector<double> reference_filter(const ReferenceType1& source, const ReferenceType2& kernel)
+{
+    int64_t rows = source.rows();
+    int64_t columns = source.columns();
+
+    std::vector<double> output(rows * columns, 0);
+
+    for(int64_t i = 0; i < rows; ++i)
+    {
+        for(int64_t j = 0; j < columns; ++j)
+        {
+            for(int64_t ki = 0; ki < int64_t(kernel.rows()); ++ki)
+            {
+                for(int64_t kj = 0; kj < int64_t(kernel.columns()); ++kj)
+                {
+                    int64_t row = std::clamp<int64_t>(i + ki - int64_t(kernel.rows() / 2), 0, rows - 1);
+                    int64_t column = std::clamp<int64_t>(j + kj - int64_t(kernel.columns() / 2), 0, columns - 1);
+
+                    output[i * columns + j] += kernel(ki,kj) * source(row,column);
+                }
+            }
+        }
+    }
+
+    return output;
+}
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+TEST_CASE("Filter with a separable gaussian kernel", "[Filters]")
+{
+    auto source = LazyMatrix::MatrixFactory::create_simple_matrix<double>(LazyMatrix::generate_random_matrix<double>(45, 60, 0, 255));
+    auto kernel = LazyMatrix::create_gaussian_kernel(31, 5.0);
+
+    auto expected = reference_filter(source, kernel);
+    auto filtered = LazyMatrix::filter(source, kernel);
+
+    REQUIRE(filtered.rows() == source.rows());
+    REQUIRE(filtered.columns() == source.columns());
+
+    for(int64_t i = 0; i < int64_t(source.rows()); ++i)
+        for(int64_t j = 0; j < int64_t(source.columns()); ++j)
+            REQUIRE(filtered(i,j) == Catch::Approx(expected[i * source.columns() + j]));
+}
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+TEST_CASE("Filter with kernels that aren't separable", "[Filters]")
+{
+    auto source = LazyMatrix::MatrixFactory::create_simple_matrix<double>(LazyMatrix::generate_random_matrix<double>(40, 33, -1, 1));
+
+    // Big kernel (uses FFTs), non square to check the kernel center
+    auto big_kernel = LazyMatrix::MatrixFactory::create_simple_matrix<double>(LazyMatrix::generate_random_matrix<double>(17, 21, -1, 1));
+
+    auto expected = reference_filter(source, big_kernel);
+    auto filtered_fft = LazyMatrix::filter(source, big_kernel);
+    auto filtered_direct = LazyMatrix::filter(source, big_kernel, LazyMatrix::ConvolutionMethod::direct);
+
+    for(int64_t i = 0; i < int64_t(source.rows()); ++i)
+    {
+        for(int64_t j = 0; j < int64_t(source.columns()); ++j)
+        {
+            REQUIRE(filtered_fft(i,j) == Catch::Approx(expected[i * source.columns() + j]).margin(1e-9));
+            REQUIRE(filtered_direct(i,j) == Catch::Approx(expected[i * source.columns() + j]).margin(1e-9));
+        }
+    }
+
+    // Small integer kernel (applied directly) on an integer source
+    auto int_source = LazyMatrix::MatrixFactory::create_simple_matrix<int>(LazyMatrix::generate_random_matrix<int>(20, 25, -100, 100));
+    auto laplacian = LazyMatrix::create_laplacian_kernel<int>();
+
+    auto int_expected = reference_filter(int_source, laplacian);
+    auto int_filtered = LazyMatrix::filter(int_source, laplacian);
+
+    for(int64_t i = 0; i < int64_t(int_source.rows()); ++i)
+        for(int64_t j = 0; j < int64_t(int_source.columns()); ++j)
+            REQUIRE(int_filtered(i,j) == int_expected[i * int_source.columns() + j]);
+}
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+TEST_CASE("Filter lazy views on the calling thread by default", "[Filters]")
+{
+    auto source = LazyMatrix::MatrixFactory::create_simple_matrix<double>(LazyMatrix::generate_random_matrix<double>(80, 35, -1, 1));
+    auto kernel = LazyMatrix::create_gaussian_kernel(7, 1.5);
+
+    // A lazy view might not be safe to read from several threads, so
+    // without a pool it's filtered on the calling thread
+    auto view = LazyMatrix::transpose(source);
+    auto filtered_view = LazyMatrix::filter(view, kernel);
+
+    LazyMatrix::ThreadPool thread_pool(4);
+    auto transposed_source = LazyMatrix::MatrixFactory::create_simple_matrix<double>(view);
+    auto filtered = LazyMatrix::filter(transposed_source, kernel, LazyMatrix::ConvolutionMethod::automatic, thread_pool);
+
+    REQUIRE(filtered_view.rows() == view.rows());
+    REQUIRE(filtered_view.columns() == view.columns());
+
+    for(int64_t i = 0; i < int64_t(view.rows()); ++i)
+        for(int64_t j = 0; j < int64_t(view.columns()); ++j)
+            REQUIRE(filtered_view(i,j) == filtered(i,j));
+}
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+TEST_CASE("Filter color images on a thread pool", "[Filters]")
+{
+    int64_t rows = 70;
+    int64_t columns = 50;
+
+    auto image = LazyMatrix::MatrixFactory::create_image_matrix<dlib::rgb_pixel>(rows, columns);
+    auto red = LazyMatrix::MatrixFactory::create_simple_matrix<double>(rows, columns);
+
+    for(int64_t i = 0; i < rows; ++i)
+    {
+        for(int64_t j = 0; j < columns; ++j)
+        {
+            image(i,j) = dlib::rgb_pixel((i * 7 + j * 3) % 256, 100, (i * j) % 256);
+            red(i,j) = image(i,j).red;
+        }
+    }
+
+    auto kernel = LazyMatrix::create_gaussian_kernel(9, 2.0);
+
+    // The result doesn't depend on the number of threads
+    LazyMatrix::ThreadPool single_thread_pool(1);
+    LazyMatrix::ThreadPool thread_pool(4);
+
+    auto filtered_single_thread = LazyMatrix::filter(image, kernel, LazyMatrix::ConvolutionMethod::automatic, single_thread_pool);
+    auto filtered = LazyMatrix::filter(image, kernel, LazyMatrix::ConvolutionMethod::automatic, thread_pool);
+
+    auto expected_red = reference_filter(red, kernel);
+
+    for(int64_t i = 0; i < rows; ++i)
+    {
+        for(int64_t j = 0; j < columns; ++j)
+        {
+            REQUIRE(filtered(i,j) == filtered_single_thread(i,j));
+            REQUIRE(double(filtered(i,j).red) == Catch::Approx(expected_red[i * columns + j]).margin(0.5 + 1e-9));
+            REQUIRE(int(filtered(i,j).green) == 100);
+        }
+    }
+}
+//-------------------------------------------------------------------
@@ -97,3 +97,103 @@ TEST_CASE("LTTB Downsampling test: Circular sampling", "[Downsampling]")
     }
 }
 //-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+/**
+ * @brief Test for downsampling every row (or column) of a matrix at once.
+ *
+ * This test checks that downsample_lttb_matrix and downsample_lttb_matrix_xy,
+ * which downsample all rows (or columns) in parallel reading them a block at a
+ * time, select the same points as downsampling each row (or column) on its own
+ * with downsample_lttb and downsample_lttb_xy, for forward, reverse and circular
+ * sampling, for sources whose columns aren't contiguous in memory and for
+ * sources whose rows are selected.
+ */
+//-------------------------------------------------------------------
+TEST_CASE("LTTB Downsampling test: Every row or column of a matrix", "[Downsampling]")
+{
+    int64_t channels = 5;
+    int64_t length = 700;
+    int64_t downsampled_length = 37;
+
+    auto source_rows = LazyMatrix::MatrixFactory::create_simple_matrix<double>(LazyMatrix::generate_random_matrix<double>(channels, length, -10, 10));
+    auto source_columns = LazyMatrix::MatrixFactory::create_simple_matrix<double>(LazyMatrix::transpose(source_rows));
+
+    bool sample_rows = GENERATE(true, false);
+
+    auto [start_index, end_index] = GENERATE(std::make_pair<int64_t, int64_t>(0, 699),
+                                             std::make_pair<int64_t, int64_t>(699, 0),
+                                             std::make_pair<int64_t, int64_t>(400, -300));
+
+    auto source = sample_rows ? source_rows : source_columns;
+
+    int64_t destination_rows = sample_rows ? channels : downsampled_length;
+    int64_t destination_columns = sample_rows ? downsampled_length : channels;
+
+    auto destination = LazyMatrix::MatrixFactory::create_simple_matrix<double>(destination_rows, destination_columns, 0.0);
+    auto expected_destination = LazyMatrix::MatrixFactory::create_simple_matrix<double>(destination_rows, destination_columns, 0.0);
+
+    auto xy_destination = LazyMatrix::MatrixFactory::create_simple_matrix<double>(destination_rows, destination_columns, 0.0);
+    auto expected_xy_destination = LazyMatrix::MatrixFactory::create_simple_matrix<double>(destination_rows, destination_columns, 0.0);
+
+    LazyMatrix::downsample_lttb_matrix(source, destination, start_index, end_index, sample_rows);
+    LazyMatrix::downsample_lttb_matrix_xy(source, xy_destination, 0, start_index, end_index, sample_rows);
+
+    for(int64_t channel = 0; channel < channels; ++channel)
+    {
+        if(sample_rows)
+        {
+            LazyMatrix::downsample_lttb(LazyMatrix::row(source, channel), LazyMatrix::row(expected_destination, channel), start_index, end_index);
+
+            if(channel > 0)
+                LazyMatrix::downsample_lttb_xy(LazyMatrix::row(source, 0), LazyMatrix::row(source, channel),
+                                               LazyMatrix::row(expected_xy_destination, 0), LazyMatrix::row(expected_xy_destination, channel),
+                                               start_index, end_index);
+        }
+        else
+        {
+            LazyMatrix::downsample_lttb(LazyMatrix::column(source, channel), LazyMatrix::column(expected_destination, channel), start_index, end_index);
+
+            if(channel > 0)
+                LazyMatrix::downsample_lttb_xy(LazyMatrix::column(source, 0), LazyMatrix::column(source, channel),
+                                               LazyMatrix::column(expected_xy_destination, 0), LazyMatrix::column(expected_xy_destination, channel),
+                                               start_index, end_index);
+        }
+    }
+
+    for(int64_t i = 0; i < destination_rows; ++i)
+    {
+        for(int64_t j = 0; j < destination_columns; ++j)
+        {
+            REQUIRE(destination(i,j) == expected_destination(i,j));
+            REQUIRE(xy_destination(i,j) == expected_xy_destination(i,j));
+        }
+    }
+
+    // Sources without contiguous rows are read element by element
+    auto transposed_destination = LazyMatrix::MatrixFactory::create_simple_matrix<double>(destination_rows, destination_columns, 0.0);
+
+    LazyMatrix::downsample_lttb_matrix(LazyMatrix::transpose(sample_rows ? source_columns : source_rows), transposed_destination, start_index, end_index, sample_rows);
+
+    for(int64_t i = 0; i < destination_rows; ++i)
+        for(int64_t j = 0; j < destination_columns; ++j)
+            REQUIRE(transposed_destination(i,j) == expected_destination(i,j));
+
+    // Sources whose rows are contiguous but not evenly spaced are read
+    // one row at a time
+    std::vector<int64_t> selected_rows(source.rows());
+
+    for(int64_t i = 0; i < source.rows(); ++i)
+        selected_rows[i] = i;
+
+    auto selected_destination = LazyMatrix::MatrixFactory::create_simple_matrix<double>(destination_rows, destination_columns, 0.0);
+
+    LazyMatrix::downsample_lttb_matrix(LazyMatrix::rows(source, selected_rows), selected_destination, start_index, end_index, sample_rows);
+
+    for(int64_t i = 0; i < destination_rows; ++i)
+        for(int64_t j = 0; j < destination_columns; ++j)
+            REQUIRE(selected_destination(i,j) == expected_destination(i,j));
+}
+//-------------------------------------------------------------------
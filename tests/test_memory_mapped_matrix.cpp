@@ -0,0 +1,496 @@
+//-------------------------------------------------------------------
+/**
+ * @file test_memory_mapped_matrix.cpp
+ * @brief Test cases for the memory mapped Matrix class.
+ *
+ * This file contains test cases for growing memory mapped matrices
+ * in place by appending rows to them, for applying memory mapping
+ * hints, for the aligned layout and the capacity of their data, for
+ * sharing them between a writer and lock-free readers, and for
+ * streaming rows through memory mapped ring buffers.
+ *
+ * @author Vincenzo Barbato
+ *
+ * Additional Information:
+ * - GitHub Project: [LazyMatrix](https://github.com/navyenzo/LazyMatrix.git)
+ * - LinkedIn: [Vincenzo Barbato](https://www.linkedin.com/in/vincenzobarbato/)
+ */
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+#include <catch2/catch_all.hpp>
+#include <thread>
+#include <mutex>
+#include "lazy_matrix.hpp"
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+TEST_CASE("Append rows to a memory mapped matrix", "[Matrix]")
+{
+    auto matrix = LazyMatrix::MatrixFactory::create_matrix<double>(2, 3, 1.0);
+
+    auto filename = matrix->get_filename_of_memory_mapped_file();
+
+    // Stream rows one at a time
+    for(int i = 0; i < 1000; ++i)
+    {
+        REQUIRE(!matrix->append_rows(1));
+
+        for(int j = 0; j < 3; ++j)
+            matrix(matrix.rows() - 1, j) = i * 3 + j;
+    }
+
+    REQUIRE(matrix.rows() == 1002);
+    REQUIRE(matrix.columns() == 3);
+
+    // The matrix grew in place, keeping its values
+    REQUIRE(matrix->get_filename_of_memory_mapped_file() == filename);
+    REQUIRE(matrix(0,0) == 1.0);
+    REQUIRE(matrix(1,2) == 1.0);
+
+    for(int i = 0; i < 1000; ++i)
+        for(int j = 0; j < 3; ++j)
+            REQUIRE(matrix(i + 2, j) == i * 3 + j);
+
+    // Capacity grows geometrically
+    REQUIRE(matrix->capacity() >= matrix.size());
+    REQUIRE(matrix->capacity() < 2 * matrix.size());
+
+    // Append the rows of a matrix expression
+    auto more_rows = LazyMatrix::generate_iota_matrix<double>(4, 3, 0, 1);
+
+    REQUIRE(!matrix->append_rows(more_rows));
+    REQUIRE(matrix.rows() == 1006);
+    REQUIRE(matrix(1005,2) == more_rows(3,2));
+
+    // The number of columns has to match
+    auto wrong_rows = LazyMatrix::generate_iota_matrix<double>(2, 5, 0, 1);
+    REQUIRE(matrix->append_rows(wrong_rows));
+
+    // The file can be loaded again with all its rows
+    LazyMatrix::Matrix<double> loaded_matrix(filename.string());
+
+    REQUIRE(loaded_matrix.rows() == 1006);
+    REQUIRE(loaded_matrix(500,1) == matrix(500,1));
+}
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+TEST_CASE("Read rows appended through another mapping of the same file", "[Matrix]")
+{
+    LazyMatrix::Matrix<double> writer(2, 3, 1.0);
+
+    // The reader maps the same file on its own, like another process would
+    LazyMatrix::Matrix<double> reader(writer.get_filename_of_memory_mapped_file().string());
+
+    REQUIRE(reader.rows() == 2);
+    std::size_t size_of_reader_mapping = reader.get_mapped_file_size();
+
+    // Growing the file past the end of the reader's mapping
+    REQUIRE(!writer.append_rows(100, 2.0));
+    REQUIRE(writer.rows() == 102);
+    REQUIRE(reader.get_mapped_file_size() == size_of_reader_mapping);
+
+    // The reader only sees the rows inside its mapping
+    REQUIRE(reader.rows() * reader.row_stride() <= reader.capacity());
+
+    for(int i = 0; i < reader.rows(); ++i)
+        for(int j = 0; j < reader.columns(); ++j)
+            REQUIRE(reader(i,j) == (i < 2 ? 1.0 : 2.0));
+
+    std::vector<double> row(3);
+    REQUIRE(!reader.copy_rows(101, 1, row.data()));
+
+    // Until it maps the file again
+    REQUIRE(!reader.refresh_mapping());
+    REQUIRE(reader.rows() == 102);
+    REQUIRE(reader(101,2) == 2.0);
+    REQUIRE(reader.copy_rows(101, 1, row.data()));
+
+    // Appending through a stale mapping doesn't overwrite the other rows
+    LazyMatrix::Matrix<double> other_writer(writer.get_filename_of_memory_mapped_file().string());
+    REQUIRE(!writer.append_rows(200, 3.0));
+    REQUIRE(!other_writer.append_rows(1, 4.0));
+
+    REQUIRE(other_writer.rows() == 303);
+    REQUIRE(other_writer(301,0) == 3.0);
+    REQUIRE(other_writer(302,0) == 4.0);
+
+    REQUIRE(!writer.refresh_mapping());
+    REQUIRE(writer.rows() == 303);
+    REQUIRE(writer(302,1) == 4.0);
+}
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+TEST_CASE("Apply memory mapping hints to a memory mapped matrix", "[Matrix]")
+{
+    LazyMatrix::Matrix<double> matrix(100, 100, 2.0);
+
+    LazyMatrix::MemoryMappingHints hints;
+    hints.access_pattern = LazyMatrix::MemoryAccessPattern::sequential;
+    hints.prefault = true;
+
+    REQUIRE(!matrix.set_memory_mapping_hints(hints));
+    REQUIRE(matrix.get_memory_mapping_hints().access_pattern == LazyMatrix::MemoryAccessPattern::sequential);
+
+    // The hints are kept when the file is mapped again
+    REQUIRE(!matrix.reserve(200 * 100));
+    REQUIRE(matrix.get_memory_mapping_hints().prefault);
+    REQUIRE(matrix(99,99) == 2.0);
+
+    // Dropping the pages from memory keeps the values in the file
+    matrix(50,50) = 3.0;
+
+    hints.access_pattern = LazyMatrix::MemoryAccessPattern::dont_need;
+    REQUIRE(!matrix.set_memory_mapping_hints(hints));
+
+    REQUIRE(matrix(50,50) == 3.0);
+    REQUIRE(matrix(0,0) == 2.0);
+
+    // Copies share the file and the hints
+    LazyMatrix::Matrix<double> copy(matrix);
+
+    REQUIRE(copy.get_memory_mapping_hints().access_pattern == LazyMatrix::MemoryAccessPattern::dont_need);
+    REQUIRE(copy(50,50) == 3.0);
+}
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+TEST_CASE("Align and pad the data of a memory mapped matrix", "[Matrix]")
+{
+    // The data starts at a 64 byte boundary by default
+    LazyMatrix::Matrix<double> matrix(3, 5, 1.0);
+
+    REQUIRE(matrix.get_data_layout().format_version == 2);
+    REQUIRE(reinterpret_cast<uintptr_t>(matrix.data()) % 64 == 0);
+    REQUIRE(matrix.row_stride() == 5);
+
+    // Padded rows all start at a 64 byte boundary
+    LazyMatrix::Matrix<float> padded;
+
+    LazyMatrix::MatrixDataLayoutOptions options;
+    options.pad_rows = true;
+    padded.set_data_layout_options(options);
+
+    REQUIRE(!padded.create_matrix(4, 5, 2.0f));
+    REQUIRE(padded.row_stride() == 16);
+
+    for(int i = 0; i < 4; ++i)
+        REQUIRE(reinterpret_cast<uintptr_t>(&padded(i,0)) % 64 == 0);
+
+    padded(3,4) = 7.0f;
+
+    REQUIRE(!padded.append_rows(2, 1.0f));
+    REQUIRE(padded(5,4) == 1.0f);
+    REQUIRE(padded(3,4) == 7.0f);
+
+    // Copied rows don't include the padding
+    std::vector<float> rows(6 * 5);
+
+    REQUIRE(padded.copy_rows(0, 6, rows.data()));
+    REQUIRE(rows[3 * 5 + 4] == 7.0f);
+    REQUIRE(rows[5 * 5 + 4] == 1.0f);
+
+    // The layout is read back when loading the file
+    LazyMatrix::Matrix<float> loaded(padded.get_filename_of_memory_mapped_file().string());
+
+    REQUIRE(loaded.row_stride() == 16);
+    REQUIRE(loaded(3,4) == 7.0f);
+}
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+TEST_CASE("Capacity of memory mapped matrices leaves out the footer", "[Matrix][Matrix3D]")
+{
+    // A new file holds exactly the requested entries
+    LazyMatrix::Matrix<double> matrix(3, 4, 1.0);
+
+    REQUIRE(matrix.capacity() == 12);
+
+    LazyMatrix::Matrix3D<double> matrix3d(2, 3, 4, 1.0);
+
+    REQUIRE(matrix3d.capacity() == 24);
+
+    // Growing by less than the size of the footer needs a bigger file,
+    // instead of writing the new entries over the footer
+    REQUIRE(!matrix3d.resize(1, 2, 13));
+    REQUIRE(matrix3d.capacity() >= 26);
+
+    matrix3d(0, 1, 12) = 5.0;
+
+    REQUIRE(matrix3d(0, 1, 12) == 5.0);
+
+    LazyMatrix::Matrix3D<double> loaded(matrix3d.get_filename_of_memory_mapped_file().string());
+
+    REQUIRE(loaded.is_valid());
+    REQUIRE(loaded(0, 1, 12) == 5.0);
+}
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+TEST_CASE("Load a memory mapped matrix written in the older format", "[Matrix]")
+{
+    // Older files have a 16 byte tag followed by the size of the
+    // data type, the rows and the columns, with their data right
+    // after them, at offset 40
+    auto filename = fs::temp_directory_path() / "lazy_matrix_older_format_test";
+
+    {
+        std::ofstream file(filename, std::ios::binary);
+
+        const char tag[16] = {':', ':', '-', '-', '-', 'b', 'e', 'g', 'i', 'n', '-', '-', '-', ':', ':', '\n'};
+        file.write(tag, sizeof(tag));
+
+        for(uintptr_t value : {uintptr_t(sizeof(double)), uintptr_t(2), uintptr_t(3)})
+            file.write(reinterpret_cast<const char*>(&value), sizeof(value));
+
+        REQUIRE(static_cast<std::size_t>(file.tellp()) == 16 + 3 * sizeof(uintptr_t));
+
+        for(int i = 0; i < 6; ++i)
+        {
+            double value = i;
+            file.write(reinterpret_cast<const char*>(&value), sizeof(value));
+        }
+
+        LazyMatrix::MatrixFooter footer;
+        file.write(reinterpret_cast<const char*>(&footer), sizeof(footer));
+    }
+
+    LazyMatrix::Matrix<double> matrix(filename.string());
+
+    REQUIRE(matrix.is_valid());
+    REQUIRE(matrix.get_data_layout().format_version == 1);
+    REQUIRE(matrix.get_data_layout().data_offset == 16 + 3 * sizeof(uintptr_t));
+    REQUIRE(matrix.rows() == 2);
+    REQUIRE(matrix.columns() == 3);
+    REQUIRE(matrix.row_stride() == 3);
+
+    for(int i = 0; i < 2; ++i)
+        for(int j = 0; j < 3; ++j)
+            REQUIRE(matrix(i,j) == double(i * 3 + j));
+
+    REQUIRE(!matrix.append_rows(1, 9.0));
+    REQUIRE(matrix(2,1) == 9.0);
+    REQUIRE(matrix(1,2) == 5.0);
+
+    fs::remove(filename);
+}
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+TEST_CASE("Load a memory mapped 3d matrix written in the older format", "[Matrix3D]")
+{
+    // Older 3d files have a 16 byte tag followed by the size of the
+    // data type, the pages, the rows and the columns, with their data
+    // right after them and no shared lock
+    auto filename = fs::temp_directory_path() / "lazy_matrix3d_older_format_test";
+
+    {
+        std::ofstream file(filename, std::ios::binary);
+
+        const char tag[16] = {'-', '-', '-', 'b', 'e', 'g', 'i', 'n', '_', '3', 'd', '_', '-', '-', '-', '\n'};
+        file.write(tag, sizeof(tag));
+
+        for(uintptr_t value : {uintptr_t(sizeof(double)), uintptr_t(2), uintptr_t(2), uintptr_t(3)})
+            file.write(reinterpret_cast<const char*>(&value), sizeof(value));
+
+        REQUIRE(static_cast<std::size_t>(file.tellp()) == 16 + 4 * sizeof(uintptr_t));
+
+        for(int i = 0; i < 12; ++i)
+        {
+            double value = i;
+            file.write(reinterpret_cast<const char*>(&value), sizeof(value));
+        }
+
+        LazyMatrix::Matrix3DFooter footer;
+        file.write(reinterpret_cast<const char*>(&footer), sizeof(footer));
+    }
+
+    LazyMatrix::Matrix3D<double> matrix(filename.string());
+
+    REQUIRE(matrix.is_valid());
+    REQUIRE(matrix.pages() == 2);
+    REQUIRE(matrix.rows() == 2);
+    REQUIRE(matrix.columns() == 3);
+    REQUIRE(matrix.capacity() == 12);
+
+    for(int k = 0; k < 2; ++k)
+        for(int i = 0; i < 2; ++i)
+            for(int j = 0; j < 3; ++j)
+                REQUIRE(matrix(k,i,j) == double(k * 6 + i * 3 + j));
+
+    // Locking a file with no shared lock does nothing, but writes
+    // still change the version seen by this object
+    REQUIRE(matrix.lock() == 0);
+    matrix.begin_write();
+    matrix(1,1,2) = 42.0;
+    matrix.end_write();
+    matrix.unlock();
+
+    REQUIRE(matrix.get_version() == 2);
+    REQUIRE(matrix.data()[11] == 42.0);
+
+    // Files that carry neither tag are rejected
+    {
+        std::fstream file(filename, std::ios::binary | std::ios::in | std::ios::out);
+        file.write("not a 3d matrix!", 16);
+    }
+
+    LazyMatrix::Matrix3D<double> invalid_matrix;
+    REQUIRE(invalid_matrix.load_matrix(filename.string()));
+
+    // New files are written with the current tag
+    LazyMatrix::Matrix3D<double> new_matrix(1, 2, 2, 1.5);
+    LazyMatrix::Matrix3D<double> loaded_matrix(new_matrix.get_filename_of_memory_mapped_file().string());
+
+    REQUIRE(loaded_matrix.is_valid());
+    REQUIRE(loaded_matrix(0,1,1) == 1.5);
+    REQUIRE(loaded_matrix.capacity() == 4);
+
+    fs::remove(filename);
+}
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+TEST_CASE("Read consistent rows while a writer appends", "[Matrix]")
+{
+    int number_of_rows = 2000;
+    int columns = 16;
+
+    LazyMatrix::Matrix<double> writer(0, columns);
+    REQUIRE(!writer.reserve(number_of_rows * columns));
+
+    // The reader maps the same file on its own, like another process would
+    LazyMatrix::Matrix<double> reader(writer.get_filename_of_memory_mapped_file().string());
+
+    std::thread writer_thread([&]()
+    {
+        for(int i = 0; i < number_of_rows; ++i)
+        {
+            std::lock_guard<LazyMatrix::Matrix<double>> lock(writer);
+
+            writer.begin_write();
+
+            writer.append_rows(1);
+
+            for(int j = 0; j < columns; ++j)
+                writer(i, j) = i;
+
+            writer.end_write();
+        }
+    });
+
+    std::vector<double> row(columns);
+    int number_of_snapshots = 0;
+
+    while(number_of_snapshots < 1000)
+    {
+        uintptr_t rows = 0;
+        reader.read_consistently([&]() { rows = reader.rows(); });
+
+        if(rows == 0 || !reader.copy_rows(rows - 1, 1, row.data()))
+            continue;
+
+        // Every value of a row is written in the same write
+        for(int j = 0; j < columns; ++j)
+            REQUIRE(row[j] == row[0]);
+
+        ++number_of_snapshots;
+    }
+
+    writer_thread.join();
+
+    REQUIRE(reader.rows() == number_of_rows);
+    REQUIRE(reader.get_version() == 2 * number_of_rows);
+}
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+TEST_CASE("Stream rows through a memory mapped ring buffer", "[RingBufferMatrix]")
+{
+    uint64_t number_of_rows = 100000;
+    int columns = 8;
+
+    LazyMatrix::RingBufferMatrix<double> writer(64, columns);
+
+    // The reader maps the same file on its own, like another process would
+    LazyMatrix::RingBufferMatrix<double> reader(writer.get_filename_of_memory_mapped_file().string());
+
+    REQUIRE(reader.is_valid());
+    REQUIRE(reader.capacity() == 64);
+    REQUIRE(reader.columns() == columns);
+
+    // The data type has to match
+    LazyMatrix::RingBufferMatrix<float> wrong_reader(writer.get_filename_of_memory_mapped_file().string());
+    REQUIRE(!wrong_reader.is_valid());
+
+    std::thread writer_thread([&]()
+    {
+        std::vector<double> row(columns);
+
+        for(uint64_t i = 0; i < number_of_rows; ++i)
+        {
+            std::fill(row.begin(), row.end(), double(i));
+            writer.push_row(row.data());
+        }
+    });
+
+    std::vector<double> rows(16 * columns);
+    uint64_t head = 0;
+
+    while(head < number_of_rows)
+    {
+        head = reader.wait_for_rows(head, std::chrono::milliseconds(100));
+
+        uint64_t number_of_copied_rows = reader.copy_latest_rows(16, rows.data());
+
+        // Rows are never torn and come out in order
+        for(uint64_t i = 0; i < number_of_copied_rows; ++i)
+        {
+            for(int j = 0; j < columns; ++j)
+                REQUIRE(rows[i * columns + j] == rows[i * columns]);
+
+            if(i > 0)
+                REQUIRE(rows[i * columns] == rows[(i - 1) * columns] + 1);
+        }
+    }
+
+    writer_thread.join();
+
+    // Only the latest rows are kept, oldest first
+    REQUIRE(reader.get_head() == number_of_rows);
+    REQUIRE(reader.rows() == 64);
+    REQUIRE(reader(0,0) == double(number_of_rows - 64));
+    REQUIRE(reader(63,columns - 1) == double(number_of_rows - 1));
+
+    // Overwritten rows can't be copied anymore
+    std::vector<double> row(columns);
+    REQUIRE(!reader.copy_row(0, row.data()));
+    REQUIRE(reader.copy_row(number_of_rows - 1, row.data()));
+    REQUIRE(row[0] == double(number_of_rows - 1));
+
+    // Waiting without new rows times out
+    REQUIRE(reader.wait_for_rows(number_of_rows, std::chrono::milliseconds(1)) == number_of_rows);
+}
+//-------------------------------------------------------------------
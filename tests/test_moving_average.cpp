@@ -0,0 +1,370 @@
+//-------------------------------------------------------------------
+/**
+ * @file test_moving_average.cpp
+ * @brief Test cases for moving averages and moving window statistics
+ *        of matrix rows and columns.
+ *
+ * This file contains test cases for the simple moving average, checking
+ * that the direct, prefix sums and running sum evaluations all match a
+ * plain reference implementation, and that cached values follow changes
+ * of the input matrix. The moving variance, min/max, percentiles and
+ * exponential moving average are checked against sorted windows.
+ *
+ * @author Vincenzo Barbato
+ *
+ * Additional Information:
+ * - GitHub Project: [LazyMatrix](https://github.com/navyenzo/LazyMatrix.git)
+ * - LinkedIn: [Vincenzo Barbato](https://www.linkedin.com/in/vincenzobarbato/)
+ */
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+#include <catch2/catch_all.hpp>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include "lazy_matrix.hpp"
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+/**
+ * @brief Reference moving average of a row (or column) of a matrix
+ */
+//-------------------------------------------------------------------
+template<typename ReferenceType>
+
+double reference_moving_average(const ReferenceType& source,
+                                int64_t row,
+                                int64_t column,
+                                int64_t number_of_data_points_to_average,
+                                LazyMatrix::MovingAverageDirection direction)
+{
+    bool is_row_average = (direction == LazyMatrix::MovingAverageDirection::RowAverage);
+
+    int64_t position = is_row_average ? column : row;
+    int64_t first_position = std::max<int64_t>(0, position - number_of_data_points_to_average + 1);
+
+    double sum = 0;
+
+    for(int64_t i = first_position; i <= position; ++i)
+        sum += is_row_average ? source(row, i) : source(i, column);
+
+    return sum / double(position + 1 - first_position);
+}
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+TEST_CASE("Moving averages with every evaluation", "[MovingAverage]")
+{
+    int64_t rows = 23;
+    int64_t columns = LazyMatrix::expression_block_size + 41;
+    int64_t number_of_data_points_to_average = 19;
+
+    // Sums are only cached for inputs with a data version
+    auto source = LazyMatrix::MatrixFactory::create_matrix<double>(LazyMatrix::generate_random_matrix<double>(rows, columns, -10, 10));
+
+    auto direction = GENERATE(LazyMatrix::MovingAverageDirection::RowAverage,
+                              LazyMatrix::MovingAverageDirection::ColumnAverage);
+
+    auto evaluation = GENERATE(LazyMatrix::MovingAverageEvaluation::Direct,
+                               LazyMatrix::MovingAverageEvaluation::PrefixSums,
+                               LazyMatrix::MovingAverageEvaluation::RunningSum);
+
+    auto average = LazyMatrix::simple_moving_average(source, number_of_data_points_to_average, direction, evaluation);
+
+    // Read in order, then materialized a row block at a time
+    for(int64_t i = 0; i < rows; ++i)
+        for(int64_t j = 0; j < columns; ++j)
+            REQUIRE(average(i,j) == Catch::Approx(reference_moving_average(source, i, j, number_of_data_points_to_average, direction)));
+
+    LazyMatrix::SimpleMatrix<double> materialized_average(average);
+
+    for(int64_t i = 0; i < rows; ++i)
+        for(int64_t j = 0; j < columns; ++j)
+            REQUIRE(materialized_average(i,j) == Catch::Approx(average(i,j)));
+
+    // Out of order reads
+    REQUIRE(average(rows - 1, columns - 1) == Catch::Approx(reference_moving_average(source, rows - 1, columns - 1, number_of_data_points_to_average, direction)));
+    REQUIRE(average(3, 2) == Catch::Approx(reference_moving_average(source, 3, 2, number_of_data_points_to_average, direction)));
+    REQUIRE(average(3, 2) == Catch::Approx(reference_moving_average(source, 3, 2, number_of_data_points_to_average, direction)));
+}
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+TEST_CASE("Moving averages of a long row of floats keep their precision", "[MovingAverage]")
+{
+    int64_t columns = 1000000;
+    int64_t number_of_data_points_to_average = 8;
+
+    // Large values with small differences, so that the prefix sums
+    // grow far beyond what a float can represent exactly
+    auto source = LazyMatrix::MatrixFactory::create_matrix<float>(LazyMatrix::generate_random_matrix<float>(1, columns, 1000, 1001));
+
+    auto direction = LazyMatrix::MovingAverageDirection::RowAverage;
+
+    auto evaluation = GENERATE(LazyMatrix::MovingAverageEvaluation::PrefixSums,
+                               LazyMatrix::MovingAverageEvaluation::RunningSum);
+
+    auto average = LazyMatrix::simple_moving_average(source, number_of_data_points_to_average, direction, evaluation);
+
+    for(int64_t j = 0; j < columns; j += 997)
+    {
+        double sum = 0;
+
+        for(int64_t i = std::max<int64_t>(0, j - number_of_data_points_to_average + 1); i <= j; ++i)
+            sum += source(0, i);
+
+        double expected = sum / double(std::min(j + 1, number_of_data_points_to_average));
+
+        REQUIRE(average(0, j) == Catch::Approx(expected).epsilon(1e-6));
+    }
+
+    REQUIRE(average(0, columns - 1) == Catch::Approx(reference_moving_average(source, 0, columns - 1, number_of_data_points_to_average, direction)).epsilon(1e-6));
+}
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+TEST_CASE("Cached moving averages follow changes of the input", "[MovingAverage]")
+{
+    auto source = LazyMatrix::MatrixFactory::create_simple_matrix<float>(4, 8, 1.0f);
+
+    auto evaluation = GENERATE(LazyMatrix::MovingAverageEvaluation::PrefixSums,
+                               LazyMatrix::MovingAverageEvaluation::RunningSum);
+
+    auto average = LazyMatrix::simple_moving_average(source, 4, LazyMatrix::MovingAverageDirection::RowAverage, evaluation);
+
+    // A simple matrix has no data version, so its sums aren't cached
+    REQUIRE(average.get_ptr()->get_evaluation() == LazyMatrix::MovingAverageEvaluation::Direct);
+    REQUIRE(average(2,7) == Catch::Approx(1.0f));
+
+    source(2,7) = 5.0f;
+
+    REQUIRE(average(2,7) == Catch::Approx(2.0f));
+
+    // Resizing the input drops the cache automatically
+    source.resize(4, 10);
+    source(3,9) = 9.0f;
+
+    REQUIRE(average(3,9) == Catch::Approx(9.0f / 4.0f));
+
+    // Memory mapped matrices version their writes
+    auto mapped_source = LazyMatrix::MatrixFactory::create_matrix<float>(4, 8, 2.0f);
+    auto mapped_average = LazyMatrix::simple_moving_average(mapped_source, 8, LazyMatrix::MovingAverageDirection::ColumnAverage, evaluation);
+
+    REQUIRE(mapped_average.get_ptr()->get_evaluation() == evaluation);
+    REQUIRE(mapped_average(3,0) == Catch::Approx(2.0f));
+
+    mapped_source->lock();
+    mapped_source->begin_write();
+    mapped_source(3,0) = 6.0f;
+    mapped_source->end_write();
+    mapped_source->unlock();
+
+    REQUIRE(mapped_average(3,0) == Catch::Approx(3.0f));
+
+    // Writes outside of begin_write and end_write require invalidating the cache
+    mapped_source(3,0) = 10.0f;
+    mapped_average.get_ptr()->invalidate_cache();
+
+    REQUIRE(mapped_average(3,0) == Catch::Approx(4.0f));
+}
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+TEST_CASE("Moving window statistics", "[MovingAverage]")
+{
+    int64_t rows = 17;
+    int64_t columns = 60;
+
+    // Values with many repeats to exercise equal values in the windows
+    auto source = LazyMatrix::MatrixFactory::create_simple_matrix<double>(LazyMatrix::generate_random_matrix<int>(rows, columns, -5, 5));
+
+    auto direction = GENERATE(LazyMatrix::MovingAverageDirection::RowAverage,
+                              LazyMatrix::MovingAverageDirection::ColumnAverage);
+
+    int64_t number_of_data_points = GENERATE(1, 2, 13);
+
+    auto variance = LazyMatrix::moving_variance(source, number_of_data_points, direction);
+    auto minimum = LazyMatrix::moving_min(source, number_of_data_points, direction);
+    auto maximum = LazyMatrix::moving_max(source, number_of_data_points, direction);
+    auto median = LazyMatrix::moving_median(source, number_of_data_points, direction);
+    auto percentile = LazyMatrix::moving_percentile(source, number_of_data_points, 90, direction);
+    auto ema = LazyMatrix::exponential_moving_average(source, 0.3, direction);
+
+    bool is_row_direction = (direction == LazyMatrix::MovingAverageDirection::RowAverage);
+
+    for(int64_t i = 0; i < rows; ++i)
+    {
+        for(int64_t j = 0; j < columns; ++j)
+        {
+            int64_t position = is_row_direction ? j : i;
+            int64_t first_position = std::max<int64_t>(0, position - number_of_data_points + 1);
+
+            std::vector<double> window;
+            double expected_ema = 0;
+
+            for(int64_t k = 0; k <= position; ++k)
+            {
+                double value = is_row_direction ? source(i,k) : source(k,j);
+
+                expected_ema = (k == 0) ? value : expected_ema + 0.3 * (value - expected_ema);
+
+                if(k >= first_position)
+                    window.push_back(value);
+            }
+
+            double mean = 0;
+            for(double value : window) mean += value;
+            mean /= double(window.size());
+
+            double sum_of_squares = 0;
+            for(double value : window) sum_of_squares += (value - mean) * (value - mean);
+
+            double expected_variance = window.size() > 1 ? sum_of_squares / double(window.size() - 1) : 0;
+
+            std::sort(window.begin(), window.end());
+
+            auto expected_percentile = [&window](double p)
+            {
+                double rank = p / 100.0 * double(window.size() - 1);
+                uintptr_t lower = uintptr_t(rank);
+
+                if(lower + 1 >= window.size())
+                    return window[lower];
+
+                return window[lower] + (rank - double(lower)) * (window[lower + 1] - window[lower]);
+            };
+
+            REQUIRE(variance(i,j) == Catch::Approx(expected_variance).margin(1e-9));
+            REQUIRE(minimum(i,j) == window.front());
+            REQUIRE(maximum(i,j) == window.back());
+            REQUIRE(median(i,j) == Catch::Approx(expected_percentile(50)));
+            REQUIRE(percentile(i,j) == Catch::Approx(expected_percentile(90)));
+            REQUIRE(ema(i,j) == Catch::Approx(expected_ema));
+        }
+    }
+
+    // A simple matrix has no data version, so nothing is cached
+    source(rows - 1, columns - 1) = 100;
+
+    REQUIRE(maximum(rows - 1, columns - 1) == 100);
+}
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+TEST_CASE("Cached moving window statistics follow changes of the input", "[MovingAverage]")
+{
+    int64_t rows = 9;
+    int64_t columns = 40;
+    int64_t number_of_data_points = 7;
+
+    auto source = LazyMatrix::MatrixFactory::create_simple_matrix<double>(LazyMatrix::generate_random_matrix<double>(rows, columns, -10, 10));
+    auto mapped_source = LazyMatrix::MatrixFactory::create_matrix<double>(source);
+
+    auto direction = GENERATE(LazyMatrix::MovingAverageDirection::RowAverage,
+                              LazyMatrix::MovingAverageDirection::ColumnAverage);
+
+    auto median = LazyMatrix::moving_median(source, number_of_data_points, direction);
+    auto mapped_median = LazyMatrix::moving_median(mapped_source, number_of_data_points, direction);
+    auto maximum = LazyMatrix::moving_max(source, number_of_data_points, direction);
+    auto mapped_maximum = LazyMatrix::moving_max(mapped_source, number_of_data_points, direction);
+
+    // Cached and uncached statistics agree
+    for(int64_t i = 0; i < rows; ++i)
+        for(int64_t j = 0; j < columns; ++j)
+            REQUIRE(mapped_median(i,j) == median(i,j));
+
+    REQUIRE(mapped_maximum(5, 6) < 1000);
+
+    // Writing an element of a simple matrix is seen right away
+    source(4, 5) = 1000;
+    source(4, 6) = 1000;
+    source(5, 5) = 1000;
+    source(5, 6) = 1000;
+
+    REQUIRE(maximum(5, 6) == 1000);
+
+    // Writes to a memory mapped matrix change its version
+    mapped_source->lock();
+    mapped_source->begin_write();
+    mapped_source(4, 5) = 1000;
+    mapped_source(4, 6) = 1000;
+    mapped_source(5, 5) = 1000;
+    mapped_source(5, 6) = 1000;
+    mapped_source->end_write();
+    mapped_source->unlock();
+
+    REQUIRE(mapped_maximum(5, 6) == 1000);
+
+    for(int64_t i = 0; i < rows; ++i)
+        for(int64_t j = 0; j < columns; ++j)
+            REQUIRE(mapped_median(i,j) == median(i,j));
+
+    // Writes outside of begin_write and end_write require invalidating the cache
+    source(4, 7) = -1000;
+    mapped_source(4, 7) = -1000;
+    mapped_median.get_ptr()->invalidate_cache();
+
+    REQUIRE(mapped_median(4, 7) == median(4, 7));
+}
+//-------------------------------------------------------------------
+
+
+
+//-------------------------------------------------------------------
+TEST_CASE("Moving percentiles leave NaN values out of the window", "[MovingAverage]")
+{
+    int64_t columns = 80;
+    int64_t number_of_data_points = 5;
+
+    auto source = LazyMatrix::MatrixFactory::create_simple_matrix<double>(LazyMatrix::generate_random_matrix<double>(1, columns, -10, 10));
+
+    double nan = std::numeric_limits<double>::quiet_NaN();
+
+    for(int64_t j = 0; j < columns; j += 7)
+        source(0, j) = nan;
+
+    // A run longer than the window
+    for(int64_t j = 40; j < 48; ++j)
+        source(0, j) = nan;
+
+    auto median = LazyMatrix::moving_median(source, number_of_data_points, LazyMatrix::MovingAverageDirection::RowAverage);
+
+    for(int64_t j = 0; j < columns; ++j)
+    {
+        std::vector<double> window;
+
+        for(int64_t k = std::max<int64_t>(0, j - number_of_data_points + 1); k <= j; ++k)
+            if(!std::isnan(source(0, k)))
+                window.push_back(source(0, k));
+
+        if(window.empty())
+        {
+            REQUIRE(std::isnan(median(0, j)));
+            continue;
+        }
+
+        std::sort(window.begin(), window.end());
+
+        double rank = 0.5 * double(window.size() - 1);
+        uintptr_t lower = uintptr_t(rank);
+        double expected = (lower + 1 < window.size()) ? window[lower] + (rank - double(lower)) * (window[lower + 1] - window[lower]) : window[lower];
+
+        REQUIRE(median(0, j) == Catch::Approx(expected));
+    }
+}
+//-------------------------------------------------------------------
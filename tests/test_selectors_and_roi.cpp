@@ -100,4 +100,72 @@ TEST_CASE("Rows and Columns Selection and Region Of Interest (ROI)", "[Rows_and_
         REQUIRE(matrix(2,2) == roi_matrix(1,1));
     }
 }
-//-------------------------------------------------------------------
\ No newline at end of file
+//-------------------------------------------------------------------
+
+
+//-------------------------------------------------------------------
+TEST_CASE("Raw access to contiguous rows through views", "[Rows_and_Columns_Selection_and_ROIs]")
+{
+    auto matrix = LazyMatrix::MatrixFactory::create_simple_matrix<double>(LazyMatrix::generate_iota_matrix(4, 5, 0, 1));
+
+    SECTION("ROI test")
+    {
+        auto roi_view = LazyMatrix::roi(matrix, 1, 1, 2, 3);
+
+        REQUIRE(roi_view.data() == &matrix(1,1));
+        REQUIRE(roi_view.row_stride() == matrix.columns());
+
+        auto row = roi_view.row_span(1);
+
+        REQUIRE(row.size() == 3);
+        REQUIRE(row[2] == matrix(2,3));
+
+        row[0] = 100;
+        REQUIRE(matrix(2,1) == 100);
+
+        // Reversed ROIs are not contiguous
+        auto reversed_roi_view = LazyMatrix::roi(matrix, 2, 3, 1, 1);
+
+        REQUIRE(reversed_roi_view.data() == nullptr);
+        REQUIRE(reversed_roi_view.row_span(0).empty());
+    }
+
+    SECTION("selectors test")
+    {
+        auto selected_rows = LazyMatrix::rows(matrix, {3, 0, -1});
+
+        REQUIRE(selected_rows.row_span(0).data() == &matrix(3,0));
+        REQUIRE(selected_rows.row_span(1).data() == &matrix(0,0));
+        REQUIRE(selected_rows.row_span(2).data() == &matrix(3,0));
+
+        auto selected_columns = LazyMatrix::columns(matrix, {1});
+
+        REQUIRE(selected_columns.row_span(0).empty());
+
+        auto selected_column = LazyMatrix::column(matrix, 2);
+
+        REQUIRE(selected_column.data() == &matrix(0,2));
+        REQUIRE(selected_column.data()[3 * selected_column.row_stride()] == matrix(3,2));
+    }
+
+    SECTION("padding test")
+    {
+        REQUIRE(LazyMatrix::create_padded_matrix_view(matrix, 3, 3).data() == matrix.data());
+        REQUIRE(LazyMatrix::create_padded_matrix_view(matrix, 6, 6).data() == nullptr);
+    }
+
+    SECTION("multiplication test")
+    {
+        // Contiguous ROIs use the blocked kernel, reversed ones the generic path
+        auto product = LazyMatrix::roi(matrix, 0, 0, 2, 3) * LazyMatrix::roi(matrix, 0, 1, 3, 2);
+        auto reversed_product = LazyMatrix::roi(matrix, 2, 3, 0, 0) * LazyMatrix::roi(matrix, 3, 2, 0, 1);
+
+        REQUIRE(product.rows() == 3);
+        REQUIRE(product.columns() == 2);
+
+        for(int64_t i = 0; i < 3; ++i)
+            for(int64_t j = 0; j < 2; ++j)
+                REQUIRE(product(i,j) == Catch::Approx(reversed_product(2 - i, 1 - j)));
+    }
+}
+//-------------------------------------------------------------------
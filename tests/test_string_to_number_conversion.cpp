@@ -78,4 +78,85 @@ TEST_CASE("interpret_string function tests", "[interpret_string]")
     // Additional tests can be added here to cover more cases, such as specific expression evaluations,
     // handling of invalid date formats, etc.
 }
-//-------------------------------------------------------------------
\ No newline at end of file
+//-------------------------------------------------------------------
+
+
+//-------------------------------------------------------------------
+/**
+ * @brief Test case for the from_string number parser.
+ *
+ * Tests plain, signed, scientific and custom decimal point numbers,
+ * that doubles are correctly rounded and the position where the
+ * conversion ends.
+ */
+//-------------------------------------------------------------------
+TEST_CASE("from_string function tests", "[from_string]")
+{
+    auto convert = [](const std::string& text, char decimal_point = '.')
+    {
+        double value = -1;
+        int position = LazyMatrix::from_string(value, text.data(), 0, int(text.size()), decimal_point);
+        return std::make_pair(value, position);
+    };
+
+    SECTION("Converts plain and signed numbers")
+    {
+        REQUIRE(convert("42").first == 42);
+        REQUIRE(convert("-42.5").first == -42.5);
+        REQUIRE(convert("+0.25").first == 0.25);
+        REQUIRE(convert("1234567890123456").first == 1234567890123456.0);
+        REQUIRE(convert("").first == 0);
+    }
+
+    SECTION("Converts numbers exactly like the standard library")
+    {
+        std::vector<std::string> numbers = {"0.1", "0.3", "123456.789e-3", "3.141592653589793",
+                                            "2.2250738585072014e-308", "1.7976931348623157e308",
+                                            "12345678901234567890123456789", "9007199254740993",
+                                            "0.000000000000000000001234567890123456789", "4.9e-324"};
+
+        for(const auto& number : numbers)
+            REQUIRE(convert(number).first == std::strtod(number.c_str(), nullptr));
+    }
+
+    SECTION("Converts scientific notation and custom decimal points")
+    {
+        REQUIRE(convert("1.5e3").first == 1500);
+        REQUIRE(convert("-2E-2").first == -0.02);
+        REQUIRE(convert("e3").first == 1000);
+        REQUIRE(convert("3,25", ',').first == 3.25);
+        REQUIRE(convert("-1,5e2", ',').first == -150);
+    }
+
+    SECTION("Stops converting at the first invalid character")
+    {
+        REQUIRE(convert("12.5;7") == std::make_pair(12.5, 4));
+        REQUIRE(convert("7e") == std::make_pair(7.0, 1));
+        REQUIRE(convert("7e+x") == std::make_pair(7.0, 1));
+        REQUIRE(convert("abc").second == 0);
+    }
+
+    SECTION("Converts floats and integers")
+    {
+        std::string text = "0.1";
+        float float_value;
+        LazyMatrix::from_string(float_value, text.data(), 0, int(text.size()), '.');
+        REQUIRE(float_value == 0.1f);
+
+        text = "-123.9";
+        int int_value;
+        LazyMatrix::from_string(int_value, text.data(), 0, int(text.size()), '.');
+        REQUIRE(int_value == -123);
+
+        text = "25e2";
+        LazyMatrix::from_string(int_value, text.data(), 0, int(text.size()), '.');
+        REQUIRE(int_value == 2500);
+    }
+
+    SECTION("Evaluates expressions with decimal and scientific numbers")
+    {
+        LazyMatrix::ExpressionEvaluator<double> evaluator("1.5 + 2e2 * 2");
+        REQUIRE(evaluator.evaluate() == Catch::Approx(401.5));
+    }
+}
+//-------------------------------------------------------------------